@@ -0,0 +1,1077 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "btree_mgr.h"
+#include "storage_mgr.h"
+
+/*
+ * A B+-tree of integer keys kept in a page file. Page 0 holds the meta data, every other page
+ * is a node. A node starts with a small header followed by its keys as one contiguous array,
+ * so a search only touches the cache lines of the keys; the record ids of a leaf, or the child
+ * page numbers of an inner node, follow after room for the maximum number of keys. Leaves are
+ * chained to their right neighbour for range scans. Freed nodes go on a free list and are
+ * reused before the file grows.
+ */
+
+typedef struct BTreeMeta {
+    char magic[8];
+    int32_t keyType;
+    int32_t order;
+    int32_t rootPage;
+    /* levels of the tree, 1 while the root is a leaf */
+    int32_t height;
+    int32_t numNodes;
+    int32_t numEntries;
+    int32_t freeList;
+} BTreeMeta;
+
+typedef struct BTreeNodeHeader {
+    int32_t isLeaf;
+    int32_t numKeys;
+    /* right neighbour of a leaf, next free page of a freed node, -1 for none */
+    int32_t next;
+    int32_t reserved;
+} BTreeNodeHeader;
+
+typedef struct BTreeMgmt {
+    SM_FileHandle fHandle;
+    BTreeMeta meta;
+    int metaDirty;
+    /* a node, its parent, its sibling, and one for the free list */
+    char *node;
+    char *parent;
+    char *sibling;
+    char *scratch;
+    /* room for one entry more than a node holds, used while splitting */
+    int32_t *tmpKeys;
+    int32_t *tmpChildren;
+    RID *tmpRids;
+} BTreeMgmt;
+
+typedef struct BTreeScan {
+    char *page;
+    int pos;
+    int hasHigh;
+    int32_t high;
+} BTreeScan;
+
+#define NODE_HEADER(page) ((BTreeNodeHeader*) (page))
+#define NODE_KEYS(page) ((int32_t*) ((page) + BTREE_NODE_HEADER_SIZE))
+#define NO_PAGE -1
+
+
+/************************************************************
+ *                    node layout                           *
+ ************************************************************/
+
+static RID *leafRids(BTreeMgmt *mgmt, char *page)
+{
+    return (RID*) (page + BTREE_NODE_HEADER_SIZE + sizeof(int32_t) * (size_t) mgmt->meta.order);
+}
+
+static int32_t *nodeChildren(BTreeMgmt *mgmt, char *page)
+{
+    return (int32_t*) (page + BTREE_NODE_HEADER_SIZE + sizeof(int32_t) * (size_t) mgmt->meta.order);
+}
+
+/**
+ * @brief Largest order whose leaves fit in a page; leaves need more room than inner nodes.
+ */
+static int maxOrder(int pageSize)
+{
+    return (pageSize - BTREE_NODE_HEADER_SIZE) / (int) (sizeof(int32_t) + sizeof(RID));
+}
+
+/**
+ * @brief Counts the keys of a sorted node that are smaller than key. Large nodes are narrowed
+ *        down by halving where the comparison only selects the step, so there is no branch to
+ *        mispredict; the last few keys are counted in one pass the compiler can vectorize.
+ */
+static inline int keysBelow(const int32_t *keys, int numKeys, int32_t key)
+{
+    const int32_t *base = keys;
+    int len = numKeys;
+    while (len > BTREE_LINEAR_SEARCH_KEYS) {
+        int half = len / 2;
+        base += (base[half - 1] < key) ? half : 0;
+        len -= half;
+    }
+    int count = 0;
+    for (int i = 0; i < len; i++) {
+        count += base[i] < key;
+    }
+    return (int) (base - keys) + count;
+}
+
+/**
+ * @brief Counts the keys of a sorted node that are not larger than key, which is the child
+ *        an inner node leads to: separators are the smallest key of their right subtree.
+ */
+static inline int keysNotAbove(const int32_t *keys, int numKeys, int32_t key)
+{
+    return key == INT32_MAX ? numKeys : keysBelow(keys, numKeys, key + 1);
+}
+
+
+/************************************************************
+ *                    node pages                            *
+ ************************************************************/
+
+static RC readNode(BTreeMgmt *mgmt, int pageNum, char *page)
+{
+    return readBlock(pageNum, &mgmt->fHandle, page);
+}
+
+static RC writeNode(BTreeMgmt *mgmt, int pageNum, char *page)
+{
+    return writeBlock(pageNum, &mgmt->fHandle, page);
+}
+
+static void initNode(BTreeMgmt *mgmt, char *page, int isLeaf)
+{
+    memset(page, 0, (size_t) mgmt->fHandle.pageSize);
+    NODE_HEADER(page)->isLeaf = isLeaf;
+    NODE_HEADER(page)->next = NO_PAGE;
+}
+
+/**
+ * @brief Takes a page for a new node from the free list, or appends one.
+ */
+static RC allocateNode(BTreeMgmt *mgmt, int *pageNum)
+{
+    if (mgmt->meta.freeList != NO_PAGE) {
+        RC rc = readNode(mgmt, mgmt->meta.freeList, mgmt->scratch);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        *pageNum = mgmt->meta.freeList;
+        mgmt->meta.freeList = NODE_HEADER(mgmt->scratch)->next;
+    }
+    else {
+        RC rc = appendEmptyBlock(&mgmt->fHandle);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        *pageNum = mgmt->fHandle.totalNumPages - 1;
+    }
+    mgmt->meta.numNodes++;
+    mgmt->metaDirty = 1;
+    return RC_OK;
+}
+
+static RC freeNode(BTreeMgmt *mgmt, int pageNum)
+{
+    initNode(mgmt, mgmt->scratch, -1);
+    NODE_HEADER(mgmt->scratch)->next = mgmt->meta.freeList;
+    RC rc = writeNode(mgmt, pageNum, mgmt->scratch);
+    if (rc == RC_OK) {
+        mgmt->meta.freeList = pageNum;
+        mgmt->meta.numNodes--;
+        mgmt->metaDirty = 1;
+    }
+    return rc;
+}
+
+/**
+ * @brief Walks from the root to the leaf that holds key, which ends up in page. path receives
+ *        the page of every level and childIdx the child taken in every inner node.
+ */
+static RC descend(BTreeMgmt *mgmt, int32_t key, int *path, int *childIdx, char *page)
+{
+    int pageNum = mgmt->meta.rootPage;
+    for (int level = 0; ; level++) {
+        RC rc = readNode(mgmt, pageNum, page);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        path[level] = pageNum;
+        if (NODE_HEADER(page)->isLeaf) {
+            return RC_OK;
+        }
+        if (level + 1 >= BTREE_MAX_HEIGHT) {
+            return RC_PAGE_CORRUPT;
+        }
+        childIdx[level] = keysNotAbove(NODE_KEYS(page), NODE_HEADER(page)->numKeys, key);
+        pageNum = nodeChildren(mgmt, page)[childIdx[level]];
+    }
+}
+
+static RC writeMeta(BTreeMgmt *mgmt)
+{
+    memset(mgmt->scratch, 0, (size_t) mgmt->fHandle.pageSize);
+    memcpy(mgmt->scratch, &mgmt->meta, sizeof(mgmt->meta));
+    RC rc = writeBlock(0, &mgmt->fHandle, mgmt->scratch);
+    if (rc == RC_OK) {
+        mgmt->metaDirty = 0;
+    }
+    return rc;
+}
+
+/**
+ * @brief Checks that the tree is open and the key has the tree's type.
+ */
+static RC checkKey(BTreeHandle *tree, Value *key)
+{
+    if (tree == NULL || tree->mgmtData == NULL || key == NULL) {
+        printMessage("The index is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (key->dt != tree->keyType) {
+        printMessage("The key does not have the type of index %s.\n", tree->idxId);
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    }
+    return RC_OK;
+}
+
+
+/************************************************************
+ *                    insertion                             *
+ ************************************************************/
+
+/**
+ * @brief Adds the separator and right half of a split child to the inner node at level,
+ *        splitting inner nodes upwards as long as they are full and growing a new root when
+ *        the old one splits.
+ */
+static RC insertIntoParent(BTreeMgmt *mgmt, int *path, int *childIdx, int level, int32_t sepKey, int rightChild)
+{
+    int n = mgmt->meta.order;
+    for (; level >= 0; level--) {
+        char *node = mgmt->node;
+        RC rc = readNode(mgmt, path[level], node);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        BTreeNodeHeader *header = NODE_HEADER(node);
+        int32_t *keys = NODE_KEYS(node);
+        int32_t *children = nodeChildren(mgmt, node);
+        int pos = childIdx[level];
+        if (header->numKeys < n) {
+            memmove(keys + pos + 1, keys + pos, sizeof(int32_t) * (size_t) (header->numKeys - pos));
+            memmove(children + pos + 2, children + pos + 1, sizeof(int32_t) * (size_t) (header->numKeys - pos));
+            keys[pos] = sepKey;
+            children[pos + 1] = rightChild;
+            header->numKeys++;
+            return writeNode(mgmt, path[level], node);
+        }
+        // n + 1 keys and n + 2 children: the middle key moves up, the rest is split in two.
+        memcpy(mgmt->tmpKeys, keys, sizeof(int32_t) * (size_t) pos);
+        mgmt->tmpKeys[pos] = sepKey;
+        memcpy(mgmt->tmpKeys + pos + 1, keys + pos, sizeof(int32_t) * (size_t) (n - pos));
+        memcpy(mgmt->tmpChildren, children, sizeof(int32_t) * (size_t) (pos + 1));
+        mgmt->tmpChildren[pos + 1] = rightChild;
+        memcpy(mgmt->tmpChildren + pos + 2, children + pos + 1, sizeof(int32_t) * (size_t) (n - pos));
+        int middle = (n + 1) / 2;
+        int rightPage;
+        if ((rc = allocateNode(mgmt, &rightPage)) != RC_OK) {
+            return rc;
+        }
+        char *right = mgmt->sibling;
+        initNode(mgmt, right, 0);
+        NODE_HEADER(right)->numKeys = n - middle;
+        memcpy(NODE_KEYS(right), mgmt->tmpKeys + middle + 1, sizeof(int32_t) * (size_t) (n - middle));
+        memcpy(nodeChildren(mgmt, right), mgmt->tmpChildren + middle + 1, sizeof(int32_t) * (size_t) (n - middle + 1));
+        header->numKeys = middle;
+        memcpy(keys, mgmt->tmpKeys, sizeof(int32_t) * (size_t) middle);
+        memcpy(children, mgmt->tmpChildren, sizeof(int32_t) * (size_t) (middle + 1));
+        if ((rc = writeNode(mgmt, path[level], node)) != RC_OK || (rc = writeNode(mgmt, rightPage, right)) != RC_OK) {
+            return rc;
+        }
+        sepKey = mgmt->tmpKeys[middle];
+        rightChild = rightPage;
+    }
+    // The root was split, so the tree grows by one level.
+    int rootPage;
+    RC rc = allocateNode(mgmt, &rootPage);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    char *root = mgmt->sibling;
+    initNode(mgmt, root, 0);
+    NODE_HEADER(root)->numKeys = 1;
+    NODE_KEYS(root)[0] = sepKey;
+    nodeChildren(mgmt, root)[0] = mgmt->meta.rootPage;
+    nodeChildren(mgmt, root)[1] = rightChild;
+    if ((rc = writeNode(mgmt, rootPage, root)) != RC_OK) {
+        return rc;
+    }
+    mgmt->meta.rootPage = rootPage;
+    mgmt->meta.height++;
+    mgmt->metaDirty = 1;
+    return RC_OK;
+}
+
+/**
+ * @brief Inserts an entry at pos of the leaf in mgmt->node, splitting the leaf if it is full.
+ */
+static RC insertIntoLeaf(BTreeMgmt *mgmt, int *path, int *childIdx, int pos, int32_t key, RID rid)
+{
+    int n = mgmt->meta.order;
+    int leafLevel = mgmt->meta.height - 1;
+    char *leaf = mgmt->node;
+    BTreeNodeHeader *header = NODE_HEADER(leaf);
+    int32_t *keys = NODE_KEYS(leaf);
+    RID *rids = leafRids(mgmt, leaf);
+    if (header->numKeys < n) {
+        memmove(keys + pos + 1, keys + pos, sizeof(int32_t) * (size_t) (header->numKeys - pos));
+        memmove(rids + pos + 1, rids + pos, sizeof(RID) * (size_t) (header->numKeys - pos));
+        keys[pos] = key;
+        rids[pos] = rid;
+        header->numKeys++;
+        return writeNode(mgmt, path[leafLevel], leaf);
+    }
+    // n + 1 entries: the left leaf keeps the larger half and the right leaf's first key goes up.
+    memcpy(mgmt->tmpKeys, keys, sizeof(int32_t) * (size_t) pos);
+    mgmt->tmpKeys[pos] = key;
+    memcpy(mgmt->tmpKeys + pos + 1, keys + pos, sizeof(int32_t) * (size_t) (n - pos));
+    memcpy(mgmt->tmpRids, rids, sizeof(RID) * (size_t) pos);
+    mgmt->tmpRids[pos] = rid;
+    memcpy(mgmt->tmpRids + pos + 1, rids + pos, sizeof(RID) * (size_t) (n - pos));
+    int leftCount = (n + 2) / 2;
+    int rightCount = n + 1 - leftCount;
+    int rightPage;
+    RC rc = allocateNode(mgmt, &rightPage);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    char *right = mgmt->sibling;
+    initNode(mgmt, right, 1);
+    NODE_HEADER(right)->numKeys = rightCount;
+    NODE_HEADER(right)->next = header->next;
+    memcpy(NODE_KEYS(right), mgmt->tmpKeys + leftCount, sizeof(int32_t) * (size_t) rightCount);
+    memcpy(leafRids(mgmt, right), mgmt->tmpRids + leftCount, sizeof(RID) * (size_t) rightCount);
+    header->numKeys = leftCount;
+    header->next = rightPage;
+    memcpy(keys, mgmt->tmpKeys, sizeof(int32_t) * (size_t) leftCount);
+    memcpy(rids, mgmt->tmpRids, sizeof(RID) * (size_t) leftCount);
+    if ((rc = writeNode(mgmt, path[leafLevel], leaf)) != RC_OK || (rc = writeNode(mgmt, rightPage, right)) != RC_OK) {
+        return rc;
+    }
+    return insertIntoParent(mgmt, path, childIdx, leafLevel - 1, mgmt->tmpKeys[leftCount], rightPage);
+}
+
+
+/************************************************************
+ *                    deletion                              *
+ ************************************************************/
+
+/**
+ * @brief Moves one entry from a sibling with keys to spare into the underfull node.
+ *        The separator in the parent is updated to the new boundary.
+ */
+static void borrowEntry(BTreeMgmt *mgmt, char *node, char *sibling, int32_t *sepKey, int fromLeft)
+{
+    BTreeNodeHeader *header = NODE_HEADER(node);
+    BTreeNodeHeader *sibHeader = NODE_HEADER(sibling);
+    int32_t *keys = NODE_KEYS(node);
+    int32_t *sibKeys = NODE_KEYS(sibling);
+    int num = header->numKeys;
+    int sibNum = sibHeader->numKeys;
+    if (header->isLeaf) {
+        RID *rids = leafRids(mgmt, node);
+        RID *sibRids = leafRids(mgmt, sibling);
+        if (fromLeft) {
+            memmove(keys + 1, keys, sizeof(int32_t) * (size_t) num);
+            memmove(rids + 1, rids, sizeof(RID) * (size_t) num);
+            keys[0] = sibKeys[sibNum - 1];
+            rids[0] = sibRids[sibNum - 1];
+            *sepKey = keys[0];
+        }
+        else {
+            keys[num] = sibKeys[0];
+            rids[num] = sibRids[0];
+            memmove(sibKeys, sibKeys + 1, sizeof(int32_t) * (size_t) (sibNum - 1));
+            memmove(sibRids, sibRids + 1, sizeof(RID) * (size_t) (sibNum - 1));
+            *sepKey = sibKeys[0];
+        }
+    }
+    else {
+        int32_t *children = nodeChildren(mgmt, node);
+        int32_t *sibChildren = nodeChildren(mgmt, sibling);
+        // Inner nodes rotate through the parent: the separator comes down, the sibling's key goes up.
+        if (fromLeft) {
+            memmove(keys + 1, keys, sizeof(int32_t) * (size_t) num);
+            memmove(children + 1, children, sizeof(int32_t) * (size_t) (num + 1));
+            keys[0] = *sepKey;
+            children[0] = sibChildren[sibNum];
+            *sepKey = sibKeys[sibNum - 1];
+        }
+        else {
+            keys[num] = *sepKey;
+            children[num + 1] = sibChildren[0];
+            *sepKey = sibKeys[0];
+            memmove(sibKeys, sibKeys + 1, sizeof(int32_t) * (size_t) (sibNum - 1));
+            memmove(sibChildren, sibChildren + 1, sizeof(int32_t) * (size_t) sibNum);
+        }
+    }
+    header->numKeys++;
+    sibHeader->numKeys--;
+}
+
+/**
+ * @brief Appends the right node to the left one; inner nodes take the separator in between.
+ */
+static void mergeNodes(BTreeMgmt *mgmt, char *left, char *right, int32_t sepKey)
+{
+    BTreeNodeHeader *leftHeader = NODE_HEADER(left);
+    BTreeNodeHeader *rightHeader = NODE_HEADER(right);
+    int leftNum = leftHeader->numKeys;
+    int rightNum = rightHeader->numKeys;
+    if (leftHeader->isLeaf) {
+        memcpy(NODE_KEYS(left) + leftNum, NODE_KEYS(right), sizeof(int32_t) * (size_t) rightNum);
+        memcpy(leafRids(mgmt, left) + leftNum, leafRids(mgmt, right), sizeof(RID) * (size_t) rightNum);
+        leftHeader->numKeys = leftNum + rightNum;
+        leftHeader->next = rightHeader->next;
+    }
+    else {
+        NODE_KEYS(left)[leftNum] = sepKey;
+        memcpy(NODE_KEYS(left) + leftNum + 1, NODE_KEYS(right), sizeof(int32_t) * (size_t) rightNum);
+        memcpy(nodeChildren(mgmt, left) + leftNum + 1, nodeChildren(mgmt, right), sizeof(int32_t) * (size_t) (rightNum + 1));
+        leftHeader->numKeys = leftNum + 1 + rightNum;
+    }
+}
+
+/**
+ * @brief Writes back the node in mgmt->node after an entry was removed from it, refilling it
+ *        from a sibling or merging it with one while it has too few keys, up to the root.
+ */
+static RC rebalance(BTreeMgmt *mgmt, int *path, int *childIdx)
+{
+    int n = mgmt->meta.order;
+    for (int level = mgmt->meta.height - 1; ; level--) {
+        char *node = mgmt->node;
+        BTreeNodeHeader *header = NODE_HEADER(node);
+        int minKeys = header->isLeaf ? (n + 1) / 2 : n / 2;
+        RC rc;
+        if (level == 0) {
+            // An inner root without keys has a single child, which becomes the root.
+            if (!header->isLeaf && header->numKeys == 0) {
+                int newRoot = nodeChildren(mgmt, node)[0];
+                if ((rc = freeNode(mgmt, path[0])) != RC_OK) {
+                    return rc;
+                }
+                mgmt->meta.rootPage = newRoot;
+                mgmt->meta.height--;
+                mgmt->metaDirty = 1;
+                return RC_OK;
+            }
+            return writeNode(mgmt, path[0], node);
+        }
+        if (header->numKeys >= minKeys) {
+            return writeNode(mgmt, path[level], node);
+        }
+        char *parent = mgmt->parent;
+        char *sibling = mgmt->sibling;
+        if ((rc = readNode(mgmt, path[level - 1], parent)) != RC_OK) {
+            return rc;
+        }
+        int c = childIdx[level - 1];
+        int fromLeft = c > 0;
+        int sepIdx = fromLeft ? c - 1 : c;
+        int siblingPage = nodeChildren(mgmt, parent)[fromLeft ? c - 1 : c + 1];
+        int32_t *parentKeys = NODE_KEYS(parent);
+        if ((rc = readNode(mgmt, siblingPage, sibling)) != RC_OK) {
+            return rc;
+        }
+        if (NODE_HEADER(sibling)->numKeys > minKeys) {
+            borrowEntry(mgmt, node, sibling, &parentKeys[sepIdx], fromLeft);
+            if ((rc = writeNode(mgmt, path[level], node)) != RC_OK
+                || (rc = writeNode(mgmt, siblingPage, sibling)) != RC_OK) {
+                return rc;
+            }
+            return writeNode(mgmt, path[level - 1], parent);
+        }
+        // Both nodes are at their minimum, so together they fit in one.
+        int leftPage = fromLeft ? siblingPage : path[level];
+        int rightPage = fromLeft ? path[level] : siblingPage;
+        char *left = fromLeft ? sibling : node;
+        mergeNodes(mgmt, left, fromLeft ? node : sibling, parentKeys[sepIdx]);
+        if ((rc = writeNode(mgmt, leftPage, left)) != RC_OK || (rc = freeNode(mgmt, rightPage)) != RC_OK) {
+            return rc;
+        }
+        BTreeNodeHeader *parentHeader = NODE_HEADER(parent);
+        int32_t *parentChildren = nodeChildren(mgmt, parent);
+        memmove(parentKeys + sepIdx, parentKeys + sepIdx + 1, sizeof(int32_t) * (size_t) (parentHeader->numKeys - sepIdx - 1));
+        memmove(parentChildren + sepIdx + 1, parentChildren + sepIdx + 2, sizeof(int32_t) * (size_t) (parentHeader->numKeys - sepIdx - 1));
+        parentHeader->numKeys--;
+        // The parent lost a key and is checked next.
+        mgmt->parent = mgmt->node;
+        mgmt->node = parent;
+    }
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Initializes the index manager and the storage manager below it.
+ *
+ * @param mgmtData Unused.
+ * @return RC_OK
+ */
+RC initIndexManager(void *mgmtData)
+{
+    (void) mgmtData;
+    initStorageManager();
+    return RC_OK;
+}
+
+
+/**
+ * @brief Shuts the index manager down. Open indexes have to be closed first.
+ *
+ * @return RC_OK
+ */
+RC shutdownIndexManager(void)
+{
+    return RC_OK;
+}
+
+
+/**
+ * @brief Creates a B+-tree index in a new page file with an empty root leaf.
+ *
+ * @param idxId Name of the page file of the index.
+ * @param keyType Type of the keys; only DT_INT is supported.
+ * @param n Order of the tree, the maximum number of keys in a node.
+ * @return RC_OK if successful.
+ *         RC_RM_UNKOWN_DATATYPE if the key type is not supported.
+ *         RC_IM_N_TO_LAGE if nodes of order n do not fit in a page.
+ *         RC_WRITE_FAILED if n is below 2 or the file could not be written.
+ */
+RC createBtree(char *idxId, DataType keyType, int n)
+{
+    if (idxId == NULL) {
+        printMessage("The index can't be created because its name is null.\n");
+        return RC_FILE_NOT_FOUND;
+    }
+    if (keyType != DT_INT) {
+        printMessage("Only integer keys are supported.\n");
+        return RC_RM_UNKOWN_DATATYPE;
+    }
+    if (n > maxOrder(PAGE_SIZE)) {
+        printMessage("Nodes with %d keys do not fit in a page; the largest order is %d.\n", n, maxOrder(PAGE_SIZE));
+        return RC_IM_N_TO_LAGE;
+    }
+    if (n < 2) {
+        printMessage("A B+-tree needs room for at least two keys per node.\n");
+        return RC_WRITE_FAILED;
+    }
+    RC rc = createPageFile(idxId);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    BTreeMgmt mgmt;
+    memset(&mgmt, 0, sizeof(mgmt));
+    if ((rc = openPageFile(idxId, &mgmt.fHandle)) != RC_OK) {
+        return rc;
+    }
+    memcpy(mgmt.meta.magic, BTREE_MAGIC, sizeof(mgmt.meta.magic));
+    mgmt.meta.keyType = keyType;
+    mgmt.meta.order = n;
+    mgmt.meta.rootPage = 1;
+    mgmt.meta.height = 1;
+    mgmt.meta.numNodes = 1;
+    mgmt.meta.numEntries = 0;
+    mgmt.meta.freeList = NO_PAGE;
+    mgmt.scratch = (char*) malloc((size_t) mgmt.fHandle.pageSize);
+    if (mgmt.scratch == NULL) {
+        closePageFile(&mgmt.fHandle);
+        return RC_WRITE_FAILED;
+    }
+    rc = ensureCapacity(2, &mgmt.fHandle);
+    if (rc == RC_OK) {
+        rc = writeMeta(&mgmt);
+    }
+    if (rc == RC_OK) {
+        initNode(&mgmt, mgmt.scratch, 1);
+        rc = writeNode(&mgmt, 1, mgmt.scratch);
+    }
+    free(mgmt.scratch);
+    RC closeCheck = closePageFile(&mgmt.fHandle);
+    return rc != RC_OK ? rc : closeCheck;
+}
+
+
+/**
+ * @brief Opens an index created with createBtree.
+ *
+ * @param tree Receives the handle of the open index.
+ * @param idxId Name of the page file of the index.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the index does not exist.
+ *         RC_PAGE_CORRUPT if the file is not an index.
+ */
+RC openBtree(BTreeHandle **tree, char *idxId)
+{
+    if (tree == NULL || idxId == NULL) {
+        printMessage("The index can't be opened because its name or handle is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    BTreeHandle *handle = (BTreeHandle*) calloc(1, sizeof(BTreeHandle));
+    BTreeMgmt *mgmt = (BTreeMgmt*) calloc(1, sizeof(BTreeMgmt));
+    char *name = strdup(idxId);
+    if (handle == NULL || mgmt == NULL || name == NULL) {
+        free(handle);
+        free(mgmt);
+        free(name);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = openPageFile(name, &mgmt->fHandle);
+    if (rc != RC_OK) {
+        free(handle);
+        free(mgmt);
+        free(name);
+        return rc;
+    }
+    size_t pageSize = (size_t) mgmt->fHandle.pageSize;
+    mgmt->node = (char*) malloc(pageSize);
+    mgmt->parent = (char*) malloc(pageSize);
+    mgmt->sibling = (char*) malloc(pageSize);
+    mgmt->scratch = (char*) malloc(pageSize);
+    if (mgmt->node == NULL || mgmt->parent == NULL || mgmt->sibling == NULL || mgmt->scratch == NULL) {
+        rc = RC_WRITE_FAILED;
+    }
+    else if ((rc = readBlock(0, &mgmt->fHandle, mgmt->scratch)) == RC_OK) {
+        memcpy(&mgmt->meta, mgmt->scratch, sizeof(mgmt->meta));
+        if (memcmp(mgmt->meta.magic, BTREE_MAGIC, sizeof(mgmt->meta.magic)) != 0
+            || mgmt->meta.order < 2 || mgmt->meta.order > maxOrder(mgmt->fHandle.pageSize)) {
+            printMessage("The file %s is not a B+-tree index!\n", name);
+            rc = RC_PAGE_CORRUPT;
+        }
+    }
+    if (rc == RC_OK) {
+        int n = mgmt->meta.order;
+        mgmt->tmpKeys = (int32_t*) malloc(sizeof(int32_t) * (size_t) (n + 1));
+        mgmt->tmpChildren = (int32_t*) malloc(sizeof(int32_t) * (size_t) (n + 2));
+        mgmt->tmpRids = (RID*) malloc(sizeof(RID) * (size_t) (n + 1));
+        if (mgmt->tmpKeys == NULL || mgmt->tmpChildren == NULL || mgmt->tmpRids == NULL) {
+            rc = RC_WRITE_FAILED;
+        }
+    }
+    handle->keyType = (DataType) mgmt->meta.keyType;
+    handle->idxId = name;
+    handle->mgmtData = mgmt;
+    if (rc != RC_OK) {
+        mgmt->metaDirty = 0;
+        closeBtree(handle);
+        return rc;
+    }
+    *tree = handle;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Writes the meta data of an index and closes it.
+ *
+ * @param tree The open index.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the index is not open.
+ *         RC_WRITE_FAILED if the meta data could not be written.
+ */
+RC closeBtree(BTreeHandle *tree)
+{
+    if (tree == NULL || tree->mgmtData == NULL) {
+        printMessage("The index is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    BTreeMgmt *mgmt = (BTreeMgmt*) tree->mgmtData;
+    RC rc = mgmt->metaDirty ? writeMeta(mgmt) : RC_OK;
+    if (closePageFile(&mgmt->fHandle) != RC_OK && rc == RC_OK) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(mgmt->node);
+    free(mgmt->parent);
+    free(mgmt->sibling);
+    free(mgmt->scratch);
+    free(mgmt->tmpKeys);
+    free(mgmt->tmpChildren);
+    free(mgmt->tmpRids);
+    free(mgmt);
+    free(tree->idxId);
+    free(tree);
+    return rc;
+}
+
+
+/**
+ * @brief Removes the page file of an index that is not open.
+ *
+ * @param idxId Name of the page file of the index.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the index does not exist.
+ */
+RC deleteBtree(char *idxId)
+{
+    return destroyPageFile(idxId);
+}
+
+
+/**
+ * @brief Returns the number of nodes of an index.
+ */
+RC getNumNodes(BTreeHandle *tree, int *result)
+{
+    if (tree == NULL || tree->mgmtData == NULL || result == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    *result = ((BTreeMgmt*) tree->mgmtData)->meta.numNodes;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns the number of keys in an index.
+ */
+RC getNumEntries(BTreeHandle *tree, int *result)
+{
+    if (tree == NULL || tree->mgmtData == NULL || result == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    *result = ((BTreeMgmt*) tree->mgmtData)->meta.numEntries;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns the key type of an index.
+ */
+RC getKeyType(BTreeHandle *tree, DataType *result)
+{
+    if (tree == NULL || result == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    *result = tree->keyType;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Looks a key up, reading one page per level of the tree.
+ *
+ * @param tree The open index.
+ * @param key The key to find.
+ * @param result Receives the record id stored with the key.
+ * @return RC_OK if successful.
+ *         RC_IM_KEY_NOT_FOUND if the key is not in the index.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if the key has another type.
+ */
+RC findKey(BTreeHandle *tree, Value *key, RID *result)
+{
+    RC rc = checkKey(tree, key);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    BTreeMgmt *mgmt = (BTreeMgmt*) tree->mgmtData;
+    int path[BTREE_MAX_HEIGHT], childIdx[BTREE_MAX_HEIGHT];
+    if ((rc = descend(mgmt, key->v.intV, path, childIdx, mgmt->node)) != RC_OK) {
+        return rc;
+    }
+    int32_t *keys = NODE_KEYS(mgmt->node);
+    int pos = keysBelow(keys, NODE_HEADER(mgmt->node)->numKeys, key->v.intV);
+    if (pos == NODE_HEADER(mgmt->node)->numKeys || keys[pos] != key->v.intV) {
+        return RC_IM_KEY_NOT_FOUND;
+    }
+    if (result != NULL) {
+        *result = leafRids(mgmt, mgmt->node)[pos];
+    }
+    return RC_OK;
+}
+
+
+/**
+ * @brief Adds a key with the record id it points to.
+ *
+ * @param tree The open index.
+ * @param key The new key.
+ * @param rid The record id stored with the key.
+ * @return RC_OK if successful.
+ *         RC_IM_KEY_ALREADY_EXISTS if the key is already in the index.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if the key has another type.
+ */
+RC insertKey(BTreeHandle *tree, Value *key, RID rid)
+{
+    RC rc = checkKey(tree, key);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    BTreeMgmt *mgmt = (BTreeMgmt*) tree->mgmtData;
+    int path[BTREE_MAX_HEIGHT], childIdx[BTREE_MAX_HEIGHT];
+    if ((rc = descend(mgmt, key->v.intV, path, childIdx, mgmt->node)) != RC_OK) {
+        return rc;
+    }
+    int32_t *keys = NODE_KEYS(mgmt->node);
+    int numKeys = NODE_HEADER(mgmt->node)->numKeys;
+    int pos = keysBelow(keys, numKeys, key->v.intV);
+    if (pos < numKeys && keys[pos] == key->v.intV) {
+        return RC_IM_KEY_ALREADY_EXISTS;
+    }
+    if ((rc = insertIntoLeaf(mgmt, path, childIdx, pos, key->v.intV, rid)) == RC_OK) {
+        mgmt->meta.numEntries++;
+        mgmt->metaDirty = 1;
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Removes a key. Nodes that fall below half full borrow from or merge with a sibling.
+ *
+ * @param tree The open index.
+ * @param key The key to remove.
+ * @return RC_OK if successful.
+ *         RC_IM_KEY_NOT_FOUND if the key is not in the index.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if the key has another type.
+ */
+RC deleteKey(BTreeHandle *tree, Value *key)
+{
+    RC rc = checkKey(tree, key);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    BTreeMgmt *mgmt = (BTreeMgmt*) tree->mgmtData;
+    int path[BTREE_MAX_HEIGHT], childIdx[BTREE_MAX_HEIGHT];
+    if ((rc = descend(mgmt, key->v.intV, path, childIdx, mgmt->node)) != RC_OK) {
+        return rc;
+    }
+    BTreeNodeHeader *header = NODE_HEADER(mgmt->node);
+    int32_t *keys = NODE_KEYS(mgmt->node);
+    RID *rids = leafRids(mgmt, mgmt->node);
+    int pos = keysBelow(keys, header->numKeys, key->v.intV);
+    if (pos == header->numKeys || keys[pos] != key->v.intV) {
+        return RC_IM_KEY_NOT_FOUND;
+    }
+    memmove(keys + pos, keys + pos + 1, sizeof(int32_t) * (size_t) (header->numKeys - pos - 1));
+    memmove(rids + pos, rids + pos + 1, sizeof(RID) * (size_t) (header->numKeys - pos - 1));
+    header->numKeys--;
+    mgmt->meta.numEntries--;
+    mgmt->metaDirty = 1;
+    return rebalance(mgmt, path, childIdx);
+}
+
+
+/**
+ * @brief Builds an empty index bottom up from keys in ascending order. Leaves are written left
+ *        to right into consecutive pages and filled evenly, then every inner level is built
+ *        from the first keys of the level below, so loading n keys costs one write per node.
+ *
+ * @param tree The open index, which must be empty.
+ * @param keys The keys in strictly ascending order.
+ * @param rids The record id of every key.
+ * @param numEntries Number of keys.
+ * @return RC_OK if successful.
+ *         RC_IM_KEY_ALREADY_EXISTS if a key appears twice.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if a key has another type.
+ *         RC_WRITE_FAILED if the index is not empty or the keys are not sorted.
+ */
+RC bulkLoadBtree(BTreeHandle *tree, Value *keys, RID *rids, int numEntries)
+{
+    if (tree == NULL || tree->mgmtData == NULL || (numEntries > 0 && (keys == NULL || rids == NULL))) {
+        printMessage("The index is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    BTreeMgmt *mgmt = (BTreeMgmt*) tree->mgmtData;
+    if (mgmt->meta.numEntries != 0) {
+        printMessage("Only an empty index can be bulk loaded.\n");
+        return RC_WRITE_FAILED;
+    }
+    for (int i = 0; i < numEntries; i++) {
+        RC rc = checkKey(tree, &keys[i]);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        if (i > 0 && keys[i].v.intV <= keys[i - 1].v.intV) {
+            printMessage("Bulk loaded keys must be unique and ascending.\n");
+            return keys[i].v.intV == keys[i - 1].v.intV ? RC_IM_KEY_ALREADY_EXISTS : RC_WRITE_FAILED;
+        }
+    }
+    if (numEntries == 0) {
+        return RC_OK;
+    }
+    int n = mgmt->meta.order;
+    int count = (numEntries + n - 1) / n;
+    int *pages = (int*) malloc(sizeof(int) * (size_t) count);
+    int32_t *firstKeys = (int32_t*) malloc(sizeof(int32_t) * (size_t) count);
+    if (pages == NULL || firstKeys == NULL) {
+        free(pages);
+        free(firstKeys);
+        return RC_WRITE_FAILED;
+    }
+    // The empty root goes back to the free list and becomes the first leaf.
+    RC rc = freeNode(mgmt, mgmt->meta.rootPage);
+    for (int i = 0; rc == RC_OK && i < count; i++) {
+        rc = allocateNode(mgmt, &pages[i]);
+    }
+    int entry = 0;
+    for (int i = 0; rc == RC_OK && i < count; i++) {
+        int numKeys = numEntries / count + (i < numEntries % count);
+        initNode(mgmt, mgmt->node, 1);
+        NODE_HEADER(mgmt->node)->numKeys = numKeys;
+        NODE_HEADER(mgmt->node)->next = i + 1 < count ? pages[i + 1] : NO_PAGE;
+        for (int k = 0; k < numKeys; k++) {
+            NODE_KEYS(mgmt->node)[k] = keys[entry + k].v.intV;
+            leafRids(mgmt, mgmt->node)[k] = rids[entry + k];
+        }
+        firstKeys[i] = keys[entry].v.intV;
+        entry += numKeys;
+        rc = writeNode(mgmt, pages[i], mgmt->node);
+    }
+    int height = 1;
+    // Every level above gets as few nodes as can hold the level below, filled evenly.
+    while (rc == RC_OK && count > 1) {
+        int parents = (count + n) / (n + 1);
+        int child = 0;
+        for (int i = 0; rc == RC_OK && i < parents; i++) {
+            int numChildren = count / parents + (i < count % parents);
+            int pageNum;
+            if ((rc = allocateNode(mgmt, &pageNum)) != RC_OK) {
+                break;
+            }
+            initNode(mgmt, mgmt->node, 0);
+            NODE_HEADER(mgmt->node)->numKeys = numChildren - 1;
+            for (int k = 0; k < numChildren; k++) {
+                nodeChildren(mgmt, mgmt->node)[k] = pages[child + k];
+                if (k > 0) {
+                    NODE_KEYS(mgmt->node)[k - 1] = firstKeys[child + k];
+                }
+            }
+            // The arrays are rewritten in place; entry i is only read again for the next level.
+            int32_t firstKey = firstKeys[child];
+            child += numChildren;
+            rc = writeNode(mgmt, pageNum, mgmt->node);
+            pages[i] = pageNum;
+            firstKeys[i] = firstKey;
+        }
+        count = parents;
+        height++;
+    }
+    if (rc == RC_OK) {
+        mgmt->meta.rootPage = pages[0];
+        mgmt->meta.height = height;
+        mgmt->meta.numEntries = numEntries;
+        mgmt->metaDirty = 1;
+    }
+    free(pages);
+    free(firstKeys);
+    return rc;
+}
+
+
+/**
+ * @brief Opens a scan over all keys of an index in ascending order.
+ *
+ * @param tree The open index.
+ * @param handle Receives the scan.
+ * @return RC_OK if successful.
+ */
+RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle)
+{
+    return openTreeRangeScan(tree, NULL, NULL, handle);
+}
+
+
+/**
+ * @brief Opens a scan over the keys in [low, high] in ascending order. The scan starts at the
+ *        leaf of low and then follows the leaf chain, reading one page per leaf. The index
+ *        must not be changed while the scan is open.
+ *
+ * @param tree The open index.
+ * @param low Smallest key returned, NULL for no lower bound.
+ * @param high Largest key returned, NULL for no upper bound.
+ * @param handle Receives the scan.
+ * @return RC_OK if successful.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if a bound has another type.
+ */
+RC openTreeRangeScan(BTreeHandle *tree, Value *low, Value *high, BT_ScanHandle **handle)
+{
+    if (tree == NULL || tree->mgmtData == NULL || handle == NULL) {
+        printMessage("The index is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RC rc;
+    if ((low != NULL && (rc = checkKey(tree, low)) != RC_OK) || (high != NULL && (rc = checkKey(tree, high)) != RC_OK)) {
+        return rc;
+    }
+    BTreeMgmt *mgmt = (BTreeMgmt*) tree->mgmtData;
+    BT_ScanHandle *scanHandle = (BT_ScanHandle*) calloc(1, sizeof(BT_ScanHandle));
+    BTreeScan *scan = (BTreeScan*) calloc(1, sizeof(BTreeScan));
+    char *page = (char*) malloc((size_t) mgmt->fHandle.pageSize);
+    if (scanHandle == NULL || scan == NULL || page == NULL) {
+        free(scanHandle);
+        free(scan);
+        free(page);
+        return RC_WRITE_FAILED;
+    }
+    int32_t start = low != NULL ? low->v.intV : INT32_MIN;
+    int path[BTREE_MAX_HEIGHT], childIdx[BTREE_MAX_HEIGHT];
+    if ((rc = descend(mgmt, start, path, childIdx, page)) != RC_OK) {
+        free(scanHandle);
+        free(scan);
+        free(page);
+        return rc;
+    }
+    scan->page = page;
+    scan->pos = keysBelow(NODE_KEYS(page), NODE_HEADER(page)->numKeys, start);
+    scan->hasHigh = high != NULL;
+    scan->high = high != NULL ? high->v.intV : INT32_MAX;
+    scanHandle->tree = tree;
+    scanHandle->mgmtData = scan;
+    *handle = scanHandle;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns the record id of the next key of a scan.
+ *
+ * @param handle The open scan.
+ * @param result Receives the record id.
+ * @return RC_OK if successful.
+ *         RC_IM_NO_MORE_ENTRIES once the scan is past its last key.
+ */
+RC nextEntry(BT_ScanHandle *handle, RID *result)
+{
+    if (handle == NULL || handle->mgmtData == NULL || result == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    BTreeScan *scan = (BTreeScan*) handle->mgmtData;
+    BTreeMgmt *mgmt = (BTreeMgmt*) handle->tree->mgmtData;
+    while (scan->pos >= NODE_HEADER(scan->page)->numKeys) {
+        int next = NODE_HEADER(scan->page)->next;
+        if (next == NO_PAGE) {
+            return RC_IM_NO_MORE_ENTRIES;
+        }
+        RC rc = readNode(mgmt, next, scan->page);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        scan->pos = 0;
+    }
+    if (scan->hasHigh && NODE_KEYS(scan->page)[scan->pos] > scan->high) {
+        return RC_IM_NO_MORE_ENTRIES;
+    }
+    *result = leafRids(mgmt, scan->page)[scan->pos++];
+    return RC_OK;
+}
+
+
+/**
+ * @brief Closes a scan.
+ */
+RC closeTreeScan(BT_ScanHandle *handle)
+{
+    if (handle == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (handle->mgmtData != NULL) {
+        free(((BTreeScan*) handle->mgmtData)->page);
+        free(handle->mgmtData);
+    }
+    free(handle);
+    return RC_OK;
+}
@@ -0,0 +1,66 @@
+#ifndef BTREE_MGR_H
+#define BTREE_MGR_H
+
+#include "dberror.h"
+#include "tables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    index constants                       *
+ ************************************************************/
+#define BTREE_MAGIC "SMBTREE1"
+/* bytes in front of the keys of every node */
+#define BTREE_NODE_HEADER_SIZE 16
+/* nodes with fewer keys than this are searched with one branch-free linear pass */
+#define BTREE_LINEAR_SEARCH_KEYS 16
+/* deepest tree that can be handled; a tree of order 2 needs 31 levels for 2^31 keys */
+#define BTREE_MAX_HEIGHT 32
+
+/* an open index; mgmtData holds the page file and the cached meta page */
+typedef struct BTreeHandle {
+	DataType keyType;
+	char *idxId;
+	void *mgmtData;
+} BTreeHandle;
+
+typedef struct BT_ScanHandle {
+	BTreeHandle *tree;
+	void *mgmtData;
+} BT_ScanHandle;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* init and shutdown index manager */
+extern RC initIndexManager (void *mgmtData);
+extern RC shutdownIndexManager (void);
+
+/* create, destroy, open, and close a btree index */
+extern RC createBtree (char *idxId, DataType keyType, int n);
+extern RC openBtree (BTreeHandle **tree, char *idxId);
+extern RC closeBtree (BTreeHandle *tree);
+extern RC deleteBtree (char *idxId);
+
+/* access information about a b-tree */
+extern RC getNumNodes (BTreeHandle *tree, int *result);
+extern RC getNumEntries (BTreeHandle *tree, int *result);
+extern RC getKeyType (BTreeHandle *tree, DataType *result);
+
+/* index access */
+extern RC findKey (BTreeHandle *tree, Value *key, RID *result);
+extern RC insertKey (BTreeHandle *tree, Value *key, RID rid);
+extern RC deleteKey (BTreeHandle *tree, Value *key);
+extern RC bulkLoadBtree (BTreeHandle *tree, Value *keys, RID *rids, int numEntries);
+extern RC openTreeScan (BTreeHandle *tree, BT_ScanHandle **handle);
+extern RC openTreeRangeScan (BTreeHandle *tree, Value *low, Value *high, BT_ScanHandle **handle);
+extern RC nextEntry (BT_ScanHandle *handle, RID *result);
+extern RC closeTreeScan (BT_ScanHandle *handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
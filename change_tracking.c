@@ -0,0 +1,494 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "change_tracking.h"
+#include "sm_backend.h"
+
+/*
+ * Every open page file has one change map shared by its handles. Tracking is off until
+ * enableChangeTracking is called; from then on the map records, per page, the backup epoch in
+ * which the page last changed. exportChangedPages closes the current epoch, so the next export
+ * with since set to the returned epoch contains exactly the pages changed after it.
+ *
+ * Maps of POSIX page files are persisted in <file>.chg on sync and close. The file is marked
+ * unclean while the page file is open; after a crash the map may be missing recent changes, so
+ * every page is then treated as changed in the current epoch.
+ */
+
+typedef struct SM_ChangeMapFile {
+    char magic[8];
+    int32_t clean;
+    uint32_t epoch;
+    int32_t numPages;
+    int32_t reserved;
+} SM_ChangeMapFile;
+
+typedef struct SM_PageDeltaHeader {
+    char magic[8];
+    int32_t pageSize;
+    int32_t totalNumPages;
+    int32_t since;
+    int32_t epoch;
+    int32_t numPages;
+    int32_t reserved;
+} SM_PageDeltaHeader;
+
+struct SM_ChangeMap {
+    char *fileName;
+    /* NULL if the map only lives as long as the file is open */
+    char *mapPath;
+    int refCount;
+    int enabled;
+    uint32_t epoch;
+    int numPages;
+    int capacity;
+    uint32_t *pageEpochs;
+    pthread_mutex_t lock;
+    SM_ChangeMap *next;
+};
+
+static pthread_mutex_t mapsLock = PTHREAD_MUTEX_INITIALIZER;
+static SM_ChangeMap *maps = NULL;
+
+
+static char *makeMapPath(const char *fileName)
+{
+    char *mapPath = (char*) malloc(strlen(fileName) + strlen(CHANGE_MAP_SUFFIX) + 1);
+    if (mapPath != NULL) {
+        strcpy(mapPath, fileName);
+        strcat(mapPath, CHANGE_MAP_SUFFIX);
+    }
+    return mapPath;
+}
+
+/**
+ * @brief Grows the map to numPages pages. New pages count as changed in the current epoch.
+ *        Must be called with the map's lock held.
+ */
+static RC growChangeMap(SM_ChangeMap *map, int numPages)
+{
+    if (numPages <= map->numPages) {
+        return RC_OK;
+    }
+    if (numPages > map->capacity) {
+        int newCapacity = map->capacity > 0 ? map->capacity : 64;
+        while (newCapacity < numPages) {
+            newCapacity *= 2;
+        }
+        uint32_t *grown = (uint32_t*) realloc(map->pageEpochs, sizeof(uint32_t) * newCapacity);
+        if (grown == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        map->pageEpochs = grown;
+        map->capacity = newCapacity;
+    }
+    for (int i = map->numPages; i < numPages; i++) {
+        map->pageEpochs[i] = map->epoch;
+    }
+    map->numPages = numPages;
+    return RC_OK;
+}
+
+/**
+ * @brief Writes the map to its file through a temporary file and a rename.
+ *        Must be called with the map's lock held.
+ */
+static RC saveChangeMap(SM_ChangeMap *map, int clean)
+{
+    if (map->mapPath == NULL || !map->enabled) {
+        return RC_OK;
+    }
+    char *tmpPath = (char*) malloc(strlen(map->mapPath) + 5);
+    if (tmpPath == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    sprintf(tmpPath, "%s.tmp", map->mapPath);
+    SM_ChangeMapFile header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHANGE_MAP_MAGIC, sizeof(header.magic));
+    header.clean = clean;
+    header.epoch = map->epoch;
+    header.numPages = map->numPages;
+    RC rc = RC_OK;
+    FILE *file = fopen(tmpPath, "wb");
+    if (file == NULL
+        || fwrite(&header, sizeof(header), 1, file) != 1
+        || fwrite(map->pageEpochs, sizeof(uint32_t), (size_t) map->numPages, file) != (size_t) map->numPages
+        || fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (file != NULL && fclose(file) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK && rename(tmpPath, map->mapPath) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(tmpPath);
+    return rc;
+}
+
+/**
+ * @brief Loads the map file of a page file if there is one, which turns tracking on.
+ */
+static void loadChangeMap(SM_ChangeMap *map)
+{
+    FILE *file = fopen(map->mapPath, "rb");
+    if (file == NULL) {
+        return;
+    }
+    SM_ChangeMapFile header;
+    if (fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, CHANGE_MAP_MAGIC, sizeof(header.magic)) == 0
+        && header.numPages >= 0 && header.epoch > 0) {
+        map->epoch = header.epoch;
+        if (growChangeMap(map, header.numPages) == RC_OK
+            && fread(map->pageEpochs, sizeof(uint32_t), (size_t) header.numPages, file) == (size_t) header.numPages) {
+            map->enabled = 1;
+            if (!header.clean) {
+                // Changes after the last sync may be missing; the next backup has to copy everything.
+                for (int i = 0; i < map->numPages; i++) {
+                    map->pageEpochs[i] = map->epoch;
+                }
+            }
+        }
+        else {
+            map->numPages = 0;
+        }
+    }
+    fclose(file);
+}
+
+
+/************************************************************
+ *                    storage manager hooks                 *
+ ************************************************************/
+
+/**
+ * @brief Returns the change map of a page file, creating it on the first open.
+ *
+ * @param fileName Name of the page file.
+ * @param persistent Non-zero if the map is kept in a file next to the page file.
+ * @return The map, or NULL if it could not be allocated.
+ */
+SM_ChangeMap *attachChangeMap(char *fileName, int persistent)
+{
+    pthread_mutex_lock(&mapsLock);
+    SM_ChangeMap *map = maps;
+    while (map != NULL && strcmp(map->fileName, fileName) != 0) {
+        map = map->next;
+    }
+    if (map != NULL) {
+        map->refCount++;
+        pthread_mutex_unlock(&mapsLock);
+        return map;
+    }
+    map = (SM_ChangeMap*) calloc(1, sizeof(SM_ChangeMap));
+    if (map != NULL) {
+        map->fileName = strdup(fileName);
+        map->mapPath = persistent ? makeMapPath(fileName) : NULL;
+        if (map->fileName == NULL || (persistent && map->mapPath == NULL)) {
+            free(map->fileName);
+            free(map->mapPath);
+            free(map);
+            pthread_mutex_unlock(&mapsLock);
+            return NULL;
+        }
+        pthread_mutex_init(&map->lock, NULL);
+        map->refCount = 1;
+        map->epoch = 1;
+        if (persistent) {
+            loadChangeMap(map);
+            saveChangeMap(map, 0);
+        }
+        map->next = maps;
+        maps = map;
+    }
+    pthread_mutex_unlock(&mapsLock);
+    return map;
+}
+
+/**
+ * @brief Drops one handle's reference to a change map; the last one saves and frees it.
+ */
+void detachChangeMap(SM_ChangeMap *map)
+{
+    if (map == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&mapsLock);
+    if (--map->refCount > 0) {
+        pthread_mutex_unlock(&mapsLock);
+        return;
+    }
+    SM_ChangeMap **link = &maps;
+    while (*link != map) {
+        link = &(*link)->next;
+    }
+    *link = map->next;
+    pthread_mutex_unlock(&mapsLock);
+    pthread_mutex_lock(&map->lock);
+    if (saveChangeMap(map, 1) != RC_OK) {
+        printMessage("The change map of %s could not be saved!\n", map->fileName);
+    }
+    pthread_mutex_unlock(&map->lock);
+    pthread_mutex_destroy(&map->lock);
+    free(map->fileName);
+    free(map->mapPath);
+    free(map->pageEpochs);
+    free(map);
+}
+
+/**
+ * @brief Records that count pages starting at first changed in the current epoch.
+ */
+void noteChangedPages(SM_ChangeMap *map, int first, int count)
+{
+    if (map == NULL || !__atomic_load_n(&map->enabled, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    pthread_mutex_lock(&map->lock);
+    if (growChangeMap(map, first + count) == RC_OK) {
+        for (int i = first; i < first + count; i++) {
+            map->pageEpochs[i] = map->epoch;
+        }
+    }
+    else {
+        printMessage("The change map of %s could not grow!\n", map->fileName);
+    }
+    pthread_mutex_unlock(&map->lock);
+}
+
+/**
+ * @brief Forgets the pages from numPages on after the file was cut, so pages added later at
+ *        those numbers count as changed.
+ */
+void noteTruncatedPages(SM_ChangeMap *map, int numPages)
+{
+    if (map == NULL || !__atomic_load_n(&map->enabled, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    pthread_mutex_lock(&map->lock);
+    if (numPages < map->numPages) {
+        map->numPages = numPages;
+    }
+    pthread_mutex_unlock(&map->lock);
+}
+
+/**
+ * @brief Saves a persistent change map; called when its page file is synced.
+ */
+RC syncChangeMap(SM_ChangeMap *map)
+{
+    if (map == NULL) {
+        return RC_OK;
+    }
+    pthread_mutex_lock(&map->lock);
+    RC rc = saveChangeMap(map, 0);
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+/**
+ * @brief Removes the change map file of a page file that is being destroyed.
+ */
+void destroyChangeMap(char *fileName)
+{
+    char *mapPath = makeMapPath(fileName);
+    if (mapPath != NULL) {
+        unlink(mapPath);
+        free(mapPath);
+    }
+}
+
+
+/************************************************************
+ *                    backup interface                      *
+ ************************************************************/
+
+/**
+ * @brief Starts tracking changed pages of a page file. All existing pages count as changed, so the
+ *        first export is a full backup. For files on disk the map is kept next to the file and
+ *        tracking stays on when the file is opened again.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the map could not be created.
+ */
+RC enableChangeTracking(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_ChangeMap *map = ((SM_OpenFile*) fHandle->mgmtInfo)->changes;
+    if (map == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = RC_OK;
+    pthread_mutex_lock(&map->lock);
+    if (!map->enabled) {
+        map->epoch = 1;
+        map->numPages = 0;
+        rc = growChangeMap(map, fHandle->totalNumPages);
+        if (rc == RC_OK) {
+            __atomic_store_n(&map->enabled, 1, __ATOMIC_RELEASE);
+            rc = saveChangeMap(map, 0);
+        }
+    }
+    pthread_mutex_unlock(&map->lock);
+    if (rc != RC_OK) {
+        printMessage("Change tracking of %s could not be enabled!\n", fHandle->fileName);
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Writes every page changed after backup epoch since to a delta file and closes the
+ *        current epoch. since = 0 exports all pages; passing the epoch returned by one export to
+ *        the next one exports only the pages changed in between.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param since Epoch of the previous backup, or 0 for a full backup.
+ * @param deltaFileName The delta file that is created.
+ * @param epoch Receives the epoch this backup covers.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if tracking is off, since is invalid or the delta could not be written.
+ */
+RC exportChangedPages(SM_FileHandle *fHandle, int since, char *deltaFileName, int *epoch)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || deltaFileName == NULL || epoch == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_ChangeMap *map = openFile->changes;
+    if (map == NULL || !map->enabled) {
+        printMessage("Change tracking is not enabled for %s!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    // Pages are read from the file, so writes still held in a shared pool go there first.
+    if (openFile->pool != NULL && sharedPoolFlushFile(openFile->pool, openFile->poolFile) != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    int totalNumPages = fHandle->totalNumPages;
+    int *pages = (int*) malloc(sizeof(int) * (totalNumPages > 0 ? totalNumPages : 1));
+    char *page = (char*) malloc((size_t) fHandle->pageSize);
+    if (pages == NULL || page == NULL) {
+        free(pages);
+        free(page);
+        return RC_WRITE_FAILED;
+    }
+
+    // Pages changed from here on belong to the next epoch and go into the next delta.
+    pthread_mutex_lock(&map->lock);
+    if (since < 0 || (uint32_t) since >= map->epoch) {
+        pthread_mutex_unlock(&map->lock);
+        printMessage("There is no backup epoch %d for %s!\n", since, fHandle->fileName);
+        free(pages);
+        free(page);
+        return RC_WRITE_FAILED;
+    }
+    int numChanged = 0;
+    for (int pageNum = 0; pageNum < totalNumPages; pageNum++) {
+        if (pageNum >= map->numPages || map->pageEpochs[pageNum] > (uint32_t) since) {
+            pages[numChanged++] = pageNum;
+        }
+    }
+    *epoch = (int) map->epoch++;
+    RC rc = saveChangeMap(map, 0);
+    pthread_mutex_unlock(&map->lock);
+
+    SM_PageDeltaHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PAGE_DELTA_MAGIC, sizeof(header.magic));
+    header.pageSize = fHandle->pageSize;
+    header.totalNumPages = totalNumPages;
+    header.since = since;
+    header.epoch = *epoch;
+    header.numPages = numChanged;
+    FILE *delta = rc == RC_OK ? fopen(deltaFileName, "wb") : NULL;
+    if (delta == NULL || fwrite(&header, sizeof(header), 1, delta) != 1) {
+        rc = RC_WRITE_FAILED;
+    }
+    for (int i = 0; i < numChanged && rc == RC_OK; i++) {
+        int32_t pageNum = pages[i];
+        if (openFile->backend->read(openFile->state, pageNum, page) != RC_OK
+            || fwrite(&pageNum, sizeof(pageNum), 1, delta) != 1
+            || fwrite(page, (size_t) fHandle->pageSize, 1, delta) != 1) {
+            rc = RC_WRITE_FAILED;
+        }
+    }
+    if (delta != NULL && fclose(delta) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(pages);
+    free(page);
+    if (rc == RC_OK) {
+        printMessage("%d changed pages of %s have been exported to %s!\n", numChanged, fHandle->fileName, deltaFileName);
+    }
+    else {
+        printMessage("The changed pages of %s could not be exported!\n", fHandle->fileName);
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Applies a delta written by exportChangedPages to a page file, growing or truncating it
+ *        to the size of the source file. Applying a full delta and then every incremental one in
+ *        order rebuilds the source file, also after the source was compacted.
+ *
+ * @param deltaFileName The delta file to apply.
+ * @param fHandle The page file the pages are written to.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the delta file can't be opened.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the delta is invalid, has another page size, the file would have to
+ *         shrink and its backend cannot truncate, or a write fails.
+ */
+RC applyPageDelta(char *deltaFileName, SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    FILE *delta = deltaFileName == NULL ? NULL : fopen(deltaFileName, "rb");
+    if (delta == NULL) {
+        printMessage("The delta file could not be opened!\n");
+        return RC_FILE_NOT_FOUND;
+    }
+    SM_PageDeltaHeader header;
+    if (fread(&header, sizeof(header), 1, delta) != 1
+        || memcmp(header.magic, PAGE_DELTA_MAGIC, sizeof(header.magic)) != 0
+        || header.pageSize != fHandle->pageSize) {
+        printMessage("The file %s is not a delta for %s!\n", deltaFileName, fHandle->fileName);
+        fclose(delta);
+        return RC_WRITE_FAILED;
+    }
+    char *page = (char*) malloc((size_t) header.pageSize);
+    RC rc = page == NULL ? RC_WRITE_FAILED
+        : header.totalNumPages < fHandle->totalNumPages ? truncateOpenFile(fHandle, header.totalNumPages)
+        : ensureCapacity(header.totalNumPages, fHandle);
+    for (int i = 0; i < header.numPages && rc == RC_OK; i++) {
+        int32_t pageNum;
+        if (fread(&pageNum, sizeof(pageNum), 1, delta) != 1
+            || fread(page, (size_t) header.pageSize, 1, delta) != 1) {
+            rc = RC_WRITE_FAILED;
+        }
+        else {
+            rc = writeBlock(pageNum, fHandle, page);
+        }
+    }
+    free(page);
+    fclose(delta);
+    if (rc != RC_OK) {
+        printMessage("The delta %s could not be applied to %s!\n", deltaFileName, fHandle->fileName);
+    }
+    return rc;
+}
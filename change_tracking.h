@@ -0,0 +1,45 @@
+#ifndef CHANGE_TRACKING_H
+#define CHANGE_TRACKING_H
+
+#include <stdint.h>
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    change tracking constants             *
+ ************************************************************/
+/* suffix of the file next to a page file that holds its change map */
+#define CHANGE_MAP_SUFFIX ".chg"
+#define CHANGE_MAP_MAGIC "SMCHGMAP"
+/* first bytes of a page delta written by exportChangedPages */
+#define PAGE_DELTA_MAGIC "SMDELTA1"
+
+/* Shared by all handles of one page file. pageEpochs[p] is the backup epoch in which page p
+ * last changed; a page changed since epoch e has pageEpochs[p] > e. */
+typedef struct SM_ChangeMap SM_ChangeMap;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* backup API */
+extern RC enableChangeTracking (SM_FileHandle *fHandle);
+extern RC exportChangedPages (SM_FileHandle *fHandle, int since, char *deltaFileName, int *epoch);
+extern RC applyPageDelta (char *deltaFileName, SM_FileHandle *fHandle);
+
+/* used by the storage manager to keep the map up to date */
+extern SM_ChangeMap *attachChangeMap (char *fileName, int persistent);
+extern void detachChangeMap (SM_ChangeMap *map);
+extern void noteChangedPages (SM_ChangeMap *map, int first, int count);
+extern void noteTruncatedPages (SM_ChangeMap *map, int numPages);
+extern RC syncChangeMap (SM_ChangeMap *map);
+extern void destroyChangeMap (char *fileName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "checkpoint.h"
+#include "sm_backend.h"
+#include "log_store.h"
+
+/*
+ * A checkpoint bounds the work a restart has to do. It writes the dirty shared pool pages of
+ * the file back in page order, syncs the backend (for a log-structured file this writes a
+ * fuzzy checkpoint of its page table, after which recovery only reads the segments written
+ * since) and saves the change map. None of these steps stops writers for longer than one page
+ * or one copy of the page table.
+ *
+ * The background checkpointer estimates the recovery time every interval from the pages a
+ * restart would have to handle (log slots to scan plus pool pages not on disk yet) and the
+ * replay rate, and checkpoints once the estimate reaches half the target, so recovery stays
+ * below the target while the checkpoint runs.
+ */
+
+struct SM_Checkpointer {
+    SM_FileHandle *fHandle;
+    SM_OpenFile *openFile;
+    SM_CheckpointOptions options;
+    SM_CheckpointStats stats;
+    pthread_t thread;
+    /* guards stats and stop */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+};
+
+
+/**
+ * @brief Returns the pages a restart would have to handle now and the rate it handles them at.
+ */
+static long recoveryPages(SM_FileHandle *fHandle, int replayPagesPerSec, long *pagesPerSec)
+{
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    long pages = openFile->pool != NULL ? sharedPoolDirtyPages(openFile->pool, openFile->poolFile) : 0;
+    *pagesPerSec = replayPagesPerSec > 0 ? replayPagesPerSec : CHECKPOINT_DEFAULT_REPLAY_RATE;
+    LogStoreStats logStats;
+    if (openFile->backend == &logStoreBackend && getLogStoreStats(fHandle, &logStats) == RC_OK) {
+        pages += logStats.recoverySlots;
+        // A measured recovery is the better guess unless the caller knows the rate.
+        if (replayPagesPerSec <= 0 && logStats.lastRecoverySlots > 0 && logStats.lastRecoveryMs >= 1.0) {
+            *pagesPerSec = (long) (logStats.lastRecoverySlots * 1000.0 / logStats.lastRecoveryMs);
+        }
+    }
+    return pages;
+}
+
+static long estimateRecoveryMs(long pages, long pagesPerSec)
+{
+    return pagesPerSec > 0 ? pages * 1000 / pagesPerSec : 0;
+}
+
+/**
+ * @brief Takes one checkpoint of a file and adds it to the stats.
+ */
+static RC runCheckpoint(SM_FileHandle *fHandle, SM_CheckpointStats *stats)
+{
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int dirty = openFile->pool != NULL ? sharedPoolDirtyPages(openFile->pool, openFile->poolFile) : 0;
+    LogStoreStats logStats;
+    long unflushed = openFile->backend == &logStoreBackend && getLogStoreStats(fHandle, &logStats) == RC_OK
+        ? logStats.unflushedWrites : 0;
+    int flushed = 0;
+    RC rc = RC_OK;
+    if ((openFile->pool != NULL && sharedPoolFlushDirty(openFile->pool, openFile->poolFile, &flushed) != RC_OK)
+        || openFile->backend->sync(openFile->state) != RC_OK || syncChangeMap(openFile->changes) != RC_OK) {
+        printMessage("The checkpoint of %s failed!\n", fHandle->fileName);
+        rc = RC_WRITE_FAILED;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->checkpoints += rc == RC_OK;
+    stats->pagesFlushed += flushed;
+    stats->dirtyPages = dirty;
+    stats->unflushedWrites = unflushed;
+    stats->lastCheckpointMs = (double) (end.tv_sec - start.tv_sec) * 1e3 + (double) (end.tv_nsec - start.tv_nsec) / 1e6;
+    return rc;
+}
+
+/**
+ * @brief Sleeps for one interval unless the checkpointer is stopped first.
+ * @return non-zero if the checkpointer was stopped.
+ */
+static int checkpointerWait(SM_Checkpointer *checkpointer)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += checkpointer->options.intervalMs / 1000;
+    deadline.tv_nsec += (long) (checkpointer->options.intervalMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&checkpointer->lock);
+    while (!checkpointer->stop) {
+        if (pthread_cond_timedwait(&checkpointer->cond, &checkpointer->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    int stopped = checkpointer->stop;
+    pthread_mutex_unlock(&checkpointer->lock);
+    return stopped;
+}
+
+static void *checkpointerMain(void *arg)
+{
+    SM_Checkpointer *checkpointer = (SM_Checkpointer*) arg;
+    while (!checkpointerWait(checkpointer)) {
+        long pagesPerSec;
+        long pages = recoveryPages(checkpointer->fHandle, checkpointer->options.replayPagesPerSec, &pagesPerSec);
+        long estimate = estimateRecoveryMs(pages, pagesPerSec);
+        SM_CheckpointStats stats;
+        pthread_mutex_lock(&checkpointer->lock);
+        checkpointer->stats.recoveryPages = pages;
+        checkpointer->stats.estimatedRecoveryMs = estimate;
+        stats = checkpointer->stats;
+        pthread_mutex_unlock(&checkpointer->lock);
+        if (2 * estimate < checkpointer->options.targetRecoveryMs) {
+            continue;
+        }
+        runCheckpoint(checkpointer->fHandle, &stats);
+        pages = recoveryPages(checkpointer->fHandle, checkpointer->options.replayPagesPerSec, &pagesPerSec);
+        pthread_mutex_lock(&checkpointer->lock);
+        checkpointer->stats.checkpoints = stats.checkpoints;
+        checkpointer->stats.pagesFlushed = stats.pagesFlushed;
+        checkpointer->stats.dirtyPages = stats.dirtyPages;
+        checkpointer->stats.unflushedWrites = stats.unflushedWrites;
+        checkpointer->stats.lastCheckpointMs = stats.lastCheckpointMs;
+        checkpointer->stats.recoveryPages = pages;
+        checkpointer->stats.estimatedRecoveryMs = estimateRecoveryMs(pages, pagesPerSec);
+        pthread_mutex_unlock(&checkpointer->lock);
+    }
+    return NULL;
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Takes a checkpoint in the calling thread: writes the file's dirty shared pool pages
+ *        back in page order, syncs the file and saves its change map. Other threads keep
+ *        reading and writing the file meanwhile.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param stats If not NULL, receives what the checkpoint did and the recovery estimate after it.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if a page could not be written back or the file not synced.
+ */
+RC checkpointPageFile(SM_FileHandle *fHandle, SM_CheckpointStats *stats)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_CheckpointStats result;
+    memset(&result, 0, sizeof(result));
+    RC rc = runCheckpoint(fHandle, &result);
+    long pagesPerSec;
+    result.recoveryPages = recoveryPages(fHandle, 0, &pagesPerSec);
+    result.estimatedRecoveryMs = estimateRecoveryMs(result.recoveryPages, pagesPerSec);
+    if (stats != NULL) {
+        *stats = result;
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Starts a background thread that keeps the estimated recovery time of the file below
+ *        options->targetRecoveryMs by taking checkpoints when needed. It runs until
+ *        stopCheckpointer is called or the file is closed.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param options Target recovery time, estimation interval and replay rate; NULL for the defaults.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if a checkpointer is already running or the thread could not start.
+ */
+RC startCheckpointer(SM_FileHandle *fHandle, SM_CheckpointOptions *options)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->checkpointer != NULL) {
+        printMessage("A checkpointer is already running for %s!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    SM_Checkpointer *checkpointer = (SM_Checkpointer*) calloc(1, sizeof(SM_Checkpointer));
+    if (checkpointer == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    checkpointer->fHandle = fHandle;
+    checkpointer->openFile = openFile;
+    if (options != NULL) {
+        checkpointer->options = *options;
+    }
+    if (checkpointer->options.targetRecoveryMs <= 0) {
+        checkpointer->options.targetRecoveryMs = CHECKPOINT_DEFAULT_TARGET_MS;
+    }
+    if (checkpointer->options.intervalMs <= 0) {
+        checkpointer->options.intervalMs = CHECKPOINT_DEFAULT_INTERVAL_MS;
+    }
+    pthread_mutex_init(&checkpointer->lock, NULL);
+    pthread_cond_init(&checkpointer->cond, NULL);
+    if (pthread_create(&checkpointer->thread, NULL, checkpointerMain, checkpointer) != 0) {
+        printMessage("The checkpointer thread could not be started!\n");
+        pthread_mutex_destroy(&checkpointer->lock);
+        pthread_cond_destroy(&checkpointer->cond);
+        free(checkpointer);
+        return RC_WRITE_FAILED;
+    }
+    openFile->checkpointer = checkpointer;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Stops the background checkpointer of a file and waits for it; stats stay readable
+ *        through getCheckpointStats until the next checkpointer is started.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @return RC_OK if successful, also if no checkpointer was running.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC stopCheckpointer(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_Checkpointer *checkpointer = openFile->checkpointer;
+    if (checkpointer == NULL) {
+        return RC_OK;
+    }
+    pthread_mutex_lock(&checkpointer->lock);
+    checkpointer->stop = 1;
+    pthread_cond_signal(&checkpointer->cond);
+    pthread_mutex_unlock(&checkpointer->lock);
+    pthread_join(checkpointer->thread, NULL);
+    openFile->checkpointer = NULL;
+    openFile->checkpointStats = checkpointer->stats;
+    pthread_mutex_destroy(&checkpointer->lock);
+    pthread_cond_destroy(&checkpointer->cond);
+    free(checkpointer);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns non-zero if the background checkpointer of the file was started through this
+ *        handle, which it keeps using until it stops.
+ */
+int checkpointerUsesHandle(SM_FileHandle *fHandle)
+{
+    SM_OpenFile *openFile = fHandle == NULL ? NULL : (SM_OpenFile*) fHandle->mgmtInfo;
+    return openFile != NULL && openFile->checkpointer != NULL && openFile->checkpointer->fHandle == fHandle;
+}
+
+
+/**
+ * @brief Reports the checkpoints of the running checkpointer, or the final stats of the last one,
+ *        with its latest recovery estimate.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC getCheckpointStats(SM_FileHandle *fHandle, SM_CheckpointStats *stats)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || stats == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_Checkpointer *checkpointer = openFile->checkpointer;
+    if (checkpointer == NULL) {
+        *stats = openFile->checkpointStats;
+        return RC_OK;
+    }
+    pthread_mutex_lock(&checkpointer->lock);
+    *stats = checkpointer->stats;
+    pthread_mutex_unlock(&checkpointer->lock);
+    return RC_OK;
+}
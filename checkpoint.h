@@ -0,0 +1,54 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    checkpoint constants                  *
+ ************************************************************/
+/* recovery time the background checkpointer stays below when the options do not say */
+#define CHECKPOINT_DEFAULT_TARGET_MS 1000
+/* how often the background checkpointer estimates the recovery time */
+#define CHECKPOINT_DEFAULT_INTERVAL_MS 100
+/* pages per second a recovery is assumed to handle until one was measured */
+#define CHECKPOINT_DEFAULT_REPLAY_RATE 20000
+
+typedef struct SM_Checkpointer SM_Checkpointer;
+
+typedef struct SM_CheckpointOptions {
+	int targetRecoveryMs;     /* 0 for the default */
+	int intervalMs;           /* 0 for the default */
+	int replayPagesPerSec;    /* 0 for the rate of the file's last recovery, or the default */
+} SM_CheckpointOptions;
+
+typedef struct SM_CheckpointStats {
+	long checkpoints;
+	long pagesFlushed;        /* dirty shared pool pages written back by checkpoints */
+	int dirtyPages;           /* dirty pages the last checkpoint found */
+	long unflushedWrites;     /* log writes since the checkpoint before, when the last one started */
+	long recoveryPages;       /* pages a restart would have to recover now */
+	long estimatedRecoveryMs;
+	double lastCheckpointMs;  /* how long the last checkpoint took */
+} SM_CheckpointStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC checkpointPageFile (SM_FileHandle *fHandle, SM_CheckpointStats *stats);
+extern RC startCheckpointer (SM_FileHandle *fHandle, SM_CheckpointOptions *options);
+extern RC stopCheckpointer (SM_FileHandle *fHandle);
+extern RC getCheckpointStats (SM_FileHandle *fHandle, SM_CheckpointStats *stats);
+
+/* used by the storage manager when one of several handles of a file is closed */
+extern int checkpointerUsesHandle (SM_FileHandle *fHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
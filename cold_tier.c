@@ -0,0 +1,625 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cold_tier.h"
+#include "mem_governor.h"
+#include "sm_backend.h"
+
+/*
+ * The cold tier keeps compressed copies of pages that recently passed through readBlock and
+ * writeBlock of an open file, so a page read again after the buffer above evicted it is
+ * decompressed instead of read from the file. Pages written are stored as written, so the
+ * tier always matches the file. Multi-page transfers are scans; they drop the pages they
+ * write and do not fill the tier.
+ *
+ * Zero pages and pages repeating one 8-byte value are kept without data. Other pages are
+ * compressed with a small LZ77 codec in the style of LZ4:
+ *
+ *   sequence = token, [literal length], literals, [offset (2 bytes), [match length]]
+ *
+ * The high nibble of the token is the literal count, the low one the match length minus
+ * LZ_MIN_MATCH; 15 means more bytes follow, each adding up to 255. The last sequence has
+ * literals only. Pages that stay larger than COLD_TIER_MAX_STORED_PERCENT of a page are not
+ * kept, because the memory is better spent on pages that compress.
+ *
+ * The pages are charged to the file's memory consumer. When the tier is full or the budget
+ * denies a page, the least recently used pages are dropped; under memory pressure the
+ * governor shrinks the tier through the file's shrink callback.
+ */
+
+#define LZ_MIN_MATCH 4
+/* the last bytes of a page are always literals, so the matcher never reads past the end */
+#define LZ_LAST_LITERALS 5
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+#define COLD_FIRST_BUCKETS 256
+
+typedef enum ColdPageKind {
+    COLD_ZERO = 0,
+    COLD_SAME_FILLED = 1,
+    COLD_COMPRESSED = 2
+} ColdPageKind;
+
+typedef struct ColdPage {
+    int pageNum;
+    ColdPageKind kind;
+    int size;
+    uint64_t fill;
+    uint8_t *data;
+    struct ColdPage *hashNext;
+    /* least recently used order, newest first */
+    struct ColdPage *newer;
+    struct ColdPage *older;
+} ColdPage;
+
+struct SM_ColdTier {
+    int pageSize;
+    SM_MemConsumer *memory;
+    ColdPage **buckets;
+    int numBuckets;
+    ColdPage *newest;
+    ColdPage *oldest;
+    /* a compressed page is built here before its size is known */
+    uint8_t *scratch;
+    int hashTable[1 << LZ_HASH_BITS];
+    pthread_mutex_t lock;
+    SM_ColdTierStats stats;
+};
+
+
+/************************************************************
+ *                    page codec                            *
+ ************************************************************/
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint8_t *writeLength(uint8_t *op, int length)
+{
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t) length;
+    return op;
+}
+
+static int readLength(const uint8_t **ip, const uint8_t *end, int *length)
+{
+    uint8_t more;
+    do {
+        if (*ip >= end) {
+            return 0;
+        }
+        more = *(*ip)++;
+        *length += more;
+    } while (more == 255);
+    return 1;
+}
+
+/**
+ * @brief Compresses a page into dst.
+ * @return the compressed size, or -1 if it would not fit in dstCapacity.
+ */
+static int compressPage(int *hashTable, const uint8_t *src, int srcLength, uint8_t *dst, int dstCapacity)
+{
+    const uint8_t *dstEnd = dst + dstCapacity;
+    uint8_t *op = dst;
+    int ip = 0, anchor = 0;
+    memset(hashTable, 0xff, sizeof(int) << LZ_HASH_BITS);
+    while (ip + LZ_MIN_MATCH <= srcLength - LZ_LAST_LITERALS) {
+        uint32_t sequence = read32(src + ip);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        int ref = hashTable[hash];
+        hashTable[hash] = ip;
+        if (ref < 0 || ip - ref > LZ_MAX_OFFSET || read32(src + ref) != sequence) {
+            ip++;
+            continue;
+        }
+        int matchLength = LZ_MIN_MATCH;
+        while (ip + matchLength < srcLength - LZ_LAST_LITERALS && src[ref + matchLength] == src[ip + matchLength]) {
+            matchLength++;
+        }
+        int literals = ip - anchor;
+        // token, both lengths, literals and offset in the worst case
+        if (op + 1 + literals / 255 + 1 + literals + 2 + (matchLength - LZ_MIN_MATCH) / 255 + 1 > dstEnd) {
+            return -1;
+        }
+        uint8_t *token = op++;
+        *token = (uint8_t) ((literals < 15 ? literals : 15) << 4);
+        if (literals >= 15) {
+            op = writeLength(op, literals - 15);
+        }
+        memcpy(op, src + anchor, (size_t) literals);
+        op += literals;
+        *op++ = (uint8_t) ((ip - ref) & 0xff);
+        *op++ = (uint8_t) ((ip - ref) >> 8);
+        int matchCode = matchLength - LZ_MIN_MATCH;
+        *token |= (uint8_t) (matchCode < 15 ? matchCode : 15);
+        if (matchCode >= 15) {
+            op = writeLength(op, matchCode - 15);
+        }
+        ip += matchLength;
+        anchor = ip;
+    }
+    int literals = srcLength - anchor;
+    if (op + 1 + literals / 255 + 1 + literals > dstEnd) {
+        return -1;
+    }
+    *op++ = (uint8_t) ((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15) {
+        op = writeLength(op, literals - 15);
+    }
+    memcpy(op, src + anchor, (size_t) literals);
+    op += literals;
+    return (int) (op - dst);
+}
+
+/**
+ * @brief Decompresses a page of exactly dstLength bytes.
+ * @return 1 if the data was a valid page.
+ */
+static int decompressPage(const uint8_t *src, int srcLength, uint8_t *dst, int dstLength)
+{
+    const uint8_t *ip = src, *end = src + srcLength;
+    uint8_t *op = dst, *dstEnd = dst + dstLength;
+    while (ip < end) {
+        uint8_t token = *ip++;
+        int literals = token >> 4;
+        if (literals == 15 && !readLength(&ip, end, &literals)) {
+            return 0;
+        }
+        if (literals > end - ip || literals > dstEnd - op) {
+            return 0;
+        }
+        memcpy(op, ip, (size_t) literals);
+        ip += literals;
+        op += literals;
+        if (ip == end) {
+            break;
+        }
+        if (end - ip < 2) {
+            return 0;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int matchLength = token & 15;
+        if (matchLength == 15 && !readLength(&ip, end, &matchLength)) {
+            return 0;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op - dst || matchLength > dstEnd - op) {
+            return 0;
+        }
+        // Matches may overlap the bytes they produce, so they are copied byte by byte.
+        for (const uint8_t *match = op - offset; matchLength > 0; matchLength--) {
+            *op++ = *match++;
+        }
+    }
+    return op == dstEnd;
+}
+
+/**
+ * @brief Tells whether a page repeats one 8-byte value, and which.
+ */
+static int isSameFilled(const uint8_t *page, int pageSize, uint64_t *fill)
+{
+    if (pageSize % (int) sizeof(uint64_t) != 0) {
+        return 0;
+    }
+    uint64_t first, word;
+    memcpy(&first, page, sizeof(first));
+    for (int i = (int) sizeof(uint64_t); i < pageSize; i += (int) sizeof(uint64_t)) {
+        memcpy(&word, page + i, sizeof(word));
+        if (word != first) {
+            return 0;
+        }
+    }
+    *fill = first;
+    return 1;
+}
+
+
+/************************************************************
+ *                    pages of the tier                     *
+ ************************************************************/
+/* All functions below are called with the tier's lock held. */
+
+static long long pageBytes(const ColdPage *page)
+{
+    return (long long) sizeof(ColdPage) + page->size;
+}
+
+static ColdPage **bucketOf(SM_ColdTier *tier, int pageNum)
+{
+    return &tier->buckets[((uint32_t) pageNum * 2654435761u) & (uint32_t) (tier->numBuckets - 1)];
+}
+
+static ColdPage *findPage(SM_ColdTier *tier, int pageNum)
+{
+    ColdPage *page = *bucketOf(tier, pageNum);
+    while (page != NULL && page->pageNum != pageNum) {
+        page = page->hashNext;
+    }
+    return page;
+}
+
+static void unlinkAge(SM_ColdTier *tier, ColdPage *page)
+{
+    if (page->newer != NULL) {
+        page->newer->older = page->older;
+    }
+    else {
+        tier->newest = page->older;
+    }
+    if (page->older != NULL) {
+        page->older->newer = page->newer;
+    }
+    else {
+        tier->oldest = page->newer;
+    }
+}
+
+static void linkNewest(SM_ColdTier *tier, ColdPage *page)
+{
+    page->newer = NULL;
+    page->older = tier->newest;
+    if (tier->newest != NULL) {
+        tier->newest->newer = page;
+    }
+    else {
+        tier->oldest = page;
+    }
+    tier->newest = page;
+}
+
+/**
+ * @brief Drops a page. Its memory is released unless the governor is taking it back itself.
+ * @return the bytes the page took.
+ */
+static long long dropPage(SM_ColdTier *tier, ColdPage *page, int release)
+{
+    ColdPage **link = bucketOf(tier, page->pageNum);
+    while (*link != page) {
+        link = &(*link)->hashNext;
+    }
+    *link = page->hashNext;
+    unlinkAge(tier, page);
+    long long bytes = pageBytes(page);
+    tier->stats.pages--;
+    tier->stats.zeroPages -= page->kind == COLD_ZERO;
+    tier->stats.sameFilledPages -= page->kind == COLD_SAME_FILLED;
+    tier->stats.bytes -= bytes;
+    if (release) {
+        memRelease(tier->memory, bytes);
+    }
+    free(page->data);
+    free(page);
+    return bytes;
+}
+
+/* doubles the buckets when the chains get long; the buckets are not charged to the budget */
+static void growBuckets(SM_ColdTier *tier)
+{
+    int numBuckets = 2 * tier->numBuckets;
+    ColdPage **buckets = (ColdPage**) calloc((size_t) numBuckets, sizeof(ColdPage*));
+    if (buckets == NULL) {
+        return;
+    }
+    ColdPage **old = tier->buckets;
+    int oldNumBuckets = tier->numBuckets;
+    tier->buckets = buckets;
+    tier->numBuckets = numBuckets;
+    for (int i = 0; i < oldNumBuckets; i++) {
+        while (old[i] != NULL) {
+            ColdPage *page = old[i];
+            old[i] = page->hashNext;
+            ColdPage **bucket = bucketOf(tier, page->pageNum);
+            page->hashNext = *bucket;
+            *bucket = page;
+        }
+    }
+    free(old);
+}
+
+static void freeColdTier(SM_ColdTier *tier)
+{
+    while (tier->oldest != NULL) {
+        dropPage(tier, tier->oldest, 1);
+    }
+    pthread_mutex_destroy(&tier->lock);
+    free(tier->buckets);
+    free(tier->scratch);
+    free(tier);
+}
+
+
+/************************************************************
+ *                    storage manager hooks                 *
+ ************************************************************/
+
+/**
+ * @brief Copies a page from the tier if it holds it.
+ * @return 1 if the page was served from the tier.
+ */
+int coldTierRead(SM_ColdTier *tier, int pageNum, SM_PageHandle memPage)
+{
+    if (tier == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&tier->lock);
+    ColdPage *page = findPage(tier, pageNum);
+    int hit = page != NULL;
+    if (page != NULL && page->kind == COLD_ZERO) {
+        memset(memPage, 0, (size_t) tier->pageSize);
+    }
+    else if (page != NULL && page->kind == COLD_SAME_FILLED) {
+        for (int i = 0; i < tier->pageSize; i += (int) sizeof(uint64_t)) {
+            memcpy(memPage + i, &page->fill, sizeof(uint64_t));
+        }
+    }
+    else if (page != NULL && !decompressPage(page->data, page->size, (uint8_t*) memPage, tier->pageSize)) {
+        printMessage("A page in the cold tier is damaged and is read from the file.\n");
+        dropPage(tier, page, 1);
+        hit = 0;
+    }
+    if (hit) {
+        unlinkAge(tier, page);
+        linkNewest(tier, page);
+        tier->stats.hits++;
+    }
+    else {
+        tier->stats.misses++;
+    }
+    pthread_mutex_unlock(&tier->lock);
+    return hit;
+}
+
+/**
+ * @brief Keeps a compressed copy of a page read from or written to the file, replacing the
+ *        copy held before. Pages that do not compress well enough are only dropped.
+ */
+void coldTierStore(SM_ColdTier *tier, int pageNum, const char *data)
+{
+    if (tier == NULL) {
+        return;
+    }
+    const uint8_t *src = (const uint8_t*) data;
+    pthread_mutex_lock(&tier->lock);
+    ColdPage *old = findPage(tier, pageNum);
+    if (old != NULL) {
+        dropPage(tier, old, 1);
+    }
+    uint64_t fill = 0;
+    ColdPageKind kind = COLD_COMPRESSED;
+    int size = 0;
+    if (isSameFilled(src, tier->pageSize, &fill)) {
+        kind = fill == 0 ? COLD_ZERO : COLD_SAME_FILLED;
+    }
+    else {
+        size = compressPage(tier->hashTable, src, tier->pageSize, tier->scratch,
+                            tier->pageSize * COLD_TIER_MAX_STORED_PERCENT / 100);
+    }
+    ColdPage *page = size >= 0 ? (ColdPage*) calloc(1, sizeof(ColdPage)) : NULL;
+    if (page != NULL && size > 0 && (page->data = (uint8_t*) malloc((size_t) size)) == NULL) {
+        free(page);
+        page = NULL;
+    }
+    if (page == NULL) {
+        tier->stats.rejected++;
+        pthread_mutex_unlock(&tier->lock);
+        return;
+    }
+    page->pageNum = pageNum;
+    page->kind = kind;
+    page->size = size;
+    page->fill = fill;
+    if (size > 0) {
+        memcpy(page->data, tier->scratch, (size_t) size);
+    }
+    // The oldest pages make room, first for the tier's own limit, then for the memory budget.
+    long long bytes = pageBytes(page);
+    while (tier->oldest != NULL && tier->stats.bytes + bytes > tier->stats.maxBytes) {
+        dropPage(tier, tier->oldest, 1);
+        tier->stats.evictions++;
+    }
+    RC rc;
+    while ((rc = memReserve(tier->memory, bytes)) != RC_OK && tier->oldest != NULL) {
+        dropPage(tier, tier->oldest, 1);
+        tier->stats.evictions++;
+    }
+    if (rc != RC_OK || bytes > tier->stats.maxBytes) {
+        if (rc == RC_OK) {
+            memRelease(tier->memory, bytes);
+        }
+        free(page->data);
+        free(page);
+        tier->stats.rejected++;
+        pthread_mutex_unlock(&tier->lock);
+        return;
+    }
+    if (tier->stats.pages >= 2 * tier->numBuckets) {
+        growBuckets(tier);
+    }
+    ColdPage **bucket = bucketOf(tier, pageNum);
+    page->hashNext = *bucket;
+    *bucket = page;
+    linkNewest(tier, page);
+    tier->stats.pages++;
+    tier->stats.zeroPages += kind == COLD_ZERO;
+    tier->stats.sameFilledPages += kind == COLD_SAME_FILLED;
+    tier->stats.bytes += bytes;
+    tier->stats.stored++;
+    pthread_mutex_unlock(&tier->lock);
+}
+
+/**
+ * @brief Drops the copies of pages that were changed or removed without passing through the tier.
+ */
+void coldTierInvalidate(SM_ColdTier *tier, int firstPage, int numPages)
+{
+    if (tier == NULL || numPages <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&tier->lock);
+    if (numPages > tier->stats.pages) {
+        // Walking the pages is cheaper than looking up a long range.
+        ColdPage *page = tier->oldest;
+        while (page != NULL) {
+            ColdPage *newer = page->newer;
+            if (page->pageNum >= firstPage && page->pageNum - firstPage < numPages) {
+                dropPage(tier, page, 1);
+            }
+            page = newer;
+        }
+    }
+    else {
+        for (int i = 0; i < numPages; i++) {
+            ColdPage *page = findPage(tier, firstPage + i);
+            if (page != NULL) {
+                dropPage(tier, page, 1);
+            }
+        }
+    }
+    pthread_mutex_unlock(&tier->lock);
+}
+
+/**
+ * @brief Drops the oldest pages when the memory budget is short. Called by the memory governor
+ *        with its lock held, so a tier that is in use is skipped.
+ * @return the bytes given back.
+ */
+long long coldTierShrink(SM_ColdTier *tier, long long bytes)
+{
+    if (tier == NULL || pthread_mutex_trylock(&tier->lock) != 0) {
+        return 0;
+    }
+    long long freed = 0;
+    while (freed < bytes && tier->oldest != NULL) {
+        freed += dropPage(tier, tier->oldest, 0);
+        tier->stats.evictions++;
+    }
+    tier->stats.bytesShrunk += freed;
+    pthread_mutex_unlock(&tier->lock);
+    return freed;
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Gives an open file a cold tier: compressed copies of the pages read and written
+ *        through it are kept in memory, and readBlock serves pages from them before reading
+ *        the file. The tier is shared by the handles of the file (see sharePageFile); other
+ *        opens of the same file that write to it are not seen. Files read through a shared
+ *        pool or a compaction bypass the tier.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param maxBytes Memory the tier may hold, or 0 for COLD_TIER_DEFAULT_BYTES. It is also
+ *        charged to the file's memory budget.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the file already has a cold tier or memory ran out.
+ */
+RC enableColdTier(SM_FileHandle *fHandle, long long maxBytes)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || maxBytes < 0) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->coldTier != NULL) {
+        printMessage("The file %s already has a cold tier!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    SM_ColdTier *tier = (SM_ColdTier*) calloc(1, sizeof(SM_ColdTier));
+    if (tier == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    tier->pageSize = fHandle->pageSize;
+    tier->memory = openFile->memory;
+    tier->numBuckets = COLD_FIRST_BUCKETS;
+    tier->buckets = (ColdPage**) calloc((size_t) tier->numBuckets, sizeof(ColdPage*));
+    tier->scratch = (uint8_t*) malloc((size_t) fHandle->pageSize);
+    tier->stats.maxBytes = maxBytes > 0 ? maxBytes : COLD_TIER_DEFAULT_BYTES;
+    pthread_mutex_init(&tier->lock, NULL);
+    if (tier->buckets == NULL || tier->scratch == NULL) {
+        freeColdTier(tier);
+        return RC_WRITE_FAILED;
+    }
+    __atomic_store_n(&openFile->coldTier, tier, __ATOMIC_RELEASE);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Drops the cold tier of a file and gives its memory back; the stats stay readable
+ *        through getColdTierStats until a tier is enabled again.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @return RC_OK if successful, also if the file has no cold tier.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC disableColdTier(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_ColdTier *tier = __atomic_exchange_n(&openFile->coldTier, NULL, __ATOMIC_ACQ_REL);
+    if (tier == NULL) {
+        return RC_OK;
+    }
+    // The memory governor may be shrinking the tier, and reads and writes through other
+    // handles sharing the file may still be using it; both must be done before it is freed.
+    memQuiesce();
+    quiesceOpenFile(openFile);
+    openFile->coldTierStats = tier->stats;
+    freeColdTier(tier);
+    openFile->coldTierStats.pages = 0;
+    openFile->coldTierStats.zeroPages = 0;
+    openFile->coldTierStats.sameFilledPages = 0;
+    openFile->coldTierStats.bytes = 0;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Reports the pages the cold tier holds, the memory they take and how reads were
+ *        served, or the final stats of the last tier of the file.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC getColdTierStats(SM_FileHandle *fHandle, SM_ColdTierStats *stats)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || stats == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    int epoch = beginOpenFileIo(openFile);
+    SM_ColdTier *tier = __atomic_load_n(&openFile->coldTier, __ATOMIC_ACQUIRE);
+    if (tier == NULL) {
+        *stats = openFile->coldTierStats;
+    }
+    else {
+        pthread_mutex_lock(&tier->lock);
+        *stats = tier->stats;
+        pthread_mutex_unlock(&tier->lock);
+    }
+    endOpenFileIo(openFile, epoch);
+    return RC_OK;
+}
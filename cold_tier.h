@@ -0,0 +1,53 @@
+#ifndef COLD_TIER_H
+#define COLD_TIER_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    cold tier constants                   *
+ ************************************************************/
+/* memory a cold tier may hold when enableColdTier is not given a limit */
+#define COLD_TIER_DEFAULT_BYTES (16 * 1024 * 1024)
+/* pages that compress to more than this percentage of a page are not kept */
+#define COLD_TIER_MAX_STORED_PERCENT 75
+
+/* compressed copies of recently read and written pages of an open file */
+typedef struct SM_ColdTier SM_ColdTier;
+
+typedef struct SM_ColdTierStats {
+	int pages;                /* pages held, including the two kinds below */
+	int zeroPages;            /* held without data */
+	int sameFilledPages;      /* a repeated 8-byte value, held without data */
+	long long bytes;          /* memory the pages take, bookkeeping included */
+	long long maxBytes;
+	long hits;                /* reads served from the tier */
+	long misses;              /* reads that went to the file */
+	long stored;
+	long rejected;            /* pages that did not compress well enough to keep */
+	long evictions;           /* pages dropped to make room */
+	long long bytesShrunk;    /* given back to the memory governor */
+} SM_ColdTierStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC enableColdTier (SM_FileHandle *fHandle, long long maxBytes);
+extern RC disableColdTier (SM_FileHandle *fHandle);
+extern RC getColdTierStats (SM_FileHandle *fHandle, SM_ColdTierStats *stats);
+
+/* used by the storage manager for files with a cold tier */
+extern int coldTierRead (SM_ColdTier *tier, int pageNum, SM_PageHandle memPage);
+extern void coldTierStore (SM_ColdTier *tier, int pageNum, const char *page);
+extern void coldTierInvalidate (SM_ColdTier *tier, int firstPage, int numPages);
+extern long long coldTierShrink (SM_ColdTier *tier, long long bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,351 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compaction.h"
+#include "sm_backend.h"
+#include "page_kernels.h"
+
+/*
+ * Compaction moves the live pages of a file to the front, keeping their order, and cuts off
+ * the tail. A live page only ever moves to a lower page number, and pages are moved in page
+ * order, so the place a page is copied to is always free or belongs to a page that was moved
+ * already. That lets the work be done in bounded steps while the handle is used for reads:
+ * until the last step, reads take the old page numbers and are sent to wherever the page is
+ * at that moment. Writes and growing the file fail until the compaction is done. Once it is
+ * done the compaction only keeps its remap table; reads no longer go through it.
+ */
+
+struct SM_Compaction {
+    SM_FileHandle *fHandle;
+    SM_OpenFile *openFile;
+    SM_PageMovedFn moved;
+    void *arg;
+    /* new page number of every old page, PAGE_NOT_LIVE for free pages */
+    int *remap;
+    /* pages below the cursor have been moved */
+    int cursor;
+    SM_CompactStats stats;
+    char *buffer;
+    /* keeps reads from seeing a page while it is being overwritten */
+    pthread_mutex_t lock;
+};
+
+
+static RC readPhysicalPage(SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage)
+{
+    return openFile->pool != NULL
+        ? sharedPoolRead(openFile->pool, openFile, pageNum, memPage)
+        : openFile->backend->read(openFile->state, pageNum, memPage);
+}
+
+static RC writePhysicalPage(SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage)
+{
+    return openFile->pool != NULL
+        ? sharedPoolWrite(openFile->pool, openFile, pageNum, memPage)
+        : openFile->backend->write(openFile->state, pageNum, memPage);
+}
+
+static void freeCompaction(SM_Compaction *compaction)
+{
+    pthread_mutex_destroy(&compaction->lock);
+    free(compaction->remap);
+    free(compaction->buffer);
+    free(compaction);
+}
+
+/**
+ * @brief Cuts the file after the last live page once every page has been moved.
+ *        Must be called with the compaction's lock held.
+ */
+static RC finishCompaction(SM_Compaction *compaction)
+{
+    SM_OpenFile *openFile = compaction->openFile;
+    SM_FileHandle *fHandle = compaction->fHandle;
+    int newNumPages = compaction->stats.newNumPages;
+    if (compaction->stats.livePages == 0) {
+        // The one page that is kept must not show old data.
+        memset(compaction->buffer, 0, (size_t) fHandle->pageSize);
+        if (writePhysicalPage(openFile, 0, compaction->buffer) != RC_OK) {
+            return RC_WRITE_FAILED;
+        }
+    }
+    // Cutting the file also records the new size in the change map and the shipping stream.
+    if (truncateOpenFile(fHandle, newNumPages) != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    // Remembered hashes belong to the old page numbers.
+    for (int i = 0; i < WRITE_HASH_SLOTS; i++) {
+        openFile->writeHashes[i].pageNum = -1;
+    }
+    compaction->stats.done = 1;
+    printMessage("The file %s has been compacted from %d to %d pages!\n", fHandle->fileName,
+                 compaction->stats.oldNumPages, newNumPages);
+    return RC_OK;
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Starts compacting a page file. Every page is classified as live or free and given its
+ *        new page number; no page is moved yet. From now until the compaction is done, reads
+ *        through this handle use the old page numbers, free pages read as zero pages, and
+ *        writes, appends and ensureCapacity fail.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param isLive Tells which pages hold data; NULL treats all-zero pages as free.
+ * @param moved Optional, called for every page that was moved.
+ * @param arg Passed to both callbacks.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the backend cannot truncate files, a compaction or a background
+ *         scrubber is running on the handle, or the pages could not be read.
+ */
+RC startCompaction(SM_FileHandle *fHandle, SM_PageLiveFn isLive, SM_PageMovedFn moved, void *arg)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->backend->truncate == NULL) {
+        printMessage("The %s backend cannot compact %s!\n", openFile->backend->name, fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    if ((openFile->compaction != NULL && !openFile->compaction->stats.done) || openFile->scrubber != NULL) {
+        printMessage("The file %s is busy and cannot be compacted!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    cancelCompaction(fHandle);
+    SM_Compaction *compaction = (SM_Compaction*) calloc(1, sizeof(SM_Compaction));
+    if (compaction == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    pthread_mutex_init(&compaction->lock, NULL);
+    compaction->fHandle = fHandle;
+    compaction->openFile = openFile;
+    compaction->moved = moved;
+    compaction->arg = arg;
+    compaction->stats.oldNumPages = fHandle->totalNumPages;
+    compaction->remap = (int*) malloc(sizeof(int) * (size_t) (fHandle->totalNumPages > 0 ? fHandle->totalNumPages : 1));
+    compaction->buffer = (char*) malloc((size_t) fHandle->pageSize);
+    if (compaction->remap == NULL || compaction->buffer == NULL) {
+        freeCompaction(compaction);
+        return RC_WRITE_FAILED;
+    }
+    int live = 0;
+    for (int pageNum = 0; pageNum < fHandle->totalNumPages; pageNum++) {
+        int isPageLive;
+        if (isLive != NULL) {
+            isPageLive = isLive(pageNum, arg);
+        }
+        else if (readPhysicalPage(openFile, pageNum, compaction->buffer) != RC_OK) {
+            printMessage("The file %s could not be read!\n", fHandle->fileName);
+            freeCompaction(compaction);
+            return RC_WRITE_FAILED;
+        }
+        else {
+            isPageLive = !pageIsZero(compaction->buffer, fHandle->pageSize);
+        }
+        compaction->remap[pageNum] = isPageLive ? live++ : PAGE_NOT_LIVE;
+        if (isPageLive && compaction->remap[pageNum] != pageNum) {
+            compaction->stats.pagesToMove++;
+        }
+    }
+    compaction->stats.livePages = live;
+    // A page file always has at least one page.
+    compaction->stats.newNumPages = live > 0 ? live : 1;
+    // Pages are renumbered from here on; reads bypass the cold tier until the compaction is dropped.
+    int epoch = beginOpenFileIo(openFile);
+    coldTierInvalidate(__atomic_load_n(&openFile->coldTier, __ATOMIC_ACQUIRE), 0, compaction->stats.oldNumPages);
+    endOpenFileIo(openFile, epoch);
+    openFile->compaction = compaction;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Moves up to maxPages live pages and cuts off the tail after the last one.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param maxPages Upper bound for the pages moved by this step, so a step takes bounded time.
+ * @param stats Optional, receives the progress; done is set once the file has been cut.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if no compaction was started on the handle.
+ *         RC_WRITE_FAILED if a page could not be moved or the file could not be cut.
+ */
+RC compactStep(SM_FileHandle *fHandle, int maxPages, SM_CompactStats *stats)
+{
+    SM_OpenFile *openFile = fHandle == NULL ? NULL : (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile == NULL || openFile->compaction == NULL) {
+        printMessage("No compaction has been started on the file handle.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_Compaction *compaction = openFile->compaction;
+    RC rc = RC_OK;
+    int movedNow = 0;
+    if (!compaction->stats.done) {
+        compaction->stats.steps++;
+    }
+    while (rc == RC_OK && !compaction->stats.done && movedNow < maxPages) {
+        pthread_mutex_lock(&compaction->lock);
+        if (compaction->cursor == compaction->stats.oldNumPages) {
+            rc = finishCompaction(compaction);
+            pthread_mutex_unlock(&compaction->lock);
+            break;
+        }
+        int oldPageNum = compaction->cursor;
+        int newPageNum = compaction->remap[oldPageNum];
+        if (newPageNum != PAGE_NOT_LIVE && newPageNum != oldPageNum) {
+            if (readPhysicalPage(openFile, oldPageNum, compaction->buffer) != RC_OK
+                || writePhysicalPage(openFile, newPageNum, compaction->buffer) != RC_OK) {
+                printMessage("Page %d of %s could not be moved!\n", oldPageNum, fHandle->fileName);
+                rc = RC_WRITE_FAILED;
+            }
+            else {
+                noteChangedPages(openFile->changes, newPageNum, 1);
+                shipPages(openFile->shipper, newPageNum, 1, compaction->buffer);
+                compaction->stats.pagesMoved++;
+                movedNow++;
+            }
+        }
+        else {
+            newPageNum = oldPageNum;
+        }
+        if (rc == RC_OK) {
+            compaction->cursor++;
+        }
+        pthread_mutex_unlock(&compaction->lock);
+        // Outside the lock, so the callback may read through the handle.
+        if (rc == RC_OK && newPageNum != oldPageNum && compaction->moved != NULL) {
+            compaction->moved(oldPageNum, newPageNum, compaction->arg);
+        }
+    }
+    if (stats != NULL) {
+        *stats = compaction->stats;
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Compacts a page file in one go: moves the live pages to the front and cuts the file
+ *        after the last one.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param isLive Tells which pages hold data; NULL treats all-zero pages as free.
+ * @param moved Optional, called for every page that was moved.
+ * @param arg Passed to both callbacks.
+ * @param stats Optional, receives the result.
+ * @return RC_OK if successful, otherwise the error of startCompaction or compactStep.
+ */
+RC compactPageFile(SM_FileHandle *fHandle, SM_PageLiveFn isLive, SM_PageMovedFn moved, void *arg, SM_CompactStats *stats)
+{
+    RC rc = startCompaction(fHandle, isLive, moved, arg);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    SM_CompactStats progress;
+    do {
+        rc = compactStep(fHandle, fHandle->totalNumPages + 1, &progress);
+    } while (rc == RC_OK && !progress.done);
+    if (stats != NULL) {
+        *stats = progress;
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Copies the remap table of the last compaction started on the handle: the new page
+ *        number of every old page, or PAGE_NOT_LIVE for pages that were dropped.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param remap Receives up to numPages entries.
+ * @param numPages Size of the remap array.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if no compaction was started on the handle.
+ */
+RC getCompactionRemap(SM_FileHandle *fHandle, int *remap, int numPages)
+{
+    SM_OpenFile *openFile = fHandle == NULL ? NULL : (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile == NULL || openFile->compaction == NULL || remap == NULL) {
+        printMessage("No compaction has been started on the file handle.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_Compaction *compaction = openFile->compaction;
+    int count = numPages < compaction->stats.oldNumPages ? numPages : compaction->stats.oldNumPages;
+    memcpy(remap, compaction->remap, sizeof(int) * (size_t) (count > 0 ? count : 0));
+    return RC_OK;
+}
+
+
+/************************************************************
+ *                    storage manager hooks                 *
+ ************************************************************/
+
+/**
+ * @brief Reads a page by its number from before the compaction. Moved pages are read from their
+ *        new place and free pages read as zero pages. Once the compaction is done, page numbers
+ *        are the new ones.
+ */
+RC compactionRead(SM_Compaction *compaction, SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage)
+{
+    pthread_mutex_lock(&compaction->lock);
+    RC rc;
+    if (compaction->stats.done || pageNum >= compaction->stats.oldNumPages) {
+        rc = readPhysicalPage(openFile, pageNum, memPage);
+    }
+    else if (compaction->remap[pageNum] == PAGE_NOT_LIVE) {
+        memset(memPage, 0, (size_t) compaction->fHandle->pageSize);
+        rc = RC_OK;
+    }
+    else {
+        rc = readPhysicalPage(openFile, pageNum < compaction->cursor ? compaction->remap[pageNum] : pageNum, memPage);
+    }
+    pthread_mutex_unlock(&compaction->lock);
+    return rc;
+}
+
+
+/**
+ * @brief Returns non-zero while a compaction of the file is moving pages.
+ */
+int compactionInProgress(SM_Compaction *compaction)
+{
+    return compaction != NULL && !compaction->stats.done;
+}
+
+
+/**
+ * @brief Drops the compaction of a handle. Pages moved so far stay at their new place and the
+ *        file keeps its length; used when the handle is closed.
+ */
+void cancelCompaction(SM_FileHandle *fHandle)
+{
+    SM_OpenFile *openFile = fHandle == NULL ? NULL : (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile == NULL || openFile->compaction == NULL) {
+        return;
+    }
+    if (!openFile->compaction->stats.done) {
+        printMessage("The compaction of %s was stopped after %d of %d pages!\n", fHandle->fileName,
+                     openFile->compaction->stats.pagesMoved, openFile->compaction->stats.pagesToMove);
+    }
+    freeCompaction(openFile->compaction);
+    openFile->compaction = NULL;
+}
+
+
+/**
+ * @brief Returns non-zero if the compaction of the file was started through this handle,
+ *        which it keeps using until it is freed.
+ */
+int compactionUsesHandle(SM_FileHandle *fHandle)
+{
+    SM_OpenFile *openFile = fHandle == NULL ? NULL : (SM_OpenFile*) fHandle->mgmtInfo;
+    return openFile != NULL && openFile->compaction != NULL && openFile->compaction->fHandle == fHandle;
+}
@@ -0,0 +1,53 @@
+#ifndef COMPACTION_H
+#define COMPACTION_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    compaction data structures            *
+ ************************************************************/
+/* remap table entry of a page that is not live */
+#define PAGE_NOT_LIVE -1
+
+typedef struct SM_Compaction SM_Compaction;
+
+/* returns non-zero if the page holds data; with no callback all-zero pages count as free */
+typedef int (*SM_PageLiveFn) (int pageNum, void *arg);
+/* called after a live page was copied to its new place, so references to it can be rewritten */
+typedef void (*SM_PageMovedFn) (int oldPageNum, int newPageNum, void *arg);
+
+typedef struct SM_CompactStats {
+	int oldNumPages;
+	int newNumPages;
+	int livePages;
+	int pagesToMove;
+	int pagesMoved;
+	int steps;
+	int done;
+} SM_CompactStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC compactPageFile (SM_FileHandle *fHandle, SM_PageLiveFn isLive, SM_PageMovedFn moved, void *arg, SM_CompactStats *stats);
+extern RC startCompaction (SM_FileHandle *fHandle, SM_PageLiveFn isLive, SM_PageMovedFn moved, void *arg);
+extern RC compactStep (SM_FileHandle *fHandle, int maxPages, SM_CompactStats *stats);
+extern RC getCompactionRemap (SM_FileHandle *fHandle, int *remap, int numPages);
+
+/* used by the storage manager for handles that are being compacted */
+struct SM_OpenFile;
+extern RC compactionRead (SM_Compaction *compaction, struct SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage);
+extern int compactionInProgress (SM_Compaction *compaction);
+extern void cancelCompaction (SM_FileHandle *fHandle);
+extern int compactionUsesHandle (SM_FileHandle *fHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
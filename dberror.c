@@ -3,9 +3,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 
 char *RC_message;
 
+/* non-zero while the thread's diagnostics are switched off */
+static __thread int messagesOff = 0;
+
 /* print a message to standard out describing the error */
 void 
 printError (RC error)
@@ -34,3 +38,26 @@ errorMessage (RC error)
 
 	return message;
 }
+
+/* print a diagnostic to standard out unless the calling thread switched them off */
+void
+printMessage (const char *format, ...)
+{
+	va_list args;
+
+	if (messagesOff)
+		return;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
+/* switch the calling thread's diagnostics on or off; returns the previous setting */
+int
+setMessagesEnabled (int enabled)
+{
+	int previous = !messagesOff;
+
+	messagesOff = !enabled;
+	return previous;
+}
@@ -6,6 +6,10 @@
 /* module wide constants */
 #define PAGE_SIZE 4096
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* return code definitions */
 typedef int RC;
 
@@ -14,6 +18,8 @@ typedef int RC;
 #define RC_FILE_HANDLE_NOT_INIT 2
 #define RC_WRITE_FAILED 3
 #define RC_READ_NON_EXISTING_PAGE 4
+#define RC_PAGE_CORRUPT 5
+#define RC_MEMORY_BUDGET_EXCEEDED 6
 
 #define RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE 200
 #define RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN 201
@@ -34,6 +40,11 @@ extern char *RC_message;
 extern void printError (RC error);
 extern char *errorMessage (RC error);
 
+/* diagnostics of the storage manager and the layers above it; printed to standard out
+ * unless the calling thread has switched them off */
+extern void printMessage (const char *format, ...);
+extern int setMessagesEnabled (int enabled);
+
 #define THROW(rc,message) \
 		do {			  \
 			RC_message=message;	  \
@@ -54,4 +65,8 @@ extern char *errorMessage (RC error);
 		} while(0);
 
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,503 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "extent_map.h"
+#include "page_kernels.h"
+#include "sm_backend.h"
+
+/*
+ * The extent map hands out pages of a page file to objects (tables, indexes, large objects)
+ * so that each object's pages are grouped in extents of extentPages consecutive pages. A new
+ * extent is claimed with a single ensureCapacity call, so the file grows a whole extent at a
+ * time and scanning an object reads long runs of adjacent pages.
+ *
+ * For page files on disk the map is kept in <file>.ext and written on syncExtentMap and
+ * closeExtentMap; for other backends it lives as long as it is open.
+ */
+
+typedef struct SM_ExtentMapFile {
+    char magic[8];
+    int32_t extentPages;
+    int32_t numExtents;
+} SM_ExtentMapFile;
+
+struct SM_ExtentMap {
+    SM_FileHandle *fHandle;
+    /* NULL if the map is not persisted */
+    char *mapPath;
+    int extentPages;
+    int numExtents;
+    int capacity;
+    int *owners;
+    int *usedCount;
+    /* one byte per page of every extent, non-zero if the page is allocated */
+    unsigned char *used;
+    /* the extent the last page was allocated from, tried first for the same object */
+    int lastObject;
+    int lastExtent;
+    pthread_mutex_t lock;
+};
+
+
+static char *makeExtentMapPath(const char *fileName)
+{
+    char *mapPath = (char*) malloc(strlen(fileName) + strlen(EXTENT_MAP_SUFFIX) + 1);
+    if (mapPath != NULL) {
+        strcpy(mapPath, fileName);
+        strcat(mapPath, EXTENT_MAP_SUFFIX);
+    }
+    return mapPath;
+}
+
+/**
+ * @brief Makes room for numExtents extents in the map's arrays; new extents are free.
+ */
+static RC reserveExtents(SM_ExtentMap *map, int numExtents)
+{
+    if (numExtents <= map->capacity) {
+        return RC_OK;
+    }
+    int newCapacity = map->capacity > 0 ? map->capacity : 16;
+    while (newCapacity < numExtents) {
+        newCapacity *= 2;
+    }
+    int *owners = (int*) realloc(map->owners, sizeof(int) * newCapacity);
+    if (owners != NULL) {
+        map->owners = owners;
+    }
+    int *usedCount = (int*) realloc(map->usedCount, sizeof(int) * newCapacity);
+    if (usedCount != NULL) {
+        map->usedCount = usedCount;
+    }
+    unsigned char *used = (unsigned char*) realloc(map->used, (size_t) newCapacity * map->extentPages);
+    if (used != NULL) {
+        map->used = used;
+    }
+    if (owners == NULL || usedCount == NULL || used == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    for (int i = map->capacity; i < newCapacity; i++) {
+        map->owners[i] = NO_OWNER;
+        map->usedCount[i] = 0;
+    }
+    memset(map->used + (size_t) map->capacity * map->extentPages, 0,
+           (size_t) (newCapacity - map->capacity) * map->extentPages);
+    map->capacity = newCapacity;
+    return RC_OK;
+}
+
+/**
+ * @brief Loads the map file; returns RC_FILE_NOT_FOUND if there is none and RC_WRITE_FAILED if
+ *        it was written with another extent size or is damaged.
+ */
+static RC loadExtentMap(SM_ExtentMap *map)
+{
+    FILE *file = fopen(map->mapPath, "rb");
+    if (file == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    SM_ExtentMapFile header;
+    RC rc = RC_WRITE_FAILED;
+    if (fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, EXTENT_MAP_MAGIC, sizeof(header.magic)) == 0
+        && header.extentPages == map->extentPages && header.numExtents >= 0
+        && reserveExtents(map, header.numExtents) == RC_OK
+        && fread(map->owners, sizeof(int32_t), (size_t) header.numExtents, file) == (size_t) header.numExtents
+        && fread(map->used, 1, (size_t) header.numExtents * map->extentPages, file) == (size_t) header.numExtents * map->extentPages) {
+        map->numExtents = header.numExtents;
+        for (int extent = 0; extent < map->numExtents; extent++) {
+            for (int i = 0; i < map->extentPages; i++) {
+                map->usedCount[extent] += map->used[(size_t) extent * map->extentPages + i] != 0;
+            }
+        }
+        rc = RC_OK;
+    }
+    fclose(file);
+    return rc;
+}
+
+/**
+ * @brief Writes the map to its file through a temporary file and a rename.
+ *        Must be called with the map's lock held.
+ */
+static RC saveExtentMap(SM_ExtentMap *map)
+{
+    if (map->mapPath == NULL) {
+        return RC_OK;
+    }
+    char *tmpPath = (char*) malloc(strlen(map->mapPath) + 5);
+    if (tmpPath == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    sprintf(tmpPath, "%s.tmp", map->mapPath);
+    SM_ExtentMapFile header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EXTENT_MAP_MAGIC, sizeof(header.magic));
+    header.extentPages = map->extentPages;
+    header.numExtents = map->numExtents;
+    size_t usedBytes = (size_t) map->numExtents * map->extentPages;
+    RC rc = RC_OK;
+    FILE *file = fopen(tmpPath, "wb");
+    if (file == NULL
+        || fwrite(&header, sizeof(header), 1, file) != 1
+        || fwrite(map->owners, sizeof(int32_t), (size_t) map->numExtents, file) != (size_t) map->numExtents
+        || fwrite(map->used, 1, usedBytes, file) != usedBytes
+        || fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (file != NULL && fclose(file) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK && rename(tmpPath, map->mapPath) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(tmpPath);
+    return rc;
+}
+
+/**
+ * @brief Takes the first free page of an extent. Must be called with the map's lock held.
+ */
+static int takePage(SM_ExtentMap *map, int extent)
+{
+    unsigned char *used = map->used + (size_t) extent * map->extentPages;
+    for (int i = 0; i < map->extentPages; i++) {
+        if (!used[i]) {
+            used[i] = 1;
+            map->usedCount[extent]++;
+            return extent * map->extentPages + i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Finds an extent of the object with a free page, or -1. Must be called with the map's
+ *        lock held.
+ */
+static int findObjectExtent(SM_ExtentMap *map, int objectId)
+{
+    if (map->lastObject == objectId && map->lastExtent < map->numExtents
+        && map->owners[map->lastExtent] == objectId && map->usedCount[map->lastExtent] < map->extentPages) {
+        return map->lastExtent;
+    }
+    for (int extent = 0; extent < map->numExtents; extent++) {
+        if (map->owners[extent] == objectId && map->usedCount[extent] < map->extentPages) {
+            return extent;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Claims an extent for an object, reusing a free one before growing the file by a whole
+ *        extent. Must be called with the map's lock held.
+ */
+static RC claimExtent(SM_ExtentMap *map, int objectId, int *extent)
+{
+    for (int i = 0; i < map->numExtents; i++) {
+        if (map->owners[i] == NO_OWNER && map->usedCount[i] == 0) {
+            map->owners[i] = objectId;
+            *extent = i;
+            return RC_OK;
+        }
+    }
+    if (reserveExtents(map, map->numExtents + 1) != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    // One extend call for the whole extent keeps its pages contiguous in the file.
+    RC rc = ensureCapacity((map->numExtents + 1) * map->extentPages, map->fHandle);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    *extent = map->numExtents++;
+    map->owners[*extent] = objectId;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Checks that a file holds no data yet, only the single empty page of a new page file.
+ *        Extents are numbered from page 0, so a new map on a file with data would hand its
+ *        pages out to objects.
+ */
+static RC checkFileIsNew(SM_FileHandle *fHandle)
+{
+    char *page = (char*) malloc((size_t) fHandle->pageSize);
+    RC rc = page == NULL ? RC_WRITE_FAILED : readBlock(0, fHandle, page);
+    if (rc == RC_OK && (fHandle->totalNumPages > 1 || !pageIsZero(page, fHandle->pageSize))) {
+        printMessage("%s already holds pages the extent map does not know about!\n", fHandle->fileName);
+        rc = RC_WRITE_FAILED;
+    }
+    free(page);
+    return rc;
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Opens the extent map of a page file, creating an empty one if the file has none.
+ *        A new map is only created for a file without data: a new page file, whose one page
+ *        is handed out like any other.
+ *
+ * @param fHandle The open page file the pages are allocated in. It must stay open while the
+ *        map is used.
+ * @param extentPages Pages per extent, 0 for DEFAULT_EXTENT_PAGES. A saved map must be opened
+ *        with the extent size it was created with.
+ * @param map Receives the map.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the saved map has another extent size or is damaged, or if there is
+ *                         no saved map and the file already holds data.
+ */
+RC openExtentMap(SM_FileHandle *fHandle, int extentPages, SM_ExtentMap **map)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || map == NULL || extentPages < 0) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_ExtentMap *extents = (SM_ExtentMap*) calloc(1, sizeof(SM_ExtentMap));
+    if (extents == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    extents->fHandle = fHandle;
+    extents->extentPages = extentPages > 0 ? extentPages : DEFAULT_EXTENT_PAGES;
+    extents->lastObject = NO_OWNER;
+    pthread_mutex_init(&extents->lock, NULL);
+    RC rc = RC_FILE_NOT_FOUND;
+    if (((SM_OpenFile*) fHandle->mgmtInfo)->backend == &posixBackend) {
+        extents->mapPath = makeExtentMapPath(fHandle->fileName);
+        rc = extents->mapPath == NULL ? RC_WRITE_FAILED : loadExtentMap(extents);
+    }
+    if (rc == RC_FILE_NOT_FOUND) {
+        rc = checkFileIsNew(fHandle);
+    }
+    if (rc != RC_OK) {
+        printMessage("The extent map of %s could not be opened!\n", fHandle->fileName);
+        closeExtentMap(extents);
+        return rc;
+    }
+    *map = extents;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Saves the extent map of a page file on disk.
+ *
+ * @param map The map returned by openExtentMap.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the map is NULL.
+ *         RC_WRITE_FAILED if the map could not be written.
+ */
+RC syncExtentMap(SM_ExtentMap *map)
+{
+    if (map == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&map->lock);
+    RC rc = saveExtentMap(map);
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+
+/**
+ * @brief Saves and frees an extent map.
+ *
+ * @param map The map returned by openExtentMap.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the map is NULL.
+ *         RC_WRITE_FAILED if the map could not be written.
+ */
+RC closeExtentMap(SM_ExtentMap *map)
+{
+    if (map == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RC rc = map->numExtents > 0 ? syncExtentMap(map) : RC_OK;
+    pthread_mutex_destroy(&map->lock);
+    free(map->mapPath);
+    free(map->owners);
+    free(map->usedCount);
+    free(map->used);
+    free(map);
+    return rc;
+}
+
+
+/**
+ * @brief Removes the extent map file of a page file that is being destroyed.
+ */
+void destroyExtentMap(char *fileName)
+{
+    char *mapPath = makeExtentMapPath(fileName);
+    if (mapPath != NULL) {
+        unlink(mapPath);
+        free(mapPath);
+    }
+}
+
+
+/**
+ * @brief Allocates a page for an object. The page comes from an extent the object already owns
+ *        if one has room, otherwise from a free extent, otherwise the file grows by an extent.
+ *
+ * @param map The map returned by openExtentMap.
+ * @param objectId Any non-negative number identifying the object.
+ * @param pageNum Receives the allocated page.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the map is NULL.
+ *         RC_WRITE_FAILED if objectId is invalid or the file could not grow.
+ */
+RC allocateObjectPage(SM_ExtentMap *map, int objectId, int *pageNum)
+{
+    if (map == NULL || pageNum == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (objectId < 0) {
+        printMessage("Object ids must not be negative.\n");
+        return RC_WRITE_FAILED;
+    }
+    RC rc = RC_OK;
+    pthread_mutex_lock(&map->lock);
+    int extent = findObjectExtent(map, objectId);
+    if (extent == -1) {
+        rc = claimExtent(map, objectId, &extent);
+    }
+    if (rc == RC_OK) {
+        *pageNum = takePage(map, extent);
+        map->lastObject = objectId;
+        map->lastExtent = extent;
+    }
+    pthread_mutex_unlock(&map->lock);
+    if (rc != RC_OK) {
+        printMessage("No page could be allocated for object %d in %s!\n", objectId, map->fHandle->fileName);
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Gives a page back. An extent whose last page is released no longer belongs to its
+ *        object and is reused for the next extent claimed by any object.
+ *
+ * @param map The map returned by openExtentMap.
+ * @param pageNum The page to release.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the map is NULL.
+ *         RC_READ_NON_EXISTING_PAGE if the page is not allocated.
+ */
+RC releaseObjectPage(SM_ExtentMap *map, int pageNum)
+{
+    if (map == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RC rc = RC_OK;
+    pthread_mutex_lock(&map->lock);
+    int extent = pageNum / map->extentPages;
+    if (pageNum < 0 || extent >= map->numExtents || !map->used[pageNum]) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    else {
+        map->used[pageNum] = 0;
+        if (--map->usedCount[extent] == 0) {
+            map->owners[extent] = NO_OWNER;
+        }
+    }
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+
+/**
+ * @brief Releases every page of an object.
+ *
+ * @param map The map returned by openExtentMap.
+ * @param objectId The object whose pages are released.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the map is NULL.
+ */
+RC releaseObject(SM_ExtentMap *map, int objectId)
+{
+    if (map == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&map->lock);
+    for (int extent = 0; extent < map->numExtents; extent++) {
+        if (map->owners[extent] == objectId) {
+            map->owners[extent] = NO_OWNER;
+            map->usedCount[extent] = 0;
+            memset(map->used + (size_t) extent * map->extentPages, 0, (size_t) map->extentPages);
+        }
+    }
+    pthread_mutex_unlock(&map->lock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Lists the extents owned by an object in file order, so its pages can be read extent
+ *        by extent.
+ *
+ * @param map The map returned by openExtentMap.
+ * @param objectId The object.
+ * @param extents Receives up to maxExtents extent numbers.
+ * @param maxExtents Size of the extents array.
+ * @param numExtents Receives the number of extents the object owns, which may exceed maxExtents.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the map is NULL.
+ */
+RC getObjectExtents(SM_ExtentMap *map, int objectId, int *extents, int maxExtents, int *numExtents)
+{
+    if (map == NULL || numExtents == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    int count = 0;
+    pthread_mutex_lock(&map->lock);
+    for (int extent = 0; extent < map->numExtents; extent++) {
+        if (map->owners[extent] == objectId) {
+            if (extents != NULL && count < maxExtents) {
+                extents[count] = extent;
+            }
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&map->lock);
+    *numExtents = count;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Reports the extent size, the number of extents and free extents and the pages in use.
+ *
+ * @param map The map returned by openExtentMap.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the map is NULL.
+ */
+RC getExtentStats(SM_ExtentMap *map, SM_ExtentStats *stats)
+{
+    if (map == NULL || stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&map->lock);
+    stats->extentPages = map->extentPages;
+    stats->numExtents = map->numExtents;
+    stats->freeExtents = 0;
+    stats->usedPages = 0;
+    for (int extent = 0; extent < map->numExtents; extent++) {
+        stats->freeExtents += map->owners[extent] == NO_OWNER;
+        stats->usedPages += map->usedCount[extent];
+    }
+    pthread_mutex_unlock(&map->lock);
+    return RC_OK;
+}
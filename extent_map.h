@@ -0,0 +1,52 @@
+#ifndef EXTENT_MAP_H
+#define EXTENT_MAP_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    extent map constants                  *
+ ************************************************************/
+/* suffix of the file next to a page file that holds its extent map */
+#define EXTENT_MAP_SUFFIX ".ext"
+#define EXTENT_MAP_MAGIC "SMEXTMAP"
+/* extent size used when openExtentMap is given 0 */
+#define DEFAULT_EXTENT_PAGES 64
+/* owner of an extent no object uses */
+#define NO_OWNER -1
+
+/* Extent e covers pages [e * extentPages, (e + 1) * extentPages) of the file. Each extent
+ * belongs to at most one object, and pages of an object are taken from its own extents
+ * before a new extent is claimed, so an object's pages stay physically together. */
+typedef struct SM_ExtentMap SM_ExtentMap;
+
+typedef struct SM_ExtentStats {
+	int extentPages;
+	int numExtents;
+	int freeExtents;
+	int usedPages;
+} SM_ExtentStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC openExtentMap (SM_FileHandle *fHandle, int extentPages, SM_ExtentMap **map);
+extern RC syncExtentMap (SM_ExtentMap *map);
+extern RC closeExtentMap (SM_ExtentMap *map);
+extern void destroyExtentMap (char *fileName);
+
+extern RC allocateObjectPage (SM_ExtentMap *map, int objectId, int *pageNum);
+extern RC releaseObjectPage (SM_ExtentMap *map, int pageNum);
+extern RC releaseObject (SM_ExtentMap *map, int objectId);
+extern RC getObjectExtents (SM_ExtentMap *map, int objectId, int *extents, int maxExtents, int *numExtents);
+extern RC getExtentStats (SM_ExtentMap *map, SM_ExtentStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,723 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "external_sort.h"
+#include "mem_governor.h"
+
+/*
+ * Sorting a page file that does not fit in memory takes two phases. The input is read in
+ * chunks that fill the memory budget; every chunk is sorted in memory and written as a run to
+ * a scratch page file. The runs are then merged, as many at a time as the budget has buffers
+ * for, with a loser tree: picking the next record costs one comparison per tree level.
+ * If there are more runs than that, merge passes write longer runs to a second scratch file
+ * until the last pass writes the output.
+ *
+ * All file I/O is done by one I/O thread in multi-page readBlocks/writeBlocks calls. Every
+ * stream has two buffers: while the sort works on one, the I/O thread fills or writes out
+ * the other, so reading the next input pages and writing the last output pages overlap with
+ * the comparisons.
+ */
+
+/* a multi-page transfer handed to the I/O thread */
+typedef struct SortBuffer {
+    char *pages;
+    SM_FileHandle *fHandle;
+    int firstPage;
+    int numPages;
+    int isWrite;
+    int pending;
+    RC rc;
+    struct SortBuffer *next;
+} SortBuffer;
+
+typedef struct SortIO {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    SortBuffer *head;
+    SortBuffer *tail;
+    int stop;
+    long pagesRead;
+    long pagesWritten;
+} SortIO;
+
+/* the layout of records in pages, shared by every file of one sort */
+typedef struct SortLayout {
+    int pageSize;
+    int recordSize;
+    int recordsPerPage;
+    SM_SortCompareFn compare;
+    void *arg;
+} SortLayout;
+
+/* reads the records of one run with two buffers of ioPages pages */
+typedef struct SortReader {
+    SortIO *io;
+    SortLayout *layout;
+    SortBuffer buffers[2];
+    int current;
+    int ioPages;
+    int nextPage;
+    int endPage;
+    long remaining;
+    int started;
+    int pageInBuffer;
+    int recordInPage;
+    RC rc;
+} SortReader;
+
+/* writes records to consecutive pages with two buffers of ioPages pages */
+typedef struct SortWriter {
+    SortIO *io;
+    SortLayout *layout;
+    SortBuffer buffers[2];
+    int current;
+    int ioPages;
+    int nextPage;
+    int pageInBuffer;
+    int recordInPage;
+    RC rc;
+} SortWriter;
+
+/* a sorted run in a scratch file */
+typedef struct SortRun {
+    int firstPage;
+    long numRecords;
+} SortRun;
+
+
+/************************************************************
+ *                    I/O thread                            *
+ ************************************************************/
+
+static void *sortIOMain(void *arg)
+{
+    SortIO *io = (SortIO*) arg;
+    pthread_mutex_lock(&io->lock);
+    for (;;) {
+        while (io->head == NULL && !io->stop) {
+            pthread_cond_wait(&io->changed, &io->lock);
+        }
+        SortBuffer *buffer = io->head;
+        if (buffer == NULL) {
+            break;
+        }
+        io->head = buffer->next;
+        if (io->head == NULL) {
+            io->tail = NULL;
+        }
+        pthread_mutex_unlock(&io->lock);
+        RC rc;
+        if (buffer->isWrite) {
+            rc = ensureCapacity(buffer->firstPage + buffer->numPages, buffer->fHandle);
+            if (rc == RC_OK) {
+                rc = writeBlocks(buffer->firstPage, buffer->numPages, buffer->fHandle, buffer->pages);
+            }
+        }
+        else {
+            rc = readBlocks(buffer->firstPage, buffer->numPages, buffer->fHandle, buffer->pages);
+        }
+        pthread_mutex_lock(&io->lock);
+        if (buffer->isWrite) {
+            io->pagesWritten += buffer->numPages;
+        }
+        else {
+            io->pagesRead += buffer->numPages;
+        }
+        buffer->rc = rc;
+        buffer->pending = 0;
+        pthread_cond_broadcast(&io->changed);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return NULL;
+}
+
+/**
+ * @brief Queues a buffer for the I/O thread; transfers are done in the order they are queued.
+ */
+static void submitBuffer(SortIO *io, SortBuffer *buffer)
+{
+    pthread_mutex_lock(&io->lock);
+    buffer->pending = 1;
+    buffer->next = NULL;
+    if (io->tail != NULL) {
+        io->tail->next = buffer;
+    }
+    else {
+        io->head = buffer;
+    }
+    io->tail = buffer;
+    pthread_cond_broadcast(&io->changed);
+    pthread_mutex_unlock(&io->lock);
+}
+
+/**
+ * @brief Waits until the I/O thread is done with a buffer.
+ */
+static RC awaitBuffer(SortIO *io, SortBuffer *buffer)
+{
+    pthread_mutex_lock(&io->lock);
+    while (buffer->pending) {
+        pthread_cond_wait(&io->changed, &io->lock);
+    }
+    RC rc = buffer->rc;
+    pthread_mutex_unlock(&io->lock);
+    return rc;
+}
+
+static RC startSortIO(SortIO *io)
+{
+    memset(io, 0, sizeof(SortIO));
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->changed, NULL);
+    if (pthread_create(&io->thread, NULL, sortIOMain, io) != 0) {
+        printMessage("The I/O thread of the sort could not be started!\n");
+        pthread_cond_destroy(&io->changed);
+        pthread_mutex_destroy(&io->lock);
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+static void stopSortIO(SortIO *io)
+{
+    pthread_mutex_lock(&io->lock);
+    io->stop = 1;
+    pthread_cond_broadcast(&io->changed);
+    pthread_mutex_unlock(&io->lock);
+    pthread_join(io->thread, NULL);
+    pthread_cond_destroy(&io->changed);
+    pthread_mutex_destroy(&io->lock);
+}
+
+
+/************************************************************
+ *                    record streams                        *
+ ************************************************************/
+
+static RC allocateBuffers(SortBuffer *buffers, SM_FileHandle *fHandle, int ioPages, int pageSize, int isWrite)
+{
+    memset(buffers, 0, 2 * sizeof(SortBuffer));
+    for (int i = 0; i < 2; i++) {
+        // Writers rely on the zeroed bytes at the end of every page.
+        buffers[i].pages = (char*) calloc((size_t) ioPages, (size_t) pageSize);
+        buffers[i].fHandle = fHandle;
+        buffers[i].isWrite = isWrite;
+        buffers[i].rc = RC_OK;
+    }
+    return buffers[0].pages != NULL && buffers[1].pages != NULL ? RC_OK : RC_WRITE_FAILED;
+}
+
+/**
+ * @brief Queues the next pages of a reader's run into one of its buffers.
+ */
+static void requestPages(SortReader *reader, SortBuffer *buffer)
+{
+    buffer->numPages = 0;
+    if (reader->nextPage < reader->endPage) {
+        int count = reader->endPage - reader->nextPage;
+        buffer->firstPage = reader->nextPage;
+        buffer->numPages = count < reader->ioPages ? count : reader->ioPages;
+        reader->nextPage += buffer->numPages;
+        submitBuffer(reader->io, buffer);
+    }
+}
+
+/**
+ * @brief Starts reading numRecords records from firstPage on; both buffers are queued at once.
+ */
+static RC openReader(SortReader *reader, SortIO *io, SortLayout *layout, SM_FileHandle *fHandle,
+                     int firstPage, long numRecords, int ioPages)
+{
+    memset(reader, 0, sizeof(SortReader));
+    reader->io = io;
+    reader->layout = layout;
+    reader->ioPages = ioPages;
+    reader->nextPage = firstPage;
+    reader->endPage = firstPage + (int) ((numRecords + layout->recordsPerPage - 1) / layout->recordsPerPage);
+    reader->remaining = numRecords;
+    RC rc = allocateBuffers(reader->buffers, fHandle, ioPages, layout->pageSize, 0);
+    if (rc == RC_OK) {
+        requestPages(reader, &reader->buffers[0]);
+        requestPages(reader, &reader->buffers[1]);
+    }
+    return rc;
+}
+
+/**
+ * @brief Returns the next record of a reader, valid until the next call, or NULL at the end of
+ *        the run or after an error, which is left in reader->rc.
+ */
+static const char *nextRecord(SortReader *reader)
+{
+    if (reader->remaining == 0 || reader->rc != RC_OK) {
+        return NULL;
+    }
+    SortBuffer *buffer = &reader->buffers[reader->current];
+    if (!reader->started) {
+        reader->started = 1;
+        reader->rc = awaitBuffer(reader->io, buffer);
+    }
+    else if (reader->recordInPage == reader->layout->recordsPerPage) {
+        reader->recordInPage = 0;
+        if (++reader->pageInBuffer == buffer->numPages) {
+            // The buffer is used up: refill it in the background and go on with the other one.
+            requestPages(reader, buffer);
+            reader->current ^= 1;
+            buffer = &reader->buffers[reader->current];
+            reader->pageInBuffer = 0;
+            reader->rc = awaitBuffer(reader->io, buffer);
+        }
+    }
+    if (reader->rc != RC_OK) {
+        return NULL;
+    }
+    const char *record = buffer->pages + (size_t) reader->pageInBuffer * reader->layout->pageSize
+        + (size_t) reader->recordInPage * reader->layout->recordSize;
+    reader->recordInPage++;
+    reader->remaining--;
+    return record;
+}
+
+static void closeReader(SortReader *reader)
+{
+    for (int i = 0; i < 2; i++) {
+        awaitBuffer(reader->io, &reader->buffers[i]);
+        free(reader->buffers[i].pages);
+        reader->buffers[i].pages = NULL;
+    }
+}
+
+static RC openWriter(SortWriter *writer, SortIO *io, SortLayout *layout, SM_FileHandle *fHandle, int ioPages)
+{
+    memset(writer, 0, sizeof(SortWriter));
+    writer->io = io;
+    writer->layout = layout;
+    writer->ioPages = ioPages;
+    return allocateBuffers(writer->buffers, fHandle, ioPages, layout->pageSize, 1);
+}
+
+/**
+ * @brief Queues the filled pages of the current buffer and waits for the other buffer's
+ *        previous write, so the next records can go there. A partly filled last page is
+ *        written too; the next record starts a new page.
+ */
+static RC flushWriter(SortWriter *writer)
+{
+    SortBuffer *buffer = &writer->buffers[writer->current];
+    int numPages = writer->pageInBuffer + (writer->recordInPage > 0);
+    if (numPages == 0 || writer->rc != RC_OK) {
+        return writer->rc;
+    }
+    if (writer->recordInPage > 0) {
+        SortLayout *layout = writer->layout;
+        char *page = buffer->pages + (size_t) writer->pageInBuffer * layout->pageSize;
+        memset(page + (size_t) writer->recordInPage * layout->recordSize, 0,
+               (size_t) (layout->recordsPerPage - writer->recordInPage) * layout->recordSize);
+    }
+    buffer->firstPage = writer->nextPage;
+    buffer->numPages = numPages;
+    writer->nextPage += numPages;
+    submitBuffer(writer->io, buffer);
+    writer->current ^= 1;
+    writer->pageInBuffer = 0;
+    writer->recordInPage = 0;
+    writer->rc = awaitBuffer(writer->io, &writer->buffers[writer->current]);
+    return writer->rc;
+}
+
+static RC putRecord(SortWriter *writer, const char *record)
+{
+    SortLayout *layout = writer->layout;
+    SortBuffer *buffer = &writer->buffers[writer->current];
+    memcpy(buffer->pages + (size_t) writer->pageInBuffer * layout->pageSize + (size_t) writer->recordInPage * layout->recordSize,
+           record, (size_t) layout->recordSize);
+    if (++writer->recordInPage == layout->recordsPerPage) {
+        writer->recordInPage = 0;
+        if (++writer->pageInBuffer == writer->ioPages) {
+            return flushWriter(writer);
+        }
+    }
+    return writer->rc;
+}
+
+/**
+ * @brief Writes what is left and waits for both buffers; the writer can't be used afterwards.
+ */
+static RC closeWriter(SortWriter *writer)
+{
+    RC rc = flushWriter(writer);
+    for (int i = 0; i < 2; i++) {
+        RC bufferRc = awaitBuffer(writer->io, &writer->buffers[i]);
+        if (rc == RC_OK) {
+            rc = bufferRc;
+        }
+        free(writer->buffers[i].pages);
+        writer->buffers[i].pages = NULL;
+    }
+    return rc;
+}
+
+
+/************************************************************
+ *                    merging                               *
+ ************************************************************/
+
+static int compareIntKeys(const void *a, const void *b, void *arg)
+{
+    int keyOffset = *(int*) arg;
+    int32_t x, y;
+    memcpy(&x, (const char*) a + keyOffset, sizeof(x));
+    memcpy(&y, (const char*) b + keyOffset, sizeof(y));
+    return (x > y) - (x < y);
+}
+
+/* The loser tree keeps, in every inner node, the stream that lost the comparison there;
+ * tree[0] is the overall winner. Stream k stands for a key smaller than all others and is
+ * only used while the tree is built. Finished streams lose against everything, and equal
+ * records are taken from the earlier run first so the sort is stable. */
+typedef struct LoserTree {
+    int k;
+    int *tree;
+    const char **current;
+    SortLayout *layout;
+} LoserTree;
+
+static int beats(LoserTree *lt, int a, int b)
+{
+    if (a == lt->k || b == lt->k) {
+        return a == lt->k;
+    }
+    if (lt->current[a] == NULL || lt->current[b] == NULL) {
+        return lt->current[b] == NULL && (lt->current[a] != NULL || a < b);
+    }
+    int cmp = lt->layout->compare(lt->current[a], lt->current[b], lt->layout->arg);
+    return cmp < 0 || (cmp == 0 && a < b);
+}
+
+/**
+ * @brief Replays the games on the path from stream s to the root after its record changed.
+ */
+static void replay(LoserTree *lt, int s)
+{
+    for (int t = (s + lt->k) / 2; t > 0; t /= 2) {
+        if (beats(lt, lt->tree[t], s)) {
+            int winner = lt->tree[t];
+            lt->tree[t] = s;
+            s = winner;
+        }
+    }
+    lt->tree[0] = s;
+}
+
+/**
+ * @brief Merges runs into one run written by writer; the runs are read from fHandle.
+ */
+static RC mergeRuns(SortIO *io, SortLayout *layout, SM_FileHandle *fHandle, SortRun *runs, int numRuns,
+                    int ioPages, SortWriter *writer, long *numRecords)
+{
+    SortReader *readers = (SortReader*) calloc((size_t) numRuns, sizeof(SortReader));
+    LoserTree lt;
+    lt.k = numRuns;
+    lt.layout = layout;
+    lt.tree = (int*) malloc(sizeof(int) * (size_t) numRuns);
+    lt.current = (const char**) calloc((size_t) numRuns, sizeof(char*));
+    RC rc = readers == NULL || lt.tree == NULL || lt.current == NULL ? RC_WRITE_FAILED : RC_OK;
+    int opened = 0;
+    for (; rc == RC_OK && opened < numRuns; opened++) {
+        rc = openReader(&readers[opened], io, layout, fHandle, runs[opened].firstPage, runs[opened].numRecords, ioPages);
+    }
+    if (rc == RC_OK) {
+        for (int i = 0; i < numRuns; i++) {
+            lt.current[i] = nextRecord(&readers[i]);
+            lt.tree[i] = numRuns;
+        }
+        for (int i = numRuns - 1; i >= 0; i--) {
+            replay(&lt, i);
+        }
+        *numRecords = 0;
+        for (;;) {
+            int winner = lt.tree[0];
+            if (lt.current[winner] == NULL) {
+                break;
+            }
+            if ((rc = putRecord(writer, lt.current[winner])) != RC_OK) {
+                break;
+            }
+            (*numRecords)++;
+            lt.current[winner] = nextRecord(&readers[winner]);
+            replay(&lt, winner);
+        }
+        for (int i = 0; i < numRuns && rc == RC_OK; i++) {
+            rc = readers[i].rc;
+        }
+    }
+    for (int i = 0; i < opened; i++) {
+        closeReader(&readers[i]);
+    }
+    free(readers);
+    free(lt.tree);
+    free(lt.current);
+    return rc;
+}
+
+
+/************************************************************
+ *                    sorting                               *
+ ************************************************************/
+
+/**
+ * @brief Creates an empty page file, replacing an existing one, and opens it.
+ */
+static RC createEmptyFile(char *fileName, int pageSize, SM_FileHandle *fHandle)
+{
+    destroyPageFile(fileName);
+    RC rc = createPageFileWithPageSize(fileName, pageSize);
+    if (rc == RC_OK) {
+        rc = openPageFile(fileName, fHandle);
+    }
+    return rc;
+}
+
+static char *scratchName(char *outputFile, int num)
+{
+    char *name = (char*) malloc(strlen(outputFile) + 16);
+    if (name != NULL) {
+        sprintf(name, "%s.runs%d", outputFile, num);
+    }
+    return name;
+}
+
+static int clampIoPages(int pages)
+{
+    return pages < 1 ? 1 : pages > SORT_MAX_IO_PAGES ? SORT_MAX_IO_PAGES : pages;
+}
+
+/**
+ * @brief Sorts the fixed size records of a page file into another page file, using no more
+ *        memory than the spec allows and the memory budget grants. The output has the page
+ *        size of the input and the same record layout; an existing output file is replaced. Scratch files named after the
+ *        output with the suffixes ".runs0" and ".runs1" are removed when the sort ends.
+ *
+ * @param inputFile The page file holding the records.
+ * @param outputFile The page file receiving the sorted records; must differ from the input.
+ * @param spec Record size, number of records, order and memory budget.
+ * @param stats Optional; receives the number of runs, passes and pages moved.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the input does not exist.
+ *         RC_READ_NON_EXISTING_PAGE if the input holds fewer records than the spec says.
+ *         RC_WRITE_FAILED if the spec is invalid or a file could not be written.
+ *         RC_MEMORY_BUDGET_EXCEEDED if the memory budget has no room for the smallest sort.
+ */
+RC externalSort(char *inputFile, char *outputFile, SM_SortSpec *spec, SM_SortStats *stats)
+{
+    if (inputFile == NULL || outputFile == NULL || spec == NULL || strcmp(inputFile, outputFile) == 0) {
+        printMessage("The sort needs an input and a different output file.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    int memoryPages = spec->memoryPages > 0 ? spec->memoryPages : SORT_DEFAULT_MEMORY_PAGES;
+    if (memoryPages < SORT_MIN_MEMORY_PAGES) {
+        printMessage("The sort needs at least %d pages of memory.\n", SORT_MIN_MEMORY_PAGES);
+        return RC_WRITE_FAILED;
+    }
+    SM_FileHandle input, scratch[2], output;
+    RC rc = openPageFile(inputFile, &input);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    SortLayout layout;
+    layout.pageSize = input.pageSize;
+    layout.recordSize = spec->recordSize;
+    layout.recordsPerPage = spec->recordSize > 0 ? input.pageSize / spec->recordSize : 0;
+    layout.compare = spec->compare != NULL ? spec->compare : compareIntKeys;
+    layout.arg = spec->compare != NULL ? spec->arg : (void*) &spec->keyOffset;
+    long numRecords = spec->numRecords >= 0 ? spec->numRecords : (long) input.totalNumPages * layout.recordsPerPage;
+    if (layout.recordsPerPage == 0 || (spec->compare == NULL
+        && (spec->keyOffset < 0 || spec->keyOffset + (int) sizeof(int32_t) > spec->recordSize))) {
+        printMessage("Records of %d bytes can't be sorted in pages of %d bytes.\n", spec->recordSize, input.pageSize);
+        closePageFile(&input);
+        return RC_WRITE_FAILED;
+    }
+    if (numRecords > (long) input.totalNumPages * layout.recordsPerPage) {
+        printMessage("The file %s holds fewer than %ld records.\n", inputFile, numRecords);
+        closePageFile(&input);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    // A short memory budget grants fewer pages; the sort then writes more and shorter runs.
+    SM_MemConsumer *memory = NULL;
+    registerMemConsumer(outputFile, MEMGOV_DEFAULT_WEIGHT, NULL, NULL, &memory);
+    while (memReserve(memory, (long long) memoryPages * layout.pageSize) != RC_OK) {
+        if (memoryPages == SORT_MIN_MEMORY_PAGES) {
+            unregisterMemConsumer(memory);
+            closePageFile(&input);
+            return RC_MEMORY_BUDGET_EXCEEDED;
+        }
+        memoryPages = memoryPages / 2 > SORT_MIN_MEMORY_PAGES ? memoryPages / 2 : SORT_MIN_MEMORY_PAGES;
+    }
+
+    // Run generation: two buffers for reading, two for writing, the rest holds the run.
+    int ioPages = clampIoPages(memoryPages / 8);
+    long capacity = (long) (memoryPages - 4 * ioPages) * layout.recordsPerPage;
+    char *runArea = (char*) malloc((size_t) capacity * (size_t) layout.recordSize);
+    char *names[2] = { scratchName(outputFile, 0), scratchName(outputFile, 1) };
+    int scratchOpen[2] = { 0, 0 };
+    int outputOpen = 0;
+    SortRun *runs = NULL;
+    int numRuns = 0, runCapacity = 0, sortedRuns = 0, passes = 0;
+    SortIO io;
+    if (runArea == NULL || names[0] == NULL || names[1] == NULL) {
+        free(runArea);
+        free(names[0]);
+        free(names[1]);
+        unregisterMemConsumer(memory);
+        closePageFile(&input);
+        return RC_WRITE_FAILED;
+    }
+    if ((rc = startSortIO(&io)) != RC_OK) {
+        free(runArea);
+        free(names[0]);
+        free(names[1]);
+        unregisterMemConsumer(memory);
+        closePageFile(&input);
+        return rc;
+    }
+    SortReader reader;
+    SortWriter writer;
+    int readerOpen = 0, writerOpen = 0;
+    if ((rc = openReader(&reader, &io, &layout, &input, 0, numRecords, ioPages)) == RC_OK) {
+        readerOpen = 1;
+    }
+    while (rc == RC_OK) {
+        long n = 0;
+        const char *record;
+        while (n < capacity && (record = nextRecord(&reader)) != NULL) {
+            memcpy(runArea + (size_t) n * layout.recordSize, record, (size_t) layout.recordSize);
+            n++;
+        }
+        if ((rc = reader.rc) != RC_OK) {
+            break;
+        }
+        qsort_r(runArea, (size_t) n, (size_t) layout.recordSize, layout.compare, layout.arg);
+        // A single run is the sorted output; otherwise runs go to the first scratch file.
+        if (!writerOpen) {
+            SM_FileHandle *target = reader.remaining == 0 ? &output : &scratch[0];
+            rc = createEmptyFile(reader.remaining == 0 ? outputFile : names[0], layout.pageSize, target);
+            if (rc != RC_OK) {
+                break;
+            }
+            outputOpen = target == &output;
+            scratchOpen[0] = target == &scratch[0];
+            if ((rc = openWriter(&writer, &io, &layout, target, ioPages)) != RC_OK) {
+                break;
+            }
+            writerOpen = 1;
+        }
+        // An empty input still gets its output file, holding one empty page.
+        if (n == 0) {
+            break;
+        }
+        if (numRuns == runCapacity) {
+            runCapacity = runCapacity > 0 ? 2 * runCapacity : 16;
+            SortRun *grown = (SortRun*) realloc(runs, sizeof(SortRun) * (size_t) runCapacity);
+            if (grown == NULL) {
+                rc = RC_WRITE_FAILED;
+                break;
+            }
+            runs = grown;
+        }
+        runs[numRuns].firstPage = writer.nextPage;
+        runs[numRuns].numRecords = n;
+        numRuns++;
+        for (long i = 0; i < n && rc == RC_OK; i++) {
+            rc = putRecord(&writer, runArea + (size_t) i * layout.recordSize);
+        }
+        if (rc == RC_OK) {
+            rc = flushWriter(&writer);
+        }
+        if (reader.remaining == 0) {
+            break;
+        }
+    }
+    if (readerOpen) {
+        closeReader(&reader);
+    }
+    if (writerOpen) {
+        RC closeRc = closeWriter(&writer);
+        if (rc == RC_OK) {
+            rc = closeRc;
+        }
+    }
+    free(runArea);
+    closePageFile(&input);
+    sortedRuns = numRuns;
+
+    // Merge passes: fanIn runs at a time, each with two buffers, plus two for the writer.
+    int source = 0;
+    while (rc == RC_OK && !outputOpen && numRuns > 0) {
+        int maxFanIn = memoryPages / 2 - 1;
+        int fanIn = numRuns < maxFanIn ? numRuns : maxFanIn;
+        int mergeIoPages = clampIoPages(memoryPages / (2 * (fanIn + 1)));
+        int last = numRuns <= maxFanIn;
+        int dest = 1 - source;
+        SM_FileHandle *target = last ? &output : &scratch[dest];
+        if ((rc = createEmptyFile(last ? outputFile : names[dest], layout.pageSize, target)) != RC_OK) {
+            break;
+        }
+        outputOpen = last;
+        scratchOpen[dest] = !last;
+        if ((rc = openWriter(&writer, &io, &layout, target, mergeIoPages)) != RC_OK) {
+            closeWriter(&writer);
+            break;
+        }
+        int numMerged = 0;
+        for (int first = 0; first < numRuns && rc == RC_OK; first += fanIn) {
+            int count = numRuns - first < fanIn ? numRuns - first : fanIn;
+            SortRun merged;
+            merged.firstPage = writer.nextPage;
+            rc = mergeRuns(&io, &layout, &scratch[source], runs + first, count, mergeIoPages, &writer, &merged.numRecords);
+            if (rc == RC_OK) {
+                rc = flushWriter(&writer);
+            }
+            runs[numMerged++] = merged;
+        }
+        RC closeRc = closeWriter(&writer);
+        if (rc == RC_OK) {
+            rc = closeRc;
+        }
+        closePageFile(&scratch[source]);
+        destroyPageFile(names[source]);
+        scratchOpen[source] = 0;
+        numRuns = numMerged;
+        source = dest;
+        passes++;
+    }
+    stopSortIO(&io);
+    for (int i = 0; i < 2; i++) {
+        if (scratchOpen[i]) {
+            closePageFile(&scratch[i]);
+            destroyPageFile(names[i]);
+        }
+        free(names[i]);
+    }
+    if (outputOpen) {
+        RC closeRc = closePageFile(&output);
+        if (rc == RC_OK) {
+            rc = closeRc;
+        }
+    }
+    if (stats != NULL) {
+        stats->numRecords = numRecords;
+        stats->numRuns = sortedRuns;
+        stats->mergePasses = passes;
+        stats->pagesRead = io.pagesRead;
+        stats->pagesWritten = io.pagesWritten;
+        stats->memoryPages = memoryPages;
+    }
+    unregisterMemConsumer(memory);
+    free(runs);
+    return rc;
+}
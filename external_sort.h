@@ -0,0 +1,53 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    external sort constants               *
+ ************************************************************/
+/* memory budget in pages when the spec does not give one */
+#define SORT_DEFAULT_MEMORY_PAGES 256
+/* smallest budget: two double buffered streams and room for a run */
+#define SORT_MIN_MEMORY_PAGES 8
+/* most pages one read or write of a stream moves */
+#define SORT_MAX_IO_PAGES 32
+
+/* orders two records like qsort comparators; arg is the spec's arg */
+typedef int (*SM_SortCompareFn) (const void *a, const void *b, void *arg);
+
+/* Records have a fixed size and are packed into pages from the start; the bytes at the end
+ * of a page that can't hold a whole record are unused. The output has the same layout. */
+typedef struct SM_SortSpec {
+	int recordSize;
+	int numRecords;           /* records in the input, -1 for every record of every page */
+	SM_SortCompareFn compare; /* NULL sorts by the int at keyOffset, ascending */
+	int keyOffset;
+	void *arg;                /* passed to compare */
+	int memoryPages;          /* pages of memory the sort may use, 0 for the default */
+} SM_SortSpec;
+
+typedef struct SM_SortStats {
+	long numRecords;
+	int numRuns;              /* sorted runs written before merging */
+	int mergePasses;          /* passes over the data after the runs were written */
+	long pagesRead;
+	long pagesWritten;
+	int memoryPages;          /* pages of memory the sort used; fewer than asked if the budget was short */
+} SM_SortStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC externalSort (char *inputFile, char *outputFile, SM_SortSpec *spec, SM_SortStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
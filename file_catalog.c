@@ -0,0 +1,728 @@
+#define _GNU_SOURCE
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "file_catalog.h"
+#include "sm_backend.h"
+
+/*
+ * The catalog keeps one open file per path: every handle it opens for a path shares the
+ * file's descriptor, page count and attachments through sharePageFile, and the catalog keeps
+ * its own handle so the file stays open until the catalog is closed. Paths are resolved with
+ * realpath, so different names of one file find the same entry. Open catalogs are kept in a
+ * process-wide list, and openPageFile of a file one of them holds open shares that file too.
+ * Destroying a page file closes the catalogs' handles on it, so a file created later under
+ * the same path is opened afresh.
+ *
+ * The manifest caches the page size and page count of every file the catalog has seen,
+ * together with the file's size and modification time. A lookup whose file still has that
+ * size and time is answered with one stat instead of opening the file. The manifest is
+ * written through a temporary file and a rename:
+ *
+ *   ManifestHeader, then per file: ManifestEntry + keyLength bytes of key
+ */
+
+typedef struct ManifestHeader {
+    char magic[8];
+    int32_t numEntries;
+    int32_t reserved;
+} ManifestHeader;
+
+typedef struct ManifestEntry {
+    int32_t pageSize;
+    int32_t totalNumPages;
+    int64_t fileSize;
+    int64_t mtimeNs;
+    int32_t keyLength;
+    int32_t reserved;
+} ManifestEntry;
+
+typedef struct CatalogEntry {
+    /* the backend prefix and the resolved path */
+    char *key;
+    /* the catalog's own handle while the file is open; mgmtInfo is NULL otherwise */
+    SM_FileHandle handle;
+    char *fileName;
+    /* the metadata below is valid; it is saved in the manifest */
+    int known;
+    int pageSize;
+    int totalNumPages;
+    long long fileSize;
+    long long mtimeNs;
+    struct CatalogEntry *next;
+} CatalogEntry;
+
+struct SM_Catalog {
+    /* NULL if the catalog keeps no manifest */
+    char *manifestPath;
+    CatalogEntry **buckets;
+    int numBuckets;
+    int numEntries;
+    /* guards the entries and stats; files are opened outside of it */
+    pthread_mutex_t lock;
+    SM_CatalogStats stats;
+    struct SM_Catalog *nextOpen;
+};
+
+/* the work of the threads of one catalogOpenAll call */
+typedef struct OpenAllWork {
+    SM_Catalog *catalog;
+    char **fileNames;
+    SM_FileHandle *handles;
+    RC *results;
+    int numFiles;
+    int next;
+} OpenAllWork;
+
+#define CATALOG_FIRST_BUCKETS 64
+
+/* the open catalogs of the process; openPageFile only looks at them when there are any */
+static SM_Catalog *openCatalogs = NULL;
+static int numOpenCatalogs = 0;
+static pthread_mutex_t openCatalogsLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static uint32_t hashKey(const char *key)
+{
+    uint32_t hash = 2166136261u;
+    for (; *key != '\0'; key++) {
+        hash = (hash ^ (uint8_t) *key) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Builds the key of a page file: its backend prefix and its resolved path.
+ */
+static char *catalogKey(char *fileName)
+{
+    const char *prefix = findStorageBackend(fileName)->prefix;
+    char *rest = fileName + strlen(prefix);
+    char path[PATH_MAX];
+    const char *resolved = realpath(rest, path) != NULL ? path : rest;
+    char *key = (char*) malloc(strlen(prefix) + strlen(resolved) + 1);
+    if (key != NULL) {
+        sprintf(key, "%s%s", prefix, resolved);
+    }
+    return key;
+}
+
+/**
+ * @brief Reads the size and modification time of the file on disk behind a key.
+ * @return 1 if the file exists on disk.
+ */
+static int statKey(char *key, long long *fileSize, long long *mtimeNs)
+{
+    struct stat st;
+    if (stat(key + strlen(findStorageBackend(key)->prefix), &st) != 0) {
+        return 0;
+    }
+    *fileSize = (long long) st.st_size;
+    *mtimeNs = (long long) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return 1;
+}
+
+static CatalogEntry *findEntry(SM_Catalog *catalog, const char *key)
+{
+    CatalogEntry *entry = catalog->buckets[hashKey(key) & (uint32_t) (catalog->numBuckets - 1)];
+    while (entry != NULL && strcmp(entry->key, key) != 0) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+/**
+ * @brief Adds an entry that takes over the key; doubles the buckets when they get crowded.
+ */
+static CatalogEntry *addEntry(SM_Catalog *catalog, char *key)
+{
+    if (catalog->numEntries >= 2 * catalog->numBuckets) {
+        int numBuckets = 2 * catalog->numBuckets;
+        CatalogEntry **buckets = (CatalogEntry**) calloc((size_t) numBuckets, sizeof(CatalogEntry*));
+        if (buckets != NULL) {
+            for (int i = 0; i < catalog->numBuckets; i++) {
+                while (catalog->buckets[i] != NULL) {
+                    CatalogEntry *moved = catalog->buckets[i];
+                    catalog->buckets[i] = moved->next;
+                    uint32_t bucket = hashKey(moved->key) & (uint32_t) (numBuckets - 1);
+                    moved->next = buckets[bucket];
+                    buckets[bucket] = moved;
+                }
+            }
+            free(catalog->buckets);
+            catalog->buckets = buckets;
+            catalog->numBuckets = numBuckets;
+        }
+    }
+    CatalogEntry *entry = (CatalogEntry*) calloc(1, sizeof(CatalogEntry));
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->key = key;
+    uint32_t bucket = hashKey(key) & (uint32_t) (catalog->numBuckets - 1);
+    entry->next = catalog->buckets[bucket];
+    catalog->buckets[bucket] = entry;
+    catalog->numEntries++;
+    return entry;
+}
+
+/**
+ * @brief Records the metadata of an entry for the manifest.
+ */
+static void rememberFile(CatalogEntry *entry, int pageSize, int totalNumPages)
+{
+    entry->known = statKey(entry->key, &entry->fileSize, &entry->mtimeNs);
+    entry->pageSize = pageSize;
+    entry->totalNumPages = totalNumPages;
+}
+
+/**
+ * @brief Loads the entries of a manifest; a missing or damaged manifest leaves the catalog empty.
+ */
+static void loadManifest(SM_Catalog *catalog)
+{
+    FILE *file = fopen(catalog->manifestPath, "rb");
+    if (file == NULL) {
+        return;
+    }
+    ManifestHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, CATALOG_MANIFEST_MAGIC, sizeof(header.magic)) != 0) {
+        printMessage("The catalog manifest %s is damaged and is ignored.\n", catalog->manifestPath);
+        fclose(file);
+        return;
+    }
+    for (int i = 0; i < header.numEntries; i++) {
+        ManifestEntry record;
+        if (fread(&record, sizeof(record), 1, file) != 1 || record.keyLength <= 0 || record.keyLength > PATH_MAX) {
+            break;
+        }
+        char *key = (char*) malloc((size_t) record.keyLength + 1);
+        if (key == NULL || fread(key, (size_t) record.keyLength, 1, file) != 1) {
+            free(key);
+            break;
+        }
+        key[record.keyLength] = '\0';
+        CatalogEntry *entry = findEntry(catalog, key) == NULL ? addEntry(catalog, key) : NULL;
+        if (entry == NULL) {
+            free(key);
+            continue;
+        }
+        entry->known = 1;
+        entry->pageSize = record.pageSize;
+        entry->totalNumPages = record.totalNumPages;
+        entry->fileSize = record.fileSize;
+        entry->mtimeNs = record.mtimeNs;
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Writes the manifest through a temporary file and a rename. Called with the lock held.
+ */
+static RC storeManifest(SM_Catalog *catalog)
+{
+    char *tmpPath = (char*) malloc(strlen(catalog->manifestPath) + 5);
+    if (tmpPath == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    sprintf(tmpPath, "%s.tmp", catalog->manifestPath);
+    FILE *file = fopen(tmpPath, "wb");
+    if (file == NULL) {
+        free(tmpPath);
+        return RC_WRITE_FAILED;
+    }
+    ManifestHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_MANIFEST_MAGIC, sizeof(header.magic));
+    for (int i = 0; i < catalog->numBuckets; i++) {
+        for (CatalogEntry *entry = catalog->buckets[i]; entry != NULL; entry = entry->next) {
+            if (entry->handle.mgmtInfo != NULL) {
+                SM_OpenFile *openFile = (SM_OpenFile*) entry->handle.mgmtInfo;
+                rememberFile(entry, entry->handle.pageSize, __atomic_load_n(&openFile->numPages, __ATOMIC_RELAXED));
+            }
+            header.numEntries += entry->known;
+        }
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < catalog->numBuckets; i++) {
+        for (CatalogEntry *entry = catalog->buckets[i]; ok && entry != NULL; entry = entry->next) {
+            if (!entry->known) {
+                continue;
+            }
+            ManifestEntry record;
+            memset(&record, 0, sizeof(record));
+            record.pageSize = entry->pageSize;
+            record.totalNumPages = entry->totalNumPages;
+            record.fileSize = entry->fileSize;
+            record.mtimeNs = entry->mtimeNs;
+            record.keyLength = (int32_t) strlen(entry->key);
+            ok = fwrite(&record, sizeof(record), 1, file) == 1
+                && fwrite(entry->key, (size_t) record.keyLength, 1, file) == 1;
+        }
+    }
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok && rename(tmpPath, catalog->manifestPath) == 0;
+    if (!ok) {
+        unlink(tmpPath);
+        printMessage("The catalog manifest %s could not be written!\n", catalog->manifestPath);
+    }
+    free(tmpPath);
+    return ok ? RC_OK : RC_WRITE_FAILED;
+}
+
+static void *openAllMain(void *arg)
+{
+    OpenAllWork *work = (OpenAllWork*) arg;
+    int i;
+    while ((i = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED)) < work->numFiles) {
+        work->results[i] = catalogOpenFile(work->catalog, work->fileNames[i], &work->handles[i]);
+    }
+    return NULL;
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Creates a catalog of page files, loading the manifest if one was saved before.
+ *
+ * @param manifestPath File the metadata of the catalog's files is kept in, or NULL for none.
+ * @param catalog Receives the catalog.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if catalog is NULL.
+ *         RC_WRITE_FAILED if memory ran out.
+ */
+RC openCatalog(char *manifestPath, SM_Catalog **catalog)
+{
+    if (catalog == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_Catalog *c = (SM_Catalog*) calloc(1, sizeof(SM_Catalog));
+    if (c == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    c->numBuckets = CATALOG_FIRST_BUCKETS;
+    c->buckets = (CatalogEntry**) calloc((size_t) c->numBuckets, sizeof(CatalogEntry*));
+    c->manifestPath = manifestPath != NULL ? strdup(manifestPath) : NULL;
+    if (c->buckets == NULL || (manifestPath != NULL && c->manifestPath == NULL)) {
+        free(c->buckets);
+        free(c->manifestPath);
+        free(c);
+        return RC_WRITE_FAILED;
+    }
+    pthread_mutex_init(&c->lock, NULL);
+    if (c->manifestPath != NULL) {
+        loadManifest(c);
+    }
+    pthread_mutex_lock(&openCatalogsLock);
+    c->nextOpen = openCatalogs;
+    openCatalogs = c;
+    __atomic_add_fetch(&numOpenCatalogs, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&openCatalogsLock);
+    *catalog = c;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Saves the manifest and closes the catalog's handles. Files that handles from the
+ *        catalog still use stay open until those handles are closed.
+ *
+ * @param catalog The catalog.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if catalog is NULL.
+ *         RC_WRITE_FAILED if the manifest or a file could not be written.
+ */
+RC closeCatalog(SM_Catalog *catalog)
+{
+    if (catalog == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    // Once the catalog is off the list, openPageFile no longer shares its files.
+    pthread_mutex_lock(&openCatalogsLock);
+    SM_Catalog **link = &openCatalogs;
+    while (*link != NULL && *link != catalog) {
+        link = &(*link)->nextOpen;
+    }
+    if (*link != NULL) {
+        *link = catalog->nextOpen;
+        __atomic_sub_fetch(&numOpenCatalogs, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&openCatalogsLock);
+    RC rc = catalog->manifestPath != NULL ? storeManifest(catalog) : RC_OK;
+    for (int i = 0; i < catalog->numBuckets; i++) {
+        while (catalog->buckets[i] != NULL) {
+            CatalogEntry *entry = catalog->buckets[i];
+            catalog->buckets[i] = entry->next;
+            if (entry->handle.mgmtInfo != NULL && closePageFile(&entry->handle) != RC_OK) {
+                rc = RC_WRITE_FAILED;
+            }
+            free(entry->fileName);
+            free(entry->key);
+            free(entry);
+        }
+    }
+    pthread_mutex_destroy(&catalog->lock);
+    free(catalog->buckets);
+    free(catalog->manifestPath);
+    free(catalog);
+    return rc;
+}
+
+
+/**
+ * @brief Writes the page size, page count, size and modification time of every file the
+ *        catalog knows to its manifest.
+ *
+ * @param catalog The catalog.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if catalog is NULL or keeps no manifest.
+ *         RC_WRITE_FAILED if the manifest could not be written.
+ */
+RC saveCatalogManifest(SM_Catalog *catalog)
+{
+    if (catalog == NULL || catalog->manifestPath == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&catalog->lock);
+    RC rc = storeManifest(catalog);
+    pthread_mutex_unlock(&catalog->lock);
+    return rc;
+}
+
+
+/**
+ * @brief Opens a page file through the catalog. The first open of a path opens the file;
+ *        later opens of the same path, under any name, share it (see sharePageFile).
+ *        The handle is closed with closePageFile.
+ *
+ * @param catalog The catalog.
+ * @param fileName The page file; it must stay valid while the handle is open.
+ * @param fHandle The handle that is opened.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if an argument is NULL.
+ *         RC_FILE_NOT_FOUND if the file could not be opened.
+ */
+RC catalogOpenFile(SM_Catalog *catalog, char *fileName, SM_FileHandle *fHandle)
+{
+    if (catalog == NULL || fileName == NULL || fHandle == NULL) {
+        printMessage("File can't be opened because the file name or file handle is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    char *key = catalogKey(fileName);
+    if (key == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    pthread_mutex_lock(&catalog->lock);
+    CatalogEntry *entry = findEntry(catalog, key);
+    if (entry != NULL && entry->handle.mgmtInfo != NULL) {
+        sharePageFile(&entry->handle, fHandle);
+        fHandle->fileName = fileName;
+        catalog->stats.sharedOpens++;
+        pthread_mutex_unlock(&catalog->lock);
+        free(key);
+        return RC_OK;
+    }
+    pthread_mutex_unlock(&catalog->lock);
+
+    // Files are opened outside the lock, so several threads open different files at once.
+    SM_FileHandle opened;
+    char *name = strdup(fileName);
+    RC rc = name != NULL ? openPageFile(name, &opened) : RC_FILE_NOT_FOUND;
+    if (rc != RC_OK) {
+        free(name);
+        free(key);
+        return rc;
+    }
+    pthread_mutex_lock(&catalog->lock);
+    entry = findEntry(catalog, key);
+    int raced = entry != NULL && entry->handle.mgmtInfo != NULL;
+    if (!raced && entry == NULL && (entry = addEntry(catalog, key)) != NULL) {
+        key = NULL;
+    }
+    if (entry == NULL) {
+        pthread_mutex_unlock(&catalog->lock);
+        closePageFile(&opened);
+        free(name);
+        free(key);
+        return RC_FILE_NOT_FOUND;
+    }
+    if (!raced) {
+        entry->handle = opened;
+        entry->fileName = name;
+        rememberFile(entry, opened.pageSize, opened.totalNumPages);
+        catalog->stats.fileOpens++;
+    }
+    else {
+        catalog->stats.sharedOpens++;
+    }
+    sharePageFile(&entry->handle, fHandle);
+    fHandle->fileName = fileName;
+    pthread_mutex_unlock(&catalog->lock);
+    if (raced) {
+        // Another thread opened the file first; its open file is shared instead.
+        closePageFile(&opened);
+        free(name);
+    }
+    free(key);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Opens a handle on a file that one of the open catalogs holds open, sharing it like
+ *        catalogOpenFile does. Costs nothing while no catalog is open.
+ *
+ * @param fileName The page file.
+ * @param fHandle The handle that is opened if the file is shared.
+ * @return 1 if the handle shares a file held by a catalog, 0 if the file has to be opened.
+ */
+int catalogShareFile(char *fileName, SM_FileHandle *fHandle)
+{
+    if (__atomic_load_n(&numOpenCatalogs, __ATOMIC_ACQUIRE) == 0) {
+        return 0;
+    }
+    char *key = catalogKey(fileName);
+    if (key == NULL) {
+        return 0;
+    }
+    int shared = 0;
+    pthread_mutex_lock(&openCatalogsLock);
+    for (SM_Catalog *catalog = openCatalogs; catalog != NULL && !shared; catalog = catalog->nextOpen) {
+        pthread_mutex_lock(&catalog->lock);
+        CatalogEntry *entry = findEntry(catalog, key);
+        if (entry != NULL && entry->handle.mgmtInfo != NULL) {
+            sharePageFile(&entry->handle, fHandle);
+            fHandle->fileName = fileName;
+            catalog->stats.sharedOpens++;
+            shared = 1;
+        }
+        pthread_mutex_unlock(&catalog->lock);
+    }
+    pthread_mutex_unlock(&openCatalogsLock);
+    free(key);
+    return shared;
+}
+
+
+/**
+ * @brief Closes the open catalogs' handles on a page file that is being destroyed and forgets
+ *        its cached metadata. Handles opened from a catalog keep the destroyed file until they
+ *        are closed. Must be called before the file is removed, so its path still resolves.
+ *
+ * @param fileName The page file.
+ */
+void catalogForgetFile(char *fileName)
+{
+    if (__atomic_load_n(&numOpenCatalogs, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
+    char *key = catalogKey(fileName);
+    if (key == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&openCatalogsLock);
+    // A catalog has at most one entry for a key; the handles are closed outside the locks.
+    SM_FileHandle *handles = (SM_FileHandle*) malloc(sizeof(SM_FileHandle) * (size_t) numOpenCatalogs);
+    char **names = (char**) malloc(sizeof(char*) * (size_t) numOpenCatalogs);
+    int count = 0;
+    for (SM_Catalog *catalog = openCatalogs; catalog != NULL && handles != NULL && names != NULL; catalog = catalog->nextOpen) {
+        pthread_mutex_lock(&catalog->lock);
+        CatalogEntry *entry = findEntry(catalog, key);
+        if (entry != NULL) {
+            if (entry->handle.mgmtInfo != NULL) {
+                handles[count] = entry->handle;
+                names[count] = entry->fileName;
+                count++;
+                entry->handle.mgmtInfo = NULL;
+                entry->fileName = NULL;
+            }
+            entry->known = 0;
+        }
+        pthread_mutex_unlock(&catalog->lock);
+    }
+    pthread_mutex_unlock(&openCatalogsLock);
+    for (int i = 0; i < count; i++) {
+        closePageFile(&handles[i]);
+        free(names[i]);
+    }
+    free(handles);
+    free(names);
+    free(key);
+}
+
+
+/**
+ * @brief Opens many page files through the catalog on several threads, for example all
+ *        tables of a database at startup. If any file can't be opened, the others are
+ *        closed again.
+ *
+ * @param catalog The catalog.
+ * @param fileNames The page files; they must stay valid while the handles are open.
+ * @param numFiles The number of files.
+ * @param numThreads Threads opening files, or 0 for CATALOG_DEFAULT_OPEN_THREADS.
+ * @param handles Array of numFiles handles that are opened.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if an argument is NULL.
+ *         The error of the first file that could not be opened otherwise.
+ */
+RC catalogOpenAll(SM_Catalog *catalog, char **fileNames, int numFiles, int numThreads, SM_FileHandle *handles)
+{
+    if (catalog == NULL || fileNames == NULL || handles == NULL || numFiles < 0) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    OpenAllWork work;
+    work.catalog = catalog;
+    work.fileNames = fileNames;
+    work.handles = handles;
+    work.numFiles = numFiles;
+    work.next = 0;
+    work.results = (RC*) malloc(sizeof(RC) * (size_t) (numFiles > 0 ? numFiles : 1));
+    if (numThreads <= 0) {
+        numThreads = CATALOG_DEFAULT_OPEN_THREADS;
+    }
+    if (numThreads > numFiles) {
+        numThreads = numFiles > 0 ? numFiles : 1;
+    }
+    pthread_t *threads = (pthread_t*) malloc(sizeof(pthread_t) * (size_t) numThreads);
+    if (work.results == NULL || threads == NULL) {
+        free(work.results);
+        free(threads);
+        return RC_WRITE_FAILED;
+    }
+    // The calling thread opens files too; started threads only add to it.
+    int started = 0;
+    while (started < numThreads - 1 && pthread_create(&threads[started], NULL, openAllMain, &work) == 0) {
+        started++;
+    }
+    openAllMain(&work);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    RC rc = RC_OK;
+    for (int i = 0; i < numFiles && rc == RC_OK; i++) {
+        rc = work.results[i];
+    }
+    for (int i = 0; rc != RC_OK && i < numFiles; i++) {
+        if (work.results[i] == RC_OK) {
+            closePageFile(&handles[i]);
+        }
+    }
+    free(work.results);
+    free(threads);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_mutex_lock(&catalog->lock);
+    catalog->stats.lastOpenAllMs = (double) (end.tv_sec - begin.tv_sec) * 1000.0 + (double) (end.tv_nsec - begin.tv_nsec) / 1e6;
+    pthread_mutex_unlock(&catalog->lock);
+    return rc;
+}
+
+
+/**
+ * @brief Tells the page size and page count of a page file. Files the catalog holds open
+ *        and files whose size and modification time match the manifest are answered without
+ *        opening them; others are opened once and added to the manifest.
+ *
+ * @param catalog The catalog.
+ * @param fileName The page file.
+ * @param info Receives the page size and page count.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if an argument is NULL.
+ *         RC_FILE_NOT_FOUND if the file could not be opened.
+ */
+RC catalogLookup(SM_Catalog *catalog, char *fileName, SM_CatalogInfo *info)
+{
+    if (catalog == NULL || fileName == NULL || info == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    char *key = catalogKey(fileName);
+    if (key == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    long long fileSize = 0, mtimeNs = 0;
+    int onDisk = statKey(key, &fileSize, &mtimeNs);
+    pthread_mutex_lock(&catalog->lock);
+    CatalogEntry *entry = findEntry(catalog, key);
+    if (entry != NULL && entry->handle.mgmtInfo != NULL) {
+        info->pageSize = entry->handle.pageSize;
+        info->totalNumPages = __atomic_load_n(&((SM_OpenFile*) entry->handle.mgmtInfo)->numPages, __ATOMIC_RELAXED);
+        info->open = 1;
+        catalog->stats.manifestHits++;
+        pthread_mutex_unlock(&catalog->lock);
+        free(key);
+        return RC_OK;
+    }
+    if (entry != NULL && entry->known && onDisk && entry->fileSize == fileSize && entry->mtimeNs == mtimeNs) {
+        info->pageSize = entry->pageSize;
+        info->totalNumPages = entry->totalNumPages;
+        info->open = 0;
+        catalog->stats.manifestHits++;
+        pthread_mutex_unlock(&catalog->lock);
+        free(key);
+        return RC_OK;
+    }
+    catalog->stats.manifestMisses++;
+    pthread_mutex_unlock(&catalog->lock);
+
+    SM_FileHandle fh;
+    RC rc = openPageFile(fileName, &fh);
+    if (rc != RC_OK) {
+        free(key);
+        return rc;
+    }
+    info->pageSize = fh.pageSize;
+    info->totalNumPages = fh.totalNumPages;
+    info->open = 0;
+    closePageFile(&fh);
+    pthread_mutex_lock(&catalog->lock);
+    entry = findEntry(catalog, key);
+    if (entry == NULL && (entry = addEntry(catalog, key)) != NULL) {
+        key = NULL;
+    }
+    if (entry != NULL && entry->handle.mgmtInfo == NULL) {
+        rememberFile(entry, info->pageSize, info->totalNumPages);
+    }
+    pthread_mutex_unlock(&catalog->lock);
+    free(key);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Reports the files the catalog holds open, the manifest entries and how opens and
+ *        lookups were served.
+ *
+ * @param catalog The catalog.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if an argument is NULL.
+ */
+RC getCatalogStats(SM_Catalog *catalog, SM_CatalogStats *stats)
+{
+    if (catalog == NULL || stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&catalog->lock);
+    *stats = catalog->stats;
+    stats->files = 0;
+    stats->manifestEntries = 0;
+    for (int i = 0; i < catalog->numBuckets; i++) {
+        for (CatalogEntry *entry = catalog->buckets[i]; entry != NULL; entry = entry->next) {
+            stats->files += entry->handle.mgmtInfo != NULL;
+            stats->manifestEntries += entry->known;
+        }
+    }
+    pthread_mutex_unlock(&catalog->lock);
+    return RC_OK;
+}
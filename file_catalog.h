@@ -0,0 +1,59 @@
+#ifndef FILE_CATALOG_H
+#define FILE_CATALOG_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    catalog constants                     *
+ ************************************************************/
+#define CATALOG_MANIFEST_MAGIC "SMCATLG1"
+/* threads catalogOpenAll uses when the caller does not say */
+#define CATALOG_DEFAULT_OPEN_THREADS 8
+
+/* the page files of a process, by path */
+typedef struct SM_Catalog SM_Catalog;
+
+/* what the manifest knows about a page file without opening it */
+typedef struct SM_CatalogInfo {
+	int pageSize;
+	int totalNumPages;
+	int open;                 /* the catalog holds the file open */
+} SM_CatalogInfo;
+
+typedef struct SM_CatalogStats {
+	int files;                /* files the catalog holds open */
+	int manifestEntries;
+	long fileOpens;           /* opens that opened the file */
+	long sharedOpens;         /* opens served by a file the catalog already held open */
+	long manifestHits;        /* lookups answered by the manifest */
+	long manifestMisses;      /* lookups that had to open the file */
+	double lastOpenAllMs;
+} SM_CatalogStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC openCatalog (char *manifestPath, SM_Catalog **catalog);
+extern RC closeCatalog (SM_Catalog *catalog);
+extern RC saveCatalogManifest (SM_Catalog *catalog);
+
+extern RC catalogOpenFile (SM_Catalog *catalog, char *fileName, SM_FileHandle *fHandle);
+extern RC catalogOpenAll (SM_Catalog *catalog, char **fileNames, int numFiles, int numThreads, SM_FileHandle *handles);
+extern RC catalogLookup (SM_Catalog *catalog, char *fileName, SM_CatalogInfo *info);
+extern RC getCatalogStats (SM_Catalog *catalog, SM_CatalogStats *stats);
+
+/* used by openPageFile, so files a catalog holds open are not opened a second time */
+extern int catalogShareFile (char *fileName, SM_FileHandle *fHandle);
+/* used by destroyPageFile, so a file created later under the same path is not shared */
+extern void catalogForgetFile (char *fileName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
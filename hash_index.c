@@ -0,0 +1,777 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash_index.h"
+#include "storage_mgr.h"
+
+/*
+ * An extendible hash index of integer keys kept in a page file. Page 0 holds the meta data
+ * and the directory: 2^globalDepth page numbers of buckets, indexed by the low bits of the
+ * hash of a key. A directory that does not fit in page 0 goes on in a chain of directory
+ * pages, each holding the number of the next. Every other page is a bucket whose keys share
+ * their lowest localDepth hash bits, so several directory entries may point to one bucket.
+ * The directory stays in memory while the index is open, so a lookup reads exactly one page.
+ *
+ * A full bucket is split on its next hash bit: only its own keys are redistributed, and the
+ * directory doubles, by copying itself, only when the bucket already used every bit of it.
+ * Buckets are not merged when keys are deleted.
+ */
+
+typedef struct HashMeta {
+    char magic[8];
+    int32_t keyType;
+    int32_t globalDepth;
+    int32_t numBuckets;
+    int32_t numEntries;
+    /* first directory page after page 0, 0 if the directory fits in page 0 */
+    int32_t directoryPage;
+} HashMeta;
+
+typedef struct HashBucketHeader {
+    int32_t localDepth;
+    int32_t numEntries;
+    int32_t reserved[2];
+} HashBucketHeader;
+
+typedef struct HashDirectoryHeader {
+    int32_t nextPage;
+    int32_t numEntries;
+} HashDirectoryHeader;
+
+typedef struct HashMgmt {
+    SM_FileHandle fHandle;
+    /* page 0: the meta data followed by the start of the directory */
+    char *metaPage;
+    int metaDirty;
+    /* the whole directory, 2^globalDepth entries */
+    int32_t *directory;
+    /* the chain of directory pages after page 0 and which of them must be written */
+    int *directoryPages;
+    char *directoryDirty;
+    int numDirectoryPages;
+    int capacity;
+    char *bucket;
+    char *sibling;
+} HashMgmt;
+
+/* one probe of a batched lookup, sorted by the bucket it reads */
+typedef struct HashProbe {
+    int32_t pageNum;
+    int32_t keyNum;
+} HashProbe;
+
+#define HASH_META(mgmt) ((HashMeta*) (mgmt)->metaPage)
+#define HASH_DIRECTORY(page) ((int32_t*) ((page) + HASH_DIRECTORY_OFFSET))
+#define DIRECTORY_HEADER(page) ((HashDirectoryHeader*) (page))
+#define DIRECTORY_ENTRIES(page) ((int32_t*) ((page) + HASH_DIRECTORY_PAGE_HEADER_SIZE))
+#define BUCKET_HEADER(page) ((HashBucketHeader*) (page))
+#define BUCKET_KEYS(page) ((int32_t*) ((page) + HASH_BUCKET_HEADER_SIZE))
+#define NOT_FOUND -1
+
+
+/************************************************************
+ *                    hashing and bucket layout             *
+ ************************************************************/
+
+/**
+ * @brief Mixes all bits of a key into the low bits the directory uses. This is the finalizer
+ *        of MurmurHash3: a few multiplies and shifts, and a bijection, so different keys never
+ *        share a hash and a bucket can always be split.
+ */
+static inline uint32_t hashKey(int32_t key)
+{
+    uint32_t h = (uint32_t) key;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static RID *bucketRids(HashMgmt *mgmt, char *page)
+{
+    return (RID*) (page + HASH_BUCKET_HEADER_SIZE + sizeof(int32_t) * (size_t) mgmt->capacity);
+}
+
+/**
+ * @brief Number of keys that fit in a bucket page.
+ */
+static int bucketCapacity(int pageSize)
+{
+    return (pageSize - HASH_BUCKET_HEADER_SIZE) / (int) (sizeof(int32_t) + sizeof(RID));
+}
+
+/**
+ * @brief Number of directory entries held by page 0.
+ */
+static int headEntries(int pageSize)
+{
+    return (pageSize - HASH_DIRECTORY_OFFSET) / (int) sizeof(int32_t);
+}
+
+/**
+ * @brief Number of directory entries held by every page of the directory chain.
+ */
+static int chainEntries(int pageSize)
+{
+    return (pageSize - HASH_DIRECTORY_PAGE_HEADER_SIZE) / (int) sizeof(int32_t);
+}
+
+/**
+ * @brief Number of chain pages a directory of the given number of entries needs.
+ */
+static int chainPagesFor(int pageSize, int numEntries)
+{
+    int head = headEntries(pageSize), per = chainEntries(pageSize);
+    return numEntries <= head ? 0 : (numEntries - head + per - 1) / per;
+}
+
+/**
+ * @brief Finds a key in a bucket with one pass over its keys that has no data dependent
+ *        branch, so the compiler can vectorize it.
+ * @return the position of the key, or NOT_FOUND.
+ */
+static inline int findInBucket(const int32_t *keys, int numKeys, int32_t key)
+{
+    int pos = NOT_FOUND;
+    for (int i = 0; i < numKeys; i++) {
+        pos = keys[i] == key ? i : pos;
+    }
+    return pos;
+}
+
+static int bucketOf(HashMgmt *mgmt, int32_t key)
+{
+    uint32_t mask = (1u << HASH_META(mgmt)->globalDepth) - 1;
+    return mgmt->directory[hashKey(key) & mask];
+}
+
+
+/************************************************************
+ *                    directory and splits                  *
+ ************************************************************/
+
+/**
+ * @brief Writes page 0 with the start of the directory.
+ */
+static RC writeMeta(HashMgmt *mgmt)
+{
+    int size = 1 << HASH_META(mgmt)->globalDepth, head = headEntries(mgmt->fHandle.pageSize);
+    memcpy(HASH_DIRECTORY(mgmt->metaPage), mgmt->directory, sizeof(int32_t) * (size_t) (size < head ? size : head));
+    RC rc = writeBlock(0, &mgmt->fHandle, mgmt->metaPage);
+    if (rc == RC_OK) {
+        mgmt->metaDirty = 0;
+    }
+    return rc;
+}
+
+/**
+ * @brief Writes the changed pages of the directory chain, then page 0, so page 0 never leads
+ *        to a chain page that was not written.
+ */
+static RC writeDirectory(HashMgmt *mgmt)
+{
+    int pageSize = mgmt->fHandle.pageSize, size = 1 << HASH_META(mgmt)->globalDepth;
+    int per = chainEntries(pageSize);
+    for (int i = 0; i < mgmt->numDirectoryPages; i++) {
+        if (!mgmt->directoryDirty[i]) {
+            continue;
+        }
+        int first = headEntries(pageSize) + i * per;
+        int count = size - first < per ? size - first : per;
+        memset(mgmt->sibling, 0, (size_t) pageSize);
+        DIRECTORY_HEADER(mgmt->sibling)->nextPage = i + 1 < mgmt->numDirectoryPages ? mgmt->directoryPages[i + 1] : 0;
+        DIRECTORY_HEADER(mgmt->sibling)->numEntries = count;
+        memcpy(DIRECTORY_ENTRIES(mgmt->sibling), mgmt->directory + first, sizeof(int32_t) * (size_t) count);
+        RC rc = writeBlock(mgmt->directoryPages[i], &mgmt->fHandle, mgmt->sibling);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        mgmt->directoryDirty[i] = 0;
+    }
+    return mgmt->metaDirty ? writeMeta(mgmt) : RC_OK;
+}
+
+/**
+ * @brief Marks the pages holding directory entries from to to-1 as changed.
+ */
+static void markDirectory(HashMgmt *mgmt, int from, int to)
+{
+    int head = headEntries(mgmt->fHandle.pageSize), per = chainEntries(mgmt->fHandle.pageSize);
+    if (from < head) {
+        mgmt->metaDirty = 1;
+        from = head;
+    }
+    for (int i = from; i < to; i += per - (i - head) % per) {
+        mgmt->directoryDirty[(i - head) / per] = 1;
+    }
+}
+
+/**
+ * @brief Reads the part of the directory that is not in page 0 by following the chain.
+ *
+ * @return RC_OK if successful.
+ *         RC_PAGE_CORRUPT if the chain is shorter than the directory or leaves the file.
+ */
+static RC loadDirectory(HashMgmt *mgmt)
+{
+    int pageSize = mgmt->fHandle.pageSize, size = 1 << HASH_META(mgmt)->globalDepth;
+    int head = headEntries(pageSize), per = chainEntries(pageSize);
+    int numPages = chainPagesFor(pageSize, size);
+    mgmt->directory = (int32_t*) malloc(sizeof(int32_t) * (size_t) size);
+    mgmt->directoryPages = (int*) malloc(sizeof(int) * (size_t) (numPages > 0 ? numPages : 1));
+    mgmt->directoryDirty = (char*) calloc((size_t) (numPages > 0 ? numPages : 1), 1);
+    if (mgmt->directory == NULL || mgmt->directoryPages == NULL || mgmt->directoryDirty == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    memcpy(mgmt->directory, HASH_DIRECTORY(mgmt->metaPage), sizeof(int32_t) * (size_t) (size < head ? size : head));
+    int pageNum = HASH_META(mgmt)->directoryPage;
+    for (int i = 0; i < numPages; i++) {
+        int first = head + i * per;
+        int count = size - first < per ? size - first : per;
+        if (pageNum <= 0 || pageNum >= mgmt->fHandle.totalNumPages) {
+            printMessage("The directory of hash index %s is cut short.\n", mgmt->fHandle.fileName);
+            return RC_PAGE_CORRUPT;
+        }
+        RC rc = readBlock(pageNum, &mgmt->fHandle, mgmt->sibling);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        if (DIRECTORY_HEADER(mgmt->sibling)->numEntries != count) {
+            printMessage("Page %d of hash index %s is not a directory page.\n", pageNum, mgmt->fHandle.fileName);
+            return RC_PAGE_CORRUPT;
+        }
+        memcpy(mgmt->directory + first, DIRECTORY_ENTRIES(mgmt->sibling), sizeof(int32_t) * (size_t) count);
+        mgmt->directoryPages[i] = pageNum;
+        pageNum = DIRECTORY_HEADER(mgmt->sibling)->nextPage;
+    }
+    mgmt->numDirectoryPages = numPages;
+    return RC_OK;
+}
+
+/**
+ * @brief Doubles the directory by copying it, adding pages to the directory chain when the
+ *        new half does not fit in the pages it has.
+ *
+ * @return RC_OK if successful.
+ *         RC_IM_N_TO_LAGE if the directory already has HASH_MAX_GLOBAL_DEPTH bits.
+ */
+static RC growDirectory(HashMgmt *mgmt)
+{
+    HashMeta *meta = HASH_META(mgmt);
+    if (meta->globalDepth == HASH_MAX_GLOBAL_DEPTH) {
+        printMessage("The directory of hash index %s is full.\n", mgmt->fHandle.fileName);
+        return RC_IM_N_TO_LAGE;
+    }
+    int size = 1 << meta->globalDepth;
+    int numPages = chainPagesFor(mgmt->fHandle.pageSize, 2 * size);
+    int32_t *directory = (int32_t*) realloc(mgmt->directory, sizeof(int32_t) * (size_t) (2 * size));
+    if (directory == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    mgmt->directory = directory;
+    if (numPages > mgmt->numDirectoryPages) {
+        int *pages = (int*) realloc(mgmt->directoryPages, sizeof(int) * (size_t) numPages);
+        if (pages == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        mgmt->directoryPages = pages;
+        char *dirty = (char*) realloc(mgmt->directoryDirty, (size_t) numPages);
+        if (dirty == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        mgmt->directoryDirty = dirty;
+        while (mgmt->numDirectoryPages < numPages) {
+            RC rc = appendEmptyBlock(&mgmt->fHandle);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            // The page before the new one has to lead to it.
+            int i = mgmt->numDirectoryPages++;
+            pages[i] = mgmt->fHandle.totalNumPages - 1;
+            dirty[i] = 1;
+            if (i == 0) {
+                meta->directoryPage = pages[0];
+                mgmt->metaDirty = 1;
+            }
+            else {
+                dirty[i - 1] = 1;
+            }
+        }
+    }
+    memcpy(directory + size, directory, sizeof(int32_t) * (size_t) size);
+    meta->globalDepth++;
+    markDirectory(mgmt, size, 2 * size);
+    return RC_OK;
+}
+
+static void initBucket(char *page, int pageSize, int localDepth)
+{
+    memset(page, 0, (size_t) pageSize);
+    BUCKET_HEADER(page)->localDepth = localDepth;
+}
+
+/**
+ * @brief Splits the full bucket in mgmt->bucket on its next hash bit. Keys with that bit set
+ *        move to a new bucket and the directory entries of that half point to it; the
+ *        directory doubles first if the bucket already uses all of its bits.
+ *
+ * @return RC_OK if successful.
+ *         RC_IM_N_TO_LAGE if the directory can't grow any more.
+ */
+static RC splitBucket(HashMgmt *mgmt, int pageNum)
+{
+    HashMeta *meta = HASH_META(mgmt);
+    int depth = BUCKET_HEADER(mgmt->bucket)->localDepth;
+    RC rc;
+    if (depth == meta->globalDepth && (rc = growDirectory(mgmt)) != RC_OK) {
+        return rc;
+    }
+    int32_t *directory = mgmt->directory;
+    // The entries of the old bucket are all i with the low depth bits of any of its keys.
+    int low = (int) (hashKey(BUCKET_KEYS(mgmt->bucket)[0]) & ((1u << depth) - 1));
+    rc = appendEmptyBlock(&mgmt->fHandle);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    int newPage = mgmt->fHandle.totalNumPages - 1;
+
+    // Partition the keys on the next hash bit, keeping the order of both halves.
+    int32_t *keys = BUCKET_KEYS(mgmt->bucket);
+    RID *rids = bucketRids(mgmt, mgmt->bucket);
+    initBucket(mgmt->sibling, mgmt->fHandle.pageSize, depth + 1);
+    int32_t *newKeys = BUCKET_KEYS(mgmt->sibling);
+    RID *newRids = bucketRids(mgmt, mgmt->sibling);
+    int numKeys = BUCKET_HEADER(mgmt->bucket)->numEntries, kept = 0, moved = 0;
+    for (int i = 0; i < numKeys; i++) {
+        int32_t key = keys[i];
+        RID rid = rids[i];
+        if ((hashKey(key) >> depth) & 1) {
+            newKeys[moved] = key;
+            newRids[moved++] = rid;
+        }
+        else {
+            keys[kept] = key;
+            rids[kept++] = rid;
+        }
+    }
+    BUCKET_HEADER(mgmt->bucket)->localDepth = depth + 1;
+    BUCKET_HEADER(mgmt->bucket)->numEntries = kept;
+    BUCKET_HEADER(mgmt->sibling)->numEntries = moved;
+
+    // Half of the entries of the old bucket move to the new one.
+    for (int i = low | (1 << depth); i < (1 << meta->globalDepth); i += 2 << depth) {
+        directory[i] = newPage;
+        markDirectory(mgmt, i, i + 1);
+    }
+    meta->numBuckets++;
+    mgmt->metaDirty = 1;
+    if ((rc = writeBlock(newPage, &mgmt->fHandle, mgmt->sibling)) != RC_OK) {
+        return rc;
+    }
+    return writeBlock(pageNum, &mgmt->fHandle, mgmt->bucket);
+}
+
+/**
+ * @brief Checks that the index is open and the key has the index's type.
+ */
+static RC checkKey(HashIndexHandle *index, Value *key)
+{
+    if (index == NULL || index->mgmtData == NULL || key == NULL) {
+        printMessage("The index is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (key->dt != index->keyType) {
+        printMessage("The key does not have the type of index %s.\n", index->idxId);
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    }
+    return RC_OK;
+}
+
+static int compareProbes(const void *a, const void *b)
+{
+    const HashProbe *x = (const HashProbe*) a, *y = (const HashProbe*) b;
+    if (x->pageNum != y->pageNum) {
+        return x->pageNum < y->pageNum ? -1 : 1;
+    }
+    return (x->keyNum > y->keyNum) - (x->keyNum < y->keyNum);
+}
+
+
+/************************************************************
+ *                    creating and opening                  *
+ ************************************************************/
+
+/**
+ * @brief Creates a hash index in a new page file with a single empty bucket.
+ *
+ * @param idxId Name of the page file of the index.
+ * @param keyType Type of the keys; only DT_INT is supported.
+ * @return RC_OK if successful.
+ *         RC_RM_UNKOWN_DATATYPE if the key type is not supported.
+ */
+RC createHashIndex(char *idxId, DataType keyType)
+{
+    if (idxId == NULL) {
+        printMessage("The index can't be created because its name is null.\n");
+        return RC_FILE_NOT_FOUND;
+    }
+    if (keyType != DT_INT) {
+        printMessage("Only integer keys are supported.\n");
+        return RC_RM_UNKOWN_DATATYPE;
+    }
+    RC rc = createPageFile(idxId);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    HashMgmt mgmt;
+    memset(&mgmt, 0, sizeof(mgmt));
+    if ((rc = openPageFile(idxId, &mgmt.fHandle)) != RC_OK) {
+        return rc;
+    }
+    mgmt.metaPage = (char*) calloc(1, (size_t) mgmt.fHandle.pageSize);
+    if (mgmt.metaPage == NULL) {
+        closePageFile(&mgmt.fHandle);
+        return RC_WRITE_FAILED;
+    }
+    memcpy(HASH_META(&mgmt)->magic, HASH_INDEX_MAGIC, sizeof(HASH_META(&mgmt)->magic));
+    HASH_META(&mgmt)->keyType = keyType;
+    HASH_META(&mgmt)->globalDepth = 0;
+    HASH_META(&mgmt)->numBuckets = 1;
+    HASH_META(&mgmt)->numEntries = 0;
+    int32_t firstBucket = 1;
+    mgmt.directory = &firstBucket;
+    rc = ensureCapacity(2, &mgmt.fHandle);
+    if (rc == RC_OK) {
+        rc = writeMeta(&mgmt);
+    }
+    if (rc == RC_OK) {
+        // An all-zero page is an empty bucket of local depth 0.
+        initBucket(mgmt.metaPage, mgmt.fHandle.pageSize, 0);
+        rc = writeBlock(1, &mgmt.fHandle, mgmt.metaPage);
+    }
+    free(mgmt.metaPage);
+    RC closeCheck = closePageFile(&mgmt.fHandle);
+    return rc != RC_OK ? rc : closeCheck;
+}
+
+
+/**
+ * @brief Opens an index created with createHashIndex and loads its directory from page 0
+ *        and the directory chain.
+ *
+ * @param index Receives the handle of the open index.
+ * @param idxId Name of the page file of the index.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the index does not exist.
+ *         RC_PAGE_CORRUPT if the file is not a hash index or its directory chain is broken.
+ */
+RC openHashIndex(HashIndexHandle **index, char *idxId)
+{
+    if (index == NULL || idxId == NULL) {
+        printMessage("The index can't be opened because its name or handle is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    HashIndexHandle *handle = (HashIndexHandle*) calloc(1, sizeof(HashIndexHandle));
+    HashMgmt *mgmt = (HashMgmt*) calloc(1, sizeof(HashMgmt));
+    char *name = strdup(idxId);
+    if (handle == NULL || mgmt == NULL || name == NULL) {
+        free(handle);
+        free(mgmt);
+        free(name);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = openPageFile(name, &mgmt->fHandle);
+    if (rc != RC_OK) {
+        free(handle);
+        free(mgmt);
+        free(name);
+        return rc;
+    }
+    size_t pageSize = (size_t) mgmt->fHandle.pageSize;
+    mgmt->capacity = bucketCapacity(mgmt->fHandle.pageSize);
+    mgmt->metaPage = (char*) malloc(pageSize);
+    mgmt->bucket = (char*) malloc(pageSize);
+    mgmt->sibling = (char*) malloc(pageSize);
+    if (mgmt->metaPage == NULL || mgmt->bucket == NULL || mgmt->sibling == NULL) {
+        rc = RC_WRITE_FAILED;
+    }
+    else if ((rc = readBlock(0, &mgmt->fHandle, mgmt->metaPage)) == RC_OK) {
+        HashMeta *meta = HASH_META(mgmt);
+        if (memcmp(meta->magic, HASH_INDEX_MAGIC, sizeof(meta->magic)) != 0
+            || meta->globalDepth < 0 || meta->globalDepth > HASH_MAX_GLOBAL_DEPTH) {
+            printMessage("The file %s is not a hash index!\n", name);
+            rc = RC_PAGE_CORRUPT;
+        }
+        else {
+            rc = loadDirectory(mgmt);
+        }
+    }
+    handle->keyType = rc == RC_OK ? (DataType) HASH_META(mgmt)->keyType : DT_INT;
+    handle->idxId = name;
+    handle->mgmtData = mgmt;
+    if (rc != RC_OK) {
+        closeHashIndex(handle);
+        return rc;
+    }
+    *index = handle;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Writes the directory and counts of an index and closes it.
+ *
+ * @param index The open index.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the index is not open.
+ *         RC_WRITE_FAILED if the directory could not be written.
+ */
+RC closeHashIndex(HashIndexHandle *index)
+{
+    if (index == NULL || index->mgmtData == NULL) {
+        printMessage("The index is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    HashMgmt *mgmt = (HashMgmt*) index->mgmtData;
+    RC rc = mgmt->directory != NULL ? writeDirectory(mgmt) : RC_OK;
+    if (closePageFile(&mgmt->fHandle) != RC_OK && rc == RC_OK) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(mgmt->metaPage);
+    free(mgmt->directory);
+    free(mgmt->directoryPages);
+    free(mgmt->directoryDirty);
+    free(mgmt->bucket);
+    free(mgmt->sibling);
+    free(mgmt);
+    free(index->idxId);
+    free(index);
+    return rc;
+}
+
+
+/**
+ * @brief Removes the page file of an index that is not open.
+ */
+RC deleteHashIndex(char *idxId)
+{
+    return destroyPageFile(idxId);
+}
+
+
+/**
+ * @brief Returns the number of keys in an index.
+ */
+RC getHashNumEntries(HashIndexHandle *index, int *result)
+{
+    if (index == NULL || index->mgmtData == NULL || result == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    *result = HASH_META((HashMgmt*) index->mgmtData)->numEntries;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns the number of bucket pages of an index.
+ */
+RC getHashNumBuckets(HashIndexHandle *index, int *result)
+{
+    if (index == NULL || index->mgmtData == NULL || result == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    *result = HASH_META((HashMgmt*) index->mgmtData)->numBuckets;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns the number of hash bits the directory uses.
+ */
+RC getHashGlobalDepth(HashIndexHandle *index, int *result)
+{
+    if (index == NULL || index->mgmtData == NULL || result == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    *result = HASH_META((HashMgmt*) index->mgmtData)->globalDepth;
+    return RC_OK;
+}
+
+
+/************************************************************
+ *                    index access                          *
+ ************************************************************/
+
+/**
+ * @brief Looks a key up, reading the one bucket page the directory leads to.
+ *
+ * @param index The open index.
+ * @param key The key to find.
+ * @param result Receives the record id stored with the key.
+ * @return RC_OK if successful.
+ *         RC_IM_KEY_NOT_FOUND if the key is not in the index.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if the key has another type.
+ */
+RC hashFindKey(HashIndexHandle *index, Value *key, RID *result)
+{
+    RC rc = checkKey(index, key);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    HashMgmt *mgmt = (HashMgmt*) index->mgmtData;
+    if ((rc = readBlock(bucketOf(mgmt, key->v.intV), &mgmt->fHandle, mgmt->bucket)) != RC_OK) {
+        return rc;
+    }
+    int pos = findInBucket(BUCKET_KEYS(mgmt->bucket), BUCKET_HEADER(mgmt->bucket)->numEntries, key->v.intV);
+    if (pos == NOT_FOUND) {
+        return RC_IM_KEY_NOT_FOUND;
+    }
+    if (result != NULL) {
+        *result = bucketRids(mgmt, mgmt->bucket)[pos];
+    }
+    return RC_OK;
+}
+
+
+/**
+ * @brief Looks many keys up at once. The probes are sorted by the bucket page they need, so
+ *        every bucket is read once however many of the keys it holds, in ascending page order.
+ *
+ * @param index The open index.
+ * @param keys The keys to find.
+ * @param numKeys Number of keys.
+ * @param results Receives the record id of every key that was found.
+ * @param found Receives RC_OK or RC_IM_KEY_NOT_FOUND for every key.
+ * @return RC_OK if every bucket could be read.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if a key has another type.
+ */
+RC hashFindKeys(HashIndexHandle *index, Value *keys, int numKeys, RID *results, RC *found)
+{
+    if (numKeys < 0 || (numKeys > 0 && (keys == NULL || results == NULL || found == NULL))) {
+        printMessage("The keys or results of the lookup are missing.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    for (int i = 0; i < numKeys; i++) {
+        RC rc = checkKey(index, &keys[i]);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    if (numKeys == 0) {
+        return RC_OK;
+    }
+    HashMgmt *mgmt = (HashMgmt*) index->mgmtData;
+    HashProbe *probes = (HashProbe*) malloc(sizeof(HashProbe) * (size_t) numKeys);
+    if (probes == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    for (int i = 0; i < numKeys; i++) {
+        probes[i].pageNum = bucketOf(mgmt, keys[i].v.intV);
+        probes[i].keyNum = i;
+    }
+    qsort(probes, (size_t) numKeys, sizeof(HashProbe), compareProbes);
+    RC rc = RC_OK;
+    int loadedPage = -1;
+    for (int i = 0; i < numKeys && rc == RC_OK; i++) {
+        if (probes[i].pageNum != loadedPage) {
+            rc = readBlock(probes[i].pageNum, &mgmt->fHandle, mgmt->bucket);
+            loadedPage = probes[i].pageNum;
+        }
+        int keyNum = probes[i].keyNum;
+        int pos = findInBucket(BUCKET_KEYS(mgmt->bucket), BUCKET_HEADER(mgmt->bucket)->numEntries, keys[keyNum].v.intV);
+        found[keyNum] = pos == NOT_FOUND ? RC_IM_KEY_NOT_FOUND : RC_OK;
+        if (pos != NOT_FOUND) {
+            results[keyNum] = bucketRids(mgmt, mgmt->bucket)[pos];
+        }
+    }
+    free(probes);
+    return rc;
+}
+
+
+/**
+ * @brief Adds a key with the record id it points to, splitting its bucket while it is full.
+ *
+ * @param index The open index.
+ * @param key The new key.
+ * @param rid The record id stored with the key.
+ * @return RC_OK if successful.
+ *         RC_IM_KEY_ALREADY_EXISTS if the key is already in the index.
+ *         RC_IM_N_TO_LAGE if the bucket is full and the directory can't grow any more.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if the key has another type.
+ */
+RC hashInsertKey(HashIndexHandle *index, Value *key, RID rid)
+{
+    RC rc = checkKey(index, key);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    HashMgmt *mgmt = (HashMgmt*) index->mgmtData;
+    int32_t k = key->v.intV;
+    for (;;) {
+        int pageNum = bucketOf(mgmt, k);
+        if ((rc = readBlock(pageNum, &mgmt->fHandle, mgmt->bucket)) != RC_OK) {
+            return rc;
+        }
+        HashBucketHeader *header = BUCKET_HEADER(mgmt->bucket);
+        if (findInBucket(BUCKET_KEYS(mgmt->bucket), header->numEntries, k) != NOT_FOUND) {
+            return RC_IM_KEY_ALREADY_EXISTS;
+        }
+        if (header->numEntries < mgmt->capacity) {
+            BUCKET_KEYS(mgmt->bucket)[header->numEntries] = k;
+            bucketRids(mgmt, mgmt->bucket)[header->numEntries] = rid;
+            header->numEntries++;
+            if ((rc = writeBlock(pageNum, &mgmt->fHandle, mgmt->bucket)) == RC_OK) {
+                HASH_META(mgmt)->numEntries++;
+                mgmt->metaDirty = 1;
+            }
+            return rc;
+        }
+        // All keys of the bucket may land on one side, so split until the key's bucket has room.
+        if ((rc = splitBucket(mgmt, pageNum)) != RC_OK) {
+            return rc;
+        }
+    }
+}
+
+
+/**
+ * @brief Removes a key; its bucket takes the last key into the free place.
+ *
+ * @param index The open index.
+ * @param key The key to remove.
+ * @return RC_OK if successful.
+ *         RC_IM_KEY_NOT_FOUND if the key is not in the index.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if the key has another type.
+ */
+RC hashDeleteKey(HashIndexHandle *index, Value *key)
+{
+    RC rc = checkKey(index, key);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    HashMgmt *mgmt = (HashMgmt*) index->mgmtData;
+    int pageNum = bucketOf(mgmt, key->v.intV);
+    if ((rc = readBlock(pageNum, &mgmt->fHandle, mgmt->bucket)) != RC_OK) {
+        return rc;
+    }
+    HashBucketHeader *header = BUCKET_HEADER(mgmt->bucket);
+    int32_t *keys = BUCKET_KEYS(mgmt->bucket);
+    RID *rids = bucketRids(mgmt, mgmt->bucket);
+    int pos = findInBucket(keys, header->numEntries, key->v.intV);
+    if (pos == NOT_FOUND) {
+        return RC_IM_KEY_NOT_FOUND;
+    }
+    int last = --header->numEntries;
+    keys[pos] = keys[last];
+    rids[pos] = rids[last];
+    if ((rc = writeBlock(pageNum, &mgmt->fHandle, mgmt->bucket)) == RC_OK) {
+        HASH_META(mgmt)->numEntries--;
+        mgmt->metaDirty = 1;
+    }
+    return rc;
+}
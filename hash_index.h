@@ -0,0 +1,55 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include "dberror.h"
+#include "tables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    hash index constants                  *
+ ************************************************************/
+#define HASH_INDEX_MAGIC "SMHASH01"
+/* bytes of page 0 in front of the directory */
+#define HASH_DIRECTORY_OFFSET 32
+/* bytes in front of the entries of every further directory page */
+#define HASH_DIRECTORY_PAGE_HEADER_SIZE 8
+/* the directory has at most 2^24 entries, 64 MiB in memory */
+#define HASH_MAX_GLOBAL_DEPTH 24
+/* bytes in front of the keys of every bucket */
+#define HASH_BUCKET_HEADER_SIZE 16
+
+/* an open hash index; mgmtData holds the page file and the cached directory */
+typedef struct HashIndexHandle {
+	DataType keyType;
+	char *idxId;
+	void *mgmtData;
+} HashIndexHandle;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* create, destroy, open, and close a hash index */
+extern RC createHashIndex (char *idxId, DataType keyType);
+extern RC openHashIndex (HashIndexHandle **index, char *idxId);
+extern RC closeHashIndex (HashIndexHandle *index);
+extern RC deleteHashIndex (char *idxId);
+
+/* access information about a hash index */
+extern RC getHashNumEntries (HashIndexHandle *index, int *result);
+extern RC getHashNumBuckets (HashIndexHandle *index, int *result);
+extern RC getHashGlobalDepth (HashIndexHandle *index, int *result);
+
+/* index access */
+extern RC hashFindKey (HashIndexHandle *index, Value *key, RID *result);
+extern RC hashFindKeys (HashIndexHandle *index, Value *keys, int numKeys, RID *results, RC *found);
+extern RC hashInsertKey (HashIndexHandle *index, Value *key, RID rid);
+extern RC hashDeleteKey (HashIndexHandle *index, Value *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,425 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heat_profile.h"
+#include "io_replay.h"
+#include "sm_backend.h"
+
+/*
+ * A heat profile describes how a file's pages are used, for sizing caches and choosing page
+ * sizes. The read/write mix and the share of sequential accesses are counted exactly with a
+ * few atomic adds per page. Everything else works on samples so the cost per access stays low:
+ *
+ * - One access in 2^sampleShift, picked by a hash of its number, is counted in a count-min
+ *   sketch: a few rows of counters indexed by different hashes of the page number, where a
+ *   page's count is the smallest of its counters. The pages with the largest counts are kept
+ *   as the hottest pages.
+ * - One page in 2^sampleShift, chosen by a hash of the page number, has the distance of its
+ *   reuses measured: the number of distinct sampled pages used since it was last used, found
+ *   in a most-recently-used stack. Scaled by the sampling rate, this estimates the distance
+ *   among all pages; an LRU cache of C pages hits every access with a distance below C.
+ */
+
+#define HEAT_MAX_SAMPLE_SHIFT 16
+
+struct SM_HeatProfiler {
+    int sampleShift;
+    uint32_t sampleMask;
+    /* exact counters, updated without the lock */
+    long long accesses;
+    long long reads;
+    long long writes;
+    long long sequential;
+    int lastPage;
+    /* guards the sampled parts below */
+    pthread_mutex_t lock;
+    uint32_t sketch[HEAT_SKETCH_DEPTH][HEAT_SKETCH_WIDTH];
+    int numHot;
+    SM_HeatPage hot[HEAT_TOP_PAGES];
+    /* sampled pages, most recently used first */
+    int *stack;
+    int stackSize;
+    long long reuse[HEAT_REUSE_BUCKETS];
+    long long coldAccesses;
+};
+
+static const uint32_t sketchSeeds[HEAT_SKETCH_DEPTH] = { 2654435761u, 2246822519u, 3266489917u, 668265263u };
+
+
+static uint32_t hashPage(int pageNum)
+{
+    uint32_t hash = (uint32_t) pageNum * 2654435761u;
+    return hash ^ (hash >> 15);
+}
+
+/* mixes the access number, so samples do not fall into step with a periodic workload */
+static uint32_t hashAccess(long long n)
+{
+    uint64_t hash = (uint64_t) n;
+    hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccdULL;
+    hash = (hash ^ (hash >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return (uint32_t) (hash ^ (hash >> 33));
+}
+
+static int reuseBucket(long long distance)
+{
+    int bucket = 0;
+    while (distance > 0 && bucket < HEAT_REUSE_BUCKETS - 1) {
+        distance >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief Counts a sampled access in the sketch and keeps the hottest pages. Called with the lock held.
+ */
+static void countHotPage(SM_HeatProfiler *profiler, int pageNum)
+{
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < HEAT_SKETCH_DEPTH; row++) {
+        uint32_t hash = (uint32_t) (pageNum + 1) * sketchSeeds[row];
+        uint32_t *counter = &profiler->sketch[row][((uint64_t) hash * HEAT_SKETCH_WIDTH) >> 32];
+        if (*counter < UINT32_MAX) {
+            (*counter)++;
+        }
+        if (*counter < estimate) {
+            estimate = *counter;
+        }
+    }
+    int coldest = 0;
+    for (int i = 0; i < profiler->numHot; i++) {
+        if (profiler->hot[i].pageNum == pageNum) {
+            profiler->hot[i].accesses = estimate;
+            return;
+        }
+        if (profiler->hot[i].accesses < profiler->hot[coldest].accesses) {
+            coldest = i;
+        }
+    }
+    if (profiler->numHot < HEAT_TOP_PAGES) {
+        coldest = profiler->numHot++;
+    }
+    else if (profiler->hot[coldest].accesses >= estimate) {
+        return;
+    }
+    profiler->hot[coldest].pageNum = pageNum;
+    profiler->hot[coldest].accesses = estimate;
+}
+
+/**
+ * @brief Measures the reuse distance of an access to a sampled page. Called with the lock held.
+ */
+static void measureReuse(SM_HeatProfiler *profiler, int pageNum)
+{
+    long long weight = 1LL << profiler->sampleShift;
+    int distance = 0;
+    while (distance < profiler->stackSize && profiler->stack[distance] != pageNum) {
+        distance++;
+    }
+    if (distance < profiler->stackSize) {
+        profiler->reuse[reuseBucket((long long) distance << profiler->sampleShift)] += weight;
+    }
+    else {
+        profiler->coldAccesses += weight;
+        if (profiler->stackSize < HEAT_REUSE_MAX_PAGES) {
+            profiler->stackSize++;
+        }
+        // The least recently used page falls off the end of a full stack.
+        distance = profiler->stackSize - 1;
+    }
+    memmove(profiler->stack + 1, profiler->stack, sizeof(int) * (size_t) distance);
+    profiler->stack[0] = pageNum;
+}
+
+static SM_HeatProfiler *createProfiler(int sampleShift)
+{
+    SM_HeatProfiler *profiler = (SM_HeatProfiler*) calloc(1, sizeof(SM_HeatProfiler));
+    if (profiler == NULL) {
+        return NULL;
+    }
+    profiler->stack = (int*) malloc(sizeof(int) * HEAT_REUSE_MAX_PAGES);
+    if (profiler->stack == NULL) {
+        free(profiler);
+        return NULL;
+    }
+    profiler->sampleShift = sampleShift;
+    profiler->sampleMask = (1u << sampleShift) - 1;
+    profiler->lastPage = -2;
+    pthread_mutex_init(&profiler->lock, NULL);
+    return profiler;
+}
+
+static void freeProfiler(SM_HeatProfiler *profiler)
+{
+    pthread_mutex_destroy(&profiler->lock);
+    free(profiler->stack);
+    free(profiler);
+}
+
+static int compareHotPages(const void *a, const void *b)
+{
+    const SM_HeatPage *x = (const SM_HeatPage*) a, *y = (const SM_HeatPage*) b;
+    if (x->accesses != y->accesses) {
+        return x->accesses < y->accesses ? 1 : -1;
+    }
+    return x->pageNum - y->pageNum;
+}
+
+static void takeProfile(SM_HeatProfiler *profiler, SM_HeatProfile *profile)
+{
+    memset(profile, 0, sizeof(*profile));
+    profile->sampleShift = profiler->sampleShift;
+    profile->accesses = __atomic_load_n(&profiler->accesses, __ATOMIC_RELAXED);
+    profile->reads = __atomic_load_n(&profiler->reads, __ATOMIC_RELAXED);
+    profile->writes = __atomic_load_n(&profiler->writes, __ATOMIC_RELAXED);
+    profile->sequential = __atomic_load_n(&profiler->sequential, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&profiler->lock);
+    profile->numHotPages = profiler->numHot;
+    for (int i = 0; i < profiler->numHot; i++) {
+        profile->hotPages[i].pageNum = profiler->hot[i].pageNum;
+        profile->hotPages[i].accesses = profiler->hot[i].accesses << profiler->sampleShift;
+    }
+    memcpy(profile->reuse, profiler->reuse, sizeof(profile->reuse));
+    profile->coldAccesses = profiler->coldAccesses;
+    pthread_mutex_unlock(&profiler->lock);
+    qsort(profile->hotPages, (size_t) profile->numHotPages, sizeof(SM_HeatPage), compareHotPages);
+}
+
+
+/************************************************************
+ *                    storage manager hook                  *
+ ************************************************************/
+
+/**
+ * @brief Counts the pages read or written by one call.
+ */
+void profileAccess(SM_HeatProfiler *profiler, int firstPage, int numPages, int isWrite)
+{
+    if (profiler == NULL) {
+        return;
+    }
+    for (int pageNum = firstPage; pageNum < firstPage + numPages; pageNum++) {
+        long long n = __atomic_fetch_add(&profiler->accesses, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(isWrite ? &profiler->writes : &profiler->reads, 1, __ATOMIC_RELAXED);
+        if (__atomic_exchange_n(&profiler->lastPage, pageNum, __ATOMIC_RELAXED) == pageNum - 1) {
+            __atomic_fetch_add(&profiler->sequential, 1, __ATOMIC_RELAXED);
+        }
+        int counted = (hashAccess(n) & profiler->sampleMask) == 0;
+        int measured = (hashPage(pageNum) & profiler->sampleMask) == 0;
+        if (!counted && !measured) {
+            continue;
+        }
+        pthread_mutex_lock(&profiler->lock);
+        if (counted) {
+            countHotPage(profiler, pageNum);
+        }
+        if (measured) {
+            measureReuse(profiler, pageNum);
+        }
+        pthread_mutex_unlock(&profiler->lock);
+    }
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Starts profiling the pages read and written through an open file and its shared
+ *        handles: readBlock, writeBlock, the multi-page transfers and range writes.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param sampleShift One access in 2^sampleShift is sampled, 0 to 16; 0 samples everything.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the file is already profiled, the shift is out of range or
+ *         memory ran out.
+ */
+RC startHeatProfile(SM_FileHandle *fHandle, int sampleShift)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->profiler != NULL || sampleShift < 0 || sampleShift > HEAT_MAX_SAMPLE_SHIFT) {
+        printMessage("The file %s can't be profiled!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    SM_HeatProfiler *profiler = createProfiler(sampleShift);
+    if (profiler == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    __atomic_store_n(&openFile->profiler, profiler, __ATOMIC_RELEASE);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Stops profiling a file; the profile stays readable through getHeatProfile until
+ *        profiling starts again.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @return RC_OK if successful, also if the file was not profiled.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC stopHeatProfile(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_HeatProfiler *profiler = __atomic_exchange_n(&openFile->profiler, NULL, __ATOMIC_ACQ_REL);
+    if (profiler == NULL) {
+        return RC_OK;
+    }
+    // Calls through other handles sharing the file may still be counting pages in it.
+    quiesceOpenFile(openFile);
+    takeProfile(profiler, &openFile->heatProfile);
+    freeProfiler(profiler);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Reports the profile of a file so far, or the final profile of the last one.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param profile The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC getHeatProfile(SM_FileHandle *fHandle, SM_HeatProfile *profile)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || profile == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    int epoch = beginOpenFileIo(openFile);
+    SM_HeatProfiler *profiler = __atomic_load_n(&openFile->profiler, __ATOMIC_ACQUIRE);
+    if (profiler == NULL) {
+        *profile = openFile->heatProfile;
+    }
+    else {
+        takeProfile(profiler, profile);
+    }
+    endOpenFileIo(openFile, epoch);
+    return RC_OK;
+}
+
+
+/* counts one captured call of the chosen file, passed on by scanIoCapture */
+static void profileCapturedCall(IoCaptureRecord *record, void *context)
+{
+    if (record->rc == RC_OK && record->pageNum >= 0
+        && (record->op == TRACE_READ_BLOCK || record->op == TRACE_WRITE_BLOCK)) {
+        profileAccess((SM_HeatProfiler*) context, record->pageNum, 1, record->op == TRACE_WRITE_BLOCK);
+    }
+}
+
+
+/**
+ * @brief Profiles the successful page reads and writes of one file in an I/O capture (see
+ *        startIoCapture), so a workload recorded elsewhere can be studied without replaying it.
+ *
+ * @param captureFileName The capture file.
+ * @param capturedFileName The captured file to profile, as it was opened during the capture, or
+ *                         NULL if the capture holds only one file.
+ * @param sampleShift One access in 2^sampleShift is sampled, 0 to 16.
+ * @param profile The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if profile is NULL or the shift is out of range.
+ *         RC_FILE_NOT_FOUND if the capture can't be opened or the captured file is not in it.
+ *         RC_READ_NON_EXISTING_PAGE if the file is not a capture.
+ */
+RC profileIoCapture(char *captureFileName, char *capturedFileName, int sampleShift, SM_HeatProfile *profile)
+{
+    if (captureFileName == NULL || profile == NULL || sampleShift < 0 || sampleShift > HEAT_MAX_SAMPLE_SHIFT) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_HeatProfiler *profiler = createProfiler(sampleShift);
+    if (profiler == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = scanIoCapture(captureFileName, capturedFileName, profileCapturedCall, profiler);
+    if (rc == RC_OK) {
+        takeProfile(profiler, profile);
+    }
+    freeProfiler(profiler);
+    return rc;
+}
+
+
+/**
+ * @brief Writes a profile as a text report: the read/write mix, the sequential share, the
+ *        hottest pages and the reuse distances with the hit ratio of LRU caches of each size.
+ *
+ * @param profile The profile.
+ * @param fileName The report file, or NULL for the standard output.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if profile is NULL.
+ *         RC_WRITE_FAILED if the report could not be written.
+ */
+RC dumpHeatProfile(SM_HeatProfile *profile, char *fileName)
+{
+    if (profile == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    FILE *file = fileName != NULL ? fopen(fileName, "w") : stdout;
+    if (file == NULL) {
+        printMessage("The file %s could not be opened!\n", fileName);
+        return RC_WRITE_FAILED;
+    }
+    double total = profile->accesses > 0 ? (double) profile->accesses : 1.0;
+    long long runs = profile->accesses - profile->sequential;
+    fprintf(file, "accesses:    %lld (one in %d sampled)\n", profile->accesses, 1 << profile->sampleShift);
+    fprintf(file, "reads:       %lld (%.1f%%)\n", profile->reads, 100.0 * (double) profile->reads / total);
+    fprintf(file, "writes:      %lld (%.1f%%)\n", profile->writes, 100.0 * (double) profile->writes / total);
+    fprintf(file, "sequential:  %lld (%.1f%%), %.1f pages per run\n", profile->sequential,
+            100.0 * (double) profile->sequential / total, runs > 0 ? (double) profile->accesses / (double) runs : 0.0);
+    fprintf(file, "\nhottest pages:\n%10s %12s %8s\n", "page", "accesses", "share");
+    for (int i = 0; i < profile->numHotPages; i++) {
+        fprintf(file, "%10d %12lld %7.1f%%\n", profile->hotPages[i].pageNum, profile->hotPages[i].accesses,
+                100.0 * (double) profile->hotPages[i].accesses / total);
+    }
+    long long measured = profile->coldAccesses;
+    for (int i = 0; i < HEAT_REUSE_BUCKETS; i++) {
+        measured += profile->reuse[i];
+    }
+    fprintf(file, "\nreuse distance:\n%16s %12s %12s %10s\n", "distinct pages", "accesses", "LRU pages", "hit ratio");
+    long long hits = 0;
+    for (int i = 0; i < HEAT_REUSE_BUCKETS; i++) {
+        if (profile->reuse[i] == 0) {
+            continue;
+        }
+        // An LRU cache of 2^i pages hits this bucket and every one before it.
+        char range[32];
+        long long low = i == 0 ? 0 : 1LL << (i - 1), high = i == 0 ? 0 : (1LL << i) - 1;
+        if (low == high) {
+            sprintf(range, "%lld", low);
+        }
+        else {
+            sprintf(range, "%lld-%lld", low, high);
+        }
+        hits += profile->reuse[i];
+        fprintf(file, "%16s %12lld %12lld %9.1f%%\n", range, profile->reuse[i], 1LL << i,
+                100.0 * (double) hits / (double) (measured > 0 ? measured : 1));
+    }
+    fprintf(file, "%16s %12lld\n", "cold", profile->coldAccesses);
+    if (fileName == NULL) {
+        fflush(file);
+        return RC_OK;
+    }
+    if (fclose(file) != 0) {
+        printMessage("The file %s could not be closed!\n", fileName);
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
@@ -0,0 +1,64 @@
+#ifndef HEAT_PROFILE_H
+#define HEAT_PROFILE_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    profile constants                     *
+ ************************************************************/
+/* hottest pages a profile reports */
+#define HEAT_TOP_PAGES 32
+/* reuse distances are counted in powers of two: 0, 1, 2-3, 4-7, ... */
+#define HEAT_REUSE_BUCKETS 24
+/* rows and counters per row of the count-min sketch of page accesses */
+#define HEAT_SKETCH_DEPTH 4
+#define HEAT_SKETCH_WIDTH 2048
+/* sampled pages whose reuse distance is tracked; older ones count as cold */
+#define HEAT_REUSE_MAX_PAGES 4096
+/* one access in 2^shift feeds the sketch, one page in 2^shift the reuse distances */
+#define HEAT_DEFAULT_SAMPLE_SHIFT 2
+
+/* the access counters of an open file */
+typedef struct SM_HeatProfiler SM_HeatProfiler;
+
+typedef struct SM_HeatPage {
+	int pageNum;
+	long long accesses;       /* estimated from the samples */
+} SM_HeatPage;
+
+typedef struct SM_HeatProfile {
+	int sampleShift;
+	long long accesses;       /* pages read or written, counted exactly */
+	long long reads;
+	long long writes;
+	long long sequential;     /* accesses to the page after the one accessed before */
+	int numHotPages;
+	SM_HeatPage hotPages[HEAT_TOP_PAGES];   /* hottest first */
+	/* accesses by the distinct pages used since the page was last used: bucket 0 holds
+	 * distance 0, bucket i distances 2^(i-1) to 2^i - 1; estimated from the sampled pages */
+	long long reuse[HEAT_REUSE_BUCKETS];
+	long long coldAccesses;   /* first accesses and reuses further than could be tracked */
+} SM_HeatProfile;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC startHeatProfile (SM_FileHandle *fHandle, int sampleShift);
+extern RC stopHeatProfile (SM_FileHandle *fHandle);
+extern RC getHeatProfile (SM_FileHandle *fHandle, SM_HeatProfile *profile);
+extern RC profileIoCapture (char *captureFileName, char *capturedFileName, int sampleShift, SM_HeatProfile *profile);
+extern RC dumpHeatProfile (SM_HeatProfile *profile, char *fileName);
+
+/* used by the storage manager for files that are profiled */
+extern void profileAccess (SM_HeatProfiler *profiler, int firstPage, int numPages, int isWrite);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "storage_mgr.h"
+#include "heat_profile.h"
+
+/* profiles the page accesses of an I/O capture and prints the heat report */
+int main (int argc, char **argv)
+{
+  SM_HeatProfile profile;
+  int sampleShift = HEAT_DEFAULT_SAMPLE_SHIFT;
+  RC rc;
+
+  if (argc < 2 || argc > 4)
+  {
+    printf("usage: %s <capture file> [sample shift] [captured file]\n", argv[0]);
+    return 1;
+  }
+  if (argc >= 3)
+    sampleShift = atoi(argv[2]);
+
+  rc = profileIoCapture(argv[1], argc == 4 ? argv[3] : NULL, sampleShift, &profile);
+  if (rc == RC_OK)
+    rc = dumpHeatProfile(&profile, NULL);
+  if (rc != RC_OK)
+  {
+    printError(rc);
+    return 1;
+  }
+  return 0;
+}
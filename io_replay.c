@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "storage_mgr.h"
+#include "io_replay.h"
+
+int captureEnabled = 0;
+
+static pthread_mutex_t captureLock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *captureFile = NULL;
+static long long captureStartNs = 0;
+/* the files named in the running capture; a file's id is its index */
+static char **capturedNames = NULL;
+static int numCapturedNames = 0;
+
+
+/**
+ * @brief Starts writing every traced page API call to a capture file. Each call is filed under
+ *        the name its handle was opened with, so a capture can hold several files.
+ *
+ * @param captureFileName The name of the capture file; an existing file is overwritten.
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if a capture is already running or the file can't be written.
+ */
+RC startIoCapture(char *captureFileName)
+{
+    pthread_mutex_lock(&captureLock);
+    if (captureFile != NULL) {
+        pthread_mutex_unlock(&captureLock);
+        printMessage("An I/O capture is already running.\n");
+        return RC_WRITE_FAILED;
+    }
+    FILE *file = fopen(captureFileName, "wb");
+    if (file == NULL) {
+        pthread_mutex_unlock(&captureLock);
+        printMessage("The file %s could not be opened!\n", captureFileName);
+        return RC_WRITE_FAILED;
+    }
+    if (fwrite(IO_CAPTURE_MAGIC, 1, IO_CAPTURE_MAGIC_LEN, file) != IO_CAPTURE_MAGIC_LEN) {
+        fclose(file);
+        pthread_mutex_unlock(&captureLock);
+        printMessage("The file %s could not be written!\n", captureFileName);
+        return RC_WRITE_FAILED;
+    }
+    captureFile = file;
+    captureStartNs = traceClockNs();
+    __atomic_store_n(&captureEnabled, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&captureLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Stops the running capture and closes its file.
+ *
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if no capture is running or the file could not be closed.
+ */
+RC stopIoCapture(void)
+{
+    pthread_mutex_lock(&captureLock);
+    __atomic_store_n(&captureEnabled, 0, __ATOMIC_RELEASE);
+    FILE *file = captureFile;
+    captureFile = NULL;
+    for (int i = 0; i < numCapturedNames; i++) {
+        free(capturedNames[i]);
+    }
+    free(capturedNames);
+    capturedNames = NULL;
+    numCapturedNames = 0;
+    pthread_mutex_unlock(&captureLock);
+    if (file == NULL) {
+        printMessage("No I/O capture is running.\n");
+        return RC_WRITE_FAILED;
+    }
+    if (fclose(file) != 0) {
+        printMessage("The capture file could not be closed!\n");
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+
+/**
+ * @brief Looks up the id of a file in the running capture. A file seen for the first time gets
+ *        the next id, and a record naming it is written. Must be called with captureLock held.
+ *
+ * @return The id, or -1 if there is no name or it could not be recorded.
+ */
+static int capturedFileId(char *fileName)
+{
+    if (fileName == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < numCapturedNames; i++) {
+        if (strcmp(capturedNames[i], fileName) == 0) {
+            return i;
+        }
+    }
+    size_t length = strlen(fileName);
+    if (length == 0 || length > IO_CAPTURE_MAX_NAME) {
+        return -1;
+    }
+    char **names = (char**) realloc(capturedNames, sizeof(char*) * (numCapturedNames + 1));
+    if (names == NULL) {
+        return -1;
+    }
+    capturedNames = names;
+    // The name is padded to whole records, so a reader can step over it record by record.
+    size_t padded = (length + sizeof(IoCaptureRecord) - 1) / sizeof(IoCaptureRecord) * sizeof(IoCaptureRecord);
+    char *name = (char*) calloc(1, padded + 1);
+    if (name == NULL) {
+        return -1;
+    }
+    memcpy(name, fileName, length);
+    IoCaptureRecord record;
+    memset(&record, 0, sizeof(record));
+    record.pageNum = (int32_t) length;
+    record.op = IO_CAPTURE_FILE_NAME;
+    record.fileId = numCapturedNames;
+    fwrite(&record, sizeof(record), 1, captureFile);
+    fwrite(name, 1, padded, captureFile);
+    capturedNames[numCapturedNames] = name;
+    return numCapturedNames++;
+}
+
+
+/**
+ * @brief Appends one finished operation to the capture file.
+ *
+ * @param op The operation that finished.
+ * @param startNs When the operation started, on the trace clock.
+ * @param fileName The name the handle was opened with, or NULL if it has none.
+ * @param pageNum The page the operation worked on, or -1 if it has none.
+ * @param rc The return code of the operation.
+ */
+void captureOperation(SM_TraceOp op, long long startNs, char *fileName, int pageNum, RC rc)
+{
+    IoCaptureRecord record;
+    memset(&record, 0, sizeof(record));
+    record.pageNum = pageNum;
+    record.op = (uint16_t) op;
+    record.rc = (uint16_t) rc;
+    pthread_mutex_lock(&captureLock);
+    if (captureFile != NULL) {
+        record.fileId = capturedFileId(fileName);
+        record.startNs = startNs - captureStartNs;
+        fwrite(&record, sizeof(record), 1, captureFile);
+    }
+    pthread_mutex_unlock(&captureLock);
+}
+
+
+/**
+ * @brief Reads a capture file and passes the calls on one of its files to a visitor.
+ *
+ * @param captureFileName The capture file written by startIoCapture/stopIoCapture.
+ * @param capturedFileName The name of the file whose calls are wanted, as it was opened during
+ *                         the capture, or NULL if the capture holds only one file.
+ * @param visit Called with every call on that file, in capture order.
+ * @param context Passed on to visit.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the capture can't be opened, does not hold the named file, or
+ *                           holds several files and none was named.
+ *         RC_READ_NON_EXISTING_PAGE if the file is not a capture or is malformed.
+ */
+RC scanIoCapture(char *captureFileName, char *capturedFileName, IoCaptureVisitor visit, void *context)
+{
+    if (captureFileName == NULL || visit == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    FILE *file = fopen(captureFileName, "rb");
+    if (file == NULL) {
+        printMessage("The file %s could not be opened!\n", captureFileName);
+        return RC_FILE_NOT_FOUND;
+    }
+    char magic[IO_CAPTURE_MAGIC_LEN];
+    if (fread(magic, 1, IO_CAPTURE_MAGIC_LEN, file) != IO_CAPTURE_MAGIC_LEN
+        || memcmp(magic, IO_CAPTURE_MAGIC, IO_CAPTURE_MAGIC_LEN) != 0) {
+        fclose(file);
+        printMessage("The file %s is not an I/O capture!\n", captureFileName);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    char *name = (char*) malloc(IO_CAPTURE_MAX_NAME + sizeof(IoCaptureRecord) + 1);
+    if (name == NULL) {
+        fclose(file);
+        return RC_WRITE_FAILED;
+    }
+    IoCaptureRecord record;
+    int selected = -1, found = 0;
+    RC rc = RC_OK;
+    size_t got;
+    while ((got = fread(&record, 1, sizeof(record), file)) == sizeof(record)) {
+        if (record.op != IO_CAPTURE_FILE_NAME) {
+            if (found && record.fileId == selected) {
+                visit(&record, context);
+            }
+            continue;
+        }
+        size_t padded = ((size_t) record.pageNum + sizeof(record) - 1) / sizeof(record) * sizeof(record);
+        if (record.pageNum <= 0 || record.pageNum > IO_CAPTURE_MAX_NAME || fread(name, 1, padded, file) != padded) {
+            rc = RC_READ_NON_EXISTING_PAGE;
+            break;
+        }
+        name[record.pageNum] = '\0';
+        if (capturedFileName != NULL ? strcmp(name, capturedFileName) == 0 : !found) {
+            selected = record.fileId;
+            found = 1;
+        }
+        else if (capturedFileName == NULL) {
+            printMessage("The capture %s holds several files; name the one to use.\n", captureFileName);
+            rc = RC_FILE_NOT_FOUND;
+            break;
+        }
+    }
+    if (rc == RC_OK && got != 0) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    if (rc == RC_READ_NON_EXISTING_PAGE) {
+        printMessage("The file %s is not an I/O capture!\n", captureFileName);
+    }
+    else if (rc == RC_OK && capturedFileName != NULL && !found) {
+        printMessage("The capture %s holds no calls on %s!\n", captureFileName, capturedFileName);
+        rc = RC_FILE_NOT_FOUND;
+    }
+    free(name);
+    fclose(file);
+    return rc;
+}
+
+
+/* the calls a replay re-executes, collected by scanIoCapture */
+typedef struct CapturedCalls {
+    IoCaptureRecord *records;
+    long count;
+    long capacity;
+    int failed;
+} CapturedCalls;
+
+static void collectCall(IoCaptureRecord *record, void *context)
+{
+    CapturedCalls *calls = (CapturedCalls*) context;
+    if (calls->count == calls->capacity && !calls->failed) {
+        long capacity = calls->capacity > 0 ? calls->capacity * 2 : 1024;
+        IoCaptureRecord *records = (IoCaptureRecord*) realloc(calls->records, sizeof(IoCaptureRecord) * capacity);
+        if (records == NULL) {
+            calls->failed = 1;
+            return;
+        }
+        calls->records = records;
+        calls->capacity = capacity;
+    }
+    if (!calls->failed) {
+        calls->records[calls->count++] = *record;
+    }
+}
+
+
+/**
+ * @brief Sorts latencies in ascending order for qsort.
+ */
+static int compareLatency(const void *a, const void *b)
+{
+    long long x = *(const long long*) a;
+    long long y = *(const long long*) b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Sleeps until the trace clock reaches the given time.
+ */
+static void sleepUntil(long long targetNs)
+{
+    long long now = traceClockNs();
+    if (targetNs > now) {
+        struct timespec ts;
+        ts.tv_sec = (targetNs - now) / 1000000000LL;
+        ts.tv_nsec = (targetNs - now) % 1000000000LL;
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+/**
+ * @brief Re-executes the reads, writes, appends and capacity changes of one captured file against
+ *        a page file and measures them. Operations that failed when they were captured are skipped;
+ *        open and close calls are not replayed because the page file stays open throughout.
+ *
+ * @param captureFileName The capture file written by startIoCapture/stopIoCapture.
+ * @param capturedFileName The captured file whose calls are replayed, as it was opened during the
+ *                         capture, or NULL if the capture holds only one file.
+ * @param pageFileName The page file the operations are replayed against. It is grown up front
+ *                     so every captured read and write finds its page.
+ * @param paced If non-zero, each operation waits for its original start time; otherwise the
+ *              operations run back to back.
+ * @param stats Filled with the number of operations, throughput and latencies.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if either file can't be opened or the captured file is not in the capture.
+ *         RC_READ_NON_EXISTING_PAGE if the capture file is malformed.
+ *         any error returned by the replayed operations.
+ */
+RC replayIoTrace(char *captureFileName, char *capturedFileName, char *pageFileName, int paced, IoReplayStats *stats)
+{
+    if (stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    memset(stats, 0, sizeof(IoReplayStats));
+    if (captureEnabled) {
+        printMessage("An I/O capture can't be replayed while a capture is running.\n");
+        return RC_WRITE_FAILED;
+    }
+    CapturedCalls calls;
+    memset(&calls, 0, sizeof(calls));
+    RC rc = scanIoCapture(captureFileName, capturedFileName, collectCall, &calls);
+    IoCaptureRecord *records = calls.records;
+    long numRecords = calls.count;
+    long long *latencies = (long long*) malloc(sizeof(long long) * (numRecords > 0 ? numRecords : 1));
+    if (rc != RC_OK || calls.failed || latencies == NULL) {
+        free(records);
+        free(latencies);
+        return rc != RC_OK ? rc : RC_WRITE_FAILED;
+    }
+
+    SM_FileHandle fh;
+    rc = openPageFile(pageFileName, &fh);
+    SM_PageHandle page = rc == RC_OK ? (SM_PageHandle) malloc((size_t) fh.pageSize) : NULL;
+    if (page == NULL) {
+        if (rc == RC_OK) {
+            closePageFile(&fh);
+            rc = RC_WRITE_FAILED;
+        }
+        free(records);
+        free(latencies);
+        return rc;
+    }
+    // Grow the file once so captured reads and writes never run past its end.
+    int maxPage = -1;
+    for (long i = 0; i < numRecords; i++) {
+        if (records[i].rc == RC_OK && (records[i].op == TRACE_READ_BLOCK || records[i].op == TRACE_WRITE_BLOCK)
+            && records[i].pageNum > maxPage) {
+            maxPage = records[i].pageNum;
+        }
+    }
+    rc = ensureCapacity(maxPage + 1, &fh);
+    // Every captured write is replayed, even when it rewrites the page the replay wrote last.
+    if (rc == RC_OK) {
+        rc = setWriteDedup(&fh, 0);
+    }
+    memset(page, 'R', (size_t) fh.pageSize);
+
+    long long replayStartNs = traceClockNs();
+    long long totalLatency = 0;
+    for (long i = 0; i < numRecords && rc == RC_OK; i++) {
+        IoCaptureRecord *record = &records[i];
+        if (record->op == TRACE_OPEN || record->op == TRACE_CLOSE) {
+            continue;
+        }
+        if (record->rc != RC_OK) {
+            stats->numSkipped++;
+            continue;
+        }
+        if (paced) {
+            sleepUntil(replayStartNs + record->startNs);
+        }
+        long long start = traceClockNs();
+        switch (record->op) {
+        case TRACE_READ_BLOCK:
+            rc = readBlock(record->pageNum, &fh, page);
+            break;
+        case TRACE_WRITE_BLOCK:
+            rc = writeBlock(record->pageNum, &fh, page);
+            break;
+        case TRACE_APPEND:
+            rc = appendEmptyBlock(&fh);
+            break;
+        case TRACE_ENSURE_CAPACITY:
+            rc = ensureCapacity(record->pageNum, &fh);
+            break;
+        default:
+            stats->numSkipped++;
+            continue;
+        }
+        long long latency = traceClockNs() - start;
+        latencies[stats->numOps++] = latency;
+        totalLatency += latency;
+    }
+    long long elapsedNs = traceClockNs() - replayStartNs;
+    closePageFile(&fh);
+
+    stats->elapsedSec = elapsedNs / 1e9;
+    if (stats->numOps > 0) {
+        qsort(latencies, (size_t) stats->numOps, sizeof(long long), compareLatency);
+        stats->opsPerSec = elapsedNs > 0 ? stats->numOps / stats->elapsedSec : 0;
+        stats->avgLatencyUs = totalLatency / 1000.0 / stats->numOps;
+        stats->p99LatencyUs = latencies[(stats->numOps * 99) / 100 < stats->numOps ? (stats->numOps * 99) / 100 : stats->numOps - 1] / 1000.0;
+        stats->maxLatencyUs = latencies[stats->numOps - 1] / 1000.0;
+    }
+    free(records);
+    free(latencies);
+    free(page);
+    return rc;
+}
@@ -0,0 +1,65 @@
+#ifndef IO_REPLAY_H
+#define IO_REPLAY_H
+
+#include <stdint.h>
+#include "dberror.h"
+#include "sm_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    capture data structures               *
+ ************************************************************/
+/* first bytes of every capture file */
+#define IO_CAPTURE_MAGIC "SMIOCAP2"
+#define IO_CAPTURE_MAGIC_LEN 8
+
+/* op of a record naming the file with its fileId; pageNum holds the length of the name,
+   which follows padded to whole records. It comes before the first call on that file. */
+#define IO_CAPTURE_FILE_NAME 0xffff
+#define IO_CAPTURE_MAX_NAME 4096
+
+/* one captured page API call; 24 bytes on disk, host byte order */
+typedef struct IoCaptureRecord {
+	int32_t pageNum;
+	uint16_t op;
+	uint16_t rc;
+	int64_t startNs;
+	int32_t fileId;		/* -1 if the handle had no file */
+	int32_t reserved;
+} IoCaptureRecord;
+
+/* called with every captured call on the chosen file, in capture order */
+typedef void (*IoCaptureVisitor) (IoCaptureRecord *record, void *context);
+
+typedef struct IoReplayStats {
+	long numOps;
+	long numSkipped;
+	double elapsedSec;
+	double opsPerSec;
+	double avgLatencyUs;
+	double p99LatencyUs;
+	double maxLatencyUs;
+} IoReplayStats;
+
+/* non-zero while a capture file is being written */
+extern int captureEnabled;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC startIoCapture (char *captureFileName);
+extern RC stopIoCapture (void);
+extern RC replayIoTrace (char *captureFileName, char *capturedFileName, char *pageFileName, int paced, IoReplayStats *stats);
+extern RC scanIoCapture (char *captureFileName, char *capturedFileName, IoCaptureVisitor visit, void *context);
+
+/* used by the storage manager's trace hooks */
+extern void captureOperation (SM_TraceOp op, long long startNs, char *fileName, int pageNum, RC rc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,726 @@
+#define _GNU_SOURCE
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "large_object.h"
+#include "extent_map.h"
+
+/*
+ * Large objects (documents of hundreds of KiB to many MiB) are stored in a page file of
+ * their own. Each object owns extents of the file's extent map, so its data pages form a few
+ * long runs of adjacent pages, and the runs are listed in order on the object's header page,
+ * continued on a chain of directory pages when they do not all fit.
+ *
+ * Data pages hold nothing but data, so a byte range of an object maps to slices of its runs:
+ * whole pages are moved with one readBlocks or writeBlocks call per run straight between the
+ * file and the caller's buffer, and only the partial pages at either end of the range go
+ * through a page buffer. writeBlocks writes a run with one backend call whether or not the
+ * handle deduplicates writes. An object is never assembled in memory.
+ *
+ * Page 0 marks the file as a store; header and directory pages belong to extent map object
+ * LO_META_OBJECT, and the data pages of an object to the object whose id is the number of
+ * its header page.
+ */
+
+/* extent map object owning page 0 and the header and directory pages */
+#define LO_META_OBJECT 0
+
+typedef struct LODirectoryPage {
+    char magic[8];
+    int64_t length;           /* header page only */
+    int32_t numRuns;          /* runs on this page */
+    int32_t nextPage;         /* next directory page, or -1 */
+} LODirectoryPage;
+
+typedef struct LORun {
+    int32_t firstPage;
+    int32_t numPages;
+} LORun;
+
+struct SM_LOStore {
+    SM_FileHandle *fHandle;
+    SM_ExtentMap *extents;
+};
+
+struct SM_LargeObject {
+    SM_LOStore *store;
+    int loId;
+    long long length;
+    int numPages;
+    LORun *runs;
+    /* index within the object of the first page of each run */
+    int *runStart;
+    int numRuns;
+    int runCapacity;
+    /* the header page followed by the overflow chain */
+    int *dirPages;
+    int numDirPages;
+    int dirCapacity;
+    char *buffer;
+    SM_LOStats stats;
+};
+
+
+static int runsPerPage(int pageSize)
+{
+    return (pageSize - (int) sizeof(LODirectoryPage)) / (int) sizeof(LORun);
+}
+
+static long long pagesFor(SM_LargeObject *lo, long long length)
+{
+    int pageSize = lo->store->fHandle->pageSize;
+    return (length + pageSize - 1) / pageSize;
+}
+
+/**
+ * @brief Adds a data page at the end of an object, extending its last run if the page follows it.
+ */
+static RC appendPage(SM_LargeObject *lo, int pageNum)
+{
+    if (lo->numRuns > 0) {
+        LORun *last = &lo->runs[lo->numRuns - 1];
+        if (last->firstPage + last->numPages == pageNum) {
+            last->numPages++;
+            lo->numPages++;
+            return RC_OK;
+        }
+    }
+    if (lo->numRuns == lo->runCapacity) {
+        int newCapacity = lo->runCapacity > 0 ? lo->runCapacity * 2 : 16;
+        LORun *runs = (LORun*) realloc(lo->runs, sizeof(LORun) * newCapacity);
+        if (runs != NULL) {
+            lo->runs = runs;
+        }
+        int *runStart = (int*) realloc(lo->runStart, sizeof(int) * newCapacity);
+        if (runStart != NULL) {
+            lo->runStart = runStart;
+        }
+        if (runs == NULL || runStart == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        lo->runCapacity = newCapacity;
+    }
+    lo->runs[lo->numRuns].firstPage = pageNum;
+    lo->runs[lo->numRuns].numPages = 1;
+    lo->runStart[lo->numRuns] = lo->numPages;
+    lo->numRuns++;
+    lo->numPages++;
+    return RC_OK;
+}
+
+static RC appendDirectoryPage(SM_LargeObject *lo, int pageNum)
+{
+    if (lo->numDirPages == lo->dirCapacity) {
+        int newCapacity = lo->dirCapacity > 0 ? lo->dirCapacity * 2 : 4;
+        int *dirPages = (int*) realloc(lo->dirPages, sizeof(int) * newCapacity);
+        if (dirPages == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        lo->dirPages = dirPages;
+        lo->dirCapacity = newCapacity;
+    }
+    lo->dirPages[lo->numDirPages++] = pageNum;
+    return RC_OK;
+}
+
+/**
+ * @brief Releases data pages from the end of an object until keepPages are left.
+ */
+static RC trimPages(SM_LargeObject *lo, int keepPages)
+{
+    while (lo->numPages > keepPages) {
+        LORun *last = &lo->runs[lo->numRuns - 1];
+        RC rc = releaseObjectPage(lo->store->extents, last->firstPage + last->numPages - 1);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        lo->numPages--;
+        if (--last->numPages == 0) {
+            lo->numRuns--;
+        }
+    }
+    return RC_OK;
+}
+
+/**
+ * @brief Allocates data pages from the object's extents until it has numPages.
+ */
+static RC growPages(SM_LargeObject *lo, long long numPages)
+{
+    if (numPages > INT_MAX) {
+        printMessage("Large object %d cannot grow to %lld pages!\n", lo->loId, numPages);
+        return RC_WRITE_FAILED;
+    }
+    while (lo->numPages < numPages) {
+        int pageNum;
+        RC rc = allocateObjectPage(lo->store->extents, lo->loId, &pageNum);
+        if (rc == RC_OK) {
+            rc = appendPage(lo, pageNum);
+            if (rc != RC_OK) {
+                releaseObjectPage(lo->store->extents, pageNum);
+            }
+        }
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    return RC_OK;
+}
+
+/**
+ * @brief Finds the run holding the page at pageIndex within the object.
+ */
+static int findRun(SM_LargeObject *lo, int pageIndex)
+{
+    int low = 0;
+    int high = lo->numRuns - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (lo->runStart[mid] <= pageIndex) {
+            low = mid;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Moves a byte range of an object between its data pages and a buffer. Whole pages go
+ *        straight to or from the buffer, a run at a time; partial pages go through the page
+ *        buffer. A write with a NULL buffer writes zeros. Pages of a write that start at or
+ *        after dataEnd hold no data yet and are not read before being filled in.
+ */
+static RC transferData(SM_LargeObject *lo, long long offset, long long length, char *buffer,
+                       int isWrite, long long dataEnd)
+{
+    SM_FileHandle *fHandle = lo->store->fHandle;
+    int pageSize = fHandle->pageSize;
+    long long done = 0;
+    RC rc = RC_OK;
+    while (rc == RC_OK && done < length) {
+        long long pos = offset + done;
+        int pageIndex = (int) (pos / pageSize);
+        int inPage = (int) (pos % pageSize);
+        int run = findRun(lo, pageIndex);
+        int runOffset = pageIndex - lo->runStart[run];
+        int pageNum = lo->runs[run].firstPage + runOffset;
+        if (inPage == 0 && length - done >= pageSize && buffer != NULL) {
+            long long wholePages = (length - done) / pageSize;
+            int numPages = lo->runs[run].numPages - runOffset;
+            if (wholePages < numPages) {
+                numPages = (int) wholePages;
+            }
+            rc = isWrite ? writeBlocks(pageNum, numPages, fHandle, buffer + done)
+                         : readBlocks(pageNum, numPages, fHandle, buffer + done);
+            lo->stats.ioCalls++;
+            lo->stats.pagesTransferred += numPages;
+            done += (long long) numPages * pageSize;
+            continue;
+        }
+        int chunk = pageSize - inPage;
+        if (chunk > length - done) {
+            chunk = (int) (length - done);
+        }
+        if (!isWrite || (chunk < pageSize && (long long) pageIndex * pageSize < dataEnd)) {
+            rc = readBlock(pageNum, fHandle, lo->buffer);
+            lo->stats.ioCalls++;
+            lo->stats.pagesTransferred++;
+        }
+        else {
+            memset(lo->buffer, 0, pageSize);
+        }
+        if (rc == RC_OK && isWrite) {
+            if (buffer != NULL) {
+                memcpy(lo->buffer + inPage, buffer + done, chunk);
+            }
+            else {
+                memset(lo->buffer + inPage, 0, chunk);
+            }
+            rc = writeBlock(pageNum, fHandle, lo->buffer);
+            lo->stats.ioCalls++;
+            lo->stats.pagesTransferred++;
+        }
+        else if (rc == RC_OK) {
+            memcpy(buffer + done, lo->buffer + inPage, chunk);
+        }
+        lo->stats.bytesBuffered += chunk;
+        done += chunk;
+    }
+    return rc;
+}
+
+/**
+ * @brief Writes the object's length and runs to its header page and overflow chain, taking or
+ *        giving back directory pages as the number of runs changed. The header page is written
+ *        last, so it only ever points to a complete chain.
+ */
+static RC saveDirectory(SM_LargeObject *lo)
+{
+    SM_LOStore *store = lo->store;
+    int perPage = runsPerPage(store->fHandle->pageSize);
+    int needed = lo->numRuns > 0 ? (lo->numRuns + perPage - 1) / perPage : 1;
+    RC rc = RC_OK;
+    while (rc == RC_OK && lo->numDirPages < needed) {
+        int pageNum;
+        rc = allocateObjectPage(store->extents, LO_META_OBJECT, &pageNum);
+        if (rc == RC_OK) {
+            rc = appendDirectoryPage(lo, pageNum);
+        }
+    }
+    for (int i = needed - 1; rc == RC_OK && i >= 0; i--) {
+        memset(lo->buffer, 0, store->fHandle->pageSize);
+        LODirectoryPage *page = (LODirectoryPage*) lo->buffer;
+        memcpy(page->magic, i == 0 ? LO_HEADER_MAGIC : LO_DIRECTORY_MAGIC, sizeof(page->magic));
+        page->length = i == 0 ? lo->length : 0;
+        int firstRun = i * perPage;
+        page->numRuns = lo->numRuns - firstRun < perPage ? lo->numRuns - firstRun : perPage;
+        page->nextPage = i + 1 < needed ? lo->dirPages[i + 1] : -1;
+        if (page->numRuns > 0) {
+            memcpy(lo->buffer + sizeof(LODirectoryPage), lo->runs + firstRun, sizeof(LORun) * page->numRuns);
+        }
+        rc = writeBlock(lo->dirPages[i], store->fHandle, lo->buffer);
+    }
+    while (rc == RC_OK && lo->numDirPages > needed) {
+        rc = releaseObjectPage(store->extents, lo->dirPages[--lo->numDirPages]);
+    }
+    if (rc != RC_OK) {
+        printMessage("The directory of large object %d could not be written!\n", lo->loId);
+    }
+    return rc;
+}
+
+/**
+ * @brief Reads an object's header page and overflow chain.
+ */
+static RC loadDirectory(SM_LargeObject *lo)
+{
+    SM_FileHandle *fHandle = lo->store->fHandle;
+    int perPage = runsPerPage(fHandle->pageSize);
+    int pageNum = lo->loId;
+    while (pageNum != -1) {
+        int isHeader = lo->numDirPages == 0;
+        if (pageNum <= 0 || pageNum >= fHandle->totalNumPages || lo->numDirPages >= fHandle->totalNumPages) {
+            return isHeader ? RC_READ_NON_EXISTING_PAGE : RC_PAGE_CORRUPT;
+        }
+        RC rc = readBlock(pageNum, fHandle, lo->buffer);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        LODirectoryPage *page = (LODirectoryPage*) lo->buffer;
+        if (memcmp(page->magic, isHeader ? LO_HEADER_MAGIC : LO_DIRECTORY_MAGIC, sizeof(page->magic)) != 0) {
+            return isHeader ? RC_READ_NON_EXISTING_PAGE : RC_PAGE_CORRUPT;
+        }
+        if (page->numRuns < 0 || page->numRuns > perPage || (isHeader && page->length < 0)) {
+            return RC_PAGE_CORRUPT;
+        }
+        if (isHeader) {
+            lo->length = page->length;
+        }
+        int nextPage = page->nextPage;
+        int numRuns = page->numRuns;
+        rc = appendDirectoryPage(lo, pageNum);
+        for (int i = 0; rc == RC_OK && i < numRuns; i++) {
+            LORun run;
+            memcpy(&run, lo->buffer + sizeof(LODirectoryPage) + sizeof(LORun) * i, sizeof(LORun));
+            if (run.firstPage <= 0 || run.numPages <= 0 || run.firstPage > fHandle->totalNumPages - run.numPages) {
+                return RC_PAGE_CORRUPT;
+            }
+            for (int p = 0; rc == RC_OK && p < run.numPages; p++) {
+                rc = appendPage(lo, run.firstPage + p);
+            }
+        }
+        if (rc != RC_OK) {
+            return rc;
+        }
+        pageNum = nextPage;
+    }
+    return pagesFor(lo, lo->length) == lo->numPages ? RC_OK : RC_PAGE_CORRUPT;
+}
+
+static void freeLargeObject(SM_LargeObject *lo)
+{
+    free(lo->runs);
+    free(lo->runStart);
+    free(lo->dirPages);
+    free(lo->buffer);
+    free(lo);
+}
+
+static SM_LargeObject *newLargeObject(SM_LOStore *store, int loId)
+{
+    SM_LargeObject *lo = (SM_LargeObject*) calloc(1, sizeof(SM_LargeObject));
+    if (lo == NULL) {
+        return NULL;
+    }
+    lo->store = store;
+    lo->loId = loId;
+    lo->buffer = (char*) malloc(store->fHandle->pageSize);
+    if (lo->buffer == NULL) {
+        free(lo);
+        return NULL;
+    }
+    return lo;
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Opens the large objects kept in a page file, turning a new page file (one empty
+ *        page, no extent map) into an empty store. The file must hold nothing else, since the store allocates its pages through
+ *        the file's extent map.
+ *
+ * @param fHandle The open page file. It must stay open while the store is used.
+ * @param extentPages Pages per extent of the file's extent map, 0 for DEFAULT_EXTENT_PAGES.
+ * @param store Receives the store.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the file is used for something else or its extent map is missing.
+ */
+RC openLargeObjectStore(SM_FileHandle *fHandle, int extentPages, SM_LOStore **store)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || store == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (runsPerPage(fHandle->pageSize) < 1) {
+        printMessage("The pages of %s are too small for large objects!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    SM_LOStore *loStore = (SM_LOStore*) calloc(1, sizeof(SM_LOStore));
+    char *page = (char*) malloc(fHandle->pageSize);
+    if (loStore == NULL || page == NULL) {
+        free(loStore);
+        free(page);
+        return RC_WRITE_FAILED;
+    }
+    loStore->fHandle = fHandle;
+    RC rc = openExtentMap(fHandle, extentPages, &loStore->extents);
+    SM_ExtentStats stats;
+    if (rc == RC_OK) {
+        rc = getExtentStats(loStore->extents, &stats);
+    }
+    if (rc == RC_OK) {
+        rc = readBlock(0, fHandle, page);
+    }
+    int isStore = rc == RC_OK && memcmp(page, LO_STORE_MAGIC, strlen(LO_STORE_MAGIC)) == 0;
+    if (rc == RC_OK && stats.usedPages == 0 && !isStore && fHandle->totalNumPages == 1) {
+        // A new page file: page 0 is the first page the extent map hands out.
+        int pageNum;
+        rc = allocateObjectPage(loStore->extents, LO_META_OBJECT, &pageNum);
+        if (rc == RC_OK && pageNum != 0) {
+            rc = RC_WRITE_FAILED;
+        }
+        if (rc == RC_OK) {
+            memset(page, 0, fHandle->pageSize);
+            memcpy(page, LO_STORE_MAGIC, strlen(LO_STORE_MAGIC));
+            rc = writeBlock(0, fHandle, page);
+        }
+    }
+    else if (rc == RC_OK && (stats.usedPages == 0 || !isStore)) {
+        // Pages in use without a store, or a store whose extent map was lost
+        rc = RC_WRITE_FAILED;
+    }
+    free(page);
+    if (rc != RC_OK) {
+        printMessage("%s could not be opened as a large object store!\n", fHandle->fileName);
+        if (loStore->extents != NULL) {
+            closeExtentMap(loStore->extents);
+        }
+        free(loStore);
+        return rc;
+    }
+    *store = loStore;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Saves the store's extent map and frees the store. Objects of the store must be
+ *        closed first.
+ *
+ * @param store The store returned by openLargeObjectStore.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the store is NULL.
+ *         RC_WRITE_FAILED if the extent map could not be written.
+ */
+RC closeLargeObjectStore(SM_LOStore *store)
+{
+    if (store == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RC rc = closeExtentMap(store->extents);
+    free(store);
+    return rc;
+}
+
+
+/**
+ * @brief Creates an empty large object.
+ *
+ * @param store The store returned by openLargeObjectStore.
+ * @param loId Receives the id the object is opened with.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the store is NULL.
+ *         RC_WRITE_FAILED if the header page could not be allocated or written.
+ */
+RC loCreate(SM_LOStore *store, int *loId)
+{
+    if (store == NULL || loId == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    int pageNum;
+    RC rc = allocateObjectPage(store->extents, LO_META_OBJECT, &pageNum);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    SM_LargeObject *lo = newLargeObject(store, pageNum);
+    rc = lo == NULL ? RC_WRITE_FAILED : appendDirectoryPage(lo, pageNum);
+    if (rc == RC_OK) {
+        rc = saveDirectory(lo);
+    }
+    if (lo != NULL) {
+        freeLargeObject(lo);
+    }
+    if (rc != RC_OK) {
+        releaseObjectPage(store->extents, pageNum);
+        return rc;
+    }
+    *loId = pageNum;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Opens a large object, reading its list of data pages. Only the list is kept in memory.
+ *
+ * @param store The store returned by openLargeObjectStore.
+ * @param loId The id returned by loCreate.
+ * @param lo Receives the open object.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the store is NULL.
+ *         RC_READ_NON_EXISTING_PAGE if there is no object with that id.
+ *         RC_PAGE_CORRUPT if the object's directory pages are damaged.
+ */
+RC loOpen(SM_LOStore *store, int loId, SM_LargeObject **lo)
+{
+    if (store == NULL || lo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_LargeObject *object = newLargeObject(store, loId);
+    if (object == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = loadDirectory(object);
+    if (rc != RC_OK) {
+        printMessage("Large object %d could not be opened!\n", loId);
+        freeLargeObject(object);
+        return rc;
+    }
+    *lo = object;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Closes a large object. Its data and directory were written by the calls that changed them.
+ *
+ * @param lo The object returned by loOpen.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the object is NULL.
+ */
+RC loClose(SM_LargeObject *lo)
+{
+    if (lo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    freeLargeObject(lo);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Deletes a large object, giving its extents and directory pages back to the store.
+ *        The object must not be open.
+ *
+ * @param store The store returned by openLargeObjectStore.
+ * @param loId The object to delete.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the store is NULL.
+ *         RC_READ_NON_EXISTING_PAGE if there is no object with that id.
+ */
+RC loDelete(SM_LOStore *store, int loId)
+{
+    SM_LargeObject *lo;
+    RC rc = loOpen(store, loId, &lo);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    // Clearing the header first leaves no object behind if the rest is interrupted.
+    memset(lo->buffer, 0, store->fHandle->pageSize);
+    rc = writeBlock(loId, store->fHandle, lo->buffer);
+    if (rc == RC_OK) {
+        rc = releaseObject(store->extents, loId);
+    }
+    for (int i = 0; rc == RC_OK && i < lo->numDirPages; i++) {
+        rc = releaseObjectPage(store->extents, lo->dirPages[i]);
+    }
+    freeLargeObject(lo);
+    return rc;
+}
+
+
+/**
+ * @brief Reads a byte range of a large object into a buffer. Whole pages of the range are
+ *        read into the buffer directly, with one call per run of adjacent pages.
+ *
+ * @param lo The object returned by loOpen.
+ * @param offset The first byte to read.
+ * @param length Bytes to read.
+ * @param buffer Receives the bytes; at least length bytes long.
+ * @param bytesRead Receives the bytes read, fewer than length at the end of the object and
+ *        0 at or past it.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the object or buffer is NULL.
+ *         RC_READ_NON_EXISTING_PAGE if offset or length is negative.
+ */
+RC loRead(SM_LargeObject *lo, long long offset, int length, char *buffer, int *bytesRead)
+{
+    if (lo == NULL || buffer == NULL || bytesRead == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (offset < 0 || length < 0) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    int available = 0;
+    if (offset < lo->length) {
+        available = lo->length - offset < length ? (int) (lo->length - offset) : length;
+    }
+    RC rc = transferData(lo, offset, available, buffer, 0, lo->length);
+    if (rc != RC_OK) {
+        printMessage("Large object %d could not be read!\n", lo->loId);
+        return rc;
+    }
+    *bytesRead = available;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Writes a byte range of a large object, growing it if the range ends past its end.
+ *        Whole pages are written from the caller's data directly; a gap between the old end
+ *        and offset reads as zeros.
+ *
+ * @param lo The object returned by loOpen.
+ * @param offset The first byte to write.
+ * @param length Bytes to write.
+ * @param data The bytes.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the object or data is NULL.
+ *         RC_WRITE_FAILED if offset or length is negative or the object could not grow.
+ */
+RC loWrite(SM_LargeObject *lo, long long offset, int length, char *data)
+{
+    if (lo == NULL || data == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (offset < 0 || length < 0 || offset > LLONG_MAX - length) {
+        return RC_WRITE_FAILED;
+    }
+    if (length == 0) {
+        return RC_OK;
+    }
+    long long dataEnd = lo->length;
+    long long end = offset + length;
+    RC rc = growPages(lo, pagesFor(lo, end));
+    if (rc == RC_OK && offset > dataEnd) {
+        rc = transferData(lo, dataEnd, offset - dataEnd, NULL, 1, dataEnd);
+    }
+    if (rc == RC_OK) {
+        rc = transferData(lo, offset, length, data, 1, dataEnd);
+    }
+    if (rc == RC_OK && end > lo->length) {
+        lo->length = end;
+        rc = saveDirectory(lo);
+        if (rc != RC_OK) {
+            lo->length = dataEnd;
+        }
+    }
+    if (rc != RC_OK) {
+        printMessage("Large object %d could not be written!\n", lo->loId);
+        trimPages(lo, (int) pagesFor(lo, lo->length));
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Changes the length of a large object. Pages past the new end are given back; an
+ *        object that grows reads as zeros past its old end.
+ *
+ * @param lo The object returned by loOpen.
+ * @param length The new length.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the object is NULL.
+ *         RC_WRITE_FAILED if length is negative or the object could not be changed.
+ */
+RC loTruncate(SM_LargeObject *lo, long long length)
+{
+    if (lo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (length < 0) {
+        return RC_WRITE_FAILED;
+    }
+    long long oldLength = lo->length;
+    RC rc = RC_OK;
+    if (length > oldLength) {
+        rc = growPages(lo, pagesFor(lo, length));
+        if (rc == RC_OK) {
+            rc = transferData(lo, oldLength, length - oldLength, NULL, 1, oldLength);
+        }
+    }
+    else {
+        rc = trimPages(lo, (int) pagesFor(lo, length));
+    }
+    if (rc == RC_OK && length != oldLength) {
+        lo->length = length;
+        rc = saveDirectory(lo);
+    }
+    if (rc != RC_OK && length > oldLength) {
+        lo->length = oldLength;
+        trimPages(lo, (int) pagesFor(lo, oldLength));
+    }
+    if (rc != RC_OK) {
+        printMessage("Large object %d could not be truncated!\n", lo->loId);
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Reports the size and layout of a large object and the page I/O made through it.
+ *
+ * @param lo The object returned by loOpen.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the object is NULL.
+ */
+RC getLargeObjectStats(SM_LargeObject *lo, SM_LOStats *stats)
+{
+    if (lo == NULL || stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    *stats = lo->stats;
+    stats->length = lo->length;
+    stats->numPages = lo->numPages;
+    stats->numRuns = lo->numRuns;
+    stats->directoryPages = lo->numDirPages;
+    return RC_OK;
+}
@@ -0,0 +1,57 @@
+#ifndef LARGE_OBJECT_H
+#define LARGE_OBJECT_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    large object constants                *
+ ************************************************************/
+#define LO_STORE_MAGIC "SMLOSTOR"
+#define LO_HEADER_MAGIC "SMLOBJ01"
+#define LO_DIRECTORY_MAGIC "SMLODIR1"
+
+/* Large objects live in a page file of their own. Page 0 identifies the file as a large
+ * object store; each object has a header page whose number is its id, followed by a chain
+ * of directory pages when its page runs do not fit on the header page. The data pages come
+ * from extents owned by the object and hold nothing but data. */
+typedef struct SM_LOStore SM_LOStore;
+
+/* an open large object; one handle per object at a time */
+typedef struct SM_LargeObject SM_LargeObject;
+
+typedef struct SM_LOStats {
+	long long length;
+	int numPages;             /* data pages */
+	int numRuns;              /* runs of adjacent data pages */
+	int directoryPages;       /* the header page and its overflow chain */
+	long ioCalls;             /* page file calls made for data */
+	long long pagesTransferred;
+	long long bytesBuffered;  /* data copied through the page buffer at unaligned edges */
+} SM_LOStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC openLargeObjectStore (SM_FileHandle *fHandle, int extentPages, SM_LOStore **store);
+extern RC closeLargeObjectStore (SM_LOStore *store);
+
+extern RC loCreate (SM_LOStore *store, int *loId);
+extern RC loOpen (SM_LOStore *store, int loId, SM_LargeObject **lo);
+extern RC loClose (SM_LargeObject *lo);
+extern RC loDelete (SM_LOStore *store, int loId);
+
+extern RC loRead (SM_LargeObject *lo, long long offset, int length, char *buffer, int *bytesRead);
+extern RC loWrite (SM_LargeObject *lo, long long offset, int length, char *data);
+extern RC loTruncate (SM_LargeObject *lo, long long length);
+extern RC getLargeObjectStats (SM_LargeObject *lo, SM_LOStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
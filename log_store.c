@@ -0,0 +1,1128 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "log_store.h"
+#include "page_kernels.h"
+
+/*
+ * A log-structured page file never overwrites a page in place. Every writeBlock appends a new
+ * version of the page to the active segment, and an indirection table maps logical page numbers
+ * to the slot holding their newest version. Layout of the log file:
+ *
+ *   superblock (LOG_SUPERBLOCK_SIZE) | slot 0 | slot 1 | ...
+ *   slot = LogSlotHeader (LOG_SLOT_HEADER_SIZE) + one page
+ *
+ * Slots are grouped into segments of LOG_SEGMENT_SLOTS. A segment without live versions is
+ * reused; the garbage collector empties segments with few live versions by relocating them.
+ * An emptied segment is only reused once a checkpoint taken after it was emptied is durable:
+ * until then the checkpoint on disk may still point into it, and recovery would read whatever
+ * overwrote those slots. Recovery checks the slot header of every version the checkpoint
+ * names in the segments it scans and refuses to open a file whose table points at a slot
+ * holding another version.
+ * The table is persisted in a checkpoint file next to the log. After an unclean shutdown the
+ * slots newer than the checkpoint are found by their sequence numbers and replayed.
+ *
+ * Checkpoints are fuzzy: the table is copied under the lock, and the log sync and the write of
+ * the checkpoint file happen while writers go on appending. So that recovery does not have to
+ * read the whole log, every segment opened for appending is recorded in a small journal in the
+ * superblock, tagged with the epoch of the checkpoint it follows. Recovery only scans the
+ * segment that was active when the checkpoint was taken and the segments journaled since;
+ * no other segment was written after the checkpoint, so only there can a checkpointed version
+ * have been overwritten. The journal has two halves used by alternate epochs, so starting a
+ * new epoch drops the entries of the epoch before the last durable checkpoint. If a half fills
+ * up, its last entry marks an overflow, and if the journal holds epochs later than the
+ * checkpoint can explain, the checkpoint is older than the log; either way recovery falls back
+ * to scanning every slot.
+ *
+ * Appended pages have no version in the log until they are first written, so replaying the
+ * log cannot find them. Every extension writes the new page count into the superblock, and
+ * recovery keeps at least that many pages; the log never shrinks, so the larger count is right.
+ */
+
+#define LOG_SUPER_MAGIC "SMLOGSTR"
+#define LOG_CHECKPOINT_MAGIC "SMLOGCK2"
+#define LOG_SLOT_MAGIC 0x534c4f54u
+/* where the segment journal starts in the superblock, and the entries of one half */
+#define LOG_JOURNAL_OFFSET 64
+#define LOG_JOURNAL_ENTRIES ((LOG_SUPERBLOCK_SIZE - LOG_JOURNAL_OFFSET) / (2 * (int) sizeof(LogJournalEntry)))
+/* journal entry that marks a full half */
+#define LOG_JOURNAL_OVERFLOW -1
+/* states of a segment without live versions in LogFile.segmentFree */
+#define LOG_SEGMENT_FREE 1
+#define LOG_SEGMENT_RELEASED 2
+
+typedef struct LogSuperblock {
+    char magic[8];
+    int32_t pageSize;
+    int32_t segmentSlots;
+    /* page count after the last extension; 0 in files that were never extended */
+    int32_t numPages;
+} LogSuperblock;
+
+typedef struct LogSlotHeader {
+    uint32_t magic;
+    int32_t pageNum;
+    uint64_t seq;
+    uint64_t checksum;
+    uint64_t reserved;
+} LogSlotHeader;
+
+typedef struct LogCheckpointHeader {
+    char magic[8];
+    int32_t pageSize;
+    int32_t numPages;
+    int32_t clean;
+    int32_t activeSegment;
+    uint64_t seq;
+    uint32_t epoch;
+    int32_t reserved;
+} LogCheckpointHeader;
+
+/* a segment opened for appending after the checkpoint of the given epoch */
+typedef struct LogJournalEntry {
+    uint32_t epoch;
+    int32_t segment;
+} LogJournalEntry;
+
+typedef struct LogFile {
+    int fd;
+    char *path;
+    char *checkpointPath;
+    int pageSize;
+    off_t slotSize;
+    /* logical page -> slot of its newest version, -1 if it was never written (reads as zeros) */
+    int numPages;
+    int64_t *table;
+    int tableCapacity;
+    /* the page count in the superblock when the file was opened */
+    int extendedPages;
+    /* per segment: live versions and whether it is free or waiting for a checkpoint */
+    int numSegments;
+    int segmentCapacity;
+    int *liveCount;
+    char *segmentFree;
+    int *freeSegments;
+    int numFree;
+    /* emptied segments the checkpoint on disk may still point into, oldest first */
+    int *releasedSegments;
+    int numReleased;
+    /* per slot: the logical page whose live version it holds, or -1 */
+    int *slotOwner;
+    int activeSegment;
+    int activeNext;
+    uint64_t seq;
+    long pageWrites;
+    long gcRuns;
+    long pagesRelocated;
+    char *ioBuffer;
+    /* epoch of the newest checkpoint and the entries journaled in it, LOG_JOURNAL_ENTRIES after
+     * an overflow; while that checkpoint is not durable, the entries of the epoch before count too */
+    uint32_t epoch;
+    int journalNext;
+    int journalPrevious;
+    int checkpointPending;
+    uint64_t checkpointSeq;
+    int64_t lastRecoverySlots;
+    double lastRecoveryMs;
+    pthread_mutex_t lock;
+    /* serializes checkpoints, which run without the lock for most of their time */
+    pthread_mutex_t checkpointLock;
+    /* background garbage collector */
+    pthread_t gcThread;
+    pthread_cond_t gcCond;
+    /* guarded by lock, like gcStop */
+    int gcRunning;
+    int gcStop;
+    int gcIntervalMs;
+    double gcMaxLiveRatio;
+} LogFile;
+
+
+/**
+ * @brief Strips the backend prefix from a page file name.
+ */
+static char *logPath(char *fileName)
+{
+    return fileName + strlen(LOG_STORE_PREFIX);
+}
+
+/**
+ * @brief Builds the name of the checkpoint file belonging to a log file.
+ */
+static char *makeCheckpointPath(char *path)
+{
+    char *checkpointPath = (char*) malloc(strlen(path) + strlen(LOG_CHECKPOINT_SUFFIX) + 1);
+    if (checkpointPath != NULL) {
+        strcpy(checkpointPath, path);
+        strcat(checkpointPath, LOG_CHECKPOINT_SUFFIX);
+    }
+    return checkpointPath;
+}
+
+static off_t slotOffset(LogFile *file, int64_t slot)
+{
+    return LOG_SUPERBLOCK_SIZE + (off_t) slot * file->slotSize;
+}
+
+/**
+ * @brief Makes room for at least numPages entries in the indirection table.
+ */
+static RC ensureTable(LogFile *file, int numPages)
+{
+    if (numPages <= file->tableCapacity) {
+        return RC_OK;
+    }
+    int newCapacity = file->tableCapacity > 0 ? file->tableCapacity : 16;
+    while (newCapacity < numPages) {
+        newCapacity *= 2;
+    }
+    int64_t *grown = (int64_t*) realloc(file->table, sizeof(int64_t) * newCapacity);
+    if (grown == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    for (int i = file->tableCapacity; i < newCapacity; i++) {
+        grown[i] = -1;
+    }
+    file->table = grown;
+    file->tableCapacity = newCapacity;
+    return RC_OK;
+}
+
+/**
+ * @brief Makes room for at least numSegments segments in the per-segment and per-slot arrays.
+ */
+static RC ensureSegments(LogFile *file, int numSegments)
+{
+    if (numSegments <= file->segmentCapacity) {
+        return RC_OK;
+    }
+    int newCapacity = file->segmentCapacity > 0 ? file->segmentCapacity : 16;
+    while (newCapacity < numSegments) {
+        newCapacity *= 2;
+    }
+    int *liveCount = (int*) realloc(file->liveCount, sizeof(int) * newCapacity);
+    if (liveCount != NULL) {
+        file->liveCount = liveCount;
+    }
+    char *segmentFree = (char*) realloc(file->segmentFree, (size_t) newCapacity);
+    if (segmentFree != NULL) {
+        file->segmentFree = segmentFree;
+    }
+    int *freeSegments = (int*) realloc(file->freeSegments, sizeof(int) * newCapacity);
+    if (freeSegments != NULL) {
+        file->freeSegments = freeSegments;
+    }
+    int *releasedSegments = (int*) realloc(file->releasedSegments, sizeof(int) * newCapacity);
+    if (releasedSegments != NULL) {
+        file->releasedSegments = releasedSegments;
+    }
+    int *slotOwner = (int*) realloc(file->slotOwner, sizeof(int) * newCapacity * LOG_SEGMENT_SLOTS);
+    if (slotOwner != NULL) {
+        file->slotOwner = slotOwner;
+    }
+    if (liveCount == NULL || segmentFree == NULL || freeSegments == NULL || releasedSegments == NULL
+        || slotOwner == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    for (int i = file->segmentCapacity; i < newCapacity; i++) {
+        file->liveCount[i] = 0;
+        file->segmentFree[i] = 0;
+    }
+    for (int i = file->segmentCapacity * LOG_SEGMENT_SLOTS; i < newCapacity * LOG_SEGMENT_SLOTS; i++) {
+        file->slotOwner[i] = -1;
+    }
+    file->segmentCapacity = newCapacity;
+    return RC_OK;
+}
+
+/**
+ * @brief Sets a segment without live versions aside for reuse, unless it is being filled.
+ *        It goes on the free list once the next checkpoint is durable.
+ */
+static void releaseSegmentIfEmpty(LogFile *file, int segment)
+{
+    if (file->liveCount[segment] == 0 && !file->segmentFree[segment] && segment != file->activeSegment) {
+        file->segmentFree[segment] = LOG_SEGMENT_RELEASED;
+        file->releasedSegments[file->numReleased++] = segment;
+    }
+}
+
+/**
+ * @brief Moves the first count released segments to the free list. Called when a checkpoint
+ *        copied after they were released is durable, so nothing on disk points into them.
+ */
+static void freeReleasedSegments(LogFile *file, int count)
+{
+    if (count == 0) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        int segment = file->releasedSegments[i];
+        file->segmentFree[segment] = LOG_SEGMENT_FREE;
+        file->freeSegments[file->numFree++] = segment;
+    }
+    memmove(file->releasedSegments, file->releasedSegments + count, sizeof(int) * (size_t) (file->numReleased - count));
+    file->numReleased -= count;
+}
+
+static off_t journalOffset(uint32_t epoch, int entry)
+{
+    return LOG_JOURNAL_OFFSET + (off_t) ((epoch % 2) * LOG_JOURNAL_ENTRIES + entry) * (off_t) sizeof(LogJournalEntry);
+}
+
+/**
+ * @brief Records in the journal that a segment is opened for appending in the current epoch.
+ *        The last entry of a half records an overflow instead.
+ */
+static RC journalSegment(LogFile *file, int segment)
+{
+    if (file->journalNext >= LOG_JOURNAL_ENTRIES) {
+        return RC_OK;
+    }
+    LogJournalEntry entry;
+    entry.epoch = file->epoch;
+    entry.segment = file->journalNext == LOG_JOURNAL_ENTRIES - 1 ? LOG_JOURNAL_OVERFLOW : segment;
+    if (pwrite(file->fd, &entry, sizeof(entry), journalOffset(file->epoch, file->journalNext)) != (ssize_t) sizeof(entry)) {
+        return RC_WRITE_FAILED;
+    }
+    file->journalNext++;
+    return RC_OK;
+}
+
+/**
+ * @brief Picks the slot the next page version is appended to, opening a new segment when the
+ *        active one is full. Free segments are reused before the file grows.
+ */
+static RC allocateSlot(LogFile *file, int64_t *slot)
+{
+    if (file->activeSegment == -1 || file->activeNext == LOG_SEGMENT_SLOTS) {
+        int previous = file->activeSegment;
+        int segment = file->numFree > 0 ? file->freeSegments[file->numFree - 1] : file->numSegments;
+        if ((file->numFree == 0 && ensureSegments(file, file->numSegments + 1) != RC_OK)
+            || journalSegment(file, segment) != RC_OK) {
+            return RC_WRITE_FAILED;
+        }
+        if (file->numFree > 0) {
+            file->numFree--;
+            file->segmentFree[segment] = 0;
+        }
+        else {
+            file->numSegments++;
+        }
+        file->activeSegment = segment;
+        file->activeNext = 0;
+        if (previous != -1) {
+            releaseSegmentIfEmpty(file, previous);
+        }
+    }
+    *slot = (int64_t) file->activeSegment * LOG_SEGMENT_SLOTS + file->activeNext++;
+    return RC_OK;
+}
+
+/**
+ * @brief Appends a new version of a page to the log and points the table at it.
+ *        Must be called with the file's lock held.
+ */
+static RC appendVersion(LogFile *file, int pageNum, const char *data)
+{
+    int64_t slot;
+    if (allocateSlot(file, &slot) != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    LogSlotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LOG_SLOT_MAGIC;
+    header.pageNum = pageNum;
+    header.seq = ++file->seq;
+    header.checksum = pageChecksum(data, file->pageSize);
+    memcpy(file->ioBuffer, &header, sizeof(header));
+    memset(file->ioBuffer + sizeof(header), 0, LOG_SLOT_HEADER_SIZE - sizeof(header));
+    if (file->ioBuffer + LOG_SLOT_HEADER_SIZE != data) {
+        memcpy(file->ioBuffer + LOG_SLOT_HEADER_SIZE, data, (size_t) file->pageSize);
+    }
+    if (pwrite(file->fd, file->ioBuffer, (size_t) file->slotSize, slotOffset(file, slot)) != file->slotSize) {
+        return RC_WRITE_FAILED;
+    }
+    int64_t old = file->table[pageNum];
+    if (old >= 0) {
+        file->slotOwner[old] = -1;
+        file->liveCount[old / LOG_SEGMENT_SLOTS]--;
+        releaseSegmentIfEmpty(file, (int) (old / LOG_SEGMENT_SLOTS));
+    }
+    file->table[pageNum] = slot;
+    file->slotOwner[slot] = pageNum;
+    file->liveCount[slot / LOG_SEGMENT_SLOTS]++;
+    file->pageWrites++;
+    return RC_OK;
+}
+
+/**
+ * @brief Writes a checkpoint to a temporary file and renames it over the old one.
+ */
+static RC storeCheckpoint(char *checkpointPath, LogCheckpointHeader *header, const int64_t *table)
+{
+    size_t tableBytes = sizeof(int64_t) * (size_t) header->numPages;
+    char *tmpPath = (char*) malloc(strlen(checkpointPath) + 5);
+    if (tmpPath == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    sprintf(tmpPath, "%s.tmp", checkpointPath);
+    RC rc = RC_OK;
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1
+        || write(fd, header, sizeof(*header)) != (ssize_t) sizeof(*header)
+        || (tableBytes > 0 && write(fd, table, tableBytes) != (ssize_t) tableBytes)
+        || fsync(fd) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (fd != -1 && close(fd) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK && rename(tmpPath, checkpointPath) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(tmpPath);
+    return rc;
+}
+
+/**
+ * @brief Takes a fuzzy checkpoint. The table is copied and a new journal epoch is started under
+ *        the lock; the log is synced and the copy written after the lock is released, so
+ *        writers only wait for the copy. Syncing after the copy means the checkpoint never
+ *        points at versions that are not on disk yet. Until the checkpoint is durable the
+ *        journal entries of the epoch before are kept; after a failed checkpoint the next one
+ *        stays in the same epoch for that reason. Segments released before the copy become
+ *        free once the checkpoint is durable.
+ */
+static RC writeCheckpoint(LogFile *file, int clean)
+{
+    pthread_mutex_lock(&file->checkpointLock);
+    pthread_mutex_lock(&file->lock);
+    LogCheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LOG_CHECKPOINT_MAGIC, sizeof(header.magic));
+    if (!file->checkpointPending) {
+        file->epoch++;
+        file->journalPrevious = file->journalNext;
+        file->journalNext = 0;
+        file->checkpointPending = 1;
+    }
+    header.pageSize = file->pageSize;
+    header.numPages = file->numPages;
+    header.clean = clean;
+    header.activeSegment = file->activeSegment;
+    header.seq = file->seq;
+    header.epoch = file->epoch;
+    int released = file->numReleased;
+    size_t tableBytes = sizeof(int64_t) * (size_t) file->numPages;
+    int64_t *table = (int64_t*) malloc(tableBytes > 0 ? tableBytes : 1);
+    if (table != NULL) {
+        memcpy(table, file->table, tableBytes);
+    }
+    pthread_mutex_unlock(&file->lock);
+
+    RC rc = table == NULL || fdatasync(file->fd) != 0 ? RC_WRITE_FAILED
+        : storeCheckpoint(file->checkpointPath, &header, table);
+    free(table);
+
+    pthread_mutex_lock(&file->lock);
+    if (rc == RC_OK) {
+        file->checkpointPending = 0;
+        file->journalPrevious = 0;
+        file->checkpointSeq = header.seq;
+        freeReleasedSegments(file, released);
+    }
+    pthread_mutex_unlock(&file->lock);
+    pthread_mutex_unlock(&file->checkpointLock);
+    return rc;
+}
+
+/**
+ * @brief Marks the segments recovery has to scan: the one active at the checkpoint and those
+ *        journaled in its epoch or the one after. Returns non-zero if the journal overflowed,
+ *        or holds epochs later than that so the checkpoint is older than the log, and every
+ *        slot has to be scanned.
+ */
+static int markJournaledSegments(LogFile *file, LogCheckpointHeader *header, char *scan, int numSegments)
+{
+    LogJournalEntry entries[2 * LOG_JOURNAL_ENTRIES];
+    if (pread(file->fd, entries, sizeof(entries), LOG_JOURNAL_OFFSET) != (ssize_t) sizeof(entries)) {
+        return 1;
+    }
+    if (header->activeSegment >= 0 && header->activeSegment < numSegments) {
+        scan[header->activeSegment] = 1;
+    }
+    for (int i = 0; i < 2 * LOG_JOURNAL_ENTRIES; i++) {
+        if (entries[i].epoch > header->epoch + 1) {
+            return 1;
+        }
+        if (entries[i].epoch != header->epoch && entries[i].epoch != header->epoch + 1) {
+            continue;
+        }
+        if (entries[i].segment == LOG_JOURNAL_OVERFLOW) {
+            return 1;
+        }
+        if (entries[i].segment >= 0 && entries[i].segment < numSegments) {
+            scan[entries[i].segment] = 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Loads the checkpoint file, then replays slots newer than the checkpoint if the file was
+ *        not closed cleanly, and rebuilds the segment bookkeeping from the resulting table.
+ *        Only the segments the journal names are read unless there is no usable checkpoint.
+ *        Those are the only segments appended to since the checkpoint, so while they are read
+ *        every slot the checkpoint names in them is checked to still hold its version.
+ *
+ * @return RC_OK if successful.
+ *         RC_PAGE_CORRUPT if the checkpoint points at a slot that was reused for another version.
+ */
+static RC recoverLogFile(LogFile *file)
+{
+    LogCheckpointHeader header;
+    int clean = 0, haveCheckpoint = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(&header, 0, sizeof(header));
+    FILE *checkpoint = fopen(file->checkpointPath, "rb");
+    if (checkpoint != NULL) {
+        if (fread(&header, sizeof(header), 1, checkpoint) == 1
+            && memcmp(header.magic, LOG_CHECKPOINT_MAGIC, sizeof(header.magic)) == 0
+            && header.pageSize == file->pageSize && header.numPages >= 0
+            && ensureTable(file, header.numPages) == RC_OK
+            && fread(file->table, sizeof(int64_t), (size_t) header.numPages, checkpoint) == (size_t) header.numPages) {
+            file->numPages = header.numPages;
+            file->seq = header.seq;
+            file->epoch = header.epoch;
+            clean = header.clean;
+            haveCheckpoint = 1;
+        }
+        else {
+            memset(&header, 0, sizeof(header));
+        }
+        fclose(checkpoint);
+    }
+
+    struct stat st;
+    if (fstat(file->fd, &st) != 0) {
+        return RC_FILE_NOT_FOUND;
+    }
+    int64_t numSlots = st.st_size > LOG_SUPERBLOCK_SIZE ? (st.st_size - LOG_SUPERBLOCK_SIZE) / file->slotSize : 0;
+    int numSegments = (int) ((numSlots + LOG_SEGMENT_SLOTS - 1) / LOG_SEGMENT_SLOTS);
+    if (ensureSegments(file, numSegments) != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    file->numSegments = numSegments;
+
+    if (!clean) {
+        // Replay every intact slot written after the checkpoint; the newest version of a page wins.
+        uint64_t *bestSeq = NULL;
+        int bestCapacity = 0;
+        int checkpointPages = file->numPages;
+        char *scan = (char*) calloc((size_t) numSegments + 1, 1);
+        char *lost = (char*) calloc((size_t) checkpointPages + 1, 1);
+        if (scan == NULL || lost == NULL) {
+            free(scan);
+            free(lost);
+            return RC_WRITE_FAILED;
+        }
+        for (int pageNum = 0; pageNum < checkpointPages; pageNum++) {
+            int64_t slot = file->table[pageNum];
+            if (slot >= 0 && slot < numSlots) {
+                file->slotOwner[slot] = pageNum;
+            }
+        }
+        int fullScan = !haveCheckpoint || markJournaledSegments(file, &header, scan, numSegments);
+        for (int64_t slot = 0; slot < numSlots; slot++) {
+            LogSlotHeader slotHeader;
+            if (!fullScan && !scan[slot / LOG_SEGMENT_SLOTS]) {
+                slot += LOG_SEGMENT_SLOTS - 1 - slot % LOG_SEGMENT_SLOTS;
+                continue;
+            }
+            file->lastRecoverySlots++;
+            int intact = pread(file->fd, &slotHeader, sizeof(slotHeader), slotOffset(file, slot)) == (ssize_t) sizeof(slotHeader)
+                && slotHeader.magic == LOG_SLOT_MAGIC;
+            // A version the checkpoint names is lost if its slot now holds anything newer, which
+            // only happens when the checkpoint is older than the one the log was written after.
+            int owner = file->slotOwner[slot];
+            if (owner >= 0 && (!intact || slotHeader.pageNum != owner || slotHeader.seq > header.seq)) {
+                lost[owner] = 1;
+            }
+            if (!intact || slotHeader.seq <= header.seq || slotHeader.pageNum < 0) {
+                continue;
+            }
+            if (pread(file->fd, file->ioBuffer, (size_t) file->pageSize, slotOffset(file, slot) + LOG_SLOT_HEADER_SIZE) != file->pageSize
+                || pageChecksum(file->ioBuffer, file->pageSize) != slotHeader.checksum) {
+                continue;
+            }
+            int pageNum = slotHeader.pageNum;
+            if (ensureTable(file, pageNum + 1) != RC_OK) {
+                free(bestSeq);
+                free(scan);
+                free(lost);
+                return RC_WRITE_FAILED;
+            }
+            if (pageNum >= bestCapacity) {
+                int newCapacity = bestCapacity > 0 ? bestCapacity : 16;
+                while (newCapacity <= pageNum) {
+                    newCapacity *= 2;
+                }
+                uint64_t *grown = (uint64_t*) realloc(bestSeq, sizeof(uint64_t) * newCapacity);
+                if (grown == NULL) {
+                    free(bestSeq);
+                    free(scan);
+                    free(lost);
+                    return RC_WRITE_FAILED;
+                }
+                memset(grown + bestCapacity, 0, sizeof(uint64_t) * (newCapacity - bestCapacity));
+                bestSeq = grown;
+                bestCapacity = newCapacity;
+            }
+            if (slotHeader.seq > bestSeq[pageNum]) {
+                bestSeq[pageNum] = slotHeader.seq;
+                file->table[pageNum] = slot;
+                if (pageNum >= file->numPages) {
+                    file->numPages = pageNum + 1;
+                }
+            }
+            if (slotHeader.seq > file->seq) {
+                file->seq = slotHeader.seq;
+            }
+        }
+        RC rc = RC_OK;
+        for (int pageNum = 0; pageNum < checkpointPages && rc == RC_OK; pageNum++) {
+            if (lost[pageNum]) {
+                printMessage("The checkpoint of %s maps page %d to log slot %lld, which was reused after the checkpoint.\n",
+                             file->path, pageNum, (long long) file->table[pageNum]);
+                rc = RC_PAGE_CORRUPT;
+            }
+        }
+        for (int64_t slot = 0; slot < numSlots; slot++) {
+            file->slotOwner[slot] = -1;
+        }
+        free(bestSeq);
+        free(scan);
+        free(lost);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+
+    // Pages appended after the checkpoint and never written are only known from the superblock.
+    if (file->extendedPages > file->numPages) {
+        if (ensureTable(file, file->extendedPages) != RC_OK) {
+            return RC_WRITE_FAILED;
+        }
+        file->numPages = file->extendedPages;
+    }
+    for (int pageNum = 0; pageNum < file->numPages; pageNum++) {
+        int64_t slot = file->table[pageNum];
+        if (slot >= 0 && slot < numSlots) {
+            file->slotOwner[slot] = pageNum;
+            file->liveCount[slot / LOG_SEGMENT_SLOTS]++;
+        }
+        else {
+            file->table[pageNum] = -1;
+        }
+    }
+    for (int segment = 0; segment < file->numSegments; segment++) {
+        releaseSegmentIfEmpty(file, segment);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    file->lastRecoveryMs = (double) (end.tv_sec - start.tv_sec) * 1e3 + (double) (end.tv_nsec - start.tv_nsec) / 1e6;
+    return RC_OK;
+}
+
+/**
+ * @brief Relocates the live versions out of segments whose live ratio is at most maxLiveRatio.
+ *        Must be called with the file's lock held.
+ *
+ * @param maxSegments Upper bound on the number of segments to empty, or -1 for no bound.
+ */
+static RC collectGarbageLocked(LogFile *file, double maxLiveRatio, int maxSegments, int *segmentsFreed)
+{
+    int freed = 0;
+    int numSegments = file->numSegments;
+    RC rc = RC_OK;
+    for (int segment = 0; segment < numSegments && rc == RC_OK; segment++) {
+        if (maxSegments >= 0 && freed >= maxSegments) {
+            break;
+        }
+        if (file->segmentFree[segment] || segment == file->activeSegment
+            || file->liveCount[segment] > maxLiveRatio * LOG_SEGMENT_SLOTS) {
+            continue;
+        }
+        // Copy each live version to the log tail; appendVersion frees the segment with the last one.
+        for (int i = 0; i < LOG_SEGMENT_SLOTS && rc == RC_OK; i++) {
+            int64_t slot = (int64_t) segment * LOG_SEGMENT_SLOTS + i;
+            int pageNum = file->slotOwner[slot];
+            if (pageNum < 0) {
+                continue;
+            }
+            char *data = file->ioBuffer + LOG_SLOT_HEADER_SIZE;
+            if (pread(file->fd, data, (size_t) file->pageSize, slotOffset(file, slot) + LOG_SLOT_HEADER_SIZE) != file->pageSize) {
+                rc = RC_READ_NON_EXISTING_PAGE;
+                break;
+            }
+            rc = appendVersion(file, pageNum, data);
+            file->pagesRelocated++;
+        }
+        if (rc == RC_OK) {
+            releaseSegmentIfEmpty(file, segment);
+            freed++;
+        }
+    }
+    file->gcRuns++;
+    if (segmentsFreed != NULL) {
+        *segmentsFreed = freed;
+    }
+    return rc;
+}
+
+static void *gcThreadMain(void *arg)
+{
+    LogFile *file = (LogFile*) arg;
+    pthread_mutex_lock(&file->lock);
+    while (!file->gcStop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += file->gcIntervalMs / 1000;
+        deadline.tv_nsec += (long) (file->gcIntervalMs % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&file->gcCond, &file->lock, &deadline);
+        if (!file->gcStop) {
+            // One segment per round keeps the time foreground I/O waits for the lock short.
+            collectGarbageLocked(file, file->gcMaxLiveRatio, 1, NULL);
+        }
+    }
+    pthread_mutex_unlock(&file->lock);
+    return NULL;
+}
+
+static void freeLogFile(LogFile *file)
+{
+    pthread_mutex_destroy(&file->lock);
+    pthread_mutex_destroy(&file->checkpointLock);
+    pthread_cond_destroy(&file->gcCond);
+    free(file->path);
+    free(file->checkpointPath);
+    free(file->table);
+    free(file->liveCount);
+    free(file->segmentFree);
+    free(file->freeSegments);
+    free(file->releasedSegments);
+    free(file->slotOwner);
+    free(file->ioBuffer);
+    free(file);
+}
+
+
+/************************************************************
+ *                    backend operations                    *
+ ************************************************************/
+
+static RC logCreate(char *fileName, int pageSize)
+{
+    char *path = logPath(fileName);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        if (errno == EEXIST) {
+            RC_message = "File is already present there";
+            return RC_OK;
+        }
+        return RC_FILE_NOT_FOUND;
+    }
+    char *superblock = (char*) calloc(1, LOG_SUPERBLOCK_SIZE);
+    char *checkpointPath = makeCheckpointPath(path);
+    RC rc = RC_OK;
+    if (superblock == NULL || checkpointPath == NULL) {
+        rc = RC_WRITE_FAILED;
+    }
+    else {
+        LogSuperblock header;
+        memcpy(header.magic, LOG_SUPER_MAGIC, sizeof(header.magic));
+        header.pageSize = pageSize;
+        header.segmentSlots = LOG_SEGMENT_SLOTS;
+        header.numPages = 1;
+        memcpy(superblock, &header, sizeof(header));
+        if (pwrite(fd, superblock, LOG_SUPERBLOCK_SIZE, 0) != LOG_SUPERBLOCK_SIZE || fdatasync(fd) != 0) {
+            rc = RC_WRITE_FAILED;
+        }
+    }
+    // A new page file has one page; it was never written, so it reads as zeros. The journal
+    // is all zeros, so the first epoch is 1.
+    if (rc == RC_OK) {
+        LogCheckpointHeader checkpoint;
+        int64_t table[1] = { -1 };
+        memset(&checkpoint, 0, sizeof(checkpoint));
+        memcpy(checkpoint.magic, LOG_CHECKPOINT_MAGIC, sizeof(checkpoint.magic));
+        checkpoint.pageSize = pageSize;
+        checkpoint.numPages = 1;
+        checkpoint.clean = 1;
+        checkpoint.activeSegment = -1;
+        checkpoint.epoch = 1;
+        rc = storeCheckpoint(checkpointPath, &checkpoint, table);
+    }
+    free(checkpointPath);
+    free(superblock);
+    if (close(fd) != 0 && rc == RC_OK) {
+        rc = RC_WRITE_FAILED;
+    }
+    return rc;
+}
+
+static RC logDestroy(char *fileName)
+{
+    char *path = logPath(fileName);
+    char *checkpointPath = makeCheckpointPath(path);
+    if (checkpointPath != NULL) {
+        unlink(checkpointPath);
+        free(checkpointPath);
+    }
+    return unlink(path) == 0 ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+static RC logOpen(char *fileName, void **state, int *totalNumPages, int *pageSize)
+{
+    char *path = logPath(fileName);
+    int fd = open(path, O_RDWR);
+    if (fd == -1) {
+        return RC_FILE_NOT_FOUND;
+    }
+    LogSuperblock header;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+        || memcmp(header.magic, LOG_SUPER_MAGIC, sizeof(header.magic)) != 0
+        || !IS_SUPPORTED_PAGE_SIZE(header.pageSize) || header.segmentSlots != LOG_SEGMENT_SLOTS) {
+        close(fd);
+        return RC_FILE_NOT_FOUND;
+    }
+    LogFile *file = (LogFile*) calloc(1, sizeof(LogFile));
+    if (file == NULL) {
+        close(fd);
+        return RC_FILE_NOT_FOUND;
+    }
+    pthread_mutex_init(&file->lock, NULL);
+    pthread_mutex_init(&file->checkpointLock, NULL);
+    pthread_cond_init(&file->gcCond, NULL);
+    file->fd = fd;
+    file->pageSize = header.pageSize;
+    file->extendedPages = header.numPages;
+    file->slotSize = LOG_SLOT_HEADER_SIZE + header.pageSize;
+    file->activeSegment = -1;
+    file->path = strdup(path);
+    file->checkpointPath = makeCheckpointPath(path);
+    file->ioBuffer = (char*) malloc((size_t) file->slotSize);
+    // Marking the checkpoint unclean makes a crash from here on replay the log on the next open.
+    RC rc = file->path == NULL || file->checkpointPath == NULL || file->ioBuffer == NULL
+        ? RC_FILE_NOT_FOUND : recoverLogFile(file);
+    if (rc == RC_OK && writeCheckpoint(file, 0) != RC_OK) {
+        rc = RC_FILE_NOT_FOUND;
+    }
+    if (rc != RC_OK) {
+        close(fd);
+        freeLogFile(file);
+        return rc == RC_PAGE_CORRUPT ? rc : RC_FILE_NOT_FOUND;
+    }
+    *state = file;
+    *totalNumPages = file->numPages;
+    *pageSize = file->pageSize;
+    return RC_OK;
+}
+
+static RC logRead(void *state, int pageNum, SM_PageHandle memPage)
+{
+    LogFile *file = (LogFile*) state;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&file->lock);
+    if (pageNum >= file->numPages) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    else if (file->table[pageNum] < 0) {
+        memset(memPage, 0, (size_t) file->pageSize);
+    }
+    else if (pread(file->fd, memPage, (size_t) file->pageSize,
+                   slotOffset(file, file->table[pageNum]) + LOG_SLOT_HEADER_SIZE) != file->pageSize) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC logVerify(void *state, int pageNum, SM_PageHandle memPage)
+{
+    LogFile *file = (LogFile*) state;
+    RC rc = RC_OK;
+    LogSlotHeader header;
+    pthread_mutex_lock(&file->lock);
+    if (pageNum >= file->numPages) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    else if (file->table[pageNum] < 0) {
+        memset(memPage, 0, (size_t) file->pageSize);
+    }
+    else if (pread(file->fd, &header, sizeof(header), slotOffset(file, file->table[pageNum])) != (ssize_t) sizeof(header)
+             || pread(file->fd, memPage, (size_t) file->pageSize,
+                      slotOffset(file, file->table[pageNum]) + LOG_SLOT_HEADER_SIZE) != file->pageSize) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    else if (header.magic != LOG_SLOT_MAGIC || header.pageNum != pageNum
+             || header.checksum != pageChecksum(memPage, file->pageSize)) {
+        rc = RC_PAGE_CORRUPT;
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC logWrite(void *state, int pageNum, SM_PageHandle memPage)
+{
+    LogFile *file = (LogFile*) state;
+    RC rc;
+    pthread_mutex_lock(&file->lock);
+    if (pageNum >= file->numPages) {
+        rc = RC_WRITE_FAILED;
+    }
+    else {
+        rc = appendVersion(file, pageNum, memPage);
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC logExtend(void *state, int numPages, int *totalNumPages)
+{
+    LogFile *file = (LogFile*) state;
+    RC rc;
+    pthread_mutex_lock(&file->lock);
+    // New pages are only table entries until they are first written; the superblock keeps
+    // their count for recovery, as durable as the page writes around it.
+    int32_t newNumPages = file->numPages + numPages;
+    rc = ensureTable(file, newNumPages);
+    if (rc == RC_OK && pwrite(file->fd, &newNumPages, sizeof(newNumPages), offsetof(LogSuperblock, numPages))
+                       != (ssize_t) sizeof(newNumPages)) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK) {
+        file->numPages = newNumPages;
+    }
+    *totalNumPages = file->numPages;
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC logSync(void *state)
+{
+    return writeCheckpoint((LogFile*) state, 0);
+}
+
+/**
+ * @brief Stops the background garbage collector if it is running and waits for it. Only the
+ *        caller that asks the thread to stop joins it.
+ */
+static void stopGcThread(LogFile *file)
+{
+    pthread_mutex_lock(&file->lock);
+    int join = file->gcRunning && !file->gcStop;
+    pthread_t thread = file->gcThread;
+    file->gcStop = 1;
+    pthread_cond_signal(&file->gcCond);
+    pthread_mutex_unlock(&file->lock);
+    if (join) {
+        pthread_join(thread, NULL);
+        pthread_mutex_lock(&file->lock);
+        file->gcRunning = 0;
+        pthread_mutex_unlock(&file->lock);
+    }
+}
+
+static RC logClose(void *state)
+{
+    LogFile *file = (LogFile*) state;
+    stopGcThread(file);
+    RC rc = writeCheckpoint(file, 1);
+    if (close(file->fd) != 0) {
+        rc = RC_FILE_NOT_FOUND;
+    }
+    freeLogFile(file);
+    return rc;
+}
+
+const SM_Backend logStoreBackend = {
+    "log", LOG_STORE_PREFIX,
+    logCreate, logDestroy, logOpen, logRead, logWrite, logExtend, logSync, logClose,
+    NULL, /* no range writes: every write appends a whole page version */
+    logVerify,
+    NULL, /* no truncation: segments are reclaimed by the garbage collector */
+    NULL, NULL /* pages are scattered over segments, so multi-page transfers go page by page */
+};
+
+
+/************************************************************
+ *                    log store interface                   *
+ ************************************************************/
+
+/**
+ * @brief Returns the log file behind a handle, or NULL if the handle is not a log-structured file.
+ */
+static LogFile *getLogFile(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return NULL;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    return openFile->backend == &logStoreBackend ? (LogFile*) openFile->state : NULL;
+}
+
+
+/**
+ * @brief Persists the indirection table so reopening the file does not have to replay the log.
+ *        The checkpoint is fuzzy: writers are only held up while the table is copied.
+ *
+ * @param fHandle An open log-structured page file.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the handle is not an open log-structured file.
+ *         RC_WRITE_FAILED if the checkpoint could not be written.
+ */
+RC logStoreCheckpoint(SM_FileHandle *fHandle)
+{
+    LogFile *file = getLogFile(fHandle);
+    if (file == NULL) {
+        printMessage("The file is not an open log-structured page file.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return logSync(file);
+}
+
+
+/**
+ * @brief Empties every segment whose share of live page versions is at most maxLiveRatio by
+ *        appending its live versions to the log tail, so the segment can be reused.
+ *
+ * @param fHandle An open log-structured page file.
+ * @param maxLiveRatio Segments with at most this fraction of live slots are collected.
+ * @param segmentsFreed If not NULL, receives the number of segments emptied.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the handle is not an open log-structured file.
+ *         RC_WRITE_FAILED if relocating a page failed.
+ */
+RC logStoreCollectGarbage(SM_FileHandle *fHandle, double maxLiveRatio, int *segmentsFreed)
+{
+    LogFile *file = getLogFile(fHandle);
+    if (file == NULL) {
+        printMessage("The file is not an open log-structured page file.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&file->lock);
+    RC rc = collectGarbageLocked(file, maxLiveRatio, -1, segmentsFreed);
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+
+/**
+ * @brief Starts a background thread that empties one sparse segment every intervalMs
+ *        milliseconds. The thread is stopped by logStoreStopGc or when the file is closed.
+ *
+ * @param fHandle An open log-structured page file.
+ * @param intervalMs Pause between two collection rounds.
+ * @param maxLiveRatio Segments with at most this fraction of live slots are collected.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the handle is not an open log-structured file.
+ *         RC_WRITE_FAILED if the collector is already running or the thread could not start.
+ */
+RC logStoreStartGc(SM_FileHandle *fHandle, int intervalMs, double maxLiveRatio)
+{
+    LogFile *file = getLogFile(fHandle);
+    if (file == NULL) {
+        printMessage("The file is not an open log-structured page file.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&file->lock);
+    if (file->gcRunning || intervalMs <= 0) {
+        pthread_mutex_unlock(&file->lock);
+        return RC_WRITE_FAILED;
+    }
+    file->gcStop = 0;
+    file->gcIntervalMs = intervalMs;
+    file->gcMaxLiveRatio = maxLiveRatio;
+    // The thread waits for the lock before it looks at gcStop.
+    if (pthread_create(&file->gcThread, NULL, gcThreadMain, file) != 0) {
+        pthread_mutex_unlock(&file->lock);
+        printMessage("The garbage collector thread could not be started!\n");
+        return RC_WRITE_FAILED;
+    }
+    file->gcRunning = 1;
+    pthread_mutex_unlock(&file->lock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Stops the background garbage collector of a log-structured page file.
+ *
+ * @param fHandle An open log-structured page file.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the handle is not an open log-structured file.
+ */
+RC logStoreStopGc(SM_FileHandle *fHandle)
+{
+    LogFile *file = getLogFile(fHandle);
+    if (file == NULL) {
+        printMessage("The file is not an open log-structured page file.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    stopGcThread(file);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Reports segment usage and write/collection counters of a log-structured page file.
+ *
+ * @param fHandle An open log-structured page file.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the handle is not an open log-structured file.
+ */
+RC getLogStoreStats(SM_FileHandle *fHandle, LogStoreStats *stats)
+{
+    LogFile *file = getLogFile(fHandle);
+    if (file == NULL || stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&file->lock);
+    stats->numSegments = file->numSegments;
+    stats->freeSegments = file->numFree;
+    stats->livePages = 0;
+    for (int segment = 0; segment < file->numSegments; segment++) {
+        stats->livePages += file->liveCount[segment];
+    }
+    stats->pageWrites = file->pageWrites;
+    stats->gcRuns = file->gcRuns;
+    stats->pagesRelocated = file->pagesRelocated;
+    stats->unflushedWrites = (long) (file->seq - file->checkpointSeq);
+    int journaled = file->journalNext + (file->checkpointPending ? file->journalPrevious : 0);
+    long allSlots = (long) file->numSegments * LOG_SEGMENT_SLOTS;
+    stats->recoverySlots = journaled >= LOG_JOURNAL_ENTRIES
+        ? allSlots : (long) (journaled + 1) * LOG_SEGMENT_SLOTS;
+    if (stats->recoverySlots > allSlots) {
+        stats->recoverySlots = allSlots;
+    }
+    stats->lastRecoverySlots = (long) file->lastRecoverySlots;
+    stats->lastRecoveryMs = file->lastRecoveryMs;
+    pthread_mutex_unlock(&file->lock);
+    return RC_OK;
+}
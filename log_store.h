@@ -0,0 +1,54 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "sm_backend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    log store constants                   *
+ ************************************************************/
+/* page files whose name starts with this prefix are log-structured; the rest is the path */
+#define LOG_STORE_PREFIX "log:"
+/* page slots per segment, the unit the garbage collector frees */
+#define LOG_SEGMENT_SLOTS 64
+/* the superblock at the start of the log file */
+#define LOG_SUPERBLOCK_SIZE 4096
+/* bytes in front of every page version in the log */
+#define LOG_SLOT_HEADER_SIZE 32
+/* suffix of the checkpoint file holding the indirection table */
+#define LOG_CHECKPOINT_SUFFIX ".ckpt"
+
+typedef struct LogStoreStats {
+	int numSegments;
+	int freeSegments;
+	int livePages;
+	long pageWrites;
+	long gcRuns;
+	long pagesRelocated;
+	long unflushedWrites;     /* page versions appended since the last durable checkpoint */
+	long recoverySlots;       /* slots a recovery would read if the process crashed now */
+	long lastRecoverySlots;   /* slots read when the file was opened */
+	double lastRecoveryMs;
+} LogStoreStats;
+
+extern const SM_Backend logStoreBackend;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC logStoreCheckpoint (SM_FileHandle *fHandle);
+extern RC logStoreCollectGarbage (SM_FileHandle *fHandle, double maxLiveRatio, int *segmentsFreed);
+extern RC logStoreStartGc (SM_FileHandle *fHandle, int intervalMs, double maxLiveRatio);
+extern RC logStoreStopGc (SM_FileHandle *fHandle);
+extern RC getLogStoreStats (SM_FileHandle *fHandle, LogStoreStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
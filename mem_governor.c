@@ -0,0 +1,386 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mem_governor.h"
+#include "sm_backend.h"
+
+/*
+ * One budget for the whole process. Everything that holds memory for long registers as a
+ * consumer and reserves bytes before it allocates them and releases them after freeing them;
+ * every open page file is a consumer of its own. When a reservation does not fit, consumers
+ * holding more than their share of the budget are asked to shrink, the ones furthest over
+ * first, but never below their share. A consumer's share is the budget split by weight
+ * among the consumers that hold memory, so a file with weight 3 may keep three times the
+ * memory of a file with weight 1 when both are busy, and all of it when the other is idle.
+ * A reservation that still does not fit is denied; the consumer then works with less.
+ * Page buffers from allocPage are not charged: they are short-lived, and the page arena keeps
+ * its own regions, which getPageArenaStats reports.
+ */
+
+struct SM_MemConsumer {
+    char *name;
+    int weight;
+    SM_ShrinkFn shrink;
+    void *context;
+    long long used;
+    long denied;
+    long shrinkCalls;
+    long long bytesShrunk;
+    SM_MemConsumer *prev;
+    SM_MemConsumer *next;
+};
+
+/* a consumer that may be asked to shrink, and how far it is over its share */
+typedef struct ShrinkCandidate {
+    SM_MemConsumer *consumer;
+    long long over;
+} ShrinkCandidate;
+
+/* guards everything below and every consumer's counters */
+static pthread_mutex_t governorLock = PTHREAD_MUTEX_INITIALIZER;
+static SM_MemConsumer *consumers = NULL;
+static SM_MemoryStats governor;
+
+
+static int activeWeight(SM_MemConsumer *requester)
+{
+    int weight = 0;
+    for (SM_MemConsumer *c = consumers; c != NULL; c = c->next) {
+        if (c->used > 0 || c == requester) {
+            weight += c->weight;
+        }
+    }
+    return weight;
+}
+
+static long long shareOf(SM_MemConsumer *consumer, int totalWeight)
+{
+    if (governor.budget == MEMGOV_UNLIMITED || totalWeight == 0) {
+        return governor.budget;
+    }
+    return governor.budget / totalWeight * consumer->weight;
+}
+
+static int compareOvershoot(const void *a, const void *b)
+{
+    long long overA = ((const ShrinkCandidate*) a)->over;
+    long long overB = ((const ShrinkCandidate*) b)->over;
+    return overA < overB ? 1 : overA > overB ? -1 : 0;
+}
+
+/**
+ * @brief Asks consumers over their share, other than the requester, to give back needed bytes.
+ *        Called with the governor's lock held.
+ */
+static void shrinkOthers(SM_MemConsumer *requester, long long needed)
+{
+    int count = 0;
+    for (SM_MemConsumer *c = consumers; c != NULL; c = c->next) {
+        count++;
+    }
+    ShrinkCandidate *candidates = (ShrinkCandidate*) malloc(sizeof(ShrinkCandidate) * (size_t) (count > 0 ? count : 1));
+    if (candidates == NULL) {
+        return;
+    }
+    int totalWeight = activeWeight(requester);
+    int numCandidates = 0;
+    for (SM_MemConsumer *c = consumers; c != NULL; c = c->next) {
+        long long over = c->used - shareOf(c, totalWeight);
+        if (c != requester && c->shrink != NULL && over > 0) {
+            candidates[numCandidates].consumer = c;
+            candidates[numCandidates].over = over;
+            numCandidates++;
+        }
+    }
+    qsort(candidates, (size_t) numCandidates, sizeof(ShrinkCandidate), compareOvershoot);
+    for (int i = 0; i < numCandidates && needed > 0; i++) {
+        SM_MemConsumer *c = candidates[i].consumer;
+        long long ask = needed < candidates[i].over ? needed : candidates[i].over;
+        long long freed = c->shrink(c->context, ask);
+        freed = freed < 0 ? 0 : freed > c->used ? c->used : freed;
+        c->shrinkCalls++;
+        c->bytesShrunk += freed;
+        c->used -= freed;
+        governor.shrinkCalls++;
+        governor.bytesShrunk += freed;
+        governor.used -= freed;
+        needed -= freed;
+    }
+    free(candidates);
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Sets the memory budget of the process. Lowering it below the memory in use asks
+ *        consumers over their share to shrink; what they cannot give back stays in use until
+ *        they release it.
+ *
+ * @param budgetBytes The budget in bytes, or MEMGOV_UNLIMITED.
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if the budget is negative.
+ */
+RC setMemoryBudget(long long budgetBytes)
+{
+    if (budgetBytes < 0) {
+        printMessage("The memory budget can't be negative.\n");
+        return RC_WRITE_FAILED;
+    }
+    pthread_mutex_lock(&governorLock);
+    governor.budget = budgetBytes;
+    if (budgetBytes != MEMGOV_UNLIMITED && governor.used > budgetBytes) {
+        shrinkOthers(NULL, governor.used - budgetBytes);
+    }
+    pthread_mutex_unlock(&governorLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Reports the budget, the memory in use and how often reservations needed shrinking.
+ *
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if stats is NULL.
+ */
+RC getMemoryStats(SM_MemoryStats *stats)
+{
+    if (stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&governorLock);
+    *stats = governor;
+    pthread_mutex_unlock(&governorLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Registers something that holds memory drawn from the budget.
+ *
+ * @param name Shown when a reservation is denied; copied.
+ * @param weight Its claim on the budget relative to other consumers, at least 1.
+ * @param shrink Called to give memory back under pressure, or NULL if it can't.
+ * @param context Passed to shrink.
+ * @param consumer Receives the consumer.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if name or consumer is NULL.
+ *         RC_WRITE_FAILED if the weight is not positive or memory ran out.
+ */
+RC registerMemConsumer(const char *name, int weight, SM_ShrinkFn shrink, void *context, SM_MemConsumer **consumer)
+{
+    if (name == NULL || consumer == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (weight < 1) {
+        printMessage("The weight of %s must be at least 1.\n", name);
+        return RC_WRITE_FAILED;
+    }
+    SM_MemConsumer *c = (SM_MemConsumer*) calloc(1, sizeof(SM_MemConsumer));
+    if (c == NULL || (c->name = strdup(name)) == NULL) {
+        free(c);
+        return RC_WRITE_FAILED;
+    }
+    c->weight = weight;
+    c->shrink = shrink;
+    c->context = context;
+    pthread_mutex_lock(&governorLock);
+    c->next = consumers;
+    if (consumers != NULL) {
+        consumers->prev = c;
+    }
+    consumers = c;
+    governor.consumers++;
+    pthread_mutex_unlock(&governorLock);
+    *consumer = c;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Removes a consumer; memory it did not release is given back to the budget.
+ *
+ * @param consumer The consumer, or NULL.
+ */
+void unregisterMemConsumer(SM_MemConsumer *consumer)
+{
+    if (consumer == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&governorLock);
+    if (consumer->prev != NULL) {
+        consumer->prev->next = consumer->next;
+    }
+    else {
+        consumers = consumer->next;
+    }
+    if (consumer->next != NULL) {
+        consumer->next->prev = consumer->prev;
+    }
+    governor.used -= consumer->used;
+    governor.consumers--;
+    pthread_mutex_unlock(&governorLock);
+    free(consumer->name);
+    free(consumer);
+}
+
+
+/**
+ * @brief Changes a consumer's claim on the budget; takes effect at the next shortage.
+ *
+ * @param consumer The consumer.
+ * @param weight The new weight, at least 1.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if consumer is NULL.
+ *         RC_WRITE_FAILED if the weight is not positive.
+ */
+RC setMemConsumerWeight(SM_MemConsumer *consumer, int weight)
+{
+    if (consumer == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (weight < 1) {
+        printMessage("The weight of %s must be at least 1.\n", consumer->name);
+        return RC_WRITE_FAILED;
+    }
+    pthread_mutex_lock(&governorLock);
+    consumer->weight = weight;
+    pthread_mutex_unlock(&governorLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Reserves bytes before they are allocated. If they don't fit in the budget, other
+ *        consumers over their share are asked to shrink first.
+ *
+ * @param consumer The consumer; NULL reserves nothing and always succeeds.
+ * @param bytes The bytes to reserve.
+ * @return RC_OK if successful.
+ *         RC_MEMORY_BUDGET_EXCEEDED if the bytes do not fit in the budget.
+ */
+RC memReserve(SM_MemConsumer *consumer, long long bytes)
+{
+    if (consumer == NULL || bytes <= 0) {
+        return RC_OK;
+    }
+    pthread_mutex_lock(&governorLock);
+    governor.reservations++;
+    if (governor.budget != MEMGOV_UNLIMITED && governor.used + bytes > governor.budget) {
+        shrinkOthers(consumer, governor.used + bytes - governor.budget);
+    }
+    if (governor.budget != MEMGOV_UNLIMITED && governor.used + bytes > governor.budget) {
+        governor.denied++;
+        consumer->denied++;
+        pthread_mutex_unlock(&governorLock);
+        printMessage("The memory budget has no room for %lld more bytes of %s!\n", bytes, consumer->name);
+        return RC_MEMORY_BUDGET_EXCEEDED;
+    }
+    consumer->used += bytes;
+    governor.used += bytes;
+    if (governor.used > governor.peak) {
+        governor.peak = governor.used;
+    }
+    pthread_mutex_unlock(&governorLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Gives bytes back to the budget after they were freed.
+ *
+ * @param consumer The consumer; NULL releases nothing.
+ * @param bytes The bytes to release, at most what the consumer holds.
+ */
+void memRelease(SM_MemConsumer *consumer, long long bytes)
+{
+    if (consumer == NULL || bytes <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&governorLock);
+    if (bytes > consumer->used) {
+        bytes = consumer->used;
+    }
+    consumer->used -= bytes;
+    governor.used -= bytes;
+    pthread_mutex_unlock(&governorLock);
+}
+
+
+/**
+ * @brief Returns once no shrink callback is running. A consumer that unhooks a part its
+ *        callback reaches calls it before freeing that part.
+ */
+void memQuiesce(void)
+{
+    pthread_mutex_lock(&governorLock);
+    pthread_mutex_unlock(&governorLock);
+}
+
+
+/**
+ * @brief Reports the memory a consumer holds, its current share and how often it was asked
+ *        to shrink.
+ *
+ * @param consumer The consumer.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if an argument is NULL.
+ */
+RC getMemConsumerStats(SM_MemConsumer *consumer, SM_MemConsumerStats *stats)
+{
+    if (consumer == NULL || stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&governorLock);
+    stats->used = consumer->used;
+    stats->share = shareOf(consumer, activeWeight(consumer));
+    stats->weight = consumer->weight;
+    stats->denied = consumer->denied;
+    stats->shrinkCalls = consumer->shrinkCalls;
+    stats->bytesShrunk = consumer->bytesShrunk;
+    pthread_mutex_unlock(&governorLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Sets the weight of an open page file's claim on the memory budget.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param weight The new weight, at least 1.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the weight is not positive.
+ */
+RC setFileMemoryWeight(SM_FileHandle *fHandle, int weight)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return setMemConsumerWeight(((SM_OpenFile*) fHandle->mgmtInfo)->memory, weight);
+}
+
+
+/**
+ * @brief Reports the memory buffers of an open page file hold and its share of the budget.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC getFileMemoryStats(SM_FileHandle *fHandle, SM_MemConsumerStats *stats)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return getMemConsumerStats(((SM_OpenFile*) fHandle->mgmtInfo)->memory, stats);
+}
@@ -0,0 +1,68 @@
+#ifndef MEM_GOVERNOR_H
+#define MEM_GOVERNOR_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    governor constants                    *
+ ************************************************************/
+/* pass as budget to let buffers and caches grow without a limit */
+#define MEMGOV_UNLIMITED 0
+/* weight of consumers that were not given one, including open files */
+#define MEMGOV_DEFAULT_WEIGHT 1
+
+/* something holding memory drawn from the budget: an open file, a pool, a sort */
+typedef struct SM_MemConsumer SM_MemConsumer;
+
+/* Asked to give back bytes under pressure; frees what it can and returns the bytes freed.
+ * It runs with the governor's lock held, so it must not reserve or release memory and must
+ * not wait for a lock that is held while reserving (try the lock and return 0 instead). */
+typedef long long (*SM_ShrinkFn) (void *context, long long bytes);
+
+typedef struct SM_MemoryStats {
+	long long budget;         /* MEMGOV_UNLIMITED if there is none */
+	long long used;
+	long long peak;
+	int consumers;
+	long reservations;
+	long denied;              /* reservations that did not fit even after shrinking */
+	long shrinkCalls;
+	long long bytesShrunk;
+} SM_MemoryStats;
+
+typedef struct SM_MemConsumerStats {
+	long long used;
+	long long share;          /* its part of the budget by weight among consumers holding memory */
+	int weight;
+	long denied;
+	long shrinkCalls;         /* times it was asked to give memory back */
+	long long bytesShrunk;
+} SM_MemConsumerStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC setMemoryBudget (long long budgetBytes);
+extern RC getMemoryStats (SM_MemoryStats *stats);
+
+extern RC registerMemConsumer (const char *name, int weight, SM_ShrinkFn shrink, void *context, SM_MemConsumer **consumer);
+extern void unregisterMemConsumer (SM_MemConsumer *consumer);
+extern RC setMemConsumerWeight (SM_MemConsumer *consumer, int weight);
+extern RC memReserve (SM_MemConsumer *consumer, long long bytes);
+extern void memRelease (SM_MemConsumer *consumer, long long bytes);
+extern void memQuiesce (void);
+extern RC getMemConsumerStats (SM_MemConsumer *consumer, SM_MemConsumerStats *stats);
+
+extern RC setFileMemoryWeight (SM_FileHandle *fHandle, int weight);
+extern RC getFileMemoryStats (SM_FileHandle *fHandle, SM_MemConsumerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
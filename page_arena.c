@@ -0,0 +1,549 @@
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "page_arena.h"
+
+/* policy value for mbind(2); spelled out so we don't need libnuma's headers */
+#define ARENA_MPOL_BIND 2
+
+/* a free page frame stores the link to the next free frame in its first bytes */
+typedef struct FreeFrame {
+    struct FreeFrame *next;
+} FreeFrame;
+
+/* the regions and free frames of one NUMA node, or of no node in particular */
+typedef struct NodeArena {
+    pthread_mutex_t lock;
+    int node;
+    /* the arena generation its regions and frames belong to */
+    unsigned long generation;
+    int numRegions;
+    int hugeTlbRegions;
+    int bindWarned;
+    /* frames of the newest region that have never been handed out */
+    char *carveNext;
+    char *carveEnd;
+    FreeFrame *sharedFree;
+    long sharedFreeCount;
+} NodeArena;
+
+/* the region a frame belongs to, and so the arena it goes back to */
+typedef struct RegionOwner {
+    char *region;
+    NodeArena *arena;
+} RegionOwner;
+
+/* a thread's own free frames, handed back to their arenas when the thread exits */
+typedef struct ThreadCache {
+    FreeFrame *frames;
+    int count;
+    unsigned long generation;
+    /* set while the thread works on frames; a shutdown waits for it before unmapping */
+    int busy;
+    struct ThreadCache *next;
+} ThreadCache;
+
+/* arena 0 has unbound regions, arena n + 1 regions bound to node n */
+static NodeArena arenas[ARENA_MAX_NODES + 1];
+static pthread_once_t arenasOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t threadCacheKey;
+
+/* guards arenaMode, the region table and the generation. It is never held together with an
+ * arena's lock, so the two can be taken in any order. */
+static pthread_mutex_t regionLock = PTHREAD_MUTEX_INITIALIZER;
+static int arenaMode = ARENA_ANY_NODE;
+static unsigned long arenaGeneration = 1;
+/* every mapped region, sorted by address */
+static RegionOwner *regions = NULL;
+static int numRegions = 0;
+static int regionCapacity = 0;
+
+static long pagesInUse = 0;
+
+/* every thread cache, so a shutdown can wait for threads working on frames */
+static pthread_mutex_t cacheListLock = PTHREAD_MUTEX_INITIALIZER;
+static ThreadCache *threadCaches = NULL;
+
+static __thread ThreadCache *threadCache = NULL;
+
+
+/**
+ * @brief Finds the arena a frame was carved from. Must be called with regionLock held.
+ */
+static NodeArena *ownerOf(FreeFrame *frame)
+{
+    char *region = (char*) ((uintptr_t) frame & ~((uintptr_t) ARENA_REGION_SIZE - 1));
+    int low = 0, high = numRegions - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (regions[mid].region == region) {
+            return regions[mid].arena;
+        }
+        if (regions[mid].region < region) {
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Empties an arena whose regions were unmapped by a shutdown. Must be called with the
+ *        arena's lock held.
+ */
+static void syncArena(NodeArena *arena, unsigned long generation)
+{
+    if (arena->generation >= generation) {
+        return;
+    }
+    arena->generation = generation;
+    arena->numRegions = 0;
+    arena->hugeTlbRegions = 0;
+    arena->carveNext = NULL;
+    arena->carveEnd = NULL;
+    arena->sharedFree = NULL;
+    arena->sharedFreeCount = 0;
+}
+
+
+/**
+ * @brief Gives frames back to the arenas they were carved from. Frames cached before the
+ *        arena was shut down are dropped, since their regions are gone. The caller must be
+ *        marked busy, so the frames stay mapped while their links are followed.
+ */
+static void returnFrames(FreeFrame *frames, unsigned long generation)
+{
+    while (frames != NULL) {
+        pthread_mutex_lock(&regionLock);
+        if (arenaGeneration != generation) {
+            pthread_mutex_unlock(&regionLock);
+            return;
+        }
+        FreeFrame *frame = frames;
+        frames = frame->next;
+        NodeArena *arena = ownerOf(frame);
+        pthread_mutex_unlock(&regionLock);
+        if (arena == NULL) {
+            continue;
+        }
+        // A shutdown in between moves the generation on before it empties the arenas.
+        pthread_mutex_lock(&arena->lock);
+        if (__atomic_load_n(&arenaGeneration, __ATOMIC_ACQUIRE) == generation) {
+            syncArena(arena, generation);
+            frame->next = arena->sharedFree;
+            arena->sharedFree = frame;
+            arena->sharedFreeCount++;
+        }
+        pthread_mutex_unlock(&arena->lock);
+    }
+}
+
+
+/**
+ * @brief Runs when a thread that used the arena exits and hands its cached frames back.
+ */
+static void releaseThreadCache(void *value)
+{
+    ThreadCache *cache = (ThreadCache*) value;
+    __atomic_store_n(&cache->busy, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&arenaGeneration, __ATOMIC_SEQ_CST) == cache->generation) {
+        returnFrames(cache->frames, cache->generation);
+    }
+    __atomic_store_n(&cache->busy, 0, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&cacheListLock);
+    ThreadCache **link = &threadCaches;
+    while (*link != NULL && *link != cache) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = cache->next;
+    }
+    pthread_mutex_unlock(&cacheListLock);
+    threadCache = NULL;
+    free(cache);
+}
+
+
+static void initArenas(void)
+{
+    for (int i = 0; i <= ARENA_MAX_NODES; i++) {
+        pthread_mutex_init(&arenas[i].lock, NULL);
+        arenas[i].node = i - 1;
+        arenas[i].generation = 1;
+    }
+    pthread_key_create(&threadCacheKey, releaseThreadCache);
+}
+
+
+/**
+ * @brief Returns the calling thread's cache marked busy, creating it on first use and emptying
+ *        it if the arena was shut down since its frames were cached. The thread has to call
+ *        leaveThreadCache once it no longer touches frames.
+ */
+static ThreadCache *enterThreadCache(void)
+{
+    ThreadCache *cache = threadCache;
+    if (cache == NULL) {
+        pthread_once(&arenasOnce, initArenas);
+        cache = (ThreadCache*) calloc(1, sizeof(ThreadCache));
+        if (cache == NULL) {
+            return NULL;
+        }
+        pthread_setspecific(threadCacheKey, cache);
+        threadCache = cache;
+        pthread_mutex_lock(&cacheListLock);
+        cache->next = threadCaches;
+        threadCaches = cache;
+        pthread_mutex_unlock(&cacheListLock);
+    }
+    // Either a shutdown sees the thread busy and waits, or the thread sees the new generation.
+    __atomic_store_n(&cache->busy, 1, __ATOMIC_SEQ_CST);
+    unsigned long generation = __atomic_load_n(&arenaGeneration, __ATOMIC_SEQ_CST);
+    if (cache->generation != generation) {
+        cache->frames = NULL;
+        cache->count = 0;
+        cache->generation = generation;
+    }
+    return cache;
+}
+
+
+static void leaveThreadCache(ThreadCache *cache)
+{
+    __atomic_store_n(&cache->busy, 0, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief Picks the arena the calling thread allocates from: the configured node's, the node
+ *        the thread runs on for ARENA_LOCAL_NODE, or the unbound arena.
+ */
+static NodeArena *currentArena(void)
+{
+    int mode = __atomic_load_n(&arenaMode, __ATOMIC_RELAXED);
+    if (mode == ARENA_LOCAL_NODE) {
+        unsigned cpu, node;
+        mode = syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < ARENA_MAX_NODES ? (int) node : ARENA_ANY_NODE;
+    }
+    return &arenas[mode + 1];
+}
+
+
+/**
+ * @brief Adds a region to the sorted region table.
+ *
+ * @param generation Set to the generation whose table the region was added to.
+ */
+static int addRegion(char *region, NodeArena *arena, unsigned long *generation)
+{
+    pthread_mutex_lock(&regionLock);
+    *generation = arenaGeneration;
+    if (numRegions == regionCapacity) {
+        int newCapacity = regionCapacity == 0 ? 16 : regionCapacity * 2;
+        RegionOwner *grown = (RegionOwner*) realloc(regions, sizeof(RegionOwner) * newCapacity);
+        if (grown == NULL) {
+            pthread_mutex_unlock(&regionLock);
+            return 0;
+        }
+        regions = grown;
+        regionCapacity = newCapacity;
+    }
+    int i = numRegions;
+    while (i > 0 && regions[i - 1].region > region) {
+        regions[i] = regions[i - 1];
+        i--;
+    }
+    regions[i].region = region;
+    regions[i].arena = arena;
+    numRegions++;
+    pthread_mutex_unlock(&regionLock);
+    return 1;
+}
+
+
+/**
+ * @brief Maps a new 2 MiB region, preferring explicit huge pages and falling back to an aligned
+ *        mapping advised for transparent huge pages. Must be called without the arena's lock,
+ *        since the region table is locked to register the region.
+ *
+ * @param huge Set to 1 if the region is backed by explicit huge pages.
+ * @param generation Set to the generation the region belongs to.
+ * @return The start of the region, or NULL if no memory could be mapped.
+ */
+static char *mapRegion(NodeArena *arena, int *huge, unsigned long *generation)
+{
+    *huge = 1;
+    char *region = mmap(NULL, ARENA_REGION_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (region == MAP_FAILED) {
+        *huge = 0;
+        // Over-map so a huge-page aligned window can be cut out of the mapping.
+        char *raw = mmap(NULL, 2 * ARENA_REGION_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            printMessage("The page arena could not map a new region!\n");
+            return NULL;
+        }
+        uintptr_t aligned = ((uintptr_t) raw + ARENA_REGION_SIZE - 1) & ~((uintptr_t) ARENA_REGION_SIZE - 1);
+        region = (char*) aligned;
+        if (region > raw) {
+            munmap(raw, (size_t) (region - raw));
+        }
+        size_t tail = (size_t) ((raw + 2 * ARENA_REGION_SIZE) - (region + ARENA_REGION_SIZE));
+        if (tail > 0) {
+            munmap(region + ARENA_REGION_SIZE, tail);
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(region, ARENA_REGION_SIZE, MADV_HUGEPAGE);
+#endif
+    }
+    // Binding has to happen before the first touch, otherwise the pages are already placed.
+    if (arena->node != ARENA_ANY_NODE) {
+        unsigned long nodeMask = 1UL << arena->node;
+        if (syscall(SYS_mbind, region, ARENA_REGION_SIZE, ARENA_MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8, 0) != 0
+            && !__atomic_exchange_n(&arena->bindWarned, 1, __ATOMIC_RELAXED)) {
+            printMessage("The page arena regions could not be bound to NUMA node %d, using default placement.\n", arena->node);
+        }
+    }
+    if (!addRegion(region, arena, generation)) {
+        munmap(region, ARENA_REGION_SIZE);
+        printMessage("Memory allocation error!\n");
+        return NULL;
+    }
+    return region;
+}
+
+
+/**
+ * @brief Moves half a thread cache's worth of frames from the current arena into the cache,
+ *        mapping regions as needed. The arena's lock is dropped while a region is mapped, and
+ *        frames cached before a shutdown that happens meanwhile are dropped.
+ *
+ * @return 1 if the cache holds frames afterwards, 0 if the arena could not grow.
+ */
+static int refillThreadCache(ThreadCache *cache)
+{
+    NodeArena *arena = currentArena();
+    char *region = NULL;
+    unsigned long regionGeneration = 0;
+    int huge = 0;
+    pthread_mutex_lock(&arena->lock);
+    for (;;) {
+        unsigned long generation = __atomic_load_n(&arenaGeneration, __ATOMIC_ACQUIRE);
+        if (cache->generation != generation) {
+            cache->frames = NULL;
+            cache->count = 0;
+            cache->generation = generation;
+        }
+        syncArena(arena, generation);
+        // A region registered before a shutdown was unmapped with the others.
+        if (region != NULL && regionGeneration == generation) {
+            // Another thread may have added a region while the lock was dropped.
+            while (arena->carveNext != arena->carveEnd) {
+                FreeFrame *frame = (FreeFrame*) arena->carveNext;
+                arena->carveNext += PAGE_SIZE;
+                frame->next = arena->sharedFree;
+                arena->sharedFree = frame;
+                arena->sharedFreeCount++;
+            }
+            arena->carveNext = region;
+            arena->carveEnd = region + ARENA_REGION_SIZE;
+            arena->numRegions++;
+            arena->hugeTlbRegions += huge;
+        }
+        region = NULL;
+        while (cache->count < ARENA_THREAD_CACHE_PAGES / 2) {
+            FreeFrame *frame;
+            if (arena->sharedFree != NULL) {
+                frame = arena->sharedFree;
+                arena->sharedFree = frame->next;
+                arena->sharedFreeCount--;
+            }
+            else if (arena->carveNext != arena->carveEnd) {
+                frame = (FreeFrame*) arena->carveNext;
+                arena->carveNext += PAGE_SIZE;
+            }
+            else {
+                break;
+            }
+            frame->next = cache->frames;
+            cache->frames = frame;
+            cache->count++;
+        }
+        if (cache->count >= ARENA_THREAD_CACHE_PAGES / 2) {
+            break;
+        }
+        pthread_mutex_unlock(&arena->lock);
+        region = mapRegion(arena, &huge, &regionGeneration);
+        pthread_mutex_lock(&arena->lock);
+        if (region == NULL) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&arena->lock);
+    return cache->frames != NULL;
+}
+
+
+/**
+ * @brief Configures the page arena. Calling it is optional; without it pages are placed wherever
+ *        the kernel decides. Each NUMA node has an arena of its own, with regions bound to the
+ *        node; only allocations made after the call are affected.
+ *
+ * @param numaNode The NUMA node all threads allocate from, ARENA_LOCAL_NODE for the node each
+ *        thread runs on when it refills its free list, or ARENA_ANY_NODE.
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if the node number is not supported.
+ */
+RC initPageArena(int numaNode)
+{
+    if (numaNode != ARENA_ANY_NODE && numaNode != ARENA_LOCAL_NODE && (numaNode < 0 || numaNode >= ARENA_MAX_NODES)) {
+        printMessage("NUMA node %d is out of range for the page arena.\n", numaNode);
+        return RC_WRITE_FAILED;
+    }
+    pthread_once(&arenasOnce, initArenas);
+    __atomic_store_n(&arenaMode, numaNode, __ATOMIC_RELAXED);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Unmaps every region of every arena. All pages handed out by allocPage become invalid.
+ *        Threads may keep allocating meanwhile; they get pages of fresh regions once the
+ *        shutdown has moved the generation on.
+ *
+ * @return RC_OK.
+ */
+RC shutdownPageArena(void)
+{
+    pthread_once(&arenasOnce, initArenas);
+    // Threads notice the new generation and forget their cached frames; frames being handed
+    // back see it before they can reach an emptied arena. Regions mapped from now on go into
+    // a new table.
+    pthread_mutex_lock(&regionLock);
+    unsigned long generation = __atomic_add_fetch(&arenaGeneration, 1, __ATOMIC_SEQ_CST);
+    RegionOwner *oldRegions = regions;
+    int oldNumRegions = numRegions;
+    regions = NULL;
+    numRegions = 0;
+    regionCapacity = 0;
+    pthread_mutex_unlock(&regionLock);
+    for (int i = 0; i <= ARENA_MAX_NODES; i++) {
+        pthread_mutex_lock(&arenas[i].lock);
+        syncArena(&arenas[i], generation);
+        pthread_mutex_unlock(&arenas[i].lock);
+    }
+    // A thread still busy may be touching frames of the old regions.
+    pthread_mutex_lock(&cacheListLock);
+    for (ThreadCache *cache = threadCaches; cache != NULL; cache = cache->next) {
+        while (__atomic_load_n(&cache->busy, __ATOMIC_SEQ_CST)) {
+            sched_yield();
+        }
+    }
+    pthread_mutex_unlock(&cacheListLock);
+    for (int i = 0; i < oldNumRegions; i++) {
+        munmap(oldRegions[i].region, ARENA_REGION_SIZE);
+    }
+    free(oldRegions);
+    __atomic_store_n(&pagesInUse, 0, __ATOMIC_RELAXED);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Allocates one zeroed, page aligned frame of PAGE_SIZE bytes.
+ *
+ * @return The page, or NULL if the arena could not grow.
+ */
+SM_PageHandle allocPage(void)
+{
+    ThreadCache *cache = enterThreadCache();
+    if (cache == NULL) {
+        return NULL;
+    }
+    // Refill half of the thread cache at once so the lock is taken once per batch.
+    if (cache->frames == NULL && !refillThreadCache(cache)) {
+        leaveThreadCache(cache);
+        return NULL;
+    }
+    FreeFrame *frame = cache->frames;
+    cache->frames = frame->next;
+    cache->count--;
+    __atomic_add_fetch(&pagesInUse, 1, __ATOMIC_RELAXED);
+    memset(frame, 0, PAGE_SIZE);
+    leaveThreadCache(cache);
+    return (SM_PageHandle) frame;
+}
+
+
+/**
+ * @brief Returns a page obtained from allocPage to the arena.
+ *
+ * @param page The page to release; NULL is ignored.
+ */
+void freePage(SM_PageHandle page)
+{
+    if (page == NULL) {
+        return;
+    }
+    ThreadCache *cache = enterThreadCache();
+    __atomic_sub_fetch(&pagesInUse, 1, __ATOMIC_RELAXED);
+    FreeFrame *frame = (FreeFrame*) page;
+    if (cache == NULL) {
+        frame->next = NULL;
+        returnFrames(frame, __atomic_load_n(&arenaGeneration, __ATOMIC_ACQUIRE));
+        return;
+    }
+    frame->next = cache->frames;
+    cache->frames = frame;
+    cache->count++;
+    // Hand half of an overfull thread cache back so other threads can reuse the frames.
+    if (cache->count > ARENA_THREAD_CACHE_PAGES) {
+        FreeFrame *excess = NULL;
+        while (cache->count > ARENA_THREAD_CACHE_PAGES / 2) {
+            frame = cache->frames;
+            cache->frames = frame->next;
+            cache->count--;
+            frame->next = excess;
+            excess = frame;
+        }
+        returnFrames(excess, cache->generation);
+    }
+    leaveThreadCache(cache);
+}
+
+
+/**
+ * @brief Reports how many regions the arenas have mapped and how their pages are used.
+ *        Free pages cached by individual threads are not counted in pagesFree.
+ *
+ * @param stats The structure that is filled in.
+ */
+void getPageArenaStats(PageArenaStats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    pthread_once(&arenasOnce, initArenas);
+    memset(stats, 0, sizeof(PageArenaStats));
+    for (int i = 0; i <= ARENA_MAX_NODES; i++) {
+        NodeArena *arena = &arenas[i];
+        pthread_mutex_lock(&arena->lock);
+        syncArena(arena, __atomic_load_n(&arenaGeneration, __ATOMIC_ACQUIRE));
+        stats->numRegions += arena->numRegions;
+        stats->hugeTlbRegions += arena->hugeTlbRegions;
+        stats->numArenas += arena->numRegions > 0;
+        stats->pagesFree += arena->sharedFreeCount + (long) ((arena->carveEnd - arena->carveNext) / PAGE_SIZE);
+        pthread_mutex_unlock(&arena->lock);
+    }
+    stats->pagesInUse = __atomic_load_n(&pagesInUse, __ATOMIC_RELAXED);
+}
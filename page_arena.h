@@ -0,0 +1,47 @@
+#ifndef PAGE_ARENA_H
+#define PAGE_ARENA_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    arena constants                       *
+ ************************************************************/
+/* pages are carved out of regions of this size (one x86-64 huge page) */
+#define ARENA_REGION_SIZE (2 * 1024 * 1024)
+#define ARENA_PAGES_PER_REGION (ARENA_REGION_SIZE / PAGE_SIZE)
+/* number of free pages a thread keeps for itself before returning them */
+#define ARENA_THREAD_CACHE_PAGES 64
+/* pass as numaNode to leave placement to the kernel */
+#define ARENA_ANY_NODE (-1)
+/* pass as numaNode to allocate from the arena of the node the calling thread runs on */
+#define ARENA_LOCAL_NODE (-2)
+/* NUMA nodes that can have an arena of their own */
+#define ARENA_MAX_NODES 64
+
+typedef struct PageArenaStats {
+	int numArenas;            /* arenas that have mapped regions */
+	int numRegions;
+	int hugeTlbRegions;
+	long pagesInUse;
+	long pagesFree;
+} PageArenaStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC initPageArena (int numaNode);
+extern RC shutdownPageArena (void);
+extern SM_PageHandle allocPage (void);
+extern void freePage (SM_PageHandle page);
+extern void getPageArenaStats (PageArenaStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,343 @@
+#ifndef PAGE_FILE_HPP
+#define PAGE_FILE_HPP
+
+/* Header-only C++20 layer over storage_mgr.h: a move-only PageFile owning the
+ * SM_FileHandle, span-based page I/O, arena-backed Page buffers and iteration over
+ * page ranges. Errors are reported as std::error_code in the storage_mgr category, and
+ * the C layer's diagnostics are switched off while it is called. */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "storage_mgr.h"
+#include "page_arena.h"
+
+namespace sm {
+
+/************************************************************
+ *                    error codes                           *
+ ************************************************************/
+
+class StorageErrorCategory : public std::error_category {
+public:
+	const char *name() const noexcept override { return "storage_mgr"; }
+
+	std::string message(int rc) const override
+	{
+		switch (rc) {
+		case RC_OK: return "ok";
+		case RC_FILE_NOT_FOUND: return "file not found";
+		case RC_FILE_HANDLE_NOT_INIT: return "file handle not initialized";
+		case RC_WRITE_FAILED: return "write failed";
+		case RC_READ_NON_EXISTING_PAGE: return "read of non-existing page";
+		case RC_PAGE_CORRUPT: return "page checksum mismatch";
+		case RC_MEMORY_BUDGET_EXCEEDED: return "memory budget exceeded";
+		default: return "storage_mgr error " + std::to_string(rc);
+		}
+	}
+};
+
+inline const std::error_category &storageCategory()
+{
+	static const StorageErrorCategory category;
+	return category;
+}
+
+/* maps a storage manager return code to an error code; RC_OK becomes the empty error */
+inline std::error_code makeError(RC rc)
+{
+	return rc == RC_OK ? std::error_code() : std::error_code(rc, storageCategory());
+}
+
+/* Keeps the C layer from printing diagnostics on this thread while it lives; the outcome
+ * reaches the caller as an error code instead. */
+class QuietCalls {
+public:
+	QuietCalls() : previous_(setMessagesEnabled(0)) {}
+	~QuietCalls() { setMessagesEnabled(previous_); }
+
+	QuietCalls(const QuietCalls &) = delete;
+	QuietCalls &operator=(const QuietCalls &) = delete;
+
+private:
+	int previous_;
+};
+
+/* calls the C layer without diagnostics and maps its return code */
+template <typename Call>
+inline std::error_code quietly(Call call)
+{
+	QuietCalls quiet;
+	return makeError(call());
+}
+
+/************************************************************
+ *                    page buffers                          *
+ ************************************************************/
+
+/* An owning, aligned buffer for one page. PAGE_SIZE pages come from the page arena so
+ * allocating and dropping them does not touch malloc; other sizes use aligned_alloc. */
+class Page {
+public:
+	Page() = default;
+
+	explicit Page(int pageSize) : size_(pageSize)
+	{
+		if (pageSize == PAGE_SIZE) {
+			QuietCalls quiet;
+			data_ = allocPage();
+		}
+		else if (pageSize > 0) {
+			std::size_t alignment = pageSize < PAGE_SIZE ? (std::size_t) pageSize : (std::size_t) PAGE_SIZE;
+			data_ = static_cast<char *>(std::aligned_alloc(alignment, (std::size_t) pageSize));
+			if (data_ != nullptr)
+				std::memset(data_, 0, (std::size_t) pageSize);
+		}
+		if (data_ == nullptr)
+			size_ = 0;
+	}
+
+	~Page() { release(); }
+
+	Page(const Page &) = delete;
+	Page &operator=(const Page &) = delete;
+
+	Page(Page &&other) noexcept : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+	Page &operator=(Page &&other) noexcept
+	{
+		if (this != &other) {
+			release();
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+
+	explicit operator bool() const { return data_ != nullptr; }
+	int size() const { return size_; }
+	SM_PageHandle handle() const { return data_; }
+
+	std::span<std::byte> bytes() { return { reinterpret_cast<std::byte *>(data_), (std::size_t) size_ }; }
+	std::span<const std::byte> bytes() const { return { reinterpret_cast<const std::byte *>(data_), (std::size_t) size_ }; }
+
+private:
+	void release()
+	{
+		if (data_ == nullptr)
+			return;
+		if (size_ == PAGE_SIZE)
+			freePage(data_);
+		else
+			std::free(data_);
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	char *data_ = nullptr;
+	int size_ = 0;
+};
+
+/************************************************************
+ *                    page files                            *
+ ************************************************************/
+
+class PageFile;
+
+/* one page produced while iterating over a PageRange */
+struct PageView {
+	int pageNum;
+	std::span<const std::byte> bytes;
+};
+
+/* A range of pages [first, last) read one after another into a single reusable buffer.
+ * Iteration stops at the first failing read; error() tells why. */
+class PageRange {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = PageView;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const PageView *;
+		using reference = const PageView &;
+
+		iterator() = default;
+		iterator(PageRange *range, int pageNum) : range_(range), pageNum_(pageNum) { load(); }
+
+		reference operator*() const { return view_; }
+		pointer operator->() const { return &view_; }
+		iterator &operator++() { ++pageNum_; load(); return *this; }
+		void operator++(int) { ++*this; }
+		bool operator==(const iterator &other) const { return pageNum_ == other.pageNum_; }
+
+	private:
+		inline void load();
+
+		PageRange *range_ = nullptr;
+		int pageNum_ = 0;
+		PageView view_{};
+	};
+
+	PageRange(PageFile &file, int first, int last) : file_(&file), first_(first), last_(last) {}
+
+	inline iterator begin();
+	iterator end() { return iterator(nullptr, last_); }
+	std::error_code error() const { return error_; }
+
+private:
+	PageFile *file_;
+	int first_;
+	int last_;
+	Page buffer_;
+	std::error_code error_;
+};
+
+/* A move-only owner of an open page file. The file is closed when the object goes away.
+ * The SM_FileHandle lives on the heap, so background workers started on handle() keep a
+ * valid pointer when the PageFile is moved. */
+class PageFile {
+public:
+	PageFile() = default;
+
+	static std::error_code create(const std::string &fileName, int pageSize = PAGE_SIZE)
+	{
+		std::string name = fileName;
+		return quietly([&] { return createPageFileWithPageSize(name.data(), pageSize); });
+	}
+
+	static std::error_code destroy(const std::string &fileName)
+	{
+		std::string name = fileName;
+		return quietly([&] { return destroyPageFile(name.data()); });
+	}
+
+	static PageFile open(const std::string &fileName, std::error_code &ec)
+	{
+		PageFile file;
+		// The handle keeps a pointer to the name, so it lives in a buffer that never moves.
+		file.name_.reset(new char[fileName.size() + 1]);
+		std::memcpy(file.name_.get(), fileName.c_str(), fileName.size() + 1);
+		file.handle_.reset(new SM_FileHandle{});
+		ec = quietly([&] { return openPageFile(file.name_.get(), file.handle_.get()); });
+		if (ec)
+			return PageFile();
+		file.open_ = true;
+		return file;
+	}
+
+	~PageFile() { close(); }
+
+	PageFile(const PageFile &) = delete;
+	PageFile &operator=(const PageFile &) = delete;
+
+	PageFile(PageFile &&other) noexcept
+		: name_(std::move(other.name_)), handle_(std::move(other.handle_)), open_(std::exchange(other.open_, false)) {}
+
+	PageFile &operator=(PageFile &&other) noexcept
+	{
+		if (this != &other) {
+			close();
+			name_ = std::move(other.name_);
+			handle_ = std::move(other.handle_);
+			open_ = std::exchange(other.open_, false);
+		}
+		return *this;
+	}
+
+	std::error_code close()
+	{
+		if (!open_)
+			return {};
+		open_ = false;
+		return quietly([&] { return closePageFile(handle_.get()); });
+	}
+
+	bool isOpen() const { return open_; }
+	const char *name() const { return name_ ? name_.get() : ""; }
+	int numPages() const { return open_ ? handle_->totalNumPages : 0; }
+	int pageSize() const { return open_ ? handle_->pageSize : 0; }
+	int position() const { return open_ ? handle_->curPagePos : 0; }
+	/* stays the same pointer while the file is open, also across moves */
+	SM_FileHandle *handle() { return handle_.get(); }
+
+	/* a zeroed buffer of this file's page size */
+	Page newPage() const { return Page(pageSize()); }
+
+	/* reads a page straight into the caller's buffer, which must hold pageSize() bytes */
+	std::error_code read(int pageNum, std::span<std::byte> out)
+	{
+		if (!open_)
+			return makeError(RC_FILE_HANDLE_NOT_INIT);
+		if (out.size() < (std::size_t) handle_->pageSize)
+			return std::make_error_code(std::errc::invalid_argument);
+		return quietly([&] { return readBlock(pageNum, handle_.get(), reinterpret_cast<char *>(out.data())); });
+	}
+
+	/* writes a page straight from the caller's buffer, which must hold pageSize() bytes */
+	std::error_code write(int pageNum, std::span<const std::byte> in)
+	{
+		if (!open_)
+			return makeError(RC_FILE_HANDLE_NOT_INIT);
+		if (in.size() < (std::size_t) handle_->pageSize)
+			return std::make_error_code(std::errc::invalid_argument);
+		// writeBlock only reads from the buffer; the C signature just lacks the const.
+		char *data = const_cast<char *>(reinterpret_cast<const char *>(in.data()));
+		return quietly([&] { return writeBlock(pageNum, handle_.get(), data); });
+	}
+
+	std::error_code append()
+	{
+		return open_ ? quietly([&] { return appendEmptyBlock(handle_.get()); }) : makeError(RC_FILE_HANDLE_NOT_INIT);
+	}
+
+	std::error_code ensureCapacity(int numberOfPages)
+	{
+		return open_ ? quietly([&] { return ::ensureCapacity(numberOfPages, handle_.get()); }) : makeError(RC_FILE_HANDLE_NOT_INIT);
+	}
+
+	std::error_code sync()
+	{
+		return open_ ? quietly([&] { return syncPageFile(handle_.get()); }) : makeError(RC_FILE_HANDLE_NOT_INIT);
+	}
+
+	PageRange pages(int first, int last) { return PageRange(*this, first, last); }
+	PageRange pages() { return PageRange(*this, 0, numPages()); }
+
+private:
+	std::unique_ptr<char[]> name_;
+	std::unique_ptr<SM_FileHandle> handle_;
+	bool open_ = false;
+};
+
+inline PageRange::iterator PageRange::begin()
+{
+	if (!buffer_)
+		buffer_ = file_->newPage();
+	error_.clear();
+	return iterator(this, first_);
+}
+
+inline void PageRange::iterator::load()
+{
+	if (range_ == nullptr || pageNum_ >= range_->last_)
+		return;
+	range_->error_ = range_->file_->read(pageNum_, range_->buffer_.bytes());
+	if (range_->error_) {
+		// a failed read ends the iteration
+		pageNum_ = range_->last_;
+		return;
+	}
+	view_ = PageView{ pageNum_, range_->buffer_.bytes() };
+}
+
+} // namespace sm
+
+#endif // PAGE_FILE_HPP
@@ -0,0 +1,109 @@
+#ifndef PAGE_KERNELS_H
+#define PAGE_KERNELS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "dberror.h"
+
+/************************************************************
+ *                    supported page sizes                  *
+ ************************************************************/
+/* page sizes a page file can be created with; PAGE_SIZE stays the default */
+#define MIN_PAGE_SIZE 2048
+#define MAX_PAGE_SIZE 16384
+#define IS_SUPPORTED_PAGE_SIZE(size) \
+		((size) == 2048 || (size) == 4096 || (size) == 8192 || (size) == 16384)
+
+/************************************************************
+ *                    page kernels                          *
+ ************************************************************/
+/* Every kernel is generated once per supported page size so the loop bound is a
+ * compile-time constant the compiler can unroll and vectorize; the dispatchers at the
+ * bottom pick the variant with a switch, which costs one predictable branch. */
+
+#define PAGE_CHECKSUM_PRIME 0x100000001b3ULL
+#define PAGE_CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+#define DEFINE_PAGE_KERNELS(SIZE)												\
+		static inline void pageCopy##SIZE (char *dst, const char *src)				\
+		{																	\
+			memcpy(dst, src, SIZE);												\
+		}																	\
+		static inline int pageIsZero##SIZE (const char *page)					\
+		{																	\
+			uint64_t acc = 0;													\
+			for (int i = 0; i < SIZE; i += 8) {									\
+				uint64_t word;													\
+				memcpy(&word, page + i, 8);										\
+				acc |= word;													\
+			}																\
+			return acc == 0;													\
+		}																	\
+		static inline uint64_t pageChecksum##SIZE (const char *page)				\
+		{																	\
+			/* four independent lanes keep the multiplies from serializing */		\
+			uint64_t lane[4] = { PAGE_CHECKSUM_SEED, PAGE_CHECKSUM_SEED + 1,		\
+								 PAGE_CHECKSUM_SEED + 2, PAGE_CHECKSUM_SEED + 3 };	\
+			for (int i = 0; i < SIZE; i += 32) {									\
+				for (int j = 0; j < 4; j++) {									\
+					uint64_t word;												\
+					memcpy(&word, page + i + j * 8, 8);							\
+					lane[j] = (lane[j] ^ word) * PAGE_CHECKSUM_PRIME;			\
+				}																\
+			}																\
+			uint64_t hash = lane[0] ^ (lane[1] << 1) ^ (lane[2] << 2) ^ (lane[3] << 3); \
+			hash ^= hash >> 29;													\
+			return hash * PAGE_CHECKSUM_PRIME;									\
+		}
+
+DEFINE_PAGE_KERNELS(2048)
+DEFINE_PAGE_KERNELS(4096)
+DEFINE_PAGE_KERNELS(8192)
+DEFINE_PAGE_KERNELS(16384)
+
+/* copies one page of pageSize bytes */
+static inline void pageCopy (char *dst, const char *src, int pageSize)
+{
+	switch (pageSize) {
+	case 4096: pageCopy4096(dst, src); return;
+	case 2048: pageCopy2048(dst, src); return;
+	case 8192: pageCopy8192(dst, src); return;
+	case 16384: pageCopy16384(dst, src); return;
+	default: memcpy(dst, src, (size_t) pageSize); return;
+	}
+}
+
+/* returns non-zero if every byte of the page is zero */
+static inline int pageIsZero (const char *page, int pageSize)
+{
+	switch (pageSize) {
+	case 4096: return pageIsZero4096(page);
+	case 2048: return pageIsZero2048(page);
+	case 8192: return pageIsZero8192(page);
+	case 16384: return pageIsZero16384(page);
+	default:
+		for (int i = 0; i < pageSize; i++)
+			if (page[i] != 0)
+				return 0;
+		return 1;
+	}
+}
+
+/* fast non-cryptographic 64-bit checksum of one page */
+static inline uint64_t pageChecksum (const char *page, int pageSize)
+{
+	switch (pageSize) {
+	case 4096: return pageChecksum4096(page);
+	case 2048: return pageChecksum2048(page);
+	case 8192: return pageChecksum8192(page);
+	case 16384: return pageChecksum16384(page);
+	default: {
+		uint64_t hash = PAGE_CHECKSUM_SEED;
+		for (int i = 0; i < pageSize; i++)
+			hash = (hash ^ (unsigned char) page[i]) * PAGE_CHECKSUM_PRIME;
+		return hash;
+	}
+	}
+}
+
+#endif
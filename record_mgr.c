@@ -0,0 +1,1298 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "record_mgr.h"
+#include "storage_mgr.h"
+
+/*
+ * Tables are page files. Page 0 holds the schema and the tuple count; every other page is a
+ * slotted page: a header, an array of slots growing from the front and the tuples growing
+ * from the back. A stored tuple has the ints, floats and bools of the record first, at fixed
+ * offsets, followed by every string as a 16-bit length and its bytes, so short strings take
+ * little room and tuples of one table can differ in length.
+ *
+ * A record keeps its RID for its whole life. When an update no longer fits in the record's
+ * page, the tuple moves to another page and its slot keeps a forward pointer; the moved tuple
+ * starts with the RID it belongs to, so scans report it under that RID and skip the pointer.
+ *
+ * Scans filter a whole page at a time: the attribute of every predicate is decoded for all
+ * slots of the page into a column array, and each predicate is applied to the column in a
+ * loop without branches that the compiler can vectorize.
+ */
+
+typedef struct TablePageHeader {
+    int32_t numSlots;
+    /* first byte of the tuple area */
+    int32_t freeEnd;
+    /* bytes of removed tuples inside the tuple area, reclaimed by compacting the page */
+    int32_t garbage;
+    int32_t reserved;
+} TablePageHeader;
+
+typedef struct TableSlot {
+    uint16_t offset;
+    uint16_t length;
+    uint16_t flags;
+    uint16_t reserved;
+} TableSlot;
+
+/* what a slot holds */
+#define SLOT_FREE 0
+#define SLOT_LIVE 1
+/* the RID of the page and slot the record moved to */
+#define SLOT_FORWARD 2
+/* a record that moved here, starting with the RID of its home slot */
+#define SLOT_MOVED 3
+
+/* every tuple takes at least this much room, so it can always be replaced by a forward pointer */
+#define MIN_TUPLE_SPACE ((int) sizeof(RID))
+
+typedef struct TableMgmt {
+    SM_FileHandle fHandle;
+    int numTuples;
+    int metaDirty;
+    /* bytes a new tuple may take in every page; entry 0 is unused */
+    int *pageRoom;
+    int roomCapacity;
+    int lastPage;
+    /* where every attribute is in a record, and in a tuple for the fixed size ones;
+     * strings have -1 - their position among the strings */
+    int *recordOffset;
+    int *tupleOffset;
+    int fixedSize;
+    int maxTupleSize;
+    char *page;
+    char *other;
+    char *tuple;
+    char *compactBuffer;
+} TableMgmt;
+
+typedef struct TableScan {
+    RM_Predicate *preds;
+    int numPreds;
+    int pageNum;
+    int slot;
+    char *page;
+    uint8_t *selected;
+    /* where the tuple of every slot starts in the page */
+    int32_t *starts;
+    int32_t *ints;
+    float *floats;
+} TableScan;
+
+#define PAGE_HEADER(page) ((TablePageHeader*) (page))
+#define PAGE_SLOTS(page) ((TableSlot*) ((page) + TABLE_PAGE_HEADER_SIZE))
+#define TUPLE_SPACE(length) ((length) > MIN_TUPLE_SPACE ? (length) : MIN_TUPLE_SPACE)
+
+
+/************************************************************
+ *                    schema and tuple layout               *
+ ************************************************************/
+
+static int attrSize(Schema *schema, int attrNum)
+{
+    switch (schema->dataTypes[attrNum]) {
+    case DT_INT:
+        return (int) sizeof(int);
+    case DT_FLOAT:
+        return (int) sizeof(float);
+    case DT_BOOL:
+        return (int) sizeof(bool);
+    case DT_STRING:
+        return schema->typeLength[attrNum];
+    }
+    return 0;
+}
+
+/**
+ * @brief Computes where every attribute is in a record and in a stored tuple.
+ */
+static RC buildLayout(TableMgmt *mgmt, Schema *schema)
+{
+    mgmt->recordOffset = (int*) malloc(sizeof(int) * (size_t) (schema->numAttr + 1));
+    mgmt->tupleOffset = (int*) malloc(sizeof(int) * (size_t) (schema->numAttr + 1));
+    if (mgmt->recordOffset == NULL || mgmt->tupleOffset == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    int recordOffset = 0, numStrings = 0, stringBytes = 0;
+    mgmt->fixedSize = 0;
+    for (int i = 0; i < schema->numAttr; i++) {
+        mgmt->recordOffset[i] = recordOffset;
+        recordOffset += attrSize(schema, i);
+        if (schema->dataTypes[i] == DT_STRING) {
+            mgmt->tupleOffset[i] = -1 - numStrings++;
+            stringBytes += (int) sizeof(uint16_t) + schema->typeLength[i];
+        }
+        else {
+            mgmt->tupleOffset[i] = mgmt->fixedSize;
+            mgmt->fixedSize += attrSize(schema, i);
+        }
+    }
+    mgmt->maxTupleSize = mgmt->fixedSize + stringBytes;
+    return RC_OK;
+}
+
+/**
+ * @brief Returns the string of a tuple that is numString-th among its strings.
+ */
+static const char *tupleString(TableMgmt *mgmt, const char *tuple, int numString, int *length)
+{
+    const char *pos = tuple + mgmt->fixedSize;
+    for (int i = 0; ; i++) {
+        uint16_t len;
+        memcpy(&len, pos, sizeof(len));
+        if (i == numString) {
+            *length = len;
+            return pos + sizeof(len);
+        }
+        pos += sizeof(len) + len;
+    }
+}
+
+/**
+ * @brief Turns a record into the stored form and returns its length.
+ */
+static int encodeTuple(TableMgmt *mgmt, Schema *schema, const char *data, char *tuple)
+{
+    int length = mgmt->fixedSize;
+    for (int i = 0; i < schema->numAttr; i++) {
+        const char *value = data + mgmt->recordOffset[i];
+        if (schema->dataTypes[i] != DT_STRING) {
+            memcpy(tuple + mgmt->tupleOffset[i], value, (size_t) attrSize(schema, i));
+        }
+        else {
+            uint16_t len = (uint16_t) strnlen(value, (size_t) schema->typeLength[i]);
+            memcpy(tuple + length, &len, sizeof(len));
+            memcpy(tuple + length + sizeof(len), value, len);
+            length += (int) sizeof(len) + len;
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Turns a stored tuple back into a record.
+ */
+static void decodeTuple(TableMgmt *mgmt, Schema *schema, const char *tuple, char *data)
+{
+    for (int i = 0; i < schema->numAttr; i++) {
+        char *value = data + mgmt->recordOffset[i];
+        if (schema->dataTypes[i] != DT_STRING) {
+            memcpy(value, tuple + mgmt->tupleOffset[i], (size_t) attrSize(schema, i));
+        }
+        else {
+            int len;
+            const char *str = tupleString(mgmt, tuple, -1 - mgmt->tupleOffset[i], &len);
+            memset(value, 0, (size_t) schema->typeLength[i]);
+            memcpy(value, str, (size_t) len);
+        }
+    }
+}
+
+
+/************************************************************
+ *                    slotted pages                         *
+ ************************************************************/
+
+static void initDataPage(char *page, int pageSize)
+{
+    memset(page, 0, (size_t) pageSize);
+    PAGE_HEADER(page)->freeEnd = pageSize;
+}
+
+static int findFreeSlot(char *page)
+{
+    TableSlot *slots = PAGE_SLOTS(page);
+    for (int i = 0; i < PAGE_HEADER(page)->numSlots; i++) {
+        if (slots[i].flags == SLOT_FREE) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Bytes a new tuple may take in a page, after compacting it if needed.
+ */
+static int dataPageRoom(char *page)
+{
+    TablePageHeader *header = PAGE_HEADER(page);
+    int room = header->freeEnd - TABLE_PAGE_HEADER_SIZE - TABLE_SLOT_SIZE * header->numSlots + header->garbage;
+    if (findFreeSlot(page) == -1) {
+        room -= TABLE_SLOT_SIZE;
+    }
+    return room > 0 ? room : 0;
+}
+
+/**
+ * @brief Moves all tuples of a page to its end so the free bytes are in one piece.
+ */
+static void compactDataPage(char *page, int pageSize, char *buffer)
+{
+    TablePageHeader *header = PAGE_HEADER(page);
+    TableSlot *slots = PAGE_SLOTS(page);
+    int freeEnd = pageSize;
+    for (int i = 0; i < header->numSlots; i++) {
+        if (slots[i].flags != SLOT_FREE) {
+            int space = TUPLE_SPACE(slots[i].length);
+            freeEnd -= space;
+            memcpy(buffer + freeEnd, page + slots[i].offset, (size_t) space);
+            slots[i].offset = (uint16_t) freeEnd;
+        }
+    }
+    memcpy(page + freeEnd, buffer + freeEnd, (size_t) (pageSize - freeEnd));
+    header->freeEnd = freeEnd;
+    header->garbage = 0;
+}
+
+/**
+ * @brief Stores a tuple in a page, in the given free slot or, with slotNum -1, in any free slot
+ *        or a new one. The caller has checked that the page has room.
+ * @return the slot of the tuple.
+ */
+static int placeTuple(char *page, int pageSize, char *buffer, int slotNum, const char *data, int length, int flags)
+{
+    TablePageHeader *header = PAGE_HEADER(page);
+    if (slotNum == -1) {
+        slotNum = findFreeSlot(page);
+    }
+    int newSlot = slotNum == -1;
+    int space = TUPLE_SPACE(length);
+    int contiguous = header->freeEnd - TABLE_PAGE_HEADER_SIZE - TABLE_SLOT_SIZE * (header->numSlots + newSlot);
+    if (contiguous < space) {
+        compactDataPage(page, pageSize, buffer);
+    }
+    if (newSlot) {
+        slotNum = header->numSlots++;
+    }
+    header->freeEnd -= space;
+    memcpy(page + header->freeEnd, data, (size_t) length);
+    TableSlot *slot = &PAGE_SLOTS(page)[slotNum];
+    slot->offset = (uint16_t) header->freeEnd;
+    slot->length = (uint16_t) length;
+    slot->flags = (uint16_t) flags;
+    return slotNum;
+}
+
+/**
+ * @brief Frees the room of a tuple; its slot stays reserved until placeTuple reuses it.
+ */
+static void releaseTuple(char *page, int slotNum)
+{
+    TableSlot *slot = &PAGE_SLOTS(page)[slotNum];
+    PAGE_HEADER(page)->garbage += TUPLE_SPACE(slot->length);
+    slot->flags = SLOT_FREE;
+    slot->offset = 0;
+    slot->length = 0;
+}
+
+/**
+ * @brief Removes a tuple and drops free slots at the end of the slot array.
+ */
+static void removeTuple(char *page, int slotNum)
+{
+    releaseTuple(page, slotNum);
+    TablePageHeader *header = PAGE_HEADER(page);
+    while (header->numSlots > 0 && PAGE_SLOTS(page)[header->numSlots - 1].flags == SLOT_FREE) {
+        header->numSlots--;
+    }
+}
+
+/**
+ * @brief Replaces the tuple of a slot if the new one fits in the page.
+ * @return non-zero if it was replaced.
+ */
+static int replaceTuple(char *page, int pageSize, char *buffer, int slotNum, const char *data, int length, int flags)
+{
+    TableSlot *slot = &PAGE_SLOTS(page)[slotNum];
+    int oldSpace = TUPLE_SPACE(slot->length);
+    int space = TUPLE_SPACE(length);
+    if (space <= oldSpace) {
+        memcpy(page + slot->offset, data, (size_t) length);
+        PAGE_HEADER(page)->garbage += oldSpace - space;
+        slot->length = (uint16_t) length;
+        slot->flags = (uint16_t) flags;
+        return 1;
+    }
+    // The slot already exists, so only its tuple bytes count against the page.
+    TablePageHeader *header = PAGE_HEADER(page);
+    int room = header->freeEnd - TABLE_PAGE_HEADER_SIZE - TABLE_SLOT_SIZE * header->numSlots + header->garbage;
+    if (room + oldSpace < space) {
+        return 0;
+    }
+    releaseTuple(page, slotNum);
+    placeTuple(page, pageSize, buffer, slotNum, data, length, flags);
+    return 1;
+}
+
+
+/************************************************************
+ *                    table pages                           *
+ ************************************************************/
+
+static RC loadPage(TableMgmt *mgmt, int pageNum, char *page)
+{
+    if (pageNum < 1 || pageNum >= mgmt->fHandle.totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    return readBlock(pageNum, &mgmt->fHandle, page);
+}
+
+static RC storePage(TableMgmt *mgmt, int pageNum, char *page)
+{
+    mgmt->pageRoom[pageNum] = dataPageRoom(page);
+    return writeBlock(pageNum, &mgmt->fHandle, page);
+}
+
+/**
+ * @brief Finds a data page other than excludePage with room for space bytes, trying the page
+ *        of the last insert first and appending a new page if no page has room.
+ */
+static RC findPageWithRoom(TableMgmt *mgmt, int space, int excludePage, int *pageNum)
+{
+    int numPages = mgmt->fHandle.totalNumPages;
+    if (mgmt->lastPage > 0 && mgmt->lastPage < numPages && mgmt->lastPage != excludePage
+        && mgmt->pageRoom[mgmt->lastPage] >= space) {
+        *pageNum = mgmt->lastPage;
+        return RC_OK;
+    }
+    for (int i = 1; i < numPages; i++) {
+        if (i != excludePage && mgmt->pageRoom[i] >= space) {
+            *pageNum = mgmt->lastPage = i;
+            return RC_OK;
+        }
+    }
+    if (numPages >= mgmt->roomCapacity) {
+        int capacity = mgmt->roomCapacity * 2;
+        int *room = (int*) realloc(mgmt->pageRoom, sizeof(int) * (size_t) capacity);
+        if (room == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        mgmt->pageRoom = room;
+        mgmt->roomCapacity = capacity;
+    }
+    RC rc = appendEmptyBlock(&mgmt->fHandle);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    initDataPage(mgmt->other, mgmt->fHandle.pageSize);
+    if ((rc = storePage(mgmt, numPages, mgmt->other)) != RC_OK) {
+        return rc;
+    }
+    *pageNum = mgmt->lastPage = numPages;
+    return RC_OK;
+}
+
+/**
+ * @brief Stores the tuple of a record whose own page is full in another page, prefixed with
+ *        the record's RID.
+ */
+static RC placeMovedTuple(TableMgmt *mgmt, RID home, const char *tuple, int length, RID *target)
+{
+    int movedLength = (int) sizeof(RID) + length;
+    int pageNum;
+    RC rc = findPageWithRoom(mgmt, TUPLE_SPACE(movedLength), home.page, &pageNum);
+    if (rc != RC_OK || (rc = loadPage(mgmt, pageNum, mgmt->other)) != RC_OK) {
+        return rc;
+    }
+    char *moved = (char*) malloc((size_t) movedLength);
+    if (moved == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    memcpy(moved, &home, sizeof(RID));
+    memcpy(moved + sizeof(RID), tuple, (size_t) length);
+    target->page = pageNum;
+    target->slot = placeTuple(mgmt->other, mgmt->fHandle.pageSize, mgmt->compactBuffer, -1, moved, movedLength, SLOT_MOVED);
+    free(moved);
+    return storePage(mgmt, pageNum, mgmt->other);
+}
+
+/**
+ * @brief Loads the page of a record id and checks that the slot holds a record.
+ */
+static RC loadHomeSlot(TableMgmt *mgmt, RID id, TableSlot **slot)
+{
+    RC rc = loadPage(mgmt, id.page, mgmt->page);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (id.slot < 0 || id.slot >= PAGE_HEADER(mgmt->page)->numSlots) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    *slot = &PAGE_SLOTS(mgmt->page)[id.slot];
+    if ((*slot)->flags != SLOT_LIVE && (*slot)->flags != SLOT_FORWARD) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    return RC_OK;
+}
+
+static RC writeTableMeta(TableMgmt *mgmt, Schema *schema, char *page);
+
+
+/************************************************************
+ *                    scan filters                          *
+ ************************************************************/
+
+/* applies one comparison to a whole column; the compiler turns each loop into vector compares */
+#define FILTER_COLUMN(selected, column, numSlots, op, constant)					\
+		do {																	\
+			switch (op) {														\
+			case RM_EQ: for (int i_ = 0; i_ < (numSlots); i_++) (selected)[i_] &= (column)[i_] == (constant); break; \
+			case RM_NE: for (int i_ = 0; i_ < (numSlots); i_++) (selected)[i_] &= (column)[i_] != (constant); break; \
+			case RM_LT: for (int i_ = 0; i_ < (numSlots); i_++) (selected)[i_] &= (column)[i_] < (constant); break; \
+			case RM_LE: for (int i_ = 0; i_ < (numSlots); i_++) (selected)[i_] &= (column)[i_] <= (constant); break; \
+			case RM_GT: for (int i_ = 0; i_ < (numSlots); i_++) (selected)[i_] &= (column)[i_] > (constant); break; \
+			case RM_GE: for (int i_ = 0; i_ < (numSlots); i_++) (selected)[i_] &= (column)[i_] >= (constant); break; \
+			}																	\
+		} while (0)
+
+static int compareString(const char *str, int length, const char *constant)
+{
+    int constLength = (int) strlen(constant);
+    int cmp = memcmp(str, constant, (size_t) (length < constLength ? length : constLength));
+    return cmp != 0 ? cmp : length - constLength;
+}
+
+/**
+ * @brief Marks the slots of the scan's page whose record satisfies every predicate.
+ */
+static void filterPage(TableMgmt *mgmt, Schema *schema, TableScan *scan)
+{
+    char *page = scan->page;
+    TableSlot *slots = PAGE_SLOTS(page);
+    int numSlots = PAGE_HEADER(page)->numSlots;
+    uint8_t *selected = scan->selected;
+    int32_t *starts = scan->starts;
+    // Slots without a record start at the page header, which is harmless to decode and saves
+    // a branch per slot in the column loops.
+    for (int i = 0; i < numSlots; i++) {
+        int moved = slots[i].flags == SLOT_MOVED;
+        selected[i] = (slots[i].flags == SLOT_LIVE) | moved;
+        starts[i] = selected[i] ? slots[i].offset + moved * (int) sizeof(RID) : 0;
+    }
+    for (int p = 0; p < scan->numPreds; p++) {
+        RM_Predicate *pred = &scan->preds[p];
+        int offset = mgmt->tupleOffset[pred->attrNum];
+        switch (schema->dataTypes[pred->attrNum]) {
+        case DT_INT:
+            for (int i = 0; i < numSlots; i++) {
+                memcpy(&scan->ints[i], page + starts[i] + offset, sizeof(int32_t));
+            }
+            FILTER_COLUMN(selected, scan->ints, numSlots, pred->op, pred->value.v.intV);
+            break;
+        case DT_FLOAT:
+            for (int i = 0; i < numSlots; i++) {
+                memcpy(&scan->floats[i], page + starts[i] + offset, sizeof(float));
+            }
+            FILTER_COLUMN(selected, scan->floats, numSlots, pred->op, pred->value.v.floatV);
+            break;
+        case DT_BOOL:
+            for (int i = 0; i < numSlots; i++) {
+                scan->ints[i] = page[starts[i] + offset] != 0;
+            }
+            FILTER_COLUMN(selected, scan->ints, numSlots, pred->op, (int32_t) (pred->value.v.boolV != 0));
+            break;
+        case DT_STRING:
+            // Strings are compared once per selected slot; the result column is filtered like ints.
+            for (int i = 0; i < numSlots; i++) {
+                int length;
+                scan->ints[i] = 0;
+                if (selected[i]) {
+                    const char *str = tupleString(mgmt, page + starts[i], -1 - offset, &length);
+                    scan->ints[i] = compareString(str, length, pred->value.v.stringV);
+                }
+            }
+            FILTER_COLUMN(selected, scan->ints, numSlots, pred->op, 0);
+            break;
+        }
+    }
+}
+
+
+/************************************************************
+ *                    table and manager                     *
+ ************************************************************/
+
+/**
+ * @brief Initializes the record manager and the storage manager below it.
+ *
+ * @param mgmtData Unused.
+ * @return RC_OK
+ */
+RC initRecordManager(void *mgmtData)
+{
+    (void) mgmtData;
+    initStorageManager();
+    return RC_OK;
+}
+
+
+/**
+ * @brief Shuts the record manager down. Open tables have to be closed first.
+ *
+ * @return RC_OK
+ */
+RC shutdownRecordManager(void)
+{
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns how many bytes the tuple count and the schema take on page 0.
+ */
+static long tableMetaSize(Schema *schema)
+{
+    long size = 8 + (long) sizeof(int32_t) * (3 + 2 * (long) schema->numAttr + schema->keySize);
+    for (int i = 0; i < schema->numAttr; i++) {
+        size += (long) strlen(schema->attrNames[i]) + 1;
+    }
+    return size;
+}
+
+
+/**
+ * @brief Writes the tuple count and the schema to page 0.
+ */
+static RC writeTableMeta(TableMgmt *mgmt, Schema *schema, char *page)
+{
+    int pageSize = mgmt->fHandle.pageSize;
+    if (tableMetaSize(schema) > pageSize) {
+        printMessage("The schema does not fit in a page.\n");
+        return RC_WRITE_FAILED;
+    }
+    memset(page, 0, (size_t) pageSize);
+    memcpy(page, TABLE_MAGIC, 8);
+    int32_t *ints = (int32_t*) (page + 8);
+    ints[0] = mgmt->numTuples;
+    ints[1] = schema->numAttr;
+    ints[2] = schema->keySize;
+    int pos = 3;
+    for (int i = 0; i < schema->numAttr; i++) {
+        ints[pos++] = schema->dataTypes[i];
+        ints[pos++] = schema->typeLength[i];
+    }
+    for (int i = 0; i < schema->keySize; i++) {
+        ints[pos++] = schema->keyAttrs[i];
+    }
+    int offset = 8 + pos * (int) sizeof(int32_t);
+    for (int i = 0; i < schema->numAttr; i++) {
+        int len = (int) strlen(schema->attrNames[i]) + 1;
+        memcpy(page + offset, schema->attrNames[i], (size_t) len);
+        offset += len;
+    }
+    RC rc = writeBlock(0, &mgmt->fHandle, page);
+    if (rc == RC_OK) {
+        mgmt->metaDirty = 0;
+    }
+    return rc;
+}
+
+/**
+ * @brief Reads the schema and tuple count from page 0.
+ */
+static RC readTableMeta(TableMgmt *mgmt, char *page, Schema **schema)
+{
+    RC rc = readBlock(0, &mgmt->fHandle, page);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    int32_t *ints = (int32_t*) (page + 8);
+    int numAttr = ints[1], keySize = ints[2];
+    int maxAttrs = (mgmt->fHandle.pageSize - 8) / (int) sizeof(int32_t) / 3;
+    if (memcmp(page, TABLE_MAGIC, 8) != 0 || numAttr <= 0 || numAttr > maxAttrs || keySize < 0 || keySize > numAttr) {
+        printMessage("The file %s is not a table!\n", mgmt->fHandle.fileName);
+        return RC_PAGE_CORRUPT;
+    }
+    mgmt->numTuples = ints[0];
+    char **names = (char**) calloc((size_t) numAttr, sizeof(char*));
+    DataType *types = (DataType*) malloc(sizeof(DataType) * (size_t) numAttr);
+    int *lengths = (int*) malloc(sizeof(int) * (size_t) numAttr);
+    int *keys = (int*) malloc(sizeof(int) * (size_t) (keySize > 0 ? keySize : 1));
+    if (names == NULL || types == NULL || lengths == NULL || keys == NULL) {
+        free(names);
+        free(types);
+        free(lengths);
+        free(keys);
+        return RC_WRITE_FAILED;
+    }
+    int pos = 3;
+    for (int i = 0; i < numAttr; i++) {
+        types[i] = (DataType) ints[pos++];
+        lengths[i] = ints[pos++];
+    }
+    for (int i = 0; i < keySize; i++) {
+        keys[i] = ints[pos++];
+    }
+    char *name = page + 8 + pos * (int) sizeof(int32_t);
+    for (int i = 0; i < numAttr; i++) {
+        names[i] = strdup(name);
+        name += strlen(name) + 1;
+    }
+    *schema = createSchema(numAttr, names, types, lengths, keySize, keys);
+    return *schema != NULL ? RC_OK : RC_WRITE_FAILED;
+}
+
+
+/**
+ * @brief Creates a table in a new page file holding only its schema.
+ *
+ * @param name Name of the page file of the table.
+ * @param schema The attributes of the records. The table keeps its own copy.
+ * @return RC_OK if successful.
+ *         RC_RM_UNKOWN_DATATYPE if an attribute has an unknown type.
+ *         RC_WRITE_FAILED if a record or the schema does not fit in a page.
+ */
+RC createTable(char *name, Schema *schema)
+{
+    if (name == NULL || schema == NULL || schema->numAttr <= 0) {
+        printMessage("The table can't be created because its name or schema is missing.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    for (int i = 0; i < schema->numAttr; i++) {
+        if ((int) schema->dataTypes[i] < DT_INT || schema->dataTypes[i] > DT_BOOL
+            || (schema->dataTypes[i] == DT_STRING && (schema->typeLength[i] <= 0 || schema->typeLength[i] > UINT16_MAX))) {
+            printMessage("Attribute %d of the schema has an unknown type.\n", i);
+            return RC_RM_UNKOWN_DATATYPE;
+        }
+    }
+    TableMgmt mgmt;
+    memset(&mgmt, 0, sizeof(mgmt));
+    RC rc = buildLayout(&mgmt, schema);
+    // A moved record needs its tuple, its home RID and one slot in a page of its own.
+    if (rc == RC_OK && mgmt.maxTupleSize + (int) sizeof(RID) > PAGE_SIZE - TABLE_PAGE_HEADER_SIZE - TABLE_SLOT_SIZE) {
+        printMessage("Records of this schema do not fit in a page.\n");
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK && tableMetaSize(schema) > PAGE_SIZE) {
+        printMessage("The schema does not fit in a page.\n");
+        rc = RC_WRITE_FAILED;
+    }
+    free(mgmt.recordOffset);
+    free(mgmt.tupleOffset);
+    if (rc != RC_OK || (rc = createPageFile(name)) != RC_OK) {
+        return rc;
+    }
+    if ((rc = openPageFile(name, &mgmt.fHandle)) != RC_OK) {
+        return rc;
+    }
+    char *page = (char*) malloc((size_t) mgmt.fHandle.pageSize);
+    rc = page == NULL ? RC_WRITE_FAILED : writeTableMeta(&mgmt, schema, page);
+    free(page);
+    RC closeCheck = closePageFile(&mgmt.fHandle);
+    if (rc != RC_OK) {
+        destroyPageFile(name);
+        return rc;
+    }
+    return closeCheck;
+}
+
+
+/**
+ * @brief Opens a table. The free room of every data page is read once, so inserts find a page
+ *        with room without reading pages.
+ *
+ * @param rel Receives the open table, including its schema.
+ * @param name Name of the page file of the table.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the table does not exist.
+ *         RC_PAGE_CORRUPT if the file is not a table.
+ */
+RC openTable(RM_TableData *rel, char *name)
+{
+    if (rel == NULL || name == NULL) {
+        printMessage("The table can't be opened because its name or handle is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableMgmt *mgmt = (TableMgmt*) calloc(1, sizeof(TableMgmt));
+    char *tableName = strdup(name);
+    if (mgmt == NULL || tableName == NULL) {
+        free(mgmt);
+        free(tableName);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = openPageFile(tableName, &mgmt->fHandle);
+    if (rc != RC_OK) {
+        free(mgmt);
+        free(tableName);
+        return rc;
+    }
+    rel->name = tableName;
+    rel->schema = NULL;
+    rel->mgmtData = mgmt;
+    size_t pageSize = (size_t) mgmt->fHandle.pageSize;
+    mgmt->page = (char*) malloc(pageSize);
+    mgmt->other = (char*) malloc(pageSize);
+    mgmt->tuple = (char*) malloc(pageSize);
+    mgmt->compactBuffer = (char*) malloc(pageSize);
+    mgmt->roomCapacity = mgmt->fHandle.totalNumPages + 16;
+    mgmt->pageRoom = (int*) calloc((size_t) mgmt->roomCapacity, sizeof(int));
+    if (mgmt->page == NULL || mgmt->other == NULL || mgmt->tuple == NULL || mgmt->compactBuffer == NULL
+        || mgmt->pageRoom == NULL) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK) {
+        rc = readTableMeta(mgmt, mgmt->page, &rel->schema);
+    }
+    if (rc == RC_OK) {
+        rc = buildLayout(mgmt, rel->schema);
+    }
+    for (int i = 1; rc == RC_OK && i < mgmt->fHandle.totalNumPages; i++) {
+        if ((rc = readBlock(i, &mgmt->fHandle, mgmt->page)) == RC_OK) {
+            mgmt->pageRoom[i] = dataPageRoom(mgmt->page);
+        }
+    }
+    if (rc != RC_OK) {
+        closeTable(rel);
+        return rc;
+    }
+    return RC_OK;
+}
+
+
+/**
+ * @brief Writes the tuple count of a table and closes it.
+ *
+ * @param rel The open table.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the table is not open.
+ */
+RC closeTable(RM_TableData *rel)
+{
+    if (rel == NULL || rel->mgmtData == NULL) {
+        printMessage("The table is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableMgmt *mgmt = (TableMgmt*) rel->mgmtData;
+    RC rc = mgmt->metaDirty && rel->schema != NULL ? writeTableMeta(mgmt, rel->schema, mgmt->page) : RC_OK;
+    if (closePageFile(&mgmt->fHandle) != RC_OK && rc == RC_OK) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(mgmt->pageRoom);
+    free(mgmt->recordOffset);
+    free(mgmt->tupleOffset);
+    free(mgmt->page);
+    free(mgmt->other);
+    free(mgmt->tuple);
+    free(mgmt->compactBuffer);
+    free(mgmt);
+    if (rel->schema != NULL) {
+        freeSchema(rel->schema);
+    }
+    free(rel->name);
+    rel->name = NULL;
+    rel->schema = NULL;
+    rel->mgmtData = NULL;
+    return rc;
+}
+
+
+/**
+ * @brief Removes the page file of a table that is not open.
+ */
+RC deleteTable(char *name)
+{
+    return destroyPageFile(name);
+}
+
+
+/**
+ * @brief Returns the number of records in a table.
+ */
+int getNumTuples(RM_TableData *rel)
+{
+    if (rel == NULL || rel->mgmtData == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return ((TableMgmt*) rel->mgmtData)->numTuples;
+}
+
+
+/************************************************************
+ *                    handling records                      *
+ ************************************************************/
+
+/**
+ * @brief Adds a record to a page with room and stores its RID in record->id.
+ *
+ * @param rel The open table.
+ * @param record The record; its id is set.
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if the record could not be written.
+ */
+RC insertRecord(RM_TableData *rel, Record *record)
+{
+    if (rel == NULL || rel->mgmtData == NULL || record == NULL || record->data == NULL) {
+        printMessage("The table is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableMgmt *mgmt = (TableMgmt*) rel->mgmtData;
+    int length = encodeTuple(mgmt, rel->schema, record->data, mgmt->tuple);
+    int pageNum;
+    RC rc = findPageWithRoom(mgmt, TUPLE_SPACE(length), -1, &pageNum);
+    if (rc != RC_OK || (rc = loadPage(mgmt, pageNum, mgmt->page)) != RC_OK) {
+        return rc;
+    }
+    record->id.page = pageNum;
+    record->id.slot = placeTuple(mgmt->page, mgmt->fHandle.pageSize, mgmt->compactBuffer, -1, mgmt->tuple, length, SLOT_LIVE);
+    if ((rc = storePage(mgmt, pageNum, mgmt->page)) == RC_OK) {
+        mgmt->numTuples++;
+        mgmt->metaDirty = 1;
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Removes a record, including the tuple it moved to.
+ *
+ * @param rel The open table.
+ * @param id The record id.
+ * @return RC_OK if successful.
+ *         RC_READ_NON_EXISTING_PAGE if there is no record with this id.
+ */
+RC deleteRecord(RM_TableData *rel, RID id)
+{
+    if (rel == NULL || rel->mgmtData == NULL) {
+        printMessage("The table is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableMgmt *mgmt = (TableMgmt*) rel->mgmtData;
+    TableSlot *slot;
+    RC rc = loadHomeSlot(mgmt, id, &slot);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (slot->flags == SLOT_FORWARD) {
+        RID target;
+        memcpy(&target, mgmt->page + slot->offset, sizeof(RID));
+        if ((rc = loadPage(mgmt, target.page, mgmt->other)) != RC_OK) {
+            return rc;
+        }
+        removeTuple(mgmt->other, target.slot);
+        if ((rc = storePage(mgmt, target.page, mgmt->other)) != RC_OK) {
+            return rc;
+        }
+    }
+    removeTuple(mgmt->page, id.slot);
+    if ((rc = storePage(mgmt, id.page, mgmt->page)) == RC_OK) {
+        mgmt->numTuples--;
+        mgmt->metaDirty = 1;
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Replaces the record with the id record->id. A record that no longer fits in its page
+ *        moves to another page and keeps its id.
+ *
+ * @param rel The open table.
+ * @param record The new content and the id of the record.
+ * @return RC_OK if successful.
+ *         RC_READ_NON_EXISTING_PAGE if there is no record with this id.
+ */
+RC updateRecord(RM_TableData *rel, Record *record)
+{
+    if (rel == NULL || rel->mgmtData == NULL || record == NULL || record->data == NULL) {
+        printMessage("The table is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableMgmt *mgmt = (TableMgmt*) rel->mgmtData;
+    int pageSize = mgmt->fHandle.pageSize;
+    RID id = record->id;
+    TableSlot *slot;
+    RC rc = loadHomeSlot(mgmt, id, &slot);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    int length = encodeTuple(mgmt, rel->schema, record->data, mgmt->tuple);
+    if (slot->flags == SLOT_LIVE) {
+        if (replaceTuple(mgmt->page, pageSize, mgmt->compactBuffer, id.slot, mgmt->tuple, length, SLOT_LIVE)) {
+            return storePage(mgmt, id.page, mgmt->page);
+        }
+    }
+    else {
+        RID target;
+        memcpy(&target, mgmt->page + slot->offset, sizeof(RID));
+        // Back home if the page has room again, otherwise in place where it moved to.
+        if (replaceTuple(mgmt->page, pageSize, mgmt->compactBuffer, id.slot, mgmt->tuple, length, SLOT_LIVE)) {
+            if ((rc = storePage(mgmt, id.page, mgmt->page)) != RC_OK
+                || (rc = loadPage(mgmt, target.page, mgmt->other)) != RC_OK) {
+                return rc;
+            }
+            removeTuple(mgmt->other, target.slot);
+            return storePage(mgmt, target.page, mgmt->other);
+        }
+        if ((rc = loadPage(mgmt, target.page, mgmt->other)) != RC_OK) {
+            return rc;
+        }
+        memcpy(mgmt->compactBuffer, &id, sizeof(RID));
+        memcpy(mgmt->compactBuffer + sizeof(RID), mgmt->tuple, (size_t) length);
+        memcpy(mgmt->tuple, mgmt->compactBuffer, sizeof(RID) + (size_t) length);
+        if (replaceTuple(mgmt->other, pageSize, mgmt->compactBuffer, target.slot, mgmt->tuple, (int) sizeof(RID) + length, SLOT_MOVED)) {
+            return storePage(mgmt, target.page, mgmt->other);
+        }
+        removeTuple(mgmt->other, target.slot);
+        if ((rc = storePage(mgmt, target.page, mgmt->other)) != RC_OK) {
+            return rc;
+        }
+        // The tuple is moved again below; drop the RID prefix added above.
+        memmove(mgmt->tuple, mgmt->tuple + sizeof(RID), (size_t) length);
+    }
+    // The home slot keeps a forward pointer, which always fits in the room of the old tuple.
+    RID target;
+    if ((rc = placeMovedTuple(mgmt, id, mgmt->tuple, length, &target)) != RC_OK) {
+        return rc;
+    }
+    replaceTuple(mgmt->page, pageSize, mgmt->compactBuffer, id.slot, (char*) &target, (int) sizeof(RID), SLOT_FORWARD);
+    return storePage(mgmt, id.page, mgmt->page);
+}
+
+
+/**
+ * @brief Reads a record, following its forward pointer if it moved.
+ *
+ * @param rel The open table.
+ * @param id The record id.
+ * @param record Receives the record; its data must hold getRecordSize bytes.
+ * @return RC_OK if successful.
+ *         RC_READ_NON_EXISTING_PAGE if there is no record with this id.
+ */
+RC getRecord(RM_TableData *rel, RID id, Record *record)
+{
+    if (rel == NULL || rel->mgmtData == NULL || record == NULL || record->data == NULL) {
+        printMessage("The table is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableMgmt *mgmt = (TableMgmt*) rel->mgmtData;
+    TableSlot *slot;
+    RC rc = loadHomeSlot(mgmt, id, &slot);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    const char *tuple = mgmt->page + slot->offset;
+    if (slot->flags == SLOT_FORWARD) {
+        RID target;
+        memcpy(&target, tuple, sizeof(RID));
+        if ((rc = loadPage(mgmt, target.page, mgmt->other)) != RC_OK) {
+            return rc;
+        }
+        tuple = mgmt->other + PAGE_SLOTS(mgmt->other)[target.slot].offset + sizeof(RID);
+    }
+    decodeTuple(mgmt, rel->schema, tuple, record->data);
+    record->id = id;
+    return RC_OK;
+}
+
+
+/************************************************************
+ *                    scans                                 *
+ ************************************************************/
+
+/**
+ * @brief Starts a scan over the records that satisfy all predicates. Every page is read once
+ *        and filtered as a whole before its records are returned.
+ *
+ * @param rel The open table. It must not be changed while the scan is open.
+ * @param scan Receives the scan.
+ * @param preds Comparisons of attributes with constants; strings must stay valid while the scan
+ *        is open. NULL with numPreds 0 returns every record.
+ * @param numPreds Number of predicates.
+ * @return RC_OK if successful.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if a constant has another type than its attribute.
+ *         RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN if a predicate has an unknown attribute or comparison.
+ */
+RC startScan(RM_TableData *rel, RM_ScanHandle *scan, RM_Predicate *preds, int numPreds)
+{
+    if (rel == NULL || rel->mgmtData == NULL || scan == NULL || numPreds < 0 || (numPreds > 0 && preds == NULL)) {
+        printMessage("The table is not open.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    for (int p = 0; p < numPreds; p++) {
+        if (preds[p].attrNum < 0 || preds[p].attrNum >= rel->schema->numAttr || preds[p].op < RM_EQ || preds[p].op > RM_GE) {
+            printMessage("Predicate %d does not compare an attribute of the table.\n", p);
+            return RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN;
+        }
+        if (preds[p].value.dt != rel->schema->dataTypes[preds[p].attrNum]
+            || (preds[p].value.dt == DT_STRING && preds[p].value.v.stringV == NULL)) {
+            printMessage("Predicate %d compares values of different types.\n", p);
+            return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+        }
+    }
+    TableMgmt *mgmt = (TableMgmt*) rel->mgmtData;
+    int maxSlots = (mgmt->fHandle.pageSize - TABLE_PAGE_HEADER_SIZE) / TABLE_SLOT_SIZE;
+    TableScan *tableScan = (TableScan*) calloc(1, sizeof(TableScan));
+    if (tableScan == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    tableScan->preds = (RM_Predicate*) malloc(sizeof(RM_Predicate) * (size_t) (numPreds > 0 ? numPreds : 1));
+    tableScan->page = (char*) malloc((size_t) mgmt->fHandle.pageSize);
+    tableScan->selected = (uint8_t*) malloc((size_t) maxSlots);
+    tableScan->starts = (int32_t*) malloc(sizeof(int32_t) * (size_t) maxSlots);
+    tableScan->ints = (int32_t*) malloc(sizeof(int32_t) * (size_t) maxSlots);
+    tableScan->floats = (float*) malloc(sizeof(float) * (size_t) maxSlots);
+    scan->rel = rel;
+    scan->mgmtData = tableScan;
+    if (tableScan->preds == NULL || tableScan->page == NULL || tableScan->selected == NULL
+        || tableScan->starts == NULL || tableScan->ints == NULL || tableScan->floats == NULL) {
+        closeScan(scan);
+        return RC_WRITE_FAILED;
+    }
+    if (numPreds > 0) {
+        memcpy(tableScan->preds, preds, sizeof(RM_Predicate) * (size_t) numPreds);
+    }
+    tableScan->numPreds = numPreds;
+    // Page 0 is the schema; the first call to next reads page 1.
+    tableScan->pageNum = 0;
+    tableScan->slot = 0;
+    PAGE_HEADER(tableScan->page)->numSlots = 0;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns the next record of a scan.
+ *
+ * @param scan The open scan.
+ * @param record Receives the record and its id; its data must hold getRecordSize bytes.
+ * @return RC_OK if successful.
+ *         RC_RM_NO_MORE_TUPLES once every page has been scanned.
+ */
+RC next(RM_ScanHandle *scan, Record *record)
+{
+    if (scan == NULL || scan->mgmtData == NULL || record == NULL || record->data == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableScan *tableScan = (TableScan*) scan->mgmtData;
+    TableMgmt *mgmt = (TableMgmt*) scan->rel->mgmtData;
+    for (;;) {
+        char *page = tableScan->page;
+        int numSlots = PAGE_HEADER(page)->numSlots;
+        while (tableScan->slot < numSlots) {
+            int slotNum = tableScan->slot++;
+            if (tableScan->selected[slotNum]) {
+                TableSlot *slot = &PAGE_SLOTS(page)[slotNum];
+                const char *tuple = page + slot->offset;
+                if (slot->flags == SLOT_MOVED) {
+                    memcpy(&record->id, tuple, sizeof(RID));
+                    tuple += sizeof(RID);
+                }
+                else {
+                    record->id.page = tableScan->pageNum;
+                    record->id.slot = slotNum;
+                }
+                decodeTuple(mgmt, scan->rel->schema, tuple, record->data);
+                return RC_OK;
+            }
+        }
+        if (tableScan->pageNum + 1 >= mgmt->fHandle.totalNumPages) {
+            return RC_RM_NO_MORE_TUPLES;
+        }
+        RC rc = readBlock(++tableScan->pageNum, &mgmt->fHandle, page);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        tableScan->slot = 0;
+        filterPage(mgmt, scan->rel->schema, tableScan);
+    }
+}
+
+
+/**
+ * @brief Closes a scan.
+ */
+RC closeScan(RM_ScanHandle *scan)
+{
+    if (scan == NULL || scan->mgmtData == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TableScan *tableScan = (TableScan*) scan->mgmtData;
+    free(tableScan->preds);
+    free(tableScan->page);
+    free(tableScan->selected);
+    free(tableScan->starts);
+    free(tableScan->ints);
+    free(tableScan->floats);
+    free(tableScan);
+    scan->mgmtData = NULL;
+    return RC_OK;
+}
+
+
+/************************************************************
+ *                    schemas and records                   *
+ ************************************************************/
+
+/**
+ * @brief Returns the bytes of the data of a record of the schema.
+ */
+int getRecordSize(Schema *schema)
+{
+    if (schema == NULL) {
+        return 0;
+    }
+    int size = 0;
+    for (int i = 0; i < schema->numAttr; i++) {
+        size += attrSize(schema, i);
+    }
+    return size;
+}
+
+
+/**
+ * @brief Creates a schema that takes over the given arrays; freeSchema frees them.
+ */
+Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys)
+{
+    Schema *schema = (Schema*) malloc(sizeof(Schema));
+    if (schema == NULL) {
+        return NULL;
+    }
+    schema->numAttr = numAttr;
+    schema->attrNames = attrNames;
+    schema->dataTypes = dataTypes;
+    schema->typeLength = typeLength;
+    schema->keySize = keySize;
+    schema->keyAttrs = keys;
+    return schema;
+}
+
+
+/**
+ * @brief Frees a schema, its arrays and its attribute names.
+ */
+RC freeSchema(Schema *schema)
+{
+    if (schema == NULL) {
+        return RC_OK;
+    }
+    for (int i = 0; schema->attrNames != NULL && i < schema->numAttr; i++) {
+        free(schema->attrNames[i]);
+    }
+    free(schema->attrNames);
+    free(schema->dataTypes);
+    free(schema->typeLength);
+    free(schema->keyAttrs);
+    free(schema);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Creates an empty record of the schema.
+ */
+RC createRecord(Record **record, Schema *schema)
+{
+    if (record == NULL || schema == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    Record *newRecord = (Record*) malloc(sizeof(Record));
+    char *data = (char*) calloc(1, (size_t) getRecordSize(schema) + 1);
+    if (newRecord == NULL || data == NULL) {
+        free(newRecord);
+        free(data);
+        return RC_WRITE_FAILED;
+    }
+    newRecord->id.page = -1;
+    newRecord->id.slot = -1;
+    newRecord->data = data;
+    *record = newRecord;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Frees a record and its data.
+ */
+RC freeRecord(Record *record)
+{
+    if (record != NULL) {
+        free(record->data);
+        free(record);
+    }
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns a new value holding an attribute of a record; strings are copied and
+ *        terminated. The caller frees the value, and its string.
+ */
+RC getAttr(Record *record, Schema *schema, int attrNum, Value **value)
+{
+    if (record == NULL || schema == NULL || value == NULL || attrNum < 0 || attrNum >= schema->numAttr) {
+        return RC_RM_NO_PRINT_FOR_DATATYPE;
+    }
+    Value *result = (Value*) malloc(sizeof(Value));
+    if (result == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    int offset = 0;
+    for (int i = 0; i < attrNum; i++) {
+        offset += attrSize(schema, i);
+    }
+    const char *data = record->data + offset;
+    result->dt = schema->dataTypes[attrNum];
+    switch (result->dt) {
+    case DT_INT:
+        memcpy(&result->v.intV, data, sizeof(int));
+        break;
+    case DT_FLOAT:
+        memcpy(&result->v.floatV, data, sizeof(float));
+        break;
+    case DT_BOOL:
+        memcpy(&result->v.boolV, data, sizeof(bool));
+        break;
+    case DT_STRING:
+        result->v.stringV = (char*) calloc(1, (size_t) schema->typeLength[attrNum] + 1);
+        if (result->v.stringV == NULL) {
+            free(result);
+            return RC_WRITE_FAILED;
+        }
+        memcpy(result->v.stringV, data, (size_t) schema->typeLength[attrNum]);
+        break;
+    }
+    *value = result;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Sets an attribute of a record. Strings longer than the attribute are cut.
+ *
+ * @return RC_OK if successful.
+ *         RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE if the value has another type than the attribute.
+ */
+RC setAttr(Record *record, Schema *schema, int attrNum, Value *value)
+{
+    if (record == NULL || schema == NULL || value == NULL || attrNum < 0 || attrNum >= schema->numAttr) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (value->dt != schema->dataTypes[attrNum]) {
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    }
+    int offset = 0;
+    for (int i = 0; i < attrNum; i++) {
+        offset += attrSize(schema, i);
+    }
+    char *data = record->data + offset;
+    switch (value->dt) {
+    case DT_INT:
+        memcpy(data, &value->v.intV, sizeof(int));
+        break;
+    case DT_FLOAT:
+        memcpy(data, &value->v.floatV, sizeof(float));
+        break;
+    case DT_BOOL:
+        memcpy(data, &value->v.boolV, sizeof(bool));
+        break;
+    case DT_STRING:
+        memset(data, 0, (size_t) schema->typeLength[attrNum]);
+        memcpy(data, value->v.stringV, strnlen(value->v.stringV, (size_t) schema->typeLength[attrNum]));
+        break;
+    }
+    return RC_OK;
+}
@@ -0,0 +1,80 @@
+#ifndef RECORD_MGR_H
+#define RECORD_MGR_H
+
+#include "dberror.h"
+#include "tables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    record manager constants              *
+ ************************************************************/
+#define TABLE_MAGIC "SMTABLE1"
+/* bytes in front of the slot array of a data page */
+#define TABLE_PAGE_HEADER_SIZE 16
+/* bytes of one slot array entry */
+#define TABLE_SLOT_SIZE 8
+
+/* comparison of an attribute with a constant in a scan predicate */
+typedef enum RM_CompareOp {
+	RM_EQ = 0,
+	RM_NE = 1,
+	RM_LT = 2,
+	RM_LE = 3,
+	RM_GT = 4,
+	RM_GE = 5
+} RM_CompareOp;
+
+/* attribute attrNum compared with value; the predicates of a scan must all hold */
+typedef struct RM_Predicate {
+	int attrNum;
+	RM_CompareOp op;
+	Value value;
+} RM_Predicate;
+
+typedef struct RM_ScanHandle {
+	RM_TableData *rel;
+	void *mgmtData;
+} RM_ScanHandle;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* table and manager */
+extern RC initRecordManager (void *mgmtData);
+extern RC shutdownRecordManager (void);
+extern RC createTable (char *name, Schema *schema);
+extern RC openTable (RM_TableData *rel, char *name);
+extern RC closeTable (RM_TableData *rel);
+extern RC deleteTable (char *name);
+extern int getNumTuples (RM_TableData *rel);
+
+/* handling records in a table */
+extern RC insertRecord (RM_TableData *rel, Record *record);
+extern RC deleteRecord (RM_TableData *rel, RID id);
+extern RC updateRecord (RM_TableData *rel, Record *record);
+extern RC getRecord (RM_TableData *rel, RID id, Record *record);
+
+/* scans */
+extern RC startScan (RM_TableData *rel, RM_ScanHandle *scan, RM_Predicate *preds, int numPreds);
+extern RC next (RM_ScanHandle *scan, Record *record);
+extern RC closeScan (RM_ScanHandle *scan);
+
+/* dealing with schemas */
+extern int getRecordSize (Schema *schema);
+extern Schema *createSchema (int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys);
+extern RC freeSchema (Schema *schema);
+
+/* dealing with records and attribute values */
+extern RC createRecord (Record **record, Schema *schema);
+extern RC freeRecord (Record *record);
+extern RC getAttr (Record *record, Schema *schema, int attrNum, Value **value);
+extern RC setAttr (Record *record, Schema *schema, int attrNum, Value *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
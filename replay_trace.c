@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "storage_mgr.h"
+#include "io_replay.h"
+
+/* replays an I/O capture against a page file and prints throughput and latency */
+int main (int argc, char **argv)
+{
+  IoReplayStats stats;
+  char *capturedFile = NULL;
+  int paced = 0, i;
+  RC rc;
+
+  if (argc < 3)
+  {
+    printf("usage: %s <capture file> <page file> [--paced] [--file <captured file>]\n", argv[0]);
+    return 1;
+  }
+  for (i = 3; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--paced") == 0)
+      paced = 1;
+    else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+      capturedFile = argv[++i];
+    else
+    {
+      printf("usage: %s <capture file> <page file> [--paced] [--file <captured file>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  rc = replayIoTrace(argv[1], capturedFile, argv[2], paced, &stats);
+  if (rc != RC_OK)
+  {
+    printError(rc);
+    return 1;
+  }
+
+  printf("operations replayed: %ld (skipped %ld)\n", stats.numOps, stats.numSkipped);
+  printf("elapsed:             %.3f s\n", stats.elapsedSec);
+  printf("throughput:          %.0f ops/s\n", stats.opsPerSec);
+  printf("latency avg/p99/max: %.1f / %.1f / %.1f us\n", stats.avgLatencyUs, stats.p99LatencyUs, stats.maxLatencyUs);
+  return 0;
+}
@@ -0,0 +1,731 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "replication.h"
+#include "mem_governor.h"
+#include "sm_backend.h"
+
+/*
+ * Log shipping keeps read-only copies of a page file up to date without copying the file.
+ * Every page written on the primary handle and every change of its size is turned into a
+ * record and queued; a shipping thread writes whatever has been queued with one write to the
+ * stream, which can be a pipe, a socket or a file. Writers only wait for the stream when the
+ * queue is full. The queue starts small and grows as far as the memory budget of the file
+ * allows; an idle shipper gives the memory back when the budget is short. The stream starts
+ * with a record giving the page size and page count.
+ *
+ *   record = ReplRecordHeader + count pages (REPL_PAGES only)
+ *
+ * A replica reads the stream on its own thread and applies everything one read returned as a
+ * batch: consecutive pages are collected and written with one writeBlocks call. Records carry
+ * a sequence number and the time they were queued, so the replica reports how far it is
+ * behind the primary in records and in time.
+ */
+
+#define REPL_RECORD_MAGIC 0x534d5250u
+/* room kept free in the replica's receive buffer for one read */
+#define REPL_READ_BYTES (256 * 1024)
+
+typedef enum ReplRecordType {
+    REPL_HELLO = 0,
+    REPL_PAGES = 1,
+    REPL_RESIZE = 2
+} ReplRecordType;
+
+typedef struct ReplRecordHeader {
+    uint32_t magic;
+    int32_t type;
+    int32_t first;      /* REPL_PAGES: the first page; REPL_HELLO: the page size */
+    int32_t count;      /* REPL_PAGES: the pages that follow; otherwise the page count of the file */
+    uint64_t seq;
+    int64_t queuedNs;   /* CLOCK_REALTIME when the record was queued */
+} ReplRecordHeader;
+
+struct SM_Shipper {
+    int fd;
+    int pageSize;
+    /* writers append to the queue; the shipping thread swaps it with the buffer it sends */
+    char *queue;
+    size_t queueUsed;
+    size_t queueCapacity;
+    char *sending;
+    size_t sendingCapacity;
+    int sendingBatch;
+    /* the queues are charged to the memory budget of the file */
+    SM_MemConsumer *memory;
+    /* pages in a record, so that a record fits a queue of REPL_MIN_QUEUE_BYTES */
+    int recordPages;
+    SM_ShippingStats stats;
+    pthread_t thread;
+    /* guards the queue, stats and stop */
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t drained;
+    int stop;
+};
+
+struct SM_Replica {
+    int fd;
+    char *fileName;
+    SM_FileHandle fh;
+    int fileOpen;
+    /* bytes read from the stream that do not form a whole record yet */
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    /* consecutive pages collected for one writeBlocks call */
+    char *run;
+    int runFirst;
+    int runCount;
+    long pages;
+    long pageWrites;
+    SM_ReplicaStats stats;
+    pthread_t thread;
+    /* guards stats and stop */
+    pthread_mutex_t lock;
+    int stop;
+};
+
+
+static int64_t realtimeNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int writeFully(int fd, const char *data, size_t length)
+{
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+    return 0;
+}
+
+
+/************************************************************
+ *                    primary side                          *
+ ************************************************************/
+
+/**
+ * @brief Doubles the queue until it holds needed bytes, if the memory budget allows it.
+ * @return 1 if the queue holds needed bytes now.
+ */
+static int growQueue(SM_Shipper *shipper, size_t needed)
+{
+    size_t capacity = shipper->queueCapacity;
+    while (capacity < needed && capacity < REPL_MAX_QUEUE_BYTES) {
+        capacity *= 2;
+    }
+    if (capacity < needed || memReserve(shipper->memory, (long long) (capacity - shipper->queueCapacity)) != RC_OK) {
+        return 0;
+    }
+    char *grown = (char*) realloc(shipper->queue, capacity);
+    if (grown == NULL) {
+        memRelease(shipper->memory, (long long) (capacity - shipper->queueCapacity));
+        return 0;
+    }
+    shipper->queue = grown;
+    shipper->queueCapacity = capacity;
+    return 1;
+}
+
+/**
+ * @brief Queues one record. Waits while the queue is full and can't grow; once the stream
+ *        broke, records are dropped so the primary keeps working.
+ */
+static void queueRecord(SM_Shipper *shipper, ReplRecordType type, int first, int count, const char *pages, size_t pageBytes)
+{
+    size_t size = sizeof(ReplRecordHeader) + pageBytes;
+    pthread_mutex_lock(&shipper->lock);
+    // An empty queue always holds a record, so this ends once the shipping thread took the queue.
+    while (!shipper->stats.failed && shipper->queueUsed + size > shipper->queueCapacity
+           && !growQueue(shipper, shipper->queueUsed + size)) {
+        pthread_cond_wait(&shipper->drained, &shipper->lock);
+    }
+    if (shipper->stats.failed) {
+        pthread_mutex_unlock(&shipper->lock);
+        return;
+    }
+    ReplRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = REPL_RECORD_MAGIC;
+    header.type = type;
+    header.first = first;
+    header.count = count;
+    header.seq = (uint64_t) ++shipper->stats.queuedRecords;
+    header.queuedNs = realtimeNs();
+    memcpy(shipper->queue + shipper->queueUsed, &header, sizeof(header));
+    if (pageBytes > 0) {
+        memcpy(shipper->queue + shipper->queueUsed + sizeof(header), pages, pageBytes);
+        shipper->stats.pages += count;
+    }
+    shipper->queueUsed += size;
+    pthread_cond_signal(&shipper->queued);
+    pthread_mutex_unlock(&shipper->lock);
+}
+
+static void *shipperMain(void *arg)
+{
+    SM_Shipper *shipper = (SM_Shipper*) arg;
+    // A reader that went away must not kill the process; the write fails with EPIPE instead.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    pthread_mutex_lock(&shipper->lock);
+    for (;;) {
+        while (shipper->queueUsed == 0 && !shipper->stop) {
+            pthread_cond_wait(&shipper->queued, &shipper->lock);
+        }
+        if (shipper->queueUsed == 0) {
+            break;
+        }
+        // Everything queued so far goes out with one write.
+        char *batch = shipper->queue;
+        size_t batchBytes = shipper->queueUsed;
+        size_t batchCapacity = shipper->queueCapacity;
+        long lastRecord = shipper->stats.queuedRecords;
+        shipper->queue = shipper->sending;
+        shipper->queueCapacity = shipper->sendingCapacity;
+        shipper->queueUsed = 0;
+        shipper->sending = batch;
+        shipper->sendingCapacity = batchCapacity;
+        shipper->sendingBatch = 1;
+        pthread_cond_broadcast(&shipper->drained);
+        pthread_mutex_unlock(&shipper->lock);
+
+        int failed = writeFully(shipper->fd, batch, batchBytes) != 0;
+        int error = errno;
+
+        pthread_mutex_lock(&shipper->lock);
+        shipper->sendingBatch = 0;
+        if (!failed) {
+            shipper->stats.shippedRecords = lastRecord;
+            shipper->stats.bytes += (long long) batchBytes;
+            shipper->stats.batches++;
+        }
+        else if (!shipper->stats.failed) {
+            printMessage("The replication stream broke: %s\n", strerror(error));
+            shipper->stats.failed = 1;
+            pthread_cond_broadcast(&shipper->drained);
+        }
+    }
+    pthread_mutex_unlock(&shipper->lock);
+    return NULL;
+}
+
+/**
+ * @brief Shrinks the queues of an idle shipper back to REPL_MIN_QUEUE_BYTES when the memory
+ *        budget is short. A busy shipper is skipped.
+ * @return the bytes given back.
+ */
+long long shipShrink(SM_Shipper *shipper, long long bytes)
+{
+    (void) bytes;
+    if (shipper == NULL || pthread_mutex_trylock(&shipper->lock) != 0) {
+        return 0;
+    }
+    long long freed = 0;
+    char *shrunk;
+    if (!shipper->sendingBatch && shipper->sendingCapacity > REPL_MIN_QUEUE_BYTES
+        && (shrunk = (char*) realloc(shipper->sending, REPL_MIN_QUEUE_BYTES)) != NULL) {
+        freed += (long long) (shipper->sendingCapacity - REPL_MIN_QUEUE_BYTES);
+        shipper->sending = shrunk;
+        shipper->sendingCapacity = REPL_MIN_QUEUE_BYTES;
+    }
+    if (shipper->queueUsed == 0 && shipper->queueCapacity > REPL_MIN_QUEUE_BYTES
+        && (shrunk = (char*) realloc(shipper->queue, REPL_MIN_QUEUE_BYTES)) != NULL) {
+        freed += (long long) (shipper->queueCapacity - REPL_MIN_QUEUE_BYTES);
+        shipper->queue = shrunk;
+        shipper->queueCapacity = REPL_MIN_QUEUE_BYTES;
+    }
+    pthread_mutex_unlock(&shipper->lock);
+    return freed;
+}
+
+static void freeShipper(SM_Shipper *shipper)
+{
+    pthread_mutex_destroy(&shipper->lock);
+    pthread_cond_destroy(&shipper->queued);
+    pthread_cond_destroy(&shipper->drained);
+    memRelease(shipper->memory, (long long) (shipper->queueCapacity + shipper->sendingCapacity));
+    free(shipper->queue);
+    free(shipper->sending);
+    free(shipper);
+}
+
+/**
+ * @brief Queues pages written on the primary, at most REPL_BATCH_PAGES per record.
+ */
+void shipPages(SM_Shipper *shipper, int firstPage, int numPages, const char *data)
+{
+    if (shipper == NULL) {
+        return;
+    }
+    for (int done = 0; done < numPages; done += shipper->recordPages) {
+        int count = numPages - done < shipper->recordPages ? numPages - done : shipper->recordPages;
+        queueRecord(shipper, REPL_PAGES, firstPage + done, count,
+                    data + (size_t) done * shipper->pageSize, (size_t) count * shipper->pageSize);
+    }
+}
+
+/**
+ * @brief Queues the new page count of the primary after it grew or shrank.
+ */
+void shipResize(SM_Shipper *shipper, int totalNumPages)
+{
+    if (shipper != NULL) {
+        queueRecord(shipper, REPL_RESIZE, 0, totalNumPages, NULL, 0);
+    }
+}
+
+/**
+ * @brief Reads pages of a shipped file and queues them; used for pages that changed without
+ *        passing through a page buffer, and for the initial copy of a replica.
+ */
+RC shipFilePages(SM_FileHandle *fHandle, int firstPage, int numPages)
+{
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->shipper == NULL || numPages <= 0) {
+        return RC_OK;
+    }
+    char *pages = (char*) malloc((size_t) REPL_BATCH_PAGES * fHandle->pageSize);
+    if (pages == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    int curPagePos = fHandle->curPagePos;
+    RC rc = RC_OK;
+    for (int done = 0; done < numPages && rc == RC_OK; done += REPL_BATCH_PAGES) {
+        int count = numPages - done < REPL_BATCH_PAGES ? numPages - done : REPL_BATCH_PAGES;
+        rc = readBlocks(firstPage + done, count, fHandle, pages);
+        if (rc == RC_OK) {
+            shipPages(openFile->shipper, firstPage + done, count, pages);
+        }
+    }
+    fHandle->curPagePos = curPagePos;
+    free(pages);
+    return rc;
+}
+
+
+/************************************************************
+ *                    replica side                          *
+ ************************************************************/
+
+/**
+ * @brief Opens the replica's page file, creating it with the primary's page size if needed.
+ */
+static RC openReplicaFile(SM_Replica *replica, int pageSize)
+{
+    if (openPageFile(replica->fileName, &replica->fh) != RC_OK
+        && (createPageFileWithPageSize(replica->fileName, pageSize) != RC_OK
+            || openPageFile(replica->fileName, &replica->fh) != RC_OK)) {
+        return RC_FILE_NOT_FOUND;
+    }
+    replica->fileOpen = 1;
+    replica->run = (char*) malloc((size_t) REPL_BATCH_PAGES * pageSize);
+    // Pages only arrive when they changed, so hashing them to skip rewrites does not pay off.
+    if (replica->fh.pageSize != pageSize || replica->run == NULL || setWriteDedup(&replica->fh, 0) != RC_OK) {
+        printMessage("The replica %s does not have the page size of its primary!\n", replica->fileName);
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+static RC flushRun(SM_Replica *replica)
+{
+    if (replica->runCount == 0) {
+        return RC_OK;
+    }
+    RC rc = writeBlocks(replica->runFirst, replica->runCount, &replica->fh, replica->run);
+    replica->runCount = 0;
+    replica->pageWrites++;
+    return rc;
+}
+
+static RC resizeReplica(SM_Replica *replica, int numPages)
+{
+    if (numPages > replica->fh.totalNumPages) {
+        return ensureCapacity(numPages, &replica->fh);
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) replica->fh.mgmtInfo;
+    if (numPages < replica->fh.totalNumPages && openFile->backend->truncate != NULL) {
+        // Readers sharing the replica must see the new count, and nothing may cache the dropped pages.
+        return truncateOpenFile(&replica->fh, numPages);
+    }
+    return RC_OK;
+}
+
+/**
+ * @brief Applies one record; pages are collected into runs of consecutive pages first.
+ */
+static RC applyRecord(SM_Replica *replica, ReplRecordHeader *header, const char *pages)
+{
+    if (header->type == REPL_HELLO) {
+        RC rc = flushRun(replica);
+        if (rc == RC_OK && !replica->fileOpen) {
+            rc = openReplicaFile(replica, header->first);
+        }
+        else if (rc == RC_OK && replica->fh.pageSize != header->first) {
+            rc = RC_WRITE_FAILED;
+        }
+        return rc == RC_OK ? resizeReplica(replica, header->count) : rc;
+    }
+    if (!replica->fileOpen) {
+        return RC_WRITE_FAILED;
+    }
+    if (header->type == REPL_RESIZE) {
+        RC rc = flushRun(replica);
+        return rc == RC_OK ? resizeReplica(replica, header->count) : rc;
+    }
+    int pageSize = replica->fh.pageSize;
+    for (int i = 0; i < header->count; i++) {
+        int pageNum = header->first + i;
+        if (replica->runCount > 0
+            && (pageNum != replica->runFirst + replica->runCount || replica->runCount == REPL_BATCH_PAGES)
+            && flushRun(replica) != RC_OK) {
+            return RC_WRITE_FAILED;
+        }
+        if (replica->runCount == 0) {
+            replica->runFirst = pageNum;
+        }
+        memcpy(replica->run + (size_t) replica->runCount * pageSize, pages + (size_t) i * pageSize, (size_t) pageSize);
+        replica->runCount++;
+    }
+    replica->pages += header->count;
+    return RC_OK;
+}
+
+/**
+ * @brief Applies every whole record in the receive buffer and keeps the rest for the next read.
+ * @return the number of records applied, or -1 if a record was malformed or failed.
+ */
+static long applyBuffer(SM_Replica *replica, ReplRecordHeader *last)
+{
+    size_t offset = 0;
+    long applied = 0;
+    while (replica->used - offset >= sizeof(ReplRecordHeader)) {
+        ReplRecordHeader header;
+        memcpy(&header, replica->buffer + offset, sizeof(header));
+        if (header.magic != REPL_RECORD_MAGIC || header.count < 0
+            || (header.type == REPL_PAGES && (!replica->fileOpen || header.first < 0 || header.count > REPL_BATCH_PAGES))
+            || (header.type != REPL_PAGES && header.type != REPL_HELLO && header.type != REPL_RESIZE)) {
+            return -1;
+        }
+        size_t size = sizeof(header) + (header.type == REPL_PAGES ? (size_t) header.count * replica->fh.pageSize : 0);
+        if (replica->used - offset < size) {
+            break;
+        }
+        if (applyRecord(replica, &header, replica->buffer + offset + sizeof(header)) != RC_OK) {
+            return -1;
+        }
+        *last = header;
+        offset += size;
+        applied++;
+    }
+    memmove(replica->buffer, replica->buffer + offset, replica->used - offset);
+    replica->used -= offset;
+    return flushRun(replica) == RC_OK ? applied : -1;
+}
+
+static void *replicaMain(void *arg)
+{
+    SM_Replica *replica = (SM_Replica*) arg;
+    int ended = 0, failed = 0;
+    while (!ended && !failed) {
+        pthread_mutex_lock(&replica->lock);
+        int stopped = replica->stop;
+        pthread_mutex_unlock(&replica->lock);
+        if (stopped) {
+            break;
+        }
+        struct pollfd pfd;
+        pfd.fd = replica->fd;
+        pfd.events = POLLIN;
+        int ready = poll(&pfd, 1, REPL_POLL_MS);
+        if (ready <= 0) {
+            failed = ready < 0 && errno != EINTR;
+            continue;
+        }
+        if (replica->capacity - replica->used < REPL_READ_BYTES) {
+            char *grown = (char*) realloc(replica->buffer, replica->capacity * 2);
+            if (grown == NULL) {
+                failed = 1;
+                break;
+            }
+            replica->buffer = grown;
+            replica->capacity *= 2;
+        }
+        ssize_t got = read(replica->fd, replica->buffer + replica->used, replica->capacity - replica->used);
+        if (got < 0) {
+            failed = errno != EINTR && errno != EAGAIN;
+            continue;
+        }
+        ended = got == 0;
+        replica->used += (size_t) got;
+        ReplRecordHeader last;
+        long applied = applyBuffer(replica, &last);
+        failed = applied < 0;
+        if (applied > 0) {
+            double lagMs = (double) (realtimeNs() - last.queuedNs) / 1e6;
+            pthread_mutex_lock(&replica->lock);
+            replica->stats.appliedRecords = (long) last.seq;
+            replica->stats.pages = replica->pages;
+            replica->stats.batches++;
+            replica->stats.pageWrites = replica->pageWrites;
+            replica->stats.lagMs = lagMs;
+            if (lagMs > replica->stats.maxLagMs) {
+                replica->stats.maxLagMs = lagMs;
+            }
+            pthread_mutex_unlock(&replica->lock);
+        }
+    }
+    pthread_mutex_lock(&replica->lock);
+    replica->stats.ended = ended;
+    replica->stats.failed = failed || (ended && replica->used > 0);
+    pthread_mutex_unlock(&replica->lock);
+    if (failed) {
+        printMessage("The replica %s could not apply the stream!\n", replica->fileName);
+    }
+    return NULL;
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Starts shipping the changes of a page file to a stream. From then on every page written
+ *        through the handle and every change of its size is sent as a record, after a first
+ *        record with the page size and page count. The stream is written by a background
+ *        thread; if it breaks, shipping stops and the file keeps working.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param fd The stream: a pipe, a socket or a file open for writing. It is not closed.
+ * @param shipExisting Non-zero to send every page of the file first, so an empty replica
+ *        catches up without copying the file.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the file is already shipped or the thread could not start.
+ *         RC_MEMORY_BUDGET_EXCEEDED if the memory budget has no room for the queues.
+ */
+RC startLogShipping(SM_FileHandle *fHandle, int fd, int shipExisting)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || fd < 0) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->shipper != NULL) {
+        printMessage("The file %s is already shipped!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    SM_Shipper *shipper = (SM_Shipper*) calloc(1, sizeof(SM_Shipper));
+    if (shipper == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    shipper->fd = fd;
+    shipper->pageSize = fHandle->pageSize;
+    shipper->recordPages = (REPL_MIN_QUEUE_BYTES - (int) sizeof(ReplRecordHeader)) / fHandle->pageSize;
+    if (shipper->recordPages > REPL_BATCH_PAGES) {
+        shipper->recordPages = REPL_BATCH_PAGES;
+    }
+    shipper->memory = openFile->memory;
+    pthread_mutex_init(&shipper->lock, NULL);
+    pthread_cond_init(&shipper->queued, NULL);
+    pthread_cond_init(&shipper->drained, NULL);
+    if (memReserve(shipper->memory, 2 * REPL_MIN_QUEUE_BYTES) != RC_OK) {
+        freeShipper(shipper);
+        return RC_MEMORY_BUDGET_EXCEEDED;
+    }
+    shipper->queue = (char*) malloc(REPL_MIN_QUEUE_BYTES);
+    shipper->sending = (char*) malloc(REPL_MIN_QUEUE_BYTES);
+    shipper->queueCapacity = shipper->sendingCapacity = REPL_MIN_QUEUE_BYTES;
+    if (shipper->queue == NULL || shipper->sending == NULL) {
+        freeShipper(shipper);
+        return RC_WRITE_FAILED;
+    }
+    queueRecord(shipper, REPL_HELLO, fHandle->pageSize, fHandle->totalNumPages, NULL, 0);
+    if (pthread_create(&shipper->thread, NULL, shipperMain, shipper) != 0) {
+        printMessage("The shipping thread could not be started!\n");
+        freeShipper(shipper);
+        return RC_WRITE_FAILED;
+    }
+    __atomic_store_n(&openFile->shipper, shipper, __ATOMIC_RELEASE);
+    return shipExisting ? shipFilePages(fHandle, 0, fHandle->totalNumPages) : RC_OK;
+}
+
+
+/**
+ * @brief Stops shipping a file after everything queued has been written to the stream; the
+ *        stats stay readable through getShippingStats until shipping starts again.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @return RC_OK if successful, also if the file was not shipped.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the stream broke.
+ */
+RC stopLogShipping(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_Shipper *shipper = openFile->shipper;
+    if (shipper == NULL) {
+        return RC_OK;
+    }
+    pthread_mutex_lock(&shipper->lock);
+    shipper->stop = 1;
+    pthread_cond_signal(&shipper->queued);
+    pthread_mutex_unlock(&shipper->lock);
+    pthread_join(shipper->thread, NULL);
+    // The memory governor may be shrinking the queues; it must be done before they are freed.
+    __atomic_store_n(&openFile->shipper, NULL, __ATOMIC_RELEASE);
+    memQuiesce();
+    openFile->shippingStats = shipper->stats;
+    freeShipper(shipper);
+    return openFile->shippingStats.failed ? RC_WRITE_FAILED : RC_OK;
+}
+
+
+/**
+ * @brief Reports the records queued and written to the stream by the running shipper, or the
+ *        final stats of the last one.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC getShippingStats(SM_FileHandle *fHandle, SM_ShippingStats *stats)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || stats == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_Shipper *shipper = openFile->shipper;
+    if (shipper == NULL) {
+        *stats = openFile->shippingStats;
+        return RC_OK;
+    }
+    pthread_mutex_lock(&shipper->lock);
+    *stats = shipper->stats;
+    pthread_mutex_unlock(&shipper->lock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Starts a replica that applies a primary's stream to its own page file on a background
+ *        thread. The file is created with the primary's page size if it does not exist and
+ *        resized to the primary's page count. Other handles can open it to read while the
+ *        replica applies changes. The replica stops at the end of the stream.
+ *
+ * @param fileName The replica's page file.
+ * @param fd The stream: the reading end of a pipe or socket, or a file of shipped records.
+ *        It is not closed.
+ * @param replica Receives the replica.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if an argument is NULL.
+ *         RC_WRITE_FAILED if the thread could not start.
+ */
+RC startReplica(char *fileName, int fd, SM_Replica **replica)
+{
+    if (fileName == NULL || replica == NULL || fd < 0) {
+        printMessage("The replica needs a file name and a stream.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_Replica *r = (SM_Replica*) calloc(1, sizeof(SM_Replica));
+    if (r == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    r->fd = fd;
+    r->fileName = strdup(fileName);
+    r->capacity = 2 * REPL_READ_BYTES;
+    r->buffer = (char*) malloc(r->capacity);
+    pthread_mutex_init(&r->lock, NULL);
+    if (r->fileName == NULL || r->buffer == NULL
+        || pthread_create(&r->thread, NULL, replicaMain, r) != 0) {
+        printMessage("The replica thread could not be started!\n");
+        pthread_mutex_destroy(&r->lock);
+        free(r->fileName);
+        free(r->buffer);
+        free(r);
+        return RC_WRITE_FAILED;
+    }
+    *replica = r;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Stops a replica, waits for its thread and closes its page file.
+ *
+ * @param replica The replica returned by startReplica.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the replica is NULL.
+ *         RC_WRITE_FAILED if the replica failed to apply the stream.
+ */
+RC stopReplica(SM_Replica *replica)
+{
+    if (replica == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&replica->lock);
+    replica->stop = 1;
+    pthread_mutex_unlock(&replica->lock);
+    pthread_join(replica->thread, NULL);
+    RC rc = replica->stats.failed ? RC_WRITE_FAILED : RC_OK;
+    if (replica->fileOpen && closePageFile(&replica->fh) != RC_OK) {
+        rc = RC_WRITE_FAILED;
+    }
+    pthread_mutex_destroy(&replica->lock);
+    free(replica->fileName);
+    free(replica->buffer);
+    free(replica->run);
+    free(replica);
+    return rc;
+}
+
+
+/**
+ * @brief Reports the records and pages a replica applied, how it batched them and how far it
+ *        was behind when it applied the last batch.
+ *
+ * @param replica The replica returned by startReplica.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the replica is NULL.
+ */
+RC getReplicaStats(SM_Replica *replica, SM_ReplicaStats *stats)
+{
+    if (replica == NULL || stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&replica->lock);
+    *stats = replica->stats;
+    pthread_mutex_unlock(&replica->lock);
+    return RC_OK;
+}
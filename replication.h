@@ -0,0 +1,69 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    replication constants                 *
+ ************************************************************/
+/* bytes of records a primary queues before its writers wait for the stream */
+#define REPL_MAX_QUEUE_BYTES (4 * 1024 * 1024)
+/* bytes a queue starts with and shrinks back to; holds a record of the largest page */
+#define REPL_MIN_QUEUE_BYTES (64 * 1024)
+/* most pages a replica applies with one writeBlocks call */
+#define REPL_BATCH_PAGES 64
+/* how often a replica waiting for records checks whether it was stopped */
+#define REPL_POLL_MS 10
+
+/* the shipping side of a primary page file */
+typedef struct SM_Shipper SM_Shipper;
+/* a page file kept up to date from a primary's stream */
+typedef struct SM_Replica SM_Replica;
+
+typedef struct SM_ShippingStats {
+	long queuedRecords;       /* records handed to the shipper */
+	long shippedRecords;      /* records written to the stream */
+	long pages;
+	long long bytes;
+	long batches;             /* writes to the stream */
+	int failed;               /* the stream broke; later changes are not shipped */
+} SM_ShippingStats;
+
+typedef struct SM_ReplicaStats {
+	long appliedRecords;      /* records applied, comparable to the primary's queuedRecords */
+	long pages;
+	long batches;             /* reads from the stream applied together */
+	long pageWrites;          /* writeBlocks calls the pages were applied with */
+	double lagMs;             /* from queuing the last applied record to applying it */
+	double maxLagMs;
+	int ended;                /* the primary closed the stream */
+	int failed;               /* a record was malformed or could not be applied */
+} SM_ReplicaStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC startLogShipping (SM_FileHandle *fHandle, int fd, int shipExisting);
+extern RC stopLogShipping (SM_FileHandle *fHandle);
+extern RC getShippingStats (SM_FileHandle *fHandle, SM_ShippingStats *stats);
+
+extern RC startReplica (char *fileName, int fd, SM_Replica **replica);
+extern RC stopReplica (SM_Replica *replica);
+extern RC getReplicaStats (SM_Replica *replica, SM_ReplicaStats *stats);
+
+/* used by the storage manager for files that are shipped */
+extern void shipPages (SM_Shipper *shipper, int firstPage, int numPages, const char *data);
+extern void shipResize (SM_Shipper *shipper, int totalNumPages);
+extern RC shipFilePages (SM_FileHandle *fHandle, int firstPage, int numPages);
+extern long long shipShrink (SM_Shipper *shipper, long long bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,394 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "scrubber.h"
+#include "sm_backend.h"
+
+/*
+ * The scrubber reads every page of a file in large sequential chunks to find pages that can
+ * no longer be read, pages whose checksum kept by the backend does not match (log-structured
+ * files) and pages an upper layer's verifier rejects. Reads are rate limited, and whenever the
+ * handle has seen foreground reads or writes since the last chunk the scrubber backs off for a
+ * moment so it does not compete with them.
+ */
+
+struct SM_Scrubber {
+    SM_FileHandle *fHandle;
+    SM_OpenFile *openFile;
+    SM_ScrubOptions options;
+    SM_ScrubStats stats;
+    pthread_t thread;
+    /* guards stats and stop */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    long lastIoCount;
+    /* one chunk of pages, and per page of the chunk whether it could be read */
+    char *buffer;
+    char *pageOk;
+};
+
+
+static double elapsedSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief Sleeps for the given time unless the scrubber is stopped first.
+ * @return non-zero if the scrubber was stopped.
+ */
+static int scrubWait(SM_Scrubber *scrubber, double seconds)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long ns = (long long) (seconds * 1e9);
+    deadline.tv_sec += (time_t) (ns / 1000000000LL);
+    deadline.tv_nsec += (long) (ns % 1000000000LL);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&scrubber->lock);
+    while (!scrubber->stop) {
+        if (pthread_cond_timedwait(&scrubber->cond, &scrubber->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    int stopped = scrubber->stop;
+    pthread_mutex_unlock(&scrubber->lock);
+    return stopped;
+}
+
+static void reportPage(SM_Scrubber *scrubber, int pageNum, SM_ScrubProblem problem)
+{
+    pthread_mutex_lock(&scrubber->lock);
+    scrubber->stats.corruptPages++;
+    pthread_mutex_unlock(&scrubber->lock);
+    printMessage("Page %d of %s failed scrubbing (problem %d)!\n", pageNum, scrubber->fHandle->fileName, problem);
+    if (scrubber->options.onCorrupt != NULL) {
+        scrubber->options.onCorrupt(scrubber->fHandle->fileName, pageNum, problem, scrubber->options.arg);
+    }
+}
+
+/**
+ * @brief Reads count pages starting at first into the buffer. POSIX files are read with one
+ *        pread; if it comes up short, the pages are read one by one to find the bad ones.
+ *        Backends that keep checksums check every page. Unreadable pages are reported and
+ *        marked in ok.
+ */
+static void readChunk(SM_Scrubber *scrubber, int first, int count, char *ok)
+{
+    SM_OpenFile *openFile = scrubber->openFile;
+    int pageSize = scrubber->fHandle->pageSize;
+    if (openFile->backend == &posixBackend) {
+        int fd = posixBackendFd(openFile->state);
+        off_t offset = posixBackendDataOffset(openFile->state) + (off_t) first * pageSize;
+        ssize_t len = (ssize_t) count * pageSize;
+        if (pread(fd, scrubber->buffer, (size_t) len, offset) == len) {
+            memset(ok, 1, (size_t) count);
+            return;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        char *page = scrubber->buffer + (size_t) i * pageSize;
+        RC rc = openFile->backend->verify != NULL
+            ? openFile->backend->verify(openFile->state, first + i, page)
+            : openFile->backend->read(openFile->state, first + i, page);
+        ok[i] = rc == RC_OK;
+        if (rc != RC_OK) {
+            reportPage(scrubber, first + i, rc == RC_PAGE_CORRUPT ? SCRUB_BAD_CHECKSUM : SCRUB_READ_ERROR);
+        }
+    }
+}
+
+/**
+ * @brief Backs off while the handle keeps seeing foreground I/O, at most SCRUB_MAX_YIELDS times
+ *        so a busy file is still scrubbed.
+ * @return non-zero if the scrubber was stopped.
+ */
+static int yieldToForeground(SM_Scrubber *scrubber)
+{
+    for (int i = 0; i < SCRUB_MAX_YIELDS; i++) {
+        long ioCount = __atomic_load_n(&scrubber->openFile->ioCount, __ATOMIC_RELAXED);
+        if (ioCount == scrubber->lastIoCount) {
+            return 0;
+        }
+        scrubber->lastIoCount = ioCount;
+        pthread_mutex_lock(&scrubber->lock);
+        scrubber->stats.yields++;
+        pthread_mutex_unlock(&scrubber->lock);
+        if (scrubWait(scrubber, SCRUB_YIELD_MS / 1000.0)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Scrubs every page of the file once. The page count is taken from the open file before
+ *        every chunk, so pages appended or truncated through another handle sharing the file
+ *        are seen during the pass.
+ * @return RC_OK, also if problems were found; they are counted and reported.
+ */
+static RC scrubPass(SM_Scrubber *scrubber)
+{
+    SM_FileHandle *fHandle = scrubber->fHandle;
+    int pageSize = fHandle->pageSize;
+    int numPages = __atomic_load_n(&scrubber->openFile->numPages, __ATOMIC_RELAXED);
+    int chunkPages = scrubber->options.chunkPages;
+    char *ok = scrubber->pageOk;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long passBytes = 0;
+
+    if (scrubber->openFile->backend == &posixBackend) {
+        // A file that does not end on a page boundary lost part of a write.
+        struct stat st;
+        off_t dataOffset = posixBackendDataOffset(scrubber->openFile->state);
+        if (fstat(posixBackendFd(scrubber->openFile->state), &st) == 0
+            && (st.st_size - dataOffset) % pageSize != 0) {
+            reportPage(scrubber, (int) ((st.st_size - dataOffset) / pageSize), SCRUB_TORN_TAIL);
+        }
+    }
+
+    for (int first = 0; first < numPages; first += chunkPages) {
+        if (yieldToForeground(scrubber)) {
+            break;
+        }
+        numPages = __atomic_load_n(&scrubber->openFile->numPages, __ATOMIC_RELAXED);
+        if (first >= numPages) {
+            break;
+        }
+        int count = numPages - first < chunkPages ? numPages - first : chunkPages;
+        readChunk(scrubber, first, count, ok);
+        for (int i = 0; i < count; i++) {
+            if (ok[i] && scrubber->options.verify != NULL
+                && !scrubber->options.verify(first + i, scrubber->buffer + (size_t) i * pageSize, pageSize, scrubber->options.arg)) {
+                reportPage(scrubber, first + i, SCRUB_INVALID_PAGE);
+            }
+        }
+        passBytes += (long long) count * pageSize;
+        pthread_mutex_lock(&scrubber->lock);
+        scrubber->stats.pagesScanned += count;
+        scrubber->stats.bytesRead += (long long) count * pageSize;
+        int stopped = scrubber->stop;
+        pthread_mutex_unlock(&scrubber->lock);
+        if (stopped) {
+            break;
+        }
+        // Stay below the rate limit by sleeping until the bytes read so far are due.
+        if (scrubber->options.maxMBps > 0) {
+            double due = (double) passBytes / (scrubber->options.maxMBps * 1048576.0);
+            double elapsed = elapsedSince(&start);
+            if (due > elapsed && scrubWait(scrubber, due - elapsed)) {
+                break;
+            }
+        }
+    }
+    pthread_mutex_lock(&scrubber->lock);
+    scrubber->stats.passes++;
+    scrubber->stats.elapsedSec += elapsedSince(&start);
+    pthread_mutex_unlock(&scrubber->lock);
+    return RC_OK;
+}
+
+static void *scrubberMain(void *arg)
+{
+    SM_Scrubber *scrubber = (SM_Scrubber*) arg;
+    for (int pass = 0; scrubber->options.maxPasses == 0 || pass < scrubber->options.maxPasses; pass++) {
+        if (pass > 0 && scrubWait(scrubber, scrubber->options.passIntervalMs / 1000.0)) {
+            break;
+        }
+        scrubPass(scrubber);
+        pthread_mutex_lock(&scrubber->lock);
+        int stopped = scrubber->stop;
+        pthread_mutex_unlock(&scrubber->lock);
+        if (stopped) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Sets up a scrubber for an open handle; returns NULL if the arguments are invalid.
+ */
+static SM_Scrubber *newScrubber(SM_FileHandle *fHandle, SM_ScrubOptions *options)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return NULL;
+    }
+    SM_Scrubber *scrubber = (SM_Scrubber*) calloc(1, sizeof(SM_Scrubber));
+    if (scrubber == NULL) {
+        return NULL;
+    }
+    scrubber->fHandle = fHandle;
+    scrubber->openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (options != NULL) {
+        scrubber->options = *options;
+    }
+    if (scrubber->options.chunkPages <= 0) {
+        scrubber->options.chunkPages = SCRUB_DEFAULT_CHUNK_PAGES;
+    }
+    if (scrubber->options.chunkPages > SCRUB_MAX_CHUNK_PAGES) {
+        scrubber->options.chunkPages = SCRUB_MAX_CHUNK_PAGES;
+    }
+    scrubber->lastIoCount = __atomic_load_n(&scrubber->openFile->ioCount, __ATOMIC_RELAXED);
+    scrubber->buffer = (char*) malloc((size_t) scrubber->options.chunkPages * fHandle->pageSize);
+    scrubber->pageOk = (char*) malloc((size_t) scrubber->options.chunkPages);
+    if (scrubber->buffer == NULL || scrubber->pageOk == NULL) {
+        free(scrubber->buffer);
+        free(scrubber->pageOk);
+        free(scrubber);
+        return NULL;
+    }
+    pthread_mutex_init(&scrubber->lock, NULL);
+    pthread_cond_init(&scrubber->cond, NULL);
+    return scrubber;
+}
+
+static void freeScrubber(SM_Scrubber *scrubber)
+{
+    pthread_mutex_destroy(&scrubber->lock);
+    pthread_cond_destroy(&scrubber->cond);
+    free(scrubber->buffer);
+    free(scrubber->pageOk);
+    free(scrubber);
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Scrubs every page of a file once in the calling thread.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param options Rate limit, chunk size and callbacks; NULL for the defaults.
+ * @param stats If not NULL, receives what the pass found.
+ * @return RC_OK if the pass ran, also if it found corrupt pages.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC scrubPageFile(SM_FileHandle *fHandle, SM_ScrubOptions *options, SM_ScrubStats *stats)
+{
+    SM_Scrubber *scrubber = newScrubber(fHandle, options);
+    if (scrubber == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RC rc = scrubPass(scrubber);
+    if (stats != NULL) {
+        *stats = scrubber->stats;
+    }
+    freeScrubber(scrubber);
+    return rc;
+}
+
+
+/**
+ * @brief Starts a background thread that scrubs the file pass after pass. It stops after
+ *        options->maxPasses passes, when stopScrubber is called or when the file is closed.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param options Rate limit, passes, chunk size and callbacks; NULL for the defaults.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if a scrubber is already running or the thread could not start.
+ */
+RC startScrubber(SM_FileHandle *fHandle, SM_ScrubOptions *options)
+{
+    if (fHandle != NULL && fHandle->mgmtInfo != NULL && ((SM_OpenFile*) fHandle->mgmtInfo)->scrubber != NULL) {
+        printMessage("A scrubber is already running for %s!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    SM_Scrubber *scrubber = newScrubber(fHandle, options);
+    if (scrubber == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (pthread_create(&scrubber->thread, NULL, scrubberMain, scrubber) != 0) {
+        printMessage("The scrubber thread could not be started!\n");
+        freeScrubber(scrubber);
+        return RC_WRITE_FAILED;
+    }
+    scrubber->openFile->scrubber = scrubber;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Stops the background scrubber of a file and waits for it; stats stay readable
+ *        through getScrubStats until the next scrubber is started.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @return RC_OK if successful, also if no scrubber was running.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC stopScrubber(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_Scrubber *scrubber = openFile->scrubber;
+    if (scrubber == NULL) {
+        return RC_OK;
+    }
+    pthread_mutex_lock(&scrubber->lock);
+    scrubber->stop = 1;
+    pthread_cond_signal(&scrubber->cond);
+    pthread_mutex_unlock(&scrubber->lock);
+    pthread_join(scrubber->thread, NULL);
+    openFile->scrubber = NULL;
+    openFile->scrubStats = scrubber->stats;
+    freeScrubber(scrubber);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Returns non-zero if the background scrubber of the file was started through this
+ *        handle, which it keeps using until it stops.
+ */
+int scrubberUsesHandle(SM_FileHandle *fHandle)
+{
+    SM_OpenFile *openFile = fHandle == NULL ? NULL : (SM_OpenFile*) fHandle->mgmtInfo;
+    return openFile != NULL && openFile->scrubber != NULL && openFile->scrubber->fHandle == fHandle;
+}
+
+
+/**
+ * @brief Reports the progress of the running scrubber, or the final stats of the last one.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC getScrubStats(SM_FileHandle *fHandle, SM_ScrubStats *stats)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || stats == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    SM_Scrubber *scrubber = openFile->scrubber;
+    if (scrubber == NULL) {
+        *stats = openFile->scrubStats;
+        return RC_OK;
+    }
+    pthread_mutex_lock(&scrubber->lock);
+    *stats = scrubber->stats;
+    pthread_mutex_unlock(&scrubber->lock);
+    return RC_OK;
+}
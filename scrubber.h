@@ -0,0 +1,71 @@
+#ifndef SCRUBBER_H
+#define SCRUBBER_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    scrubber constants                    *
+ ************************************************************/
+/* pages read per sequential read when the options do not say otherwise */
+#define SCRUB_DEFAULT_CHUNK_PAGES 64
+/* upper bound on the pages per sequential read; larger requests are clamped to it */
+#define SCRUB_MAX_CHUNK_PAGES 1024
+/* how long the scrubber backs off when the handle saw foreground I/O, and how often in a row */
+#define SCRUB_YIELD_MS 1
+#define SCRUB_MAX_YIELDS 10
+
+typedef struct SM_Scrubber SM_Scrubber;
+
+/* what is wrong with a page reported to the corrupt page callback */
+typedef enum SM_ScrubProblem {
+	SCRUB_READ_ERROR = 0,     /* the page could not be read */
+	SCRUB_BAD_CHECKSUM = 1,   /* the backend's stored checksum does not match */
+	SCRUB_INVALID_PAGE = 2,   /* the page verifier rejected the page */
+	SCRUB_TORN_TAIL = 3       /* the file ends in a partial page */
+} SM_ScrubProblem;
+
+/* returns non-zero if the page is valid; lets upper layers check their own page invariants */
+typedef int (*SM_PageVerifier) (int pageNum, const char *page, int pageSize, void *arg);
+/* called from the scrubber for every problem it finds */
+typedef void (*SM_CorruptPageCallback) (char *fileName, int pageNum, SM_ScrubProblem problem, void *arg);
+
+typedef struct SM_ScrubOptions {
+	int maxMBps;              /* read rate limit, 0 for no limit */
+	int chunkPages;           /* pages per sequential read, 0 for the default */
+	int maxPasses;            /* passes of a background scrubber, 0 until it is stopped */
+	int passIntervalMs;       /* pause between two passes of a background scrubber */
+	SM_PageVerifier verify;   /* optional */
+	SM_CorruptPageCallback onCorrupt; /* optional */
+	void *arg;                /* passed to both callbacks */
+} SM_ScrubOptions;
+
+typedef struct SM_ScrubStats {
+	long passes;
+	long pagesScanned;
+	long corruptPages;
+	long long bytesRead;
+	long yields;
+	double elapsedSec;
+} SM_ScrubStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC scrubPageFile (SM_FileHandle *fHandle, SM_ScrubOptions *options, SM_ScrubStats *stats);
+extern RC startScrubber (SM_FileHandle *fHandle, SM_ScrubOptions *options);
+extern RC stopScrubber (SM_FileHandle *fHandle);
+extern RC getScrubStats (SM_FileHandle *fHandle, SM_ScrubStats *stats);
+
+/* used by the storage manager when one of several handles of a file is closed */
+extern int scrubberUsesHandle (SM_FileHandle *fHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
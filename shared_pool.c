@@ -0,0 +1,891 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "shared_pool.h"
+#include "mem_governor.h"
+#include "sm_backend.h"
+#include "page_kernels.h"
+
+/*
+ * A shared pool is a cache of page frames in a POSIX shared memory object, so processes that
+ * open the same page files share one copy of each cached page. Layout of the segment:
+ *
+ *   PoolHeader | PoolFrame[numFrames] | hash buckets[2 * numFrames] | frame data (page aligned)
+ *
+ * The pool latch (a robust, process-shared mutex in the header) guards the file table, the
+ * hash chains, frame ownership and pin counts. Each frame has a process-shared rwlock guarding
+ * its bytes; it is taken after the pool latch or on its own, never the other way round.
+ *
+ * Writes only update the frame and set its dirty flag, which lives in shared memory, so every
+ * process sees the newest version. Dirty frames reach the file when they are evicted, when any
+ * process syncs or closes the file, or on flushSharedPool. Files are identified by device and
+ * inode and reopened by absolute path by whichever process writes a frame back.
+ *
+ * A file table entry counts the open files attached to it in all processes and is released
+ * when the last one is closed. Every reuse of an entry bumps its generation, so descriptors a
+ * process opened for the previous file are not used for the new one. Destroying a page file
+ * drops its frames in the pools this process has open and marks its entry removed; frames
+ * written afterwards through handles still open on the destroyed file are never written back.
+ * An entry attached by a process that exits without closing the file stays in use.
+ */
+
+typedef struct PoolFile {
+    int used;
+    int removed;          /* the file was destroyed while handles were still attached */
+    int attached;         /* open files attached to the entry, in all processes */
+    unsigned int generation;
+    dev_t dev;
+    ino_t ino;
+    long dataOffset;
+    char path[SHARED_POOL_PATH_MAX];
+} PoolFile;
+
+typedef struct PoolFrame {
+    int fileIndex;    /* -1 if the frame is free */
+    int pageNum;
+    int next;         /* next frame in the hash chain */
+    int valid;        /* cleared if loading the page failed */
+    int dirty;
+    int refBit;
+    int pinCount;
+    pthread_rwlock_t latch;
+} PoolFrame;
+
+typedef struct PoolHeader {
+    char magic[8];
+    int initialized;
+    int numFrames;
+    int numBuckets;
+    int pageSize;
+    int clockHand;
+    long hits;
+    long misses;
+    long evictions;
+    long writeBacks;
+    pthread_mutex_t lock;
+    PoolFile files[SHARED_POOL_MAX_FILES];
+} PoolHeader;
+
+struct SM_SharedPool {
+    size_t size;
+    PoolHeader *header;
+    PoolFrame *frames;
+    int *buckets;
+    char *data;
+    /* this process's descriptors for writing frames back, opened on demand, and the
+     * generation of the file table entry each was opened for */
+    int fds[SHARED_POOL_MAX_FILES];
+    unsigned int fdGenerations[SHARED_POOL_MAX_FILES];
+    /* the mapping is charged to the memory budget of this process */
+    SM_MemConsumer *memory;
+    /* next pool this process has open */
+    SM_SharedPool *next;
+};
+
+/* the pools this process has open, so destroying a page file can drop its frames */
+static SM_SharedPool *openPools = NULL;
+static pthread_mutex_t openPoolsLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static size_t alignUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static size_t poolSize(int numFrames, int pageSize, size_t *dataOffset)
+{
+    size_t meta = sizeof(PoolHeader) + sizeof(PoolFrame) * numFrames + sizeof(int) * 2 * numFrames;
+    *dataOffset = alignUp(meta, 4096);
+    return *dataOffset + (size_t) numFrames * pageSize;
+}
+
+static void lockPool(SM_SharedPool *pool)
+{
+    // The latch is robust so a process that died holding it does not block the others forever.
+    if (pthread_mutex_lock(&pool->header->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&pool->header->lock);
+    }
+}
+
+static void unlockPool(SM_SharedPool *pool)
+{
+    pthread_mutex_unlock(&pool->header->lock);
+}
+
+static char *frameData(SM_SharedPool *pool, int frame)
+{
+    return pool->data + (size_t) frame * pool->header->pageSize;
+}
+
+static int bucketOf(SM_SharedPool *pool, int fileIndex, int pageNum)
+{
+    unsigned int hash = (unsigned int) fileIndex * 0x9e3779b1u ^ (unsigned int) pageNum * 0x85ebca6bu;
+    return (int) (hash % (unsigned int) pool->header->numBuckets);
+}
+
+/**
+ * @brief Finds the frame caching a page. Must be called with the pool latch held.
+ */
+static int findFrame(SM_SharedPool *pool, int fileIndex, int pageNum)
+{
+    int frame = pool->buckets[bucketOf(pool, fileIndex, pageNum)];
+    while (frame != -1 && (pool->frames[frame].fileIndex != fileIndex || pool->frames[frame].pageNum != pageNum)) {
+        frame = pool->frames[frame].next;
+    }
+    return frame;
+}
+
+static void unlinkFrame(SM_SharedPool *pool, int frame)
+{
+    PoolFrame *f = &pool->frames[frame];
+    int *link = &pool->buckets[bucketOf(pool, f->fileIndex, f->pageNum)];
+    while (*link != frame) {
+        link = &pool->frames[*link].next;
+    }
+    *link = f->next;
+    f->fileIndex = -1;
+    f->next = -1;
+}
+
+/**
+ * @brief Returns this process's descriptor for writing back the pages of a file table entry,
+ *        opening it by path if there is none for the entry's current generation.
+ *        Must be called with the pool latch held.
+ * @return the descriptor, or -1 if the file could not be opened.
+ */
+static int poolFileFd(SM_SharedPool *pool, int fileIndex)
+{
+    PoolFile *file = &pool->header->files[fileIndex];
+    if (pool->fds[fileIndex] != -1 && pool->fdGenerations[fileIndex] != file->generation) {
+        close(pool->fds[fileIndex]);
+        pool->fds[fileIndex] = -1;
+    }
+    if (pool->fds[fileIndex] == -1) {
+        pool->fds[fileIndex] = open(file->path, O_WRONLY);
+        pool->fdGenerations[fileIndex] = file->generation;
+    }
+    return pool->fds[fileIndex];
+}
+
+/**
+ * @brief Writes a dirty frame to its file. Must be called with the pool latch held; the frame's
+ *        read latch keeps writers out while the page is written. Frames of a destroyed file
+ *        are only marked clean.
+ */
+static RC writeBackFrame(SM_SharedPool *pool, int frame)
+{
+    PoolFrame *f = &pool->frames[frame];
+    PoolFile *file = &pool->header->files[f->fileIndex];
+    if (file->removed) {
+        __atomic_store_n(&f->dirty, 0, __ATOMIC_RELEASE);
+        return RC_OK;
+    }
+    int fd = poolFileFd(pool, f->fileIndex);
+    if (fd == -1) {
+        return RC_WRITE_FAILED;
+    }
+    int pageSize = pool->header->pageSize;
+    RC rc = RC_OK;
+    pthread_rwlock_rdlock(&f->latch);
+    // Clearing the flag before writing means a concurrent update sets it again and is not lost.
+    __atomic_store_n(&f->dirty, 0, __ATOMIC_RELEASE);
+    if (pwrite(fd, frameData(pool, frame), (size_t) pageSize,
+               file->dataOffset + (off_t) f->pageNum * pageSize) != pageSize) {
+        __atomic_store_n(&f->dirty, 1, __ATOMIC_RELEASE);
+        rc = RC_WRITE_FAILED;
+    }
+    pthread_rwlock_unlock(&f->latch);
+    if (rc == RC_OK) {
+        __atomic_fetch_add(&pool->header->writeBacks, 1, __ATOMIC_RELAXED);
+    }
+    return rc;
+}
+
+/**
+ * @brief Picks a frame for a new page with the clock algorithm, writing a dirty victim back
+ *        first. Must be called with the pool latch held.
+ * @return the frame, or -1 if every frame is pinned or the victim could not be written.
+ */
+static int allocateFrame(SM_SharedPool *pool)
+{
+    PoolHeader *header = pool->header;
+    for (int i = 0; i < 2 * header->numFrames + 1; i++) {
+        int frame = header->clockHand;
+        header->clockHand = (header->clockHand + 1) % header->numFrames;
+        PoolFrame *f = &pool->frames[frame];
+        if (f->fileIndex == -1) {
+            return frame;
+        }
+        if (__atomic_load_n(&f->pinCount, __ATOMIC_ACQUIRE) > 0) {
+            continue;
+        }
+        if (f->refBit) {
+            f->refBit = 0;
+            continue;
+        }
+        if (__atomic_load_n(&f->dirty, __ATOMIC_ACQUIRE) && writeBackFrame(pool, frame) != RC_OK) {
+            continue;
+        }
+        unlinkFrame(pool, frame);
+        header->evictions++;
+        return frame;
+    }
+    return -1;
+}
+
+/**
+ * @brief Maps a page to a free frame and pins it. Must be called with the pool latch held.
+ */
+static int installFrame(SM_SharedPool *pool, int fileIndex, int pageNum)
+{
+    int frame = allocateFrame(pool);
+    if (frame == -1) {
+        return -1;
+    }
+    PoolFrame *f = &pool->frames[frame];
+    int bucket = bucketOf(pool, fileIndex, pageNum);
+    f->fileIndex = fileIndex;
+    f->pageNum = pageNum;
+    f->valid = 1;
+    f->dirty = 0;
+    f->refBit = 1;
+    f->pinCount = 1;
+    f->next = pool->buckets[bucket];
+    pool->buckets[bucket] = frame;
+    return frame;
+}
+
+static void unpinFrame(SM_SharedPool *pool, int frame)
+{
+    __atomic_fetch_sub(&pool->frames[frame].pinCount, 1, __ATOMIC_RELEASE);
+}
+
+static RC initPool(SM_SharedPool *pool, int numFrames, int pageSize)
+{
+    PoolHeader *header = pool->header;
+    memcpy(header->magic, SHARED_POOL_MAGIC, sizeof(header->magic));
+    header->numFrames = numFrames;
+    header->numBuckets = 2 * numFrames;
+    header->pageSize = pageSize;
+    pthread_mutexattr_t mutexAttr;
+    pthread_mutexattr_init(&mutexAttr);
+    pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+    int rc = pthread_mutex_init(&header->lock, &mutexAttr);
+    pthread_mutexattr_destroy(&mutexAttr);
+    pthread_rwlockattr_t latchAttr;
+    pthread_rwlockattr_init(&latchAttr);
+    pthread_rwlockattr_setpshared(&latchAttr, PTHREAD_PROCESS_SHARED);
+    for (int i = 0; i < numFrames && rc == 0; i++) {
+        pool->frames[i].fileIndex = -1;
+        pool->frames[i].next = -1;
+        rc = pthread_rwlock_init(&pool->frames[i].latch, &latchAttr);
+    }
+    pthread_rwlockattr_destroy(&latchAttr);
+    for (int i = 0; i < header->numBuckets; i++) {
+        pool->buckets[i] = -1;
+    }
+    return rc == 0 ? RC_OK : RC_WRITE_FAILED;
+}
+
+static void mapPoolParts(SM_SharedPool *pool, char *base, int numFrames, int pageSize)
+{
+    size_t dataOffset;
+    poolSize(numFrames, pageSize, &dataOffset);
+    pool->header = (PoolHeader*) base;
+    pool->frames = (PoolFrame*) (base + sizeof(PoolHeader));
+    pool->buckets = (int*) (base + sizeof(PoolHeader) + sizeof(PoolFrame) * numFrames);
+    pool->data = base + dataOffset;
+}
+
+
+/************************************************************
+ *                    storage manager hooks                 *
+ ************************************************************/
+
+/**
+ * @brief Reads a page through the pool. On a miss the frame is claimed and latched before the
+ *        page is read from the file, so other processes wait for it instead of reading it too.
+ */
+RC sharedPoolRead(SM_SharedPool *pool, struct SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage)
+{
+    int fileIndex = openFile->poolFile;
+    int pageSize = pool->header->pageSize;
+    lockPool(pool);
+    int frame = findFrame(pool, fileIndex, pageNum);
+    if (frame != -1) {
+        PoolFrame *f = &pool->frames[frame];
+        __atomic_fetch_add(&f->pinCount, 1, __ATOMIC_ACQUIRE);
+        f->refBit = 1;
+        pool->header->hits++;
+        unlockPool(pool);
+        pthread_rwlock_rdlock(&f->latch);
+        int valid = f->valid;
+        if (valid) {
+            memcpy(memPage, frameData(pool, frame), (size_t) pageSize);
+        }
+        pthread_rwlock_unlock(&f->latch);
+        unpinFrame(pool, frame);
+        return valid ? RC_OK : RC_READ_NON_EXISTING_PAGE;
+    }
+    pool->header->misses++;
+    frame = installFrame(pool, fileIndex, pageNum);
+    if (frame == -1) {
+        unlockPool(pool);
+        // Every frame is pinned; read around the pool.
+        return openFile->backend->read(openFile->state, pageNum, memPage);
+    }
+    PoolFrame *f = &pool->frames[frame];
+    pthread_rwlock_wrlock(&f->latch);
+    unlockPool(pool);
+    RC rc = openFile->backend->read(openFile->state, pageNum, frameData(pool, frame));
+    if (rc == RC_OK) {
+        memcpy(memPage, frameData(pool, frame), (size_t) pageSize);
+    }
+    else {
+        f->valid = 0;
+    }
+    pthread_rwlock_unlock(&f->latch);
+    if (rc != RC_OK) {
+        lockPool(pool);
+        unlinkFrame(pool, frame);
+        unlockPool(pool);
+    }
+    unpinFrame(pool, frame);
+    return rc;
+}
+
+/**
+ * @brief Writes a page into its frame and marks it dirty; the file is written later.
+ */
+RC sharedPoolWrite(SM_SharedPool *pool, struct SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage)
+{
+    int fileIndex = openFile->poolFile;
+    lockPool(pool);
+    int frame = findFrame(pool, fileIndex, pageNum);
+    if (frame != -1) {
+        __atomic_fetch_add(&pool->frames[frame].pinCount, 1, __ATOMIC_ACQUIRE);
+        pool->frames[frame].refBit = 1;
+    }
+    else {
+        frame = installFrame(pool, fileIndex, pageNum);
+    }
+    unlockPool(pool);
+    if (frame == -1) {
+        // Every frame is pinned; write around the pool.
+        return openFile->backend->write(openFile->state, pageNum, memPage);
+    }
+    PoolFrame *f = &pool->frames[frame];
+    pthread_rwlock_wrlock(&f->latch);
+    memcpy(frameData(pool, frame), memPage, (size_t) pool->header->pageSize);
+    f->valid = 1;
+    __atomic_store_n(&f->dirty, 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&f->latch);
+    unpinFrame(pool, frame);
+    return RC_OK;
+}
+
+/**
+ * @brief Writes every dirty frame of one file back, whichever process dirtied it.
+ *        A fileIndex of -1 flushes all files.
+ */
+RC sharedPoolFlushFile(SM_SharedPool *pool, int fileIndex)
+{
+    RC rc = RC_OK;
+    lockPool(pool);
+    for (int frame = 0; frame < pool->header->numFrames; frame++) {
+        PoolFrame *f = &pool->frames[frame];
+        if (f->fileIndex != -1 && (fileIndex == -1 || f->fileIndex == fileIndex)
+            && __atomic_load_n(&f->dirty, __ATOMIC_ACQUIRE) && writeBackFrame(pool, frame) != RC_OK) {
+            rc = RC_WRITE_FAILED;
+        }
+    }
+    unlockPool(pool);
+    return rc;
+}
+
+typedef struct DirtyFrame {
+    int pageNum;
+    int frame;
+} DirtyFrame;
+
+static int compareDirtyFrames(const void *a, const void *b)
+{
+    int x = ((const DirtyFrame*) a)->pageNum, y = ((const DirtyFrame*) b)->pageNum;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Counts the dirty frames of one file.
+ */
+int sharedPoolDirtyPages(SM_SharedPool *pool, int fileIndex)
+{
+    int dirty = 0;
+    lockPool(pool);
+    for (int frame = 0; frame < pool->header->numFrames; frame++) {
+        PoolFrame *f = &pool->frames[frame];
+        dirty += f->fileIndex == fileIndex && __atomic_load_n(&f->dirty, __ATOMIC_ACQUIRE) != 0;
+    }
+    unlockPool(pool);
+    return dirty;
+}
+
+/**
+ * @brief Writes the dirty frames of one file back in page order without stopping writers for
+ *        the whole flush. The dirty frames are collected and pinned under the pool latch, which
+ *        is then released; each frame is written back taking the pool latch again for that one
+ *        frame, so a writer waits at most for one page write. Frames dirtied again after the
+ *        collection are left for the next flush.
+ *
+ * @param pagesFlushed If not NULL, receives the number of frames written back.
+ */
+RC sharedPoolFlushDirty(SM_SharedPool *pool, int fileIndex, int *pagesFlushed)
+{
+    int numFrames = pool->header->numFrames;
+    DirtyFrame *dirty = (DirtyFrame*) malloc(sizeof(DirtyFrame) * (size_t) numFrames);
+    if (dirty == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    int count = 0;
+    RC rc = RC_OK;
+    lockPool(pool);
+    if (!pool->header->files[fileIndex].removed && poolFileFd(pool, fileIndex) == -1) {
+        rc = RC_WRITE_FAILED;
+    }
+    for (int frame = 0; frame < numFrames && rc == RC_OK; frame++) {
+        PoolFrame *f = &pool->frames[frame];
+        if (f->fileIndex == fileIndex && __atomic_load_n(&f->dirty, __ATOMIC_ACQUIRE)) {
+            __atomic_fetch_add(&f->pinCount, 1, __ATOMIC_ACQUIRE);
+            dirty[count].pageNum = f->pageNum;
+            dirty[count].frame = frame;
+            count++;
+        }
+    }
+    unlockPool(pool);
+    // Page order turns the write-backs into a mostly sequential sweep over the file.
+    qsort(dirty, (size_t) count, sizeof(DirtyFrame), compareDirtyFrames);
+    int flushed = 0;
+    for (int i = 0; i < count; i++) {
+        // The latch keeps the file table entry and this process's descriptors still while the
+        // frame is written, since the file may be destroyed or detached meanwhile.
+        lockPool(pool);
+        if (__atomic_load_n(&pool->frames[dirty[i].frame].dirty, __ATOMIC_ACQUIRE)) {
+            if (writeBackFrame(pool, dirty[i].frame) == RC_OK) {
+                flushed++;
+            }
+            else {
+                rc = RC_WRITE_FAILED;
+            }
+        }
+        unlockPool(pool);
+        unpinFrame(pool, dirty[i].frame);
+    }
+    free(dirty);
+    if (pagesFlushed != NULL) {
+        *pagesFlushed = flushed;
+    }
+    return rc;
+}
+
+/**
+ * @brief Drops the frames of pages that were changed in the file behind the pool's back.
+ */
+void sharedPoolInvalidate(SM_SharedPool *pool, int fileIndex, int first, int count)
+{
+    lockPool(pool);
+    for (int frame = 0; frame < pool->header->numFrames; frame++) {
+        PoolFrame *f = &pool->frames[frame];
+        if (f->fileIndex == fileIndex && f->pageNum >= first && f->pageNum < first + count
+            && __atomic_load_n(&f->pinCount, __ATOMIC_ACQUIRE) == 0) {
+            f->dirty = 0;
+            unlinkFrame(pool, frame);
+        }
+    }
+    unlockPool(pool);
+}
+
+
+/**
+ * @brief Drops the unpinned frames of a file, dirty or not, and frees its file table entry if
+ *        no open file is attached to it any more and no frame is left.
+ *        Must be called with the pool latch held.
+ */
+static void dropFileFrames(SM_SharedPool *pool, int fileIndex)
+{
+    int left = 0;
+    for (int frame = 0; frame < pool->header->numFrames; frame++) {
+        PoolFrame *f = &pool->frames[frame];
+        if (f->fileIndex != fileIndex) {
+            continue;
+        }
+        if (__atomic_load_n(&f->pinCount, __ATOMIC_ACQUIRE) > 0) {
+            left++;
+            continue;
+        }
+        f->dirty = 0;
+        unlinkFrame(pool, frame);
+    }
+    PoolFile *file = &pool->header->files[fileIndex];
+    if (file->attached == 0 && left == 0) {
+        file->used = 0;
+        file->removed = 0;
+        file->generation++;
+    }
+}
+
+/**
+ * @brief Detaches an open file from its pool entry when the file is closed. The last file to
+ *        detach writes the entry's dirty frames back, drops its frames and frees the entry.
+ */
+void sharedPoolDetach(SM_SharedPool *pool, int fileIndex)
+{
+    lockPool(pool);
+    PoolFile *file = &pool->header->files[fileIndex];
+    if (--file->attached == 0) {
+        int dirtyLeft = 0;
+        for (int frame = 0; frame < pool->header->numFrames; frame++) {
+            PoolFrame *f = &pool->frames[frame];
+            if (f->fileIndex == fileIndex && __atomic_load_n(&f->dirty, __ATOMIC_ACQUIRE)
+                && writeBackFrame(pool, frame) != RC_OK) {
+                dirtyLeft++;
+            }
+        }
+        // Frames that could not be written keep the entry, so they can still be flushed later.
+        if (dirtyLeft == 0) {
+            dropFileFrames(pool, fileIndex);
+        }
+    }
+    if (!file->used && pool->fds[fileIndex] != -1) {
+        close(pool->fds[fileIndex]);
+        pool->fds[fileIndex] = -1;
+    }
+    unlockPool(pool);
+}
+
+/**
+ * @brief Drops the frames of a page file that is being destroyed from every pool this process
+ *        has open, so they are never written into a file created later under the same path.
+ */
+void sharedPoolForgetFile(const char *fileName)
+{
+    struct stat st;
+    if (stat(fileName, &st) != 0) {
+        return;
+    }
+    pthread_mutex_lock(&openPoolsLock);
+    for (SM_SharedPool *pool = openPools; pool != NULL; pool = pool->next) {
+        lockPool(pool);
+        for (int i = 0; i < SHARED_POOL_MAX_FILES; i++) {
+            PoolFile *file = &pool->header->files[i];
+            if (file->used && !file->removed && file->dev == st.st_dev && file->ino == st.st_ino) {
+                file->removed = 1;
+                dropFileFrames(pool, i);
+            }
+        }
+        unlockPool(pool);
+    }
+    pthread_mutex_unlock(&openPoolsLock);
+}
+
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+
+/**
+ * @brief Opens the shared pool with the given name, creating it with numFrames frames of
+ *        pageSize bytes if it does not exist yet. Processes opening an existing pool get its
+ *        size and page size; numFrames and pageSize are then ignored. With numFrames = 0 only
+ *        an existing pool is opened.
+ *
+ * @param poolName Name of the shared memory object, for example "/sm_pool".
+ * @param numFrames Number of page frames of a new pool, or 0 to open an existing one.
+ * @param pageSize Page size of a new pool; only files with this page size can be attached.
+ * @param pool Receives this process's mapping of the pool.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the shared memory object could not be created or mapped.
+ *         RC_WRITE_FAILED if the arguments are invalid.
+ *         RC_MEMORY_BUDGET_EXCEEDED if the pool does not fit in the memory budget.
+ */
+RC openSharedPool(char *poolName, int numFrames, int pageSize, SM_SharedPool **pool)
+{
+    if (poolName == NULL || pool == NULL || (numFrames > 0 && !IS_SUPPORTED_PAGE_SIZE(pageSize))) {
+        printMessage("The shared pool can't be opened with these arguments.\n");
+        return RC_WRITE_FAILED;
+    }
+    SM_SharedPool *shared = (SM_SharedPool*) calloc(1, sizeof(SM_SharedPool));
+    if (shared == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    for (int i = 0; i < SHARED_POOL_MAX_FILES; i++) {
+        shared->fds[i] = -1;
+    }
+    size_t dataOffset;
+    int created = numFrames > 0;
+    int fd = created ? shm_open(poolName, O_RDWR | O_CREAT | O_EXCL, 0600) : -1;
+    if (!created || (fd == -1 && errno == EEXIST)) {
+        created = 0;
+        fd = shm_open(poolName, O_RDWR, 0600);
+    }
+    if (fd == -1) {
+        printMessage("The shared pool %s could not be opened!\n", poolName);
+        free(shared);
+        return RC_FILE_NOT_FOUND;
+    }
+    if (created) {
+        shared->size = poolSize(numFrames, pageSize, &dataOffset);
+        if (ftruncate(fd, (off_t) shared->size) != 0) {
+            close(fd);
+            shm_unlink(poolName);
+            free(shared);
+            return RC_FILE_NOT_FOUND;
+        }
+    }
+    else {
+        // Wait until the creator has sized and initialized the segment.
+        struct stat st;
+        while (fstat(fd, &st) == 0 && (size_t) st.st_size < sizeof(PoolHeader)) {
+            sched_yield();
+        }
+        PoolHeader *header = (PoolHeader*) mmap(NULL, sizeof(PoolHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (header == MAP_FAILED) {
+            close(fd);
+            free(shared);
+            return RC_FILE_NOT_FOUND;
+        }
+        while (!__atomic_load_n(&header->initialized, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+        numFrames = header->numFrames;
+        pageSize = header->pageSize;
+        munmap(header, sizeof(PoolHeader));
+        shared->size = poolSize(numFrames, pageSize, &dataOffset);
+    }
+    if (registerMemConsumer(poolName, MEMGOV_DEFAULT_WEIGHT, NULL, NULL, &shared->memory) != RC_OK
+        || memReserve(shared->memory, (long long) shared->size) != RC_OK) {
+        unregisterMemConsumer(shared->memory);
+        close(fd);
+        if (created) {
+            shm_unlink(poolName);
+        }
+        free(shared);
+        return RC_MEMORY_BUDGET_EXCEEDED;
+    }
+    char *base = (char*) mmap(NULL, shared->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        if (created) {
+            shm_unlink(poolName);
+        }
+        unregisterMemConsumer(shared->memory);
+        free(shared);
+        printMessage("The shared pool %s could not be mapped!\n", poolName);
+        return RC_FILE_NOT_FOUND;
+    }
+    mapPoolParts(shared, base, numFrames, pageSize);
+    if (created) {
+        if (initPool(shared, numFrames, pageSize) != RC_OK) {
+            munmap(base, shared->size);
+            shm_unlink(poolName);
+            unregisterMemConsumer(shared->memory);
+            free(shared);
+            return RC_WRITE_FAILED;
+        }
+        __atomic_store_n(&shared->header->initialized, 1, __ATOMIC_RELEASE);
+    }
+    else if (memcmp(shared->header->magic, SHARED_POOL_MAGIC, sizeof(shared->header->magic)) != 0) {
+        munmap(base, shared->size);
+        unregisterMemConsumer(shared->memory);
+        free(shared);
+        return RC_FILE_NOT_FOUND;
+    }
+    pthread_mutex_lock(&openPoolsLock);
+    shared->next = openPools;
+    openPools = shared;
+    pthread_mutex_unlock(&openPoolsLock);
+    *pool = shared;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Unmaps a pool from this process. Dirty frames stay in the pool; handles attached to
+ *        it must be closed first.
+ *
+ * @param pool The pool returned by openSharedPool.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the pool is NULL.
+ */
+RC closeSharedPool(SM_SharedPool *pool)
+{
+    if (pool == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    pthread_mutex_lock(&openPoolsLock);
+    SM_SharedPool **link = &openPools;
+    while (*link != NULL && *link != pool) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = pool->next;
+    }
+    pthread_mutex_unlock(&openPoolsLock);
+    for (int i = 0; i < SHARED_POOL_MAX_FILES; i++) {
+        if (pool->fds[i] != -1) {
+            close(pool->fds[i]);
+        }
+    }
+    munmap(pool->header, pool->size);
+    unregisterMemConsumer(pool->memory);
+    free(pool);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Removes the shared memory object of a pool. Processes that still have it mapped keep
+ *        using it; the memory is freed when the last one closes it.
+ *
+ * @param poolName Name of the shared memory object.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if there is no such pool.
+ */
+RC destroySharedPool(char *poolName)
+{
+    if (poolName == NULL || shm_unlink(poolName) != 0) {
+        return RC_FILE_NOT_FOUND;
+    }
+    return RC_OK;
+}
+
+
+/**
+ * @brief Routes readBlock and writeBlock of a handle through a shared pool. Every process
+ *        that opens the file has to attach its handles to the same pool, since writes stay in
+ *        the pool until the file is synced or closed. The file's entry in the pool's file
+ *        table is freed when the last open file attached to it is closed.
+ *
+ * @param fHandle An open page file on disk with the pool's page size.
+ * @param pool The pool returned by openSharedPool.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the file can't be cached in the pool, is already cached in another
+ *         pool or the file table is full.
+ */
+RC attachSharedPool(SM_FileHandle *fHandle, SM_SharedPool *pool)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || pool == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->pool == pool) {
+        return RC_OK;
+    }
+    if (openFile->pool != NULL || openFile->backend != &posixBackend || fHandle->pageSize != pool->header->pageSize) {
+        printMessage("The file %s can't be cached in the shared pool!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    struct stat st;
+    char path[PATH_MAX];
+    if (fstat(posixBackendFd(openFile->state), &st) != 0 || realpath(fHandle->fileName, path) == NULL
+        || strlen(path) >= SHARED_POOL_PATH_MAX) {
+        printMessage("The file %s can't be cached in the shared pool!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    int fileIndex = -1;
+    lockPool(pool);
+    for (int i = 0; i < SHARED_POOL_MAX_FILES; i++) {
+        PoolFile *file = &pool->header->files[i];
+        if (file->used && !file->removed && file->dev == st.st_dev && file->ino == st.st_ino) {
+            fileIndex = i;
+            break;
+        }
+        if (!file->used && fileIndex == -1) {
+            fileIndex = i;
+        }
+    }
+    if (fileIndex != -1 && !pool->header->files[fileIndex].used) {
+        PoolFile *file = &pool->header->files[fileIndex];
+        file->used = 1;
+        file->removed = 0;
+        file->attached = 0;
+        file->dev = st.st_dev;
+        file->ino = st.st_ino;
+        file->dataOffset = posixBackendDataOffset(openFile->state);
+        strcpy(file->path, path);
+    }
+    if (fileIndex != -1) {
+        pool->header->files[fileIndex].attached++;
+    }
+    unlockPool(pool);
+    if (fileIndex == -1) {
+        printMessage("The shared pool has no room for %s!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    // Pages are served by the pool from now on.
+    int epoch = beginOpenFileIo(openFile);
+    coldTierInvalidate(__atomic_load_n(&openFile->coldTier, __ATOMIC_ACQUIRE), 0, fHandle->totalNumPages);
+    endOpenFileIo(openFile, epoch);
+    openFile->pool = pool;
+    openFile->poolFile = fileIndex;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Writes every dirty frame of the pool back to its file.
+ *
+ * @param pool The pool returned by openSharedPool.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the pool is NULL.
+ *         RC_WRITE_FAILED if a frame could not be written.
+ */
+RC flushSharedPool(SM_SharedPool *pool)
+{
+    if (pool == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return sharedPoolFlushFile(pool, -1);
+}
+
+
+/**
+ * @brief Reports the size, occupancy and hit, miss, eviction and write-back counts of a pool,
+ *        summed over all processes using it.
+ *
+ * @param pool The pool returned by openSharedPool.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the pool is NULL.
+ */
+RC getSharedPoolStats(SM_SharedPool *pool, SM_SharedPoolStats *stats)
+{
+    if (pool == NULL || stats == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    memset(stats, 0, sizeof(*stats));
+    lockPool(pool);
+    stats->numFrames = pool->header->numFrames;
+    for (int frame = 0; frame < pool->header->numFrames; frame++) {
+        if (pool->frames[frame].fileIndex != -1) {
+            stats->framesInUse++;
+            stats->dirtyFrames += __atomic_load_n(&pool->frames[frame].dirty, __ATOMIC_ACQUIRE) != 0;
+        }
+    }
+    stats->hits = pool->header->hits;
+    stats->misses = pool->header->misses;
+    stats->evictions = pool->header->evictions;
+    stats->writeBacks = pool->header->writeBacks;
+    unlockPool(pool);
+    return RC_OK;
+}
@@ -0,0 +1,59 @@
+#ifndef SHARED_POOL_H
+#define SHARED_POOL_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    shared pool constants                 *
+ ************************************************************/
+#define SHARED_POOL_MAGIC "SMSHPOOL"
+/* page files that can be cached in one pool at the same time; an entry is reused once the
+ * last open file attached to it is closed */
+#define SHARED_POOL_MAX_FILES 32
+/* longest absolute path of a cached page file */
+#define SHARED_POOL_PATH_MAX 256
+
+/* one process's mapping of a pool */
+typedef struct SM_SharedPool SM_SharedPool;
+
+typedef struct SM_SharedPoolStats {
+	int numFrames;
+	int framesInUse;
+	int dirtyFrames;
+	long hits;
+	long misses;
+	long evictions;
+	long writeBacks;
+} SM_SharedPoolStats;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC openSharedPool (char *poolName, int numFrames, int pageSize, SM_SharedPool **pool);
+extern RC closeSharedPool (SM_SharedPool *pool);
+extern RC destroySharedPool (char *poolName);
+extern RC attachSharedPool (SM_FileHandle *fHandle, SM_SharedPool *pool);
+extern RC flushSharedPool (SM_SharedPool *pool);
+extern RC getSharedPoolStats (SM_SharedPool *pool, SM_SharedPoolStats *stats);
+
+/* used by the storage manager for handles attached to a pool */
+struct SM_OpenFile;
+extern RC sharedPoolRead (SM_SharedPool *pool, struct SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage);
+extern RC sharedPoolWrite (SM_SharedPool *pool, struct SM_OpenFile *openFile, int pageNum, SM_PageHandle memPage);
+extern RC sharedPoolFlushFile (SM_SharedPool *pool, int fileIndex);
+extern RC sharedPoolFlushDirty (SM_SharedPool *pool, int fileIndex, int *pagesFlushed);
+extern int sharedPoolDirtyPages (SM_SharedPool *pool, int fileIndex);
+extern void sharedPoolInvalidate (SM_SharedPool *pool, int fileIndex, int first, int count);
+extern void sharedPoolDetach (SM_SharedPool *pool, int fileIndex);
+extern void sharedPoolForgetFile (const char *fileName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,576 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "sm_backend.h"
+#include "page_kernels.h"
+#include "log_store.h"
+
+/* zero bytes written when a POSIX page file grows; lives in .bss so it costs nothing until used */
+#define ZERO_CHUNK_SIZE (16 * MAX_PAGE_SIZE)
+static char zeroChunk[ZERO_CHUNK_SIZE];
+
+
+/************************************************************
+ *                    POSIX file backend                    *
+ ************************************************************/
+
+/* Page files start with a PAGE_FILE_HEADER_SIZE header holding the magic and the page size,
+ * so the size is never read from page data. Files without a header were written before the
+ * header existed and hold PAGE_SIZE pages from offset 0. */
+typedef struct PosixFile {
+    int fd;
+    int pageSize;
+    off_t dataOffset;
+} PosixFile;
+
+
+/**
+ * @brief Byte offset of a page in a POSIX page file.
+ */
+static off_t pageOffset(PosixFile *file, int pageNum)
+{
+    return file->dataOffset + (off_t) pageNum * file->pageSize;
+}
+
+/**
+ * @brief Writes count zero pages starting at the given page of a POSIX page file.
+ */
+static RC writeZeroPages(PosixFile *file, int firstPage, int count)
+{
+    off_t offset = pageOffset(file, firstPage);
+    off_t remaining = (off_t) count * file->pageSize;
+    while (remaining > 0) {
+        size_t len = remaining < ZERO_CHUNK_SIZE ? (size_t) remaining : ZERO_CHUNK_SIZE;
+        if (pwrite(file->fd, zeroChunk, len, offset) != (ssize_t) len) {
+            return RC_WRITE_FAILED;
+        }
+        offset += (off_t) len;
+        remaining -= (off_t) len;
+    }
+    return RC_OK;
+}
+
+static RC posixCreate(char *fileName, int pageSize)
+{
+    int fd = open(fileName, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        if (errno == EEXIST) {
+            RC_message = "File is already present there";
+            return RC_OK;
+        }
+        return RC_FILE_NOT_FOUND;
+    }
+    PosixFile file;
+    file.fd = fd;
+    file.pageSize = pageSize;
+    file.dataOffset = PAGE_FILE_HEADER_SIZE;
+    RC rc = RC_OK;
+    SM_PageFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PAGE_FILE_MAGIC, sizeof(header.magic));
+    header.pageSize = pageSize;
+    header.pageSizeCheck = ~pageSize;
+    if (pwrite(fd, zeroChunk, PAGE_FILE_HEADER_SIZE, 0) != PAGE_FILE_HEADER_SIZE
+        || pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK) {
+        rc = writeZeroPages(&file, 0, 1);
+    }
+    if (close(fd) != 0 && rc == RC_OK) {
+        rc = RC_WRITE_FAILED;
+    }
+    return rc;
+}
+
+static RC posixDestroy(char *fileName)
+{
+    return unlink(fileName) == 0 ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+static RC posixOpen(char *fileName, void **state, int *totalNumPages, int *pageSize)
+{
+    int fd = open(fileName, O_RDWR);
+    if (fd == -1) {
+        return RC_FILE_NOT_FOUND;
+    }
+    struct stat st;
+    PosixFile *file = (PosixFile*) malloc(sizeof(PosixFile));
+    if (fstat(fd, &st) != 0 || file == NULL) {
+        close(fd);
+        free(file);
+        return RC_FILE_NOT_FOUND;
+    }
+    file->fd = fd;
+    file->pageSize = PAGE_SIZE;
+    file->dataOffset = 0;
+    // Files without a valid header predate it and are plain arrays of PAGE_SIZE pages.
+    SM_PageFileHeader header;
+    if (st.st_size >= PAGE_FILE_HEADER_SIZE && pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header)
+        && memcmp(header.magic, PAGE_FILE_MAGIC, sizeof(header.magic)) == 0
+        && header.pageSizeCheck == ~header.pageSize && IS_SUPPORTED_PAGE_SIZE(header.pageSize)) {
+        file->pageSize = header.pageSize;
+        file->dataOffset = PAGE_FILE_HEADER_SIZE;
+    }
+    *state = file;
+    *pageSize = file->pageSize;
+    *totalNumPages = (int) ((st.st_size - file->dataOffset) / file->pageSize);
+    return RC_OK;
+}
+
+static RC posixRead(void *state, int pageNum, SM_PageHandle memPage)
+{
+    PosixFile *file = (PosixFile*) state;
+    if (pread(file->fd, memPage, (size_t) file->pageSize, pageOffset(file, pageNum)) != file->pageSize) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    return RC_OK;
+}
+
+static RC posixWrite(void *state, int pageNum, SM_PageHandle memPage)
+{
+    PosixFile *file = (PosixFile*) state;
+    if (pwrite(file->fd, memPage, (size_t) file->pageSize, pageOffset(file, pageNum)) != file->pageSize) {
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+/**
+ * @brief Reads consecutive pages with as few preads as the kernel allows.
+ */
+static RC posixReadPages(void *state, int firstPage, int count, SM_PageHandle memPages)
+{
+    PosixFile *file = (PosixFile*) state;
+    off_t offset = pageOffset(file, firstPage);
+    size_t remaining = (size_t) count * (size_t) file->pageSize;
+    while (remaining > 0) {
+        ssize_t done = pread(file->fd, memPages, remaining, offset);
+        if (done <= 0) {
+            return RC_READ_NON_EXISTING_PAGE;
+        }
+        memPages += done;
+        offset += done;
+        remaining -= (size_t) done;
+    }
+    return RC_OK;
+}
+
+static RC posixWritePages(void *state, int firstPage, int count, SM_PageHandle memPages)
+{
+    PosixFile *file = (PosixFile*) state;
+    off_t offset = pageOffset(file, firstPage);
+    size_t remaining = (size_t) count * (size_t) file->pageSize;
+    while (remaining > 0) {
+        ssize_t done = pwrite(file->fd, memPages, remaining, offset);
+        if (done <= 0) {
+            return RC_WRITE_FAILED;
+        }
+        memPages += done;
+        offset += done;
+        remaining -= (size_t) done;
+    }
+    return RC_OK;
+}
+
+static RC posixWriteRange(void *state, int pageNum, int offset, int length, const char *data)
+{
+    PosixFile *file = (PosixFile*) state;
+    if (pwrite(file->fd, data, (size_t) length, pageOffset(file, pageNum) + offset) != length) {
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+static RC posixExtend(void *state, int numPages, int *totalNumPages)
+{
+    PosixFile *file = (PosixFile*) state;
+    struct stat st;
+    // Other handles may have grown the file, so always append at its real end.
+    if (fstat(file->fd, &st) != 0) {
+        return RC_WRITE_FAILED;
+    }
+    int first = (int) ((st.st_size - file->dataOffset) / file->pageSize);
+    RC rc = writeZeroPages(file, first, numPages);
+    if (rc == RC_OK) {
+        *totalNumPages = first + numPages;
+    }
+    return rc;
+}
+
+static RC posixTruncate(void *state, int numPages, int *totalNumPages)
+{
+    PosixFile *file = (PosixFile*) state;
+    if (ftruncate(file->fd, pageOffset(file, numPages)) != 0) {
+        return RC_WRITE_FAILED;
+    }
+    *totalNumPages = numPages;
+    return RC_OK;
+}
+
+static RC posixSync(void *state)
+{
+    PosixFile *file = (PosixFile*) state;
+    return fdatasync(file->fd) == 0 ? RC_OK : RC_WRITE_FAILED;
+}
+
+static RC posixClose(void *state)
+{
+    PosixFile *file = (PosixFile*) state;
+    int closed = close(file->fd);
+    free(file);
+    return closed == 0 ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+/**
+ * @brief Returns the descriptor behind an open POSIX page file, for kernel side copies.
+ */
+int posixBackendFd(void *state)
+{
+    return ((PosixFile*) state)->fd;
+}
+
+/**
+ * @brief Returns the byte offset of page 0 in an open POSIX page file.
+ */
+long posixBackendDataOffset(void *state)
+{
+    return (long) ((PosixFile*) state)->dataOffset;
+}
+
+const SM_Backend posixBackend = {
+    "posix", "",
+    posixCreate, posixDestroy, posixOpen, posixRead, posixWrite, posixExtend, posixSync, posixClose,
+    posixWriteRange,
+    NULL, /* plain page files keep no checksums */
+    posixTruncate,
+    posixReadPages, posixWritePages
+};
+
+
+/************************************************************
+ *                    in-memory backend                     *
+ ************************************************************/
+
+/* a page file kept in a growable array of pages; destroyed files are freed on last close */
+typedef struct MemFile {
+    char *name;
+    char *pages;
+    int pageSize;
+    int numPages;
+    int capacity;
+    int openCount;
+    int destroyed;
+    pthread_mutex_t lock;
+    struct MemFile *next;
+} MemFile;
+
+static pthread_mutex_t memFilesLock = PTHREAD_MUTEX_INITIALIZER;
+static MemFile *memFiles = NULL;
+
+
+/**
+ * @brief Finds a live memory file by name. Must be called with memFilesLock held.
+ */
+static MemFile *findMemFile(char *fileName)
+{
+    for (MemFile *file = memFiles; file != NULL; file = file->next) {
+        if (!file->destroyed && strcmp(file->name, fileName) == 0) {
+            return file;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Unlinks and frees a memory file. Must be called with memFilesLock held.
+ */
+static void freeMemFile(MemFile *file)
+{
+    MemFile **link = &memFiles;
+    while (*link != file) {
+        link = &(*link)->next;
+    }
+    *link = file->next;
+    pthread_mutex_destroy(&file->lock);
+    free(file->pages);
+    free(file->name);
+    free(file);
+}
+
+/**
+ * @brief Grows a memory file by numPages zero pages. Must be called with the file's lock held.
+ */
+static RC growMemFile(MemFile *file, int numPages)
+{
+    int needed = file->numPages + numPages;
+    if (needed > file->capacity) {
+        // Doubling keeps repeated appendEmptyBlock calls amortized O(1).
+        int newCapacity = file->capacity > 0 ? file->capacity : 1;
+        while (newCapacity < needed) {
+            newCapacity *= 2;
+        }
+        char *grown = (char*) realloc(file->pages, (size_t) newCapacity * file->pageSize);
+        if (grown == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        file->pages = grown;
+        file->capacity = newCapacity;
+    }
+    memset(file->pages + (size_t) file->numPages * file->pageSize, 0, (size_t) numPages * file->pageSize);
+    file->numPages = needed;
+    return RC_OK;
+}
+
+static RC memCreate(char *fileName, int pageSize)
+{
+    pthread_mutex_lock(&memFilesLock);
+    if (findMemFile(fileName) != NULL) {
+        pthread_mutex_unlock(&memFilesLock);
+        RC_message = "File is already present there";
+        return RC_OK;
+    }
+    MemFile *file = (MemFile*) calloc(1, sizeof(MemFile));
+    if (file == NULL || (file->name = strdup(fileName)) == NULL) {
+        pthread_mutex_unlock(&memFilesLock);
+        free(file);
+        return RC_WRITE_FAILED;
+    }
+    file->pageSize = pageSize;
+    pthread_mutex_init(&file->lock, NULL);
+    if (growMemFile(file, 1) != RC_OK) {
+        pthread_mutex_destroy(&file->lock);
+        free(file->name);
+        free(file);
+        pthread_mutex_unlock(&memFilesLock);
+        return RC_WRITE_FAILED;
+    }
+    file->next = memFiles;
+    memFiles = file;
+    pthread_mutex_unlock(&memFilesLock);
+    return RC_OK;
+}
+
+static RC memDestroy(char *fileName)
+{
+    pthread_mutex_lock(&memFilesLock);
+    MemFile *file = findMemFile(fileName);
+    if (file == NULL) {
+        pthread_mutex_unlock(&memFilesLock);
+        return RC_FILE_NOT_FOUND;
+    }
+    // Like unlink: open handles keep working and the pages go away with the last close.
+    file->destroyed = 1;
+    if (file->openCount == 0) {
+        freeMemFile(file);
+    }
+    pthread_mutex_unlock(&memFilesLock);
+    return RC_OK;
+}
+
+static RC memOpen(char *fileName, void **state, int *totalNumPages, int *pageSize)
+{
+    pthread_mutex_lock(&memFilesLock);
+    MemFile *file = findMemFile(fileName);
+    if (file == NULL) {
+        pthread_mutex_unlock(&memFilesLock);
+        return RC_FILE_NOT_FOUND;
+    }
+    file->openCount++;
+    pthread_mutex_lock(&file->lock);
+    *totalNumPages = file->numPages;
+    pthread_mutex_unlock(&file->lock);
+    pthread_mutex_unlock(&memFilesLock);
+    *pageSize = file->pageSize;
+    *state = file;
+    return RC_OK;
+}
+
+static RC memRead(void *state, int pageNum, SM_PageHandle memPage)
+{
+    MemFile *file = (MemFile*) state;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&file->lock);
+    if (pageNum >= file->numPages) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    else {
+        pageCopy(memPage, file->pages + (size_t) pageNum * file->pageSize, file->pageSize);
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC memWrite(void *state, int pageNum, SM_PageHandle memPage)
+{
+    MemFile *file = (MemFile*) state;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&file->lock);
+    if (pageNum >= file->numPages) {
+        rc = RC_WRITE_FAILED;
+    }
+    else {
+        pageCopy(file->pages + (size_t) pageNum * file->pageSize, memPage, file->pageSize);
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC memWriteRange(void *state, int pageNum, int offset, int length, const char *data)
+{
+    MemFile *file = (MemFile*) state;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&file->lock);
+    if (pageNum >= file->numPages) {
+        rc = RC_WRITE_FAILED;
+    }
+    else {
+        memcpy(file->pages + (size_t) pageNum * file->pageSize + offset, data, (size_t) length);
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC memReadPages(void *state, int firstPage, int count, SM_PageHandle memPages)
+{
+    MemFile *file = (MemFile*) state;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&file->lock);
+    if (firstPage + count > file->numPages) {
+        rc = RC_READ_NON_EXISTING_PAGE;
+    }
+    else {
+        memcpy(memPages, file->pages + (size_t) firstPage * file->pageSize, (size_t) count * file->pageSize);
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC memWritePages(void *state, int firstPage, int count, SM_PageHandle memPages)
+{
+    MemFile *file = (MemFile*) state;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&file->lock);
+    if (firstPage + count > file->numPages) {
+        rc = RC_WRITE_FAILED;
+    }
+    else {
+        memcpy(file->pages + (size_t) firstPage * file->pageSize, memPages, (size_t) count * file->pageSize);
+    }
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC memExtend(void *state, int numPages, int *totalNumPages)
+{
+    MemFile *file = (MemFile*) state;
+    pthread_mutex_lock(&file->lock);
+    RC rc = growMemFile(file, numPages);
+    *totalNumPages = file->numPages;
+    pthread_mutex_unlock(&file->lock);
+    return rc;
+}
+
+static RC memTruncate(void *state, int numPages, int *totalNumPages)
+{
+    MemFile *file = (MemFile*) state;
+    pthread_mutex_lock(&file->lock);
+    // The array keeps its capacity; only the page count shrinks.
+    if (numPages < file->numPages) {
+        file->numPages = numPages;
+    }
+    *totalNumPages = file->numPages;
+    pthread_mutex_unlock(&file->lock);
+    return RC_OK;
+}
+
+static RC memSync(void *state)
+{
+    (void) state;
+    return RC_OK;
+}
+
+static RC memClose(void *state)
+{
+    MemFile *file = (MemFile*) state;
+    pthread_mutex_lock(&memFilesLock);
+    file->openCount--;
+    if (file->destroyed && file->openCount == 0) {
+        freeMemFile(file);
+    }
+    pthread_mutex_unlock(&memFilesLock);
+    return RC_OK;
+}
+
+const SM_Backend memoryBackend = {
+    "memory", MEMORY_BACKEND_PREFIX,
+    memCreate, memDestroy, memOpen, memRead, memWrite, memExtend, memSync, memClose,
+    memWriteRange,
+    NULL, /* memory pages keep no checksums */
+    memTruncate,
+    memReadPages, memWritePages
+};
+
+
+/************************************************************
+ *                    backend registry                      *
+ ************************************************************/
+
+static pthread_mutex_t backendsLock = PTHREAD_MUTEX_INITIALIZER;
+static const SM_Backend *backends[MAX_STORAGE_BACKENDS] = { &memoryBackend, &logStoreBackend };
+static int numBackends = 2;
+
+
+/**
+ * @brief Registers a backend for all page files whose name starts with its prefix.
+ *
+ * @param backend The backend; it has to stay valid for the lifetime of the process.
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if the backend has no prefix or the registry is full.
+ */
+RC registerStorageBackend(const SM_Backend *backend)
+{
+    if (backend == NULL || backend->prefix == NULL || backend->prefix[0] == '\0') {
+        printMessage("A storage backend needs a non-empty file name prefix.\n");
+        return RC_WRITE_FAILED;
+    }
+    pthread_mutex_lock(&backendsLock);
+    if (numBackends == MAX_STORAGE_BACKENDS) {
+        pthread_mutex_unlock(&backendsLock);
+        printMessage("No more storage backends can be registered.\n");
+        return RC_WRITE_FAILED;
+    }
+    backends[numBackends++] = backend;
+    pthread_mutex_unlock(&backendsLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Picks the backend for a page file: the registered backend with the longest matching
+ *        prefix, or the POSIX file backend if none matches.
+ *
+ * @param fileName The name of the page file.
+ * @return The backend to use.
+ */
+const SM_Backend *findStorageBackend(char *fileName)
+{
+    const SM_Backend *best = &posixBackend;
+    size_t bestLen = 0;
+    pthread_mutex_lock(&backendsLock);
+    for (int i = 0; i < numBackends; i++) {
+        size_t len = strlen(backends[i]->prefix);
+        if (len > bestLen && strncmp(fileName, backends[i]->prefix, len) == 0) {
+            best = backends[i];
+            bestLen = len;
+        }
+    }
+    pthread_mutex_unlock(&backendsLock);
+    return best;
+}
@@ -0,0 +1,126 @@
+#ifndef SM_BACKEND_H
+#define SM_BACKEND_H
+
+#include <stdint.h>
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "change_tracking.h"
+#include "scrubber.h"
+#include "shared_pool.h"
+#include "compaction.h"
+#include "checkpoint.h"
+#include "replication.h"
+#include "mem_governor.h"
+#include "cold_tier.h"
+#include "heat_profile.h"
+
+/************************************************************
+ *                    backend data structures               *
+ ************************************************************/
+/* page files whose name starts with this prefix live in memory */
+#define MEMORY_BACKEND_PREFIX "mem:"
+/* POSIX page files start with a header of this size recording their page size */
+#define PAGE_FILE_HEADER_SIZE 4096
+#define PAGE_FILE_MAGIC "SMPAGESZ"
+/* maximum number of backends that can be registered besides the POSIX one */
+#define MAX_STORAGE_BACKENDS 8
+/* hashes of recently written pages kept per handle, direct-mapped by page number */
+#define WRITE_HASH_SLOTS 256
+
+/* first bytes of the header; pageSizeCheck holds ~pageSize so random data is not taken for a header */
+typedef struct SM_PageFileHeader {
+	char magic[8];
+	int pageSize;
+	int pageSizeCheck;
+} SM_PageFileHeader;
+
+/* The operations a storage backend has to provide. Page numbers are always checked by
+ * the storage manager before they reach a backend, and page buffers hold the page size
+ * the file was created with. */
+typedef struct SM_Backend {
+	char *name;
+	char *prefix;
+	RC (*create) (char *fileName, int pageSize);
+	RC (*destroy) (char *fileName);
+	RC (*open) (char *fileName, void **state, int *totalNumPages, int *pageSize);
+	RC (*read) (void *state, int pageNum, SM_PageHandle memPage);
+	RC (*write) (void *state, int pageNum, SM_PageHandle memPage);
+	RC (*extend) (void *state, int numPages, int *totalNumPages);
+	RC (*sync) (void *state);
+	RC (*close) (void *state);
+	/* optional: writes length bytes at offset inside a page; NULL makes range writes rewrite the page */
+	RC (*writeRange) (void *state, int pageNum, int offset, int length, const char *data);
+	/* optional: reads a page and checks it against a checksum kept by the backend, RC_PAGE_CORRUPT on mismatch */
+	RC (*verify) (void *state, int pageNum, SM_PageHandle memPage);
+	/* optional: drops the pages from numPages on; NULL means the file cannot be compacted */
+	RC (*truncate) (void *state, int numPages, int *totalNumPages);
+	/* optional: read or write count consecutive pages with one call; NULL makes the storage
+	 * manager transfer them one page at a time */
+	RC (*readPages) (void *state, int firstPage, int count, SM_PageHandle memPages);
+	RC (*writePages) (void *state, int firstPage, int count, SM_PageHandle memPages);
+} SM_Backend;
+
+/* what SM_FileHandle.mgmtInfo points to for an open page file */
+typedef struct SM_OpenFile {
+	const SM_Backend *backend;
+	void *state;
+	/* content hashes of pages written through this handle, used to find rewrites worth checking */
+	int dedupWrites;
+	SM_WriteStats writeStats;
+	struct {
+		int pageNum;
+		uint64_t hash;
+	} writeHashes[WRITE_HASH_SLOTS];
+	/* changed pages of the file for incremental backups, shared with its other handles */
+	SM_ChangeMap *changes;
+	/* reads and writes through this handle; the scrubber backs off when it changes */
+	long ioCount;
+	SM_Scrubber *scrubber;
+	SM_ScrubStats scrubStats;
+	/* shared pool the handle reads and writes through, and the file's slot in it */
+	SM_SharedPool *pool;
+	int poolFile;
+	/* compaction started on this handle; reads go through it while pages are moved */
+	SM_Compaction *compaction;
+	/* background checkpointer of the handle, and the stats of the last one that stopped */
+	SM_Checkpointer *checkpointer;
+	SM_CheckpointStats checkpointStats;
+	/* stream the handle's changes are shipped to, and the stats of the last one that stopped */
+	SM_Shipper *shipper;
+	SM_ShippingStats shippingStats;
+	/* the memory budget the handle's buffers are charged to */
+	SM_MemConsumer *memory;
+	/* compressed copies of recent pages, and the stats of the last tier that was dropped */
+	SM_ColdTier *coldTier;
+	SM_ColdTierStats coldTierStats;
+	/* access counters of the file, and the profile of the last profiler that stopped */
+	SM_HeatProfiler *profiler;
+	SM_HeatProfile heatProfile;
+	/* handles sharing the open file (see sharePageFile), and its page count as of the last
+	 * operation through any of them */
+	int handles;
+	int numPages;
+	/* calls using the profiler or cold tier, counted per epoch; see quiesceOpenFile */
+	int ioEpoch;
+	int ioInFlight[2];
+} SM_OpenFile;
+
+extern const SM_Backend posixBackend;
+extern const SM_Backend memoryBackend;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC registerStorageBackend (const SM_Backend *backend);
+extern const SM_Backend *findStorageBackend (char *fileName);
+extern int posixBackendFd (void *state);
+extern long posixBackendDataOffset (void *state);
+
+/* used by compaction and backups to drop the pages of an open file from numPages on */
+extern RC truncateOpenFile (SM_FileHandle *fHandle, int numPages);
+/* used around calls that may use the profiler or cold tier of a file shared with other handles */
+extern int beginOpenFileIo (SM_OpenFile *openFile);
+extern void endOpenFileIo (SM_OpenFile *openFile, int epoch);
+extern void quiesceOpenFile (SM_OpenFile *openFile);
+
+#endif
@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "sm_trace.h"
+#include "io_replay.h"
+
+/* The owner writes event head into its slot before publishing head + 1, so the slot after the
+ * newest event may be half written; one spare slot keeps TRACE_RING_EVENTS whole events. */
+#define TRACE_RING_SLOTS (TRACE_RING_EVENTS + 1)
+
+/* one ring per thread; only its owner writes events, readers follow the published head */
+typedef struct TraceRing {
+    SM_TraceEvent events[TRACE_RING_SLOTS];
+    unsigned long head;
+    unsigned long base;
+    int threadId;
+    struct TraceRing *next;
+} TraceRing;
+
+int traceEnabled = 0;
+
+static const char *traceOpNames[] = {
+    "openPageFile", "readBlock", "writeBlock", "appendEmptyBlock", "ensureCapacity", "closePageFile"
+};
+
+/* rings outlive their threads so events of finished threads can still be dumped */
+static pthread_mutex_t ringListLock = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing *ringList = NULL;
+static __thread TraceRing *threadRing = NULL;
+
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds.
+ */
+long long traceClockNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+/**
+ * @brief Returns the calling thread's ring, creating and registering it on first use.
+ *
+ * @return The ring, or NULL if it could not be allocated.
+ */
+static TraceRing *getThreadRing(void)
+{
+    if (threadRing != NULL) {
+        return threadRing;
+    }
+    TraceRing *ring = (TraceRing*) calloc(1, sizeof(TraceRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->threadId = (int) syscall(SYS_gettid);
+    pthread_mutex_lock(&ringListLock);
+    ring->next = ringList;
+    ringList = ring;
+    pthread_mutex_unlock(&ringListLock);
+    threadRing = ring;
+    return ring;
+}
+
+
+/**
+ * @brief Switches tracing on for all threads.
+ *
+ * @return RC_OK.
+ */
+RC startTracing(void)
+{
+    __atomic_store_n(&traceEnabled, 1, __ATOMIC_RELEASE);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Switches tracing off. Events recorded so far stay available for dumping.
+ *
+ * @return RC_OK.
+ */
+RC stopTracing(void)
+{
+    __atomic_store_n(&traceEnabled, 0, __ATOMIC_RELEASE);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Forgets all events recorded so far without touching the rings writers are using.
+ *
+ * @return RC_OK.
+ */
+RC clearTrace(void)
+{
+    pthread_mutex_lock(&ringListLock);
+    for (TraceRing *ring = ringList; ring != NULL; ring = ring->next) {
+        __atomic_store_n(&ring->base, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&ringListLock);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Marks the start of a traced operation.
+ *
+ * @return The start timestamp, or 0 if neither tracing nor an I/O capture is on.
+ */
+long long traceBegin(void)
+{
+    if (!__atomic_load_n(&traceEnabled, __ATOMIC_RELAXED) && !__atomic_load_n(&captureEnabled, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return traceClockNs();
+}
+
+
+/**
+ * @brief Adds one event to the calling thread's ring and to the running I/O capture.
+ */
+static void recordEvent(SM_TraceOp op, long long startNs, long long endNs, char *fileName, int pageNum, RC rc)
+{
+    if (__atomic_load_n(&captureEnabled, __ATOMIC_RELAXED)) {
+        captureOperation(op, startNs, fileName, pageNum, rc);
+    }
+    if (!__atomic_load_n(&traceEnabled, __ATOMIC_RELAXED)) {
+        return;
+    }
+    TraceRing *ring = getThreadRing();
+    if (ring == NULL) {
+        return;
+    }
+    unsigned long head = ring->head;
+    SM_TraceEvent *event = &ring->events[head % TRACE_RING_SLOTS];
+    event->op = op;
+    event->pageNum = pageNum;
+    event->rc = rc;
+    event->threadId = ring->threadId;
+    event->startNs = startNs;
+    event->endNs = endNs;
+    // Publishing the new head makes the event visible to readers.
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief Records a finished operation in the calling thread's ring and in the running I/O capture.
+ *
+ * @param op The operation that finished.
+ * @param startNs The value traceBegin returned; 0 means tracing was off and nothing is recorded.
+ * @param fileName The file the operation worked on, or NULL if the handle had none; only an I/O
+ *                 capture keeps it.
+ * @param pageNum The page the operation worked on, or -1 if it has none.
+ * @param rc The return code of the operation.
+ */
+void traceEnd(SM_TraceOp op, long long startNs, char *fileName, int pageNum, RC rc)
+{
+    if (startNs == 0) {
+        return;
+    }
+    recordEvent(op, startNs, traceClockNs(), fileName, pageNum, rc);
+}
+
+
+/**
+ * @brief Records a finished multi-page transfer as one event per page, so every page is counted
+ *        like a single-page operation. The pages split the time of the transfer evenly. A failed
+ *        transfer is recorded as one event on its first page.
+ *
+ * @param op TRACE_READ_BLOCK or TRACE_WRITE_BLOCK.
+ * @param startNs The value traceBegin returned; 0 means tracing was off and nothing is recorded.
+ * @param fileName The file of the transfer, as for traceEnd.
+ * @param firstPage The first page of the transfer.
+ * @param numPages The number of pages transferred.
+ * @param rc The return code of the transfer.
+ */
+void traceEndPages(SM_TraceOp op, long long startNs, char *fileName, int firstPage, int numPages, RC rc)
+{
+    if (startNs == 0) {
+        return;
+    }
+    long long endNs = traceClockNs();
+    int count = rc == RC_OK ? numPages : 1;
+    for (int i = 0; i < count; i++) {
+        recordEvent(op, startNs + (endNs - startNs) * i / count, startNs + (endNs - startNs) * (i + 1) / count,
+                    fileName, firstPage + i, rc);
+    }
+}
+
+
+/**
+ * @brief Copies the recorded events of all threads into the given array.
+ *        Events overwritten while they were being copied are skipped.
+ *
+ * @param events The array the events are copied to, or NULL to only count them.
+ * @param maxEvents The size of the events array.
+ * @return The number of events copied, or available if events is NULL.
+ */
+int getTraceEvents(SM_TraceEvent *events, int maxEvents)
+{
+    int count = 0;
+    pthread_mutex_lock(&ringListLock);
+    for (TraceRing *ring = ringList; ring != NULL; ring = ring->next) {
+        unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long first = __atomic_load_n(&ring->base, __ATOMIC_ACQUIRE);
+        // Events from head - TRACE_RING_SLOTS on share a slot with event head, which the owner
+        // may be writing.
+        if (head - first >= TRACE_RING_SLOTS) {
+            first = head - TRACE_RING_EVENTS;
+        }
+        if (events == NULL) {
+            count += (int) (head - first);
+            continue;
+        }
+        int ringStart = count;
+        for (unsigned long i = first; i < head && count < maxEvents; i++) {
+            events[count++] = ring->events[i % TRACE_RING_SLOTS];
+        }
+        // The owner may have lapped us while copying; drop whatever it overwrote.
+        unsigned long headAfter = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (headAfter - first >= TRACE_RING_SLOTS) {
+            int overwritten = (int) (headAfter - first - TRACE_RING_SLOTS + 1);
+            if (overwritten > count - ringStart) {
+                overwritten = count - ringStart;
+            }
+            for (int j = ringStart; j + overwritten < count; j++) {
+                events[j] = events[j + overwritten];
+            }
+            count -= overwritten;
+        }
+    }
+    pthread_mutex_unlock(&ringListLock);
+    return count;
+}
+
+
+/**
+ * @brief Writes all recorded events as a Chrome trace JSON file that can be loaded into
+ *        chrome://tracing or Perfetto.
+ *
+ * @param fileName The name of the JSON file that will be written.
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if the file could not be written.
+ */
+RC dumpTraceJson(char *fileName)
+{
+    int available = getTraceEvents(NULL, 0);
+    SM_TraceEvent *events = (SM_TraceEvent*) malloc(sizeof(SM_TraceEvent) * (available > 0 ? available : 1));
+    if (events == NULL) {
+        printMessage("Memory allocation error!\n");
+        return RC_WRITE_FAILED;
+    }
+    int count = getTraceEvents(events, available);
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        printMessage("The file %s could not be opened!\n", fileName);
+        free(events);
+        return RC_WRITE_FAILED;
+    }
+    int pid = (int) getpid();
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (int i = 0; i < count; i++) {
+        SM_TraceEvent *event = &events[i];
+        fprintf(file, "{\"name\":\"%s\",\"cat\":\"storage_mgr\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                "\"pid\":%d,\"tid\":%d,\"args\":{\"page\":%d,\"rc\":%d}}%s\n",
+                traceOpNames[event->op], event->startNs / 1000.0, (event->endNs - event->startNs) / 1000.0,
+                pid, event->threadId, event->pageNum, event->rc, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ns\"}\n");
+    free(events);
+    if (fclose(file) != 0) {
+        printMessage("The file %s could not be closed!\n", fileName);
+        return RC_WRITE_FAILED;
+    }
+    printMessage("Trace with %d events has been written to %s!\n", count, fileName);
+    return RC_OK;
+}
@@ -0,0 +1,56 @@
+#ifndef SM_TRACE_H
+#define SM_TRACE_H
+
+#include "dberror.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    trace data structures                 *
+ ************************************************************/
+/* events kept per thread; older events are overwritten */
+#define TRACE_RING_EVENTS 8192
+
+typedef enum SM_TraceOp {
+	TRACE_OPEN = 0,
+	TRACE_READ_BLOCK = 1,
+	TRACE_WRITE_BLOCK = 2,
+	TRACE_APPEND = 3,
+	TRACE_ENSURE_CAPACITY = 4,
+	TRACE_CLOSE = 5
+} SM_TraceOp;
+
+typedef struct SM_TraceEvent {
+	SM_TraceOp op;
+	int pageNum;
+	RC rc;
+	int threadId;
+	long long startNs;
+	long long endNs;
+} SM_TraceEvent;
+
+/* non-zero while tracing is switched on; checked on every traced call */
+extern int traceEnabled;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+extern RC startTracing (void);
+extern RC stopTracing (void);
+extern RC clearTrace (void);
+extern int getTraceEvents (SM_TraceEvent *events, int maxEvents);
+extern RC dumpTraceJson (char *fileName);
+
+/* used by the storage manager around every traced operation */
+extern long long traceClockNs (void);
+extern long long traceBegin (void);
+extern void traceEnd (SM_TraceOp op, long long startNs, char *fileName, int pageNum, RC rc);
+extern void traceEndPages (SM_TraceOp op, long long startNs, char *fileName, int firstPage, int numPages, RC rc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,16 +1,57 @@
+#define _GNU_SOURCE
 #include <unistd.h>
 #include "storage_mgr.h"
 #include <stdio.h>
 #include "dberror.h"
+#include "page_arena.h"
+#include "sm_trace.h"
+#include "sm_backend.h"
+#include "page_kernels.h"
+#include "change_tracking.h"
+#include "scrubber.h"
+#include "shared_pool.h"
+#include "extent_map.h"
+#include "compaction.h"
+#include "checkpoint.h"
+#include "file_catalog.h"
+#include "replication.h"
+#include "mem_governor.h"
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
 
 /**
- * @brief This function initialize the storage manager to make it ready to be used.
+ * @brief This function initialize the storage manager to make it ready to be used. The memory
+ *        budget starts unlimited; a budget set earlier is kept, since the record and index
+ *        managers initialize the storage manager again.
  */
 void initStorageManager(void)
 {
-    FILE *file = NULL;
-    printf("Setup of the storage manager has been configured in a successful way and the manager is now up and running.\n");
+    printMessage("Setup of the storage manager has been configured in a successful way and the manager is now up and running.\n");
+}
+
+
+/**
+ * @brief Initializes the storage manager with a memory budget that page buffers and caches of
+ *        all open files draw from.
+ * @param memoryBudget Bytes the process may hold in buffers and caches, or MEMGOV_UNLIMITED.
+ * @return RC_OK if successful.
+ *         RC_WRITE_FAILED if the budget is negative.
+ */
+RC initStorageManagerWithBudget(long long memoryBudget)
+{
+    RC rc = setMemoryBudget(memoryBudget);
+    if (rc == RC_OK) {
+        printMessage("Setup of the storage manager has been configured in a successful way and the manager is now up and running.\n");
+    }
+    return rc;
 }
 
 
@@ -22,130 +63,406 @@ void initStorageManager(void)
  */
 RC createPageFile(char *fileName)
 {
-    // Opening the file using fopen function in r+ mode.
-    FILE *file= fopen(fileName, "r+");
-    // If the file exists then the task is already done so return RC_OK message.
-    if (file != NULL)
-    {
-        RC_message = "File is already present there";
-        return RC_OK;
+    return createPageFileWithPageSize(fileName, PAGE_SIZE);
+}
+
+
+/**
+ * @brief Creates a new page file whose pages are pageSize bytes, with a single page initialized to
+ *        zero bytes. The page size is recorded in the file and carried in the handle on every open.
+ * @param fileName Created file should have this name.
+ * @param pageSize One of the supported page sizes (2048, 4096, 8192 or 16384 bytes).
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if creation fails.
+ *         RC_WRITE_FAILED if the page size is not supported.
+ */
+RC createPageFileWithPageSize(char *fileName, int pageSize)
+{
+    if (fileName == NULL) {
+        printMessage("File can't be created because the file name is null.\n");
+        return RC_FILE_NOT_FOUND;
     }
-    // Else we have to create the file
-    else {
-        printf("The file %s does not exist!\n",fileName);
-        // Again opening the file in w mode.
-        FILE *file = fopen(fileName,"w");
-        // file pointer will be NULL if file could not be opened.
-        if(file == NULL) {
-            printf("The file %s could not be opened!\n",fileName);
-        }
-        // Memory block is formed using calloc to initilaize a buffer.
-        SM_PageHandle *buffer=(SM_PageHandle *)calloc(sizeof(char),PAGE_SIZE);
-        // When there is error in initializing buffer then the buffer pointer will be NULL.
-        if(buffer==NULL) {
-            printf("Memory allocation error!\n");
-            return RC_WRITE_FAILED;
+    if (!IS_SUPPORTED_PAGE_SIZE(pageSize)) {
+        printMessage("The page size %d is not supported!\n",pageSize);
+        return RC_WRITE_FAILED;
+    }
+    // The backend is chosen from the file name, e.g. names starting with "mem:" live in memory.
+    const SM_Backend *backend = findStorageBackend(fileName);
+    RC_message = NULL;
+    // The backend creates the file with one zero page, or leaves an existing file alone.
+    RC rc = backend->create(fileName, pageSize);
+    if (rc != RC_OK) {
+        printMessage("The file %s could not be created!\n",fileName);
+        return rc;
+    }
+    if (RC_message == NULL) {
+        printMessage("Write operation completed\n");
+    }
+    return RC_OK;
+}
+
+
+/************************************************************
+ *                    write deduplication                   *
+ ************************************************************/
+/* A handle with deduplication on remembers the content hash of the pages last written or
+ * read through it in a small direct-mapped table. A write whose page hashes to the remembered
+ * value may already be on disk: the stored page is read back and the write is only skipped if
+ * it is identical, so writes through other handles or processes and hash collisions never
+ * cause a write to be lost. Deduplication is off by default; setWriteDedup() turns it on. */
+
+static void forgetWrittenPages(SM_OpenFile *openFile, int first, int count)
+{
+    if (count >= WRITE_HASH_SLOTS) {
+        for (int i = 0; i < WRITE_HASH_SLOTS; i++) {
+            openFile->writeHashes[i].pageNum = -1;
         }
-        // Using fwrite we will add elements of buffer to the file.
-        size_t written= fwrite(buffer,sizeof(char),PAGE_SIZE,file);
-        // fwrite() function will return the total number of elements successfully written.
-        // if this number is less than PAGE_SIZE then write failed.
-        if(written!=PAGE_SIZE) {
-            printf("Write error!\n");
-            return RC_WRITE_FAILED;
+        return;
+    }
+    for (int pageNum = first; pageNum < first + count; pageNum++) {
+        if (openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].pageNum == pageNum) {
+            openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].pageNum = -1;
         }
-        // If nothing has been returned till now means we have successfully completed  the task of creating a page file.
-        printf("Write operation completed\n");
-        // Memory block will be cleared using fclose and free the buffer using free function.
-        fclose(file);
-        free(buffer);
-        return RC_OK;
+    }
+}
+
+static int isPageUnchanged(SM_OpenFile *openFile, int pageNum, int pageSize, uint64_t hash, SM_PageHandle memPage)
+{
+    if (!openFile->dedupWrites
+        || openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].pageNum != pageNum
+        || openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].hash != hash) {
+        return 0;
+    }
+    // The hash only says what this handle saw last; the page in the file has the final word.
+    SM_PageHandle stored = (SM_PageHandle) malloc((size_t) pageSize);
+    if (stored == NULL) {
+        return 0;
+    }
+    RC rc = openFile->pool != NULL
+        ? sharedPoolRead(openFile->pool, openFile, pageNum, stored)
+        : openFile->backend->read(openFile->state, pageNum, stored);
+    int unchanged = rc == RC_OK && memcmp(stored, memPage, (size_t) pageSize) == 0;
+    free(stored);
+    return unchanged;
+}
+
+static void rememberPage(SM_OpenFile *openFile, int pageNum, uint64_t hash)
+{
+    openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].pageNum = pageNum;
+    openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].hash = hash;
+}
+
+/**
+ * @brief Returns non-zero, with a message, if pages of the file are being moved by a compaction;
+ *        the file cannot be written or grown until it is done.
+ */
+static int isBeingCompacted(SM_FileHandle *fHandle)
+{
+    if (compactionInProgress(((SM_OpenFile*) fHandle->mgmtInfo)->compaction)) {
+        printMessage("The file %s is being compacted and cannot be written!\n",fHandle->fileName);
+        return 1;
+    }
+    return 0;
+}
+
+
+/* takes the page count another handle of a shared file left */
+static void refreshPageCount(SM_FileHandle *fHandle)
+{
+    SM_OpenFile *openFile = fHandle != NULL ? (SM_OpenFile*) fHandle->mgmtInfo : NULL;
+    if (openFile != NULL && __atomic_load_n(&openFile->handles, __ATOMIC_RELAXED) > 1) {
+        fHandle->totalNumPages = __atomic_load_n(&openFile->numPages, __ATOMIC_RELAXED);
+    }
+}
+
+/* leaves the page count of a handle for the other handles of its file */
+static void publishPageCount(SM_FileHandle *fHandle)
+{
+    SM_OpenFile *openFile = fHandle != NULL ? (SM_OpenFile*) fHandle->mgmtInfo : NULL;
+    if (openFile != NULL) {
+        __atomic_store_n(&openFile->numPages, fHandle->totalNumPages, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ * @brief Gives back memory held by the buffers of an open file when the memory budget is short.
+ */
+static long long shrinkOpenFile(void *context, long long bytes)
+{
+    SM_OpenFile *openFile = (SM_OpenFile*) context;
+    long long freed = shipShrink(__atomic_load_n(&openFile->shipper, __ATOMIC_ACQUIRE), bytes);
+    if (freed < bytes) {
+        freed += coldTierShrink(__atomic_load_n(&openFile->coldTier, __ATOMIC_ACQUIRE), bytes - freed);
+    }
+    return freed;
+}
+
+
+/* the cold tier pages are served from, or NULL; pooled files and files being compacted bypass it */
+static SM_ColdTier *coldTierOf(SM_OpenFile *openFile)
+{
+    return openFile->pool == NULL && !compactionInProgress(openFile->compaction)
+        ? __atomic_load_n(&openFile->coldTier, __ATOMIC_ACQUIRE) : NULL;
+}
+
+
+/* serializes quiesceOpenFile, so one waiter at a time flips an epoch */
+static pthread_mutex_t quiesceLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Counts a call on an open file that may use its profiler or cold tier, so
+ *        quiesceOpenFile waits for it. The pointers have to be loaded after this call.
+ *
+ * @return The epoch the call was counted in, to be passed to endOpenFileIo.
+ */
+int beginOpenFileIo(SM_OpenFile *openFile)
+{
+    int epoch = __atomic_load_n(&openFile->ioEpoch, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&openFile->ioInFlight[epoch], 1, __ATOMIC_SEQ_CST);
+    return epoch;
+}
+
+
+void endOpenFileIo(SM_OpenFile *openFile, int epoch)
+{
+    __atomic_sub_fetch(&openFile->ioInFlight[epoch], 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief Waits until calls that may still use a profiler or cold tier just unhooked from an
+ *        open file are done, so it can be freed. Calls are counted in two epochs: the epoch is
+ *        flipped and only the calls of the old one are waited for, so handles that keep doing
+ *        I/O cannot hold the waiter up. Calls starting after the flip see the cleared pointer.
+ */
+void quiesceOpenFile(SM_OpenFile *openFile)
+{
+    pthread_mutex_lock(&quiesceLock);
+    int epoch = __atomic_load_n(&openFile->ioEpoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&openFile->ioEpoch, 1 - epoch, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&openFile->ioInFlight[epoch], __ATOMIC_SEQ_CST) > 0) {
+        sched_yield();
+    }
+    pthread_mutex_unlock(&quiesceLock);
+}
 
 
+/**
+ * @brief Drops the pages of an open file from numPages on and brings everything that caches or
+ *        tracks its pages in line: pooled frames, the cold tier, remembered hashes, the change
+ *        map and a shipping stream. The caller makes sure no compaction is moving pages.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param numPages The new page count; at least one page is kept.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the backend cannot truncate files or the file could not be cut.
+ */
+RC truncateOpenFile(SM_FileHandle *fHandle, int numPages)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    int oldNumPages = fHandle->totalNumPages;
+    if (numPages < 1) {
+        numPages = 1;
+    }
+    if (numPages >= oldNumPages) {
+        return RC_OK;
+    }
+    if (openFile->backend->truncate == NULL) {
+        printMessage("The %s backend cannot truncate %s!\n", openFile->backend->name, fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    if (openFile->pool != NULL) {
+        // Pages may still be dirty in the pool; the tail must not be written back later.
+        if (sharedPoolFlushFile(openFile->pool, openFile->poolFile) != RC_OK) {
+            return RC_WRITE_FAILED;
+        }
+        sharedPoolInvalidate(openFile->pool, openFile->poolFile, numPages, oldNumPages - numPages);
+    }
+    if (openFile->backend->truncate(openFile->state, numPages, &fHandle->totalNumPages) != RC_OK) {
+        printMessage("The file %s could not be truncated!\n", fHandle->fileName);
+        return RC_WRITE_FAILED;
     }
+    int epoch = beginOpenFileIo(openFile);
+    coldTierInvalidate(__atomic_load_n(&openFile->coldTier, __ATOMIC_ACQUIRE), numPages, oldNumPages - numPages);
+    endOpenFileIo(openFile, epoch);
+    forgetWrittenPages(openFile, numPages, oldNumPages - numPages);
+    noteTruncatedPages(openFile->changes, fHandle->totalNumPages);
+    shipResize(openFile->shipper, fHandle->totalNumPages);
+    if (fHandle->curPagePos >= fHandle->totalNumPages) {
+        fHandle->curPagePos = fHandle->totalNumPages - 1;
+    }
+    publishPageCount(fHandle);
+    return RC_OK;
 }
 
 
 /**
- * @brief Opens an existing page file and initializes the file handle.
+ * @brief Opens an existing page file and initializes the file handle. A file a catalog holds
+ *        open is not opened again; the handle shares it (see sharePageFile).
  *
  * @param fileName This the name of the file that wil be opened.
  * @param fHandle It is the pointer of the file on which the operation will be performed.
  * @return RC_OK if successful.
  *         RC_FILE_NOT_FOUND if file doesn't exist.
+ *         RC_PAGE_CORRUPT if a log-structured file's checkpoint points at a reused slot.
  */
-RC openPageFile(char *fileName, SM_FileHandle *fHandle)
+static RC openPageFileUntraced(char *fileName, SM_FileHandle *fHandle)
 {
-    FILE *file = fopen(fileName, "r+");
-
-    if (file == NULL){
-        printf("The file %s could not be opened!\n",fileName);
-        return RC_FILE_NOT_FOUND;
+    if (fileName == NULL || fHandle == NULL) {
+        printMessage("File can't be opened because the file name or file handle is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
     }
-    // Initializing the fileName of fhandle
-    else{
-        fHandle->fileName = fileName;
-    }
-    // Getting the current position of the file pointer using ftell.
-    long current_pos=ftell(file);
-    // ftell will return -1 if the file could not be opened.
-    if(current_pos==-1) {
-        printf("The file %s 's current position can't be determined\n",fileName);
-        return RC_FILE_NOT_FOUND;
+    if (catalogShareFile(fileName, fHandle)) {
+        printMessage("The file %s has been opened!\n",fileName);
+        return RC_OK;
     }
-    // Storing the current position of the file pointer.
-    else {
-        printf("The file %s has been opened!\n",fileName);
-        printf("File's current position is %ld\n",current_pos);
-        fHandle->curPagePos = current_pos;
-    }
-    // using fseek function to reach the end of the file.
-    fseek(file,0,SEEK_END);
-    long end_pos=ftell(file);
-    // Strong the file pointer in mgmtInfo
-    fHandle->mgmtInfo = file;
-    if(end_pos==-1) {
-        printf("The file %s 's end position can't be determined\n",fileName);
+    SM_OpenFile *openFile = (SM_OpenFile*) malloc(sizeof(SM_OpenFile));
+    if (openFile == NULL) {
+        printMessage("Memory allocation error!\n");
         return RC_FILE_NOT_FOUND;
     }
-    else {
-        printf("The file %s has been opened!\n",fileName);
-        printf("File's end position is %ld\n",end_pos);
-        fHandle->totalNumPages = end_pos/PAGE_SIZE;
+    // The backend is selected here and stays with the handle until it is closed.
+    openFile->backend = findStorageBackend(fileName);
+    int totalNumPages = 0, pageSize = PAGE_SIZE;
+    RC rc = openFile->backend->open(fileName, &openFile->state, &totalNumPages, &pageSize);
+    if (rc != RC_OK){
+        printMessage("The file %s could not be opened!\n",fileName);
+        free(openFile);
+        return rc == RC_PAGE_CORRUPT ? rc : RC_FILE_NOT_FOUND;
     }
+    openFile->dedupWrites = 0;
+    memset(&openFile->writeStats, 0, sizeof(openFile->writeStats));
+    forgetWrittenPages(openFile, 0, WRITE_HASH_SLOTS);
+    openFile->ioCount = 0;
+    openFile->scrubber = NULL;
+    memset(&openFile->scrubStats, 0, sizeof(openFile->scrubStats));
+    openFile->pool = NULL;
+    openFile->poolFile = -1;
+    openFile->compaction = NULL;
+    openFile->checkpointer = NULL;
+    memset(&openFile->checkpointStats, 0, sizeof(openFile->checkpointStats));
+    openFile->shipper = NULL;
+    memset(&openFile->shippingStats, 0, sizeof(openFile->shippingStats));
+    openFile->memory = NULL;
+    openFile->coldTier = NULL;
+    memset(&openFile->coldTierStats, 0, sizeof(openFile->coldTierStats));
+    openFile->profiler = NULL;
+    memset(&openFile->heatProfile, 0, sizeof(openFile->heatProfile));
+    openFile->handles = 1;
+    openFile->numPages = totalNumPages;
+    openFile->ioEpoch = 0;
+    openFile->ioInFlight[0] = 0;
+    openFile->ioInFlight[1] = 0;
+    registerMemConsumer(fileName, MEMGOV_DEFAULT_WEIGHT, shrinkOpenFile, openFile, &openFile->memory);
+    // Only maps of files on disk can be kept next to the file.
+    openFile->changes = attachChangeMap(fileName, openFile->backend == &posixBackend);
+    // Initializing the fileName of fhandle
+    fHandle->fileName = fileName;
+    fHandle->curPagePos = 0;
+    fHandle->totalNumPages = totalNumPages;
+    fHandle->pageSize = pageSize;
+    // Storing the open file in mgmtInfo
+    fHandle->mgmtInfo = openFile;
+    printMessage("The file %s has been opened!\n",fileName);
     return RC_OK;
-
-
 }
 
 
 /**
- * @brief Closes an open page file and releases associated resources.
+ * @brief Closes an open page file and releases associated resources. A file shared by several
+ *        handles is closed with its last handle; closing another one only stops the scrubber,
+ *        checkpointer or compaction started through that handle.
  *
  * @param fHandle It is the pointer of the file on which the operation will be performed.
  * @return RC_OK if successful.
  *         RC_FILE_NOT_FOUND if file handle is invalid.
  */
-RC closePageFile(SM_FileHandle *fHandle)
+static RC closePageFileUntraced(SM_FileHandle *fHandle)
 {
-    FILE *file=fHandle->mgmtInfo;
-    if(file==NULL) {
-        printf("The file %s could not be opened!\n",fHandle->fileName);
+    SM_OpenFile *openFile = fHandle == NULL ? NULL : (SM_OpenFile*) fHandle->mgmtInfo;
+    if(openFile==NULL) {
+        printMessage("The file could not be closed because it is not open!\n");
         return RC_FILE_NOT_FOUND;
     }
-    // Closing the page using fclose function.
-    int checkClose=fclose(file);
-    // fclose will return 0 if the file has been closed successfully of else it's not closed.
-    if (checkClose==0) {
-        printf("The file %s has been closed!\n",fHandle->fileName);
+    // A shared file stays open until its last handle is closed, but work started through a
+    // handle keeps a pointer to it and can't outlive it. Work started through the other
+    // handles goes on.
+    if (__atomic_sub_fetch(&openFile->handles, 1, __ATOMIC_ACQ_REL) > 0) {
+        if (scrubberUsesHandle(fHandle)) {
+            stopScrubber(fHandle);
+        }
+        if (checkpointerUsesHandle(fHandle)) {
+            stopCheckpointer(fHandle);
+        }
+        if (compactionUsesHandle(fHandle)) {
+            cancelCompaction(fHandle);
+        }
+        fHandle->mgmtInfo = NULL;
+        printMessage("The file %s has been closed!\n",fHandle->fileName);
+        return RC_OK;
+    }
+    // Closing the page using the backend of the open file.
+    stopScrubber(fHandle);
+    stopCheckpointer(fHandle);
+    cancelCompaction(fHandle);
+    stopLogShipping(fHandle);
+    disableColdTier(fHandle);
+    stopHeatProfile(fHandle);
+    // Pages written through a shared pool reach the file before it is closed.
+    RC checkClose = openFile->pool != NULL ? sharedPoolFlushFile(openFile->pool, openFile->poolFile) : RC_OK;
+    if (openFile->pool != NULL) {
+        sharedPoolDetach(openFile->pool, openFile->poolFile);
+    }
+    if (openFile->backend->close(openFile->state) != RC_OK) {
+        checkClose = RC_FILE_NOT_FOUND;
+    }
+    detachChangeMap(openFile->changes);
+    unregisterMemConsumer(openFile->memory);
+    free(openFile);
+    fHandle->mgmtInfo = NULL;
+    if (checkClose==RC_OK) {
+        printMessage("The file %s has been closed!\n",fHandle->fileName);
         return RC_OK;
 
     }
     else {
-        printf("The file %s could not be closed!\n",fHandle->fileName);
+        printMessage("The file %s could not be closed!\n",fHandle->fileName);
         return RC_FILE_NOT_FOUND;
     }
+}
 
+
+/**
+ * @brief Opens another handle on an open page file. The handles share the descriptor, the
+ *        page count and everything attached to the file, and keep their own current page.
+ *        The file is closed with the last handle. Like a single handle, the handles of one
+ *        file must not be used by several threads at the same time.
+ *
+ * @param openHandle An open handle of the file.
+ * @param fHandle The handle that is opened.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if openHandle is not open or fHandle is NULL.
+ */
+RC sharePageFile(SM_FileHandle *openHandle, SM_FileHandle *fHandle)
+{
+    if (openHandle == NULL || openHandle->mgmtInfo == NULL || fHandle == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) openHandle->mgmtInfo;
+    __atomic_add_fetch(&openFile->handles, 1, __ATOMIC_ACQ_REL);
+    fHandle->fileName = openHandle->fileName;
+    fHandle->curPagePos = 0;
+    fHandle->totalNumPages = __atomic_load_n(&openFile->numPages, __ATOMIC_RELAXED);
+    fHandle->pageSize = openHandle->pageSize;
+    fHandle->mgmtInfo = openFile;
+    return RC_OK;
 }
 
 
@@ -158,16 +475,28 @@ RC closePageFile(SM_FileHandle *fHandle)
  */
 RC destroyPageFile(char *fileName)
 {
-
-    // Page file is being deleted using remove function.
-    int removeCheck=remove(fileName);
-    // If the file is deleted then remove function will return 0.
-    if(removeCheck==0) {
-        printf("The file %s has been removed!\n",fileName);
+    if (fileName == NULL) {
+        printMessage("File can't be removed because the file name is null.\n");
+        return RC_FILE_NOT_FOUND;
+    }
+    // Page file is being deleted by the backend that owns the file name. Its frames in shared
+    // pools go first, or they could be written into a new file created under the same name.
+    const SM_Backend *backend = findStorageBackend(fileName);
+    if (backend == &posixBackend) {
+        sharedPoolForgetFile(fileName);
+    }
+    catalogForgetFile(fileName);
+    RC removeCheck=backend->destroy(fileName);
+    if (removeCheck == RC_OK && backend == &posixBackend) {
+        destroyChangeMap(fileName);
+        destroyExtentMap(fileName);
+    }
+    if(removeCheck==RC_OK) {
+        printMessage("The file %s has been removed!\n",fileName);
         return RC_OK;
     }
     else {
-        printf("The file %s could not be removed!\n",fileName);
+        printMessage("The file %s could not be removed!\n",fileName);
         return RC_FILE_NOT_FOUND;
     }
 }
@@ -183,38 +512,47 @@ RC destroyPageFile(char *fileName)
  *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
  *         RC_READ_NON_EXISTING_PAGE if page doesn't exist.
  */
-RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+static RC readBlockUntraced(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
-    if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
-        return RC_FILE_HANDLE_NOT_INIT;
-    }
-    FILE *file = fopen(fHandle->fileName, "r+");
-    if(fseek(file, pageNum*PAGE_SIZE, SEEK_SET) == 0) {
-        printf("The file %s has been seeked!\n",fHandle->fileName);
-        // we are using fread function to read the page
-        int read_char=fread(memPage, sizeof(char), PAGE_SIZE/sizeof(char), file);
-        // freed will return no of bytes it read so it should match will the PAGE_SIZE as we are reading the whole page.
-        if(read_char==PAGE_SIZE/sizeof(char)) {
-            printf("The file %s has been read!\n",fHandle->fileName);
-            fHandle->curPagePos = pageNum;
-            fclose(file);
-            return RC_OK;
+    if (fHandle->fileName == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (pageNum < 0) {
+        printMessage("The file %s could not be read!\n",fHandle->fileName);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    __atomic_fetch_add(&openFile->ioCount, 1, __ATOMIC_RELAXED);
+    // Pages kept in the cold tier are not read from the file.
+    SM_ColdTier *coldTier = coldTierOf(openFile);
+    int cached = coldTierRead(coldTier, pageNum, memPage);
+    // The backend reads the whole page; a short read means the page does not exist.
+    RC readCheck = cached ? RC_OK
+        : compactionInProgress(openFile->compaction)
+        ? compactionRead(openFile->compaction, openFile, pageNum, memPage)
+        : openFile->pool != NULL
+        ? sharedPoolRead(openFile->pool, openFile, pageNum, memPage)
+        : openFile->backend->read(openFile->state, pageNum, memPage);
+    if(readCheck==RC_OK) {
+        printMessage("The file %s has been read!\n",fHandle->fileName);
+        fHandle->curPagePos = pageNum;
+        if (!cached) {
+            coldTierStore(coldTier, pageNum, memPage);
         }
-        else {
-            printf("The file %s could not be read!\n",fHandle->fileName);
-            return RC_READ_NON_EXISTING_PAGE;
+        // Only pages already in the table are rehashed, so plain reads stay cheap.
+        if (openFile->dedupWrites && openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].pageNum == pageNum) {
+            rememberPage(openFile, pageNum, pageChecksum(memPage, fHandle->pageSize));
         }
+        return RC_OK;
     }
-
     else {
-        printf("The file %s could not be read!\n",fHandle->fileName);
+        printMessage("The file %s could not be read!\n",fHandle->fileName);
         return RC_READ_NON_EXISTING_PAGE;
-
     }
 }
 
@@ -229,11 +567,11 @@ RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
 int getBlockPos(SM_FileHandle *fHandle)
 {
     if (fHandle == NULL ) {
-        printf("File can't be initialized because file handle is null.\n");
+        printMessage("File can't be initialized because file handle is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     // Storing the current page position to return it whenever needed.
@@ -253,11 +591,11 @@ int getBlockPos(SM_FileHandle *fHandle)
 RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     // Calling the readBlock function with parameter of page no set to 0 to read the first block.
@@ -277,11 +615,11 @@ RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     // Calling the readBlock function with parameter of page no set to the previous page of current page.
@@ -301,11 +639,11 @@ RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     // Calling the readBlock function with parameter of page no set to current page position.
@@ -325,11 +663,11 @@ RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     // Calling the readBlock function with parameter of page no set to next page of the file.
@@ -349,11 +687,11 @@ RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     // Calling the readBlock function with parameter of page no set to last block.
@@ -361,6 +699,48 @@ RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 }
 
 
+/**
+ * @brief Writes one page of an open file once the handle has been checked.
+ *
+ * @param mayDedup 1 if a page found unchanged may be skipped; pages of a multi-page write
+ *        are always written.
+ */
+static RC writePageOf(SM_OpenFile *openFile, int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, int mayDedup)
+{
+    // pageNum should be greater than or equal to zero and total pages in fhandle should be greater the pageNum
+    __atomic_fetch_add(&openFile->ioCount, 1, __ATOMIC_RELAXED);
+    if( pageNum>=0 && pageNum<fHandle->totalNumPages) {
+        uint64_t hash = openFile->dedupWrites ? pageChecksum(memPage, fHandle->pageSize) : 0;
+        fHandle->curPagePos = pageNum;
+        if (mayDedup && isPageUnchanged(openFile, pageNum, fHandle->pageSize, hash, memPage)) {
+            openFile->writeStats.pagesSkipped++;
+            return RC_OK;
+        }
+        RC writeCheck = openFile->pool != NULL
+            ? sharedPoolWrite(openFile->pool, openFile, pageNum, memPage)
+            : openFile->backend->write(openFile->state, pageNum, memPage);
+        if (writeCheck != RC_OK) {
+            printMessage("The file %s could not be written!\n",fHandle->fileName);
+            forgetWrittenPages(openFile, pageNum, 1);
+            return RC_WRITE_FAILED;
+        }
+        if (openFile->dedupWrites) {
+            rememberPage(openFile, pageNum, hash);
+        }
+        coldTierStore(coldTierOf(openFile), pageNum, memPage);
+        noteChangedPages(openFile->changes, pageNum, 1);
+        shipPages(openFile->shipper, pageNum, 1, memPage);
+        openFile->writeStats.pagesWritten++;
+        openFile->writeStats.bytesWritten += fHandle->pageSize;
+    }
+    else {
+        printMessage("The file %s could not be opened!\n",fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+
 /**
  * @brief Writes a block to a specific page number in the file.
  *
@@ -371,56 +751,27 @@ RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
  *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
  *         RC_WRITE_FAILED if write operation fails.
  */
-RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+static RC writeBlockUntraced(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
 
-    FILE *file = (FILE*) fHandle->mgmtInfo;
-    if (file==NULL) {
-        printf("The file %s could not be opened!\n",fHandle->fileName);
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile==NULL) {
+        printMessage("The file %s could not be opened!\n",fHandle->fileName);
         return RC_FILE_NOT_FOUND;
 
     }
-    // pageNum should be greater than or equal to zero and total pages in fhandle should be greater the pageNum
-    if( pageNum>=0 && pageNum<fHandle->totalNumPages) {
-        if(fseek(file, pageNum*PAGE_SIZE, SEEK_SET)==0) {
-            printf("The file %s has been seeked!\n",fHandle->fileName);
-            fseek(file, pageNum * PAGE_SIZE, SEEK_SET);
-            size_t writtenBytes = fwrite(memPage, 1, PAGE_SIZE, file);
-            if (writtenBytes != PAGE_SIZE) {
-                perror("Error writing page to file");
-                return RC_WRITE_FAILED;
-            }
-            fHandle->curPagePos = pageNum;
-            // going to the end of the page file and storing the total no of pages.
-            fseek(file, 0, SEEK_END);
-            long fileSize = ftell(file);
-            if (fileSize == -1) {
-                perror("Error determining file size");
-                return RC_FILE_NOT_FOUND;
-            }
-
-            fHandle->totalNumPages = fileSize / PAGE_SIZE;
-
-        }
-        else {
-            printf("The file %s could not be seeked!\n",fHandle->fileName);
-            return RC_WRITE_FAILED;
-        }
-
-    }
-    else {
-        printf("The file %s could not be opened!\n",fHandle->fileName);
+    if (isBeingCompacted(fHandle)) {
         return RC_WRITE_FAILED;
     }
-    return RC_OK;
+    return writePageOf(openFile, pageNum, fHandle, memPage, 1);
 }
 
 
@@ -437,29 +788,132 @@ RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
 RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     if (fHandle == NULL || memPage == NULL) {
-        printf("File can't be initialized because file handle or memory page is null.\n");
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     int nowBlock = getBlockPos(fHandle);
     // FILE *file =(FILE*) fHandle->mgmtInfo;
     if(nowBlock==-1) {
-        printf("The file %s could not be opened!\n",fHandle->fileName);
+        printMessage("The file %s could not be opened!\n",fHandle->fileName);
         return RC_FILE_HANDLE_NOT_INIT;
     }
     // nowBlock is written in the fHandle page file.
     if(writeBlock(nowBlock, fHandle, memPage)==RC_OK) {
-        printf("The file %s could be written!\n",fHandle->fileName);
+        printMessage("The file %s could be written!\n",fHandle->fileName);
         return RC_OK;
     }
     else {
-        printf("The file %s could not be written!\n",fHandle->fileName);
+        printMessage("The file %s could not be written!\n",fHandle->fileName);
+        return RC_WRITE_FAILED;
+
+    }
+}
+
+
+/**
+ * @brief Writes only the part of a page that changed. memPage holds the whole new page image and
+ *        [offset, offset + length) is the range that differs from the page on disk; the range is
+ *        widened to whole sectors and only those sectors are written. With deduplication on,
+ *        nothing is written if the page in the file is already identical.
+ *
+ * @param pageNum The page number that is updated.
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param memPage The whole new content of the page.
+ * @param offset Offset of the first changed byte in the page.
+ * @param length Number of changed bytes.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the range is invalid or the write fails.
+ */
+static RC writeBlockRangeUntraced(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, int offset, int length)
+{
+    if (fHandle == NULL || memPage == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages || offset < 0 || length <= 0
+        || offset > fHandle->pageSize - length) {
+        printMessage("The range of page %d of %s is invalid!\n", pageNum, fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    if (isBeingCompacted(fHandle)) {
+        return RC_WRITE_FAILED;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (openFile->backend->writeRange == NULL || openFile->pool != NULL) {
+        return writeBlockUntraced(pageNum, fHandle, memPage);
+    }
+    __atomic_fetch_add(&openFile->ioCount, 1, __ATOMIC_RELAXED);
+    uint64_t hash = openFile->dedupWrites ? pageChecksum(memPage, fHandle->pageSize) : 0;
+    fHandle->curPagePos = pageNum;
+    if (isPageUnchanged(openFile, pageNum, fHandle->pageSize, hash, memPage)) {
+        openFile->writeStats.pagesSkipped++;
+        return RC_OK;
+    }
+    // Sectors are the smallest unit the device writes, so partial sectors would not save anything.
+    int first = offset / SECTOR_SIZE * SECTOR_SIZE;
+    int end = (offset + length + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    if (openFile->backend->writeRange(openFile->state, pageNum, first, end - first, memPage + first) != RC_OK) {
+        printMessage("The file %s could not be written!\n",fHandle->fileName);
+        forgetWrittenPages(openFile, pageNum, 1);
         return RC_WRITE_FAILED;
+    }
+    if (openFile->dedupWrites) {
+        rememberPage(openFile, pageNum, hash);
+    }
+    coldTierStore(coldTierOf(openFile), pageNum, memPage);
+    noteChangedPages(openFile->changes, pageNum, 1);
+    shipPages(openFile->shipper, pageNum, 1, memPage);
+    openFile->writeStats.rangeWrites++;
+    openFile->writeStats.bytesWritten += end - first;
+    return RC_OK;
+}
+
+
+/**
+ * @brief Turns skipping of identical page writes on or off for one handle. It is off by default.
+ *        When on, a write whose content hashes to what the handle last wrote or read for the page
+ *        reads the stored page back and is skipped only if it is identical.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param enabled Non-zero to skip identical writes.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC setWriteDedup(SM_FileHandle *fHandle, int enabled)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    openFile->dedupWrites = enabled != 0;
+    forgetWrittenPages(openFile, 0, WRITE_HASH_SLOTS);
+    return RC_OK;
+}
 
+
+/**
+ * @brief Reports how many page writes went to the backend, how many were skipped as identical
+ *        and how many bytes were written through a handle.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param stats The structure that is filled in.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ */
+RC getWriteStats(SM_FileHandle *fHandle, SM_WriteStats *stats)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || stats == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
+        return RC_FILE_HANDLE_NOT_INIT;
     }
+    *stats = ((SM_OpenFile*) fHandle->mgmtInfo)->writeStats;
+    return RC_OK;
 }
 
 
@@ -472,43 +926,56 @@ RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
  *         RC_WRITE_FAILED if append operation fails.
  */
 
-RC appendEmptyBlock(SM_FileHandle *fHandle)
+static RC appendEmptyBlockUntraced(SM_FileHandle *fHandle)
 {
     if (fHandle == NULL) {
-        printf("File can't be initialized because file handle is null.\n");
+        printMessage("File can't be initialized because file handle is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
-    if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+    if (fHandle->fileName == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
-    FILE *file =(FILE*) fHandle->mgmtInfo;
-    if(fseek(file, 0, SEEK_END)==0) {
-        printf("The file %s could be seeked!\n",fHandle->fileName);
-        SM_PageHandle newPage=(SM_PageHandle)calloc(1,PAGE_SIZE);
-        if(newPage==NULL) {
-            printf("The file %s 's memory allocation failed.\n",fHandle->fileName);
-            return RC_WRITE_FAILED;
-        }
-        else {
-            printf("The file %s could be opened!\n",fHandle->fileName);
-            if(fwrite(newPage, sizeof(char), PAGE_SIZE/sizeof(char), file)==PAGE_SIZE/sizeof(char)) {
-                printf("The file %s could be written!\n",fHandle->fileName);
-                fHandle->totalNumPages += 1;
-                free(newPage);
-                return RC_OK;
-
-            }
-            else {
-                printf("The file %s could not be written!\n",fHandle->fileName);
-                return RC_WRITE_FAILED;
-            }
-        }
+    if (isBeingCompacted(fHandle)) {
+        return RC_WRITE_FAILED;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    // The backend appends one zero page at the end of the file and reports the new size.
+    int pageNum = fHandle->totalNumPages;
+    if(openFile->backend->extend(openFile->state, 1, &fHandle->totalNumPages)==RC_OK) {
+        noteChangedPages(openFile->changes, pageNum, fHandle->totalNumPages - pageNum);
+        shipResize(openFile->shipper, fHandle->totalNumPages);
+        printMessage("The file %s could be written!\n",fHandle->fileName);
+        return RC_OK;
     }
     else {
-        printf("The file %s could not be seeked!\n",fHandle->fileName);
+        printMessage("The file %s could not be written!\n",fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+}
+
+
+/**
+ * @brief Forces all pages written so far to stable storage.
+ *
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if the backend could not sync the file.
+ */
+RC syncPageFile(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("File can't be synced because file handle is not initialized.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if ((openFile->pool != NULL && sharedPoolFlushFile(openFile->pool, openFile->poolFile) != RC_OK)
+        || openFile->backend->sync(openFile->state) != RC_OK || syncChangeMap(openFile->changes) != RC_OK) {
+        printMessage("The file %s could not be synced!\n",fHandle->fileName);
         return RC_WRITE_FAILED;
     }
+    return RC_OK;
 }
 
 
@@ -521,25 +988,593 @@ RC appendEmptyBlock(SM_FileHandle *fHandle)
  *         RC_WRITE_FAILED if the append operation failed.
  */
 
-RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle)
+static RC ensureCapacityUntraced(int numberOfPages, SM_FileHandle *fHandle)
 {
     if (fHandle == NULL ) {
-        printf("File can't be initialized because file handle is null.\n");
+        printMessage("File can't be initialized because file handle is null.\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
-    if (fHandle->fileName == NULL) {
-        printf("The file name is incorrect or is not initialized in file handle\n");
+    if (fHandle->fileName == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("The file name is incorrect or is not initialized in file handle\n");
         return RC_FILE_HANDLE_NOT_INIT;
     }
     if(numberOfPages<0) {
-        printf("The page range is out of bound");
+        printMessage("The page range is out of bound");
+        return RC_WRITE_FAILED;
+    }
+    if (numberOfPages > fHandle->totalNumPages && isBeingCompacted(fHandle)) {
         return RC_WRITE_FAILED;
     }
     int pages=fHandle->totalNumPages;
-    // fHandle should have the specified no of pages or else add pages till the specified number is not reached.
-    for(int i=0;i<numberOfPages-pages;i++) {
-        appendEmptyBlock(fHandle);
+    // fHandle should have the specified no of pages or else the missing pages are added in one backend call.
+    if (numberOfPages > pages) {
+        SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+        if (openFile->backend->extend(openFile->state, numberOfPages - pages, &fHandle->totalNumPages) != RC_OK) {
+            printMessage("The file %s could not be extended!\n",fHandle->fileName);
+            return RC_WRITE_FAILED;
+        }
+        noteChangedPages(openFile->changes, pages, fHandle->totalNumPages - pages);
+        shipResize(openFile->shipper, fHandle->totalNumPages);
+    }
+    return RC_OK;
+}
+
+/**
+ * @brief Copies len bytes between two descriptors starting at the given offsets, first trying
+ *        an in-kernel copy_file_range and falling back to a pread/pwrite loop through a page buffer.
+ *
+ * @param srcFd Descriptor the bytes are read from.
+ * @param srcOff Byte offset in the source where copying starts.
+ * @param dstFd Descriptor the bytes are written to.
+ * @param dstOff Byte offset in the destination where copying starts.
+ * @param len Number of bytes to copy.
+ * @return RC_OK if successful.
+ *         RC_READ_NON_EXISTING_PAGE if the source ends before len bytes were copied.
+ *         RC_WRITE_FAILED if the destination could not be written.
+ */
+static RC copyFileBytes(int srcFd, off_t srcOff, int dstFd, off_t dstOff, off_t len)
+{
+#ifdef __linux__
+    // copy_file_range lets the kernel move the bytes (or share extents on filesystems that support it).
+    while (len > 0) {
+        ssize_t copied = copy_file_range(srcFd, &srcOff, dstFd, &dstOff, (size_t) len, 0);
+        if (copied <= 0) {
+            break;
+        }
+        len -= copied;
+    }
+    if (len == 0) {
+        return RC_OK;
+    }
+#endif
+    // Fallback for kernels or filesystems without copy_file_range: copy one page at a time.
+    SM_PageHandle buffer = allocPage();
+    if (buffer == NULL) {
+        printMessage("Memory allocation error!\n");
+        return RC_WRITE_FAILED;
+    }
+    while (len > 0) {
+        size_t chunk = len < PAGE_SIZE ? (size_t) len : PAGE_SIZE;
+        ssize_t readBytes = pread(srcFd, buffer, chunk, srcOff);
+        if (readBytes <= 0) {
+            freePage(buffer);
+            return RC_READ_NON_EXISTING_PAGE;
+        }
+        if (pwrite(dstFd, buffer, (size_t) readBytes, dstOff) != readBytes) {
+            freePage(buffer);
+            return RC_WRITE_FAILED;
+        }
+        srcOff += readBytes;
+        dstOff += readBytes;
+        len -= readBytes;
+    }
+    freePage(buffer);
+    return RC_OK;
+}
+
+
+/**
+ * @brief Copies count pages starting at page first between two open files page by page through
+ *        their backends. Used whenever one side is not a POSIX file.
+ */
+static RC copyPagesThroughBackends(SM_OpenFile *src, SM_OpenFile *dst, int pageSize, int first, int count)
+{
+    SM_PageHandle buffer = pageSize == PAGE_SIZE ? allocPage() : (SM_PageHandle) malloc((size_t) pageSize);
+    if (buffer == NULL) {
+        printMessage("Memory allocation error!\n");
+        return RC_WRITE_FAILED;
+    }
+    RC rc = RC_OK;
+    for (int pageNum = first; pageNum < first + count && rc == RC_OK; pageNum++) {
+        rc = src->backend->read(src->state, pageNum, buffer);
+        if (rc == RC_OK) {
+            rc = dst->backend->write(dst->state, pageNum, buffer);
+        }
+    }
+    if (pageSize == PAGE_SIZE) {
+        freePage(buffer);
+    }
+    else {
+        free(buffer);
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Copies a whole page file when at least one of the two names is not a POSIX file.
+ *        The destination is recreated with the same number of pages as the source.
+ */
+static RC copyPageFileThroughBackends(char *srcFileName, const SM_Backend *srcBackend,
+                                      char *dstFileName, const SM_Backend *dstBackend)
+{
+    SM_OpenFile src, dst;
+    int srcPages = 0, dstPages = 0, pageSize = PAGE_SIZE, dstPageSize = PAGE_SIZE;
+    src.backend = srcBackend;
+    dst.backend = dstBackend;
+    if (srcBackend->open(srcFileName, &src.state, &srcPages, &pageSize) != RC_OK) {
+        printMessage("The file %s could not be opened!\n", srcFileName);
+        return RC_FILE_NOT_FOUND;
+    }
+    dstBackend->destroy(dstFileName);
+    if (dstBackend->create(dstFileName, pageSize) != RC_OK
+        || dstBackend->open(dstFileName, &dst.state, &dstPages, &dstPageSize) != RC_OK) {
+        printMessage("The file %s could not be created!\n", dstFileName);
+        srcBackend->close(src.state);
+        return RC_FILE_NOT_FOUND;
+    }
+    RC rc = RC_OK;
+    if (srcPages > dstPages) {
+        rc = dstBackend->extend(dst.state, srcPages - dstPages, &dstPages);
+    }
+    if (rc == RC_OK) {
+        rc = copyPagesThroughBackends(&src, &dst, pageSize, 0, srcPages);
+    }
+    srcBackend->close(src.state);
+    dstBackend->close(dst.state);
+    if (rc == RC_OK) {
+        printMessage("The file %s has been copied to %s!\n", srcFileName, dstFileName);
+    }
+    else {
+        printMessage("The file %s could not be copied to %s!\n", srcFileName, dstFileName);
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Copies a whole page file to a new file without passing the pages through user space.
+ *        A reflink clone (FICLONE) is tried first, then copy_file_range, then a plain read/write loop.
+ *
+ * @param srcFileName The name of the page file that will be copied.
+ * @param dstFileName The name of the copy; an existing file with this name is overwritten.
+ * @return RC_OK if successful.
+ *         RC_FILE_NOT_FOUND if the source can't be opened or the destination can't be created.
+ *         RC_WRITE_FAILED if the destination is the source itself or the copy fails.
+ */
+RC copyPageFile(char *srcFileName, char *dstFileName)
+{
+    if (srcFileName == NULL || dstFileName == NULL) {
+        printMessage("File can't be copied because the source or destination name is null.\n");
+        return RC_FILE_NOT_FOUND;
+    }
+    const SM_Backend *srcBackend = findStorageBackend(srcFileName);
+    const SM_Backend *dstBackend = findStorageBackend(dstFileName);
+    if (srcBackend != &posixBackend || dstBackend != &posixBackend) {
+        if (srcBackend == dstBackend && strcmp(srcFileName, dstFileName) == 0) {
+            printMessage("The file %s can't be copied onto itself!\n", srcFileName);
+            return RC_WRITE_FAILED;
+        }
+        return copyPageFileThroughBackends(srcFileName, srcBackend, dstFileName, dstBackend);
+    }
+    int srcFd = open(srcFileName, O_RDONLY);
+    if (srcFd == -1) {
+        printMessage("The file %s could not be opened!\n", srcFileName);
+        return RC_FILE_NOT_FOUND;
+    }
+    // The destination is truncated only once it is known not to be the source under another name.
+    int dstFd = open(dstFileName, O_WRONLY | O_CREAT, 0644);
+    if (dstFd == -1) {
+        printMessage("The file %s could not be created!\n", dstFileName);
+        close(srcFd);
+        return RC_FILE_NOT_FOUND;
+    }
+    struct stat srcStat, dstStat;
+    if (fstat(srcFd, &srcStat) != 0 || fstat(dstFd, &dstStat) != 0
+        || (srcStat.st_dev == dstStat.st_dev && srcStat.st_ino == dstStat.st_ino)
+        || ftruncate(dstFd, 0) != 0) {
+        printMessage("The file %s can't be copied onto %s!\n", srcFileName, dstFileName);
+        close(srcFd);
+        close(dstFd);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = RC_OK;
+#ifdef FICLONE
+    // On copy-on-write filesystems (btrfs, XFS) the clone shares extents and finishes in constant time.
+    if (ioctl(dstFd, FICLONE, srcFd) == 0) {
+        printMessage("The file %s has been cloned to %s!\n", srcFileName, dstFileName);
+        close(srcFd);
+        close(dstFd);
+        return RC_OK;
+    }
+#endif
+    off_t size = lseek(srcFd, 0, SEEK_END);
+    if (size == -1) {
+        printMessage("The file %s 's end position can't be determined\n", srcFileName);
+        rc = RC_FILE_NOT_FOUND;
+    }
+    else {
+        rc = copyFileBytes(srcFd, 0, dstFd, 0, size);
+    }
+    close(srcFd);
+    if (close(dstFd) != 0 && rc == RC_OK) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc == RC_OK) {
+        printMessage("The file %s has been copied to %s!\n", srcFileName, dstFileName);
+    }
+    else {
+        printMessage("The file %s could not be copied to %s!\n", srcFileName, dstFileName);
+    }
+    return rc;
+}
+
+
+/**
+ * @brief Copies count pages starting at page first from one open page file to the same page
+ *        numbers of another, growing the destination if needed.
+ *
+ * @param srcHandle The open page file the pages are copied from.
+ * @param dstHandle The open page file the pages are copied to.
+ * @param first The first page number to copy.
+ * @param count The number of pages to copy.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if either file has not be initialized.
+ *         RC_READ_NON_EXISTING_PAGE if the range is outside the source file.
+ *         RC_WRITE_FAILED if the copy fails.
+ */
+static RC copyPageRangeUnshipped(SM_FileHandle *srcHandle, SM_FileHandle *dstHandle, int first, int count)
+{
+    if (srcHandle == NULL || dstHandle == NULL || srcHandle->mgmtInfo == NULL || dstHandle->mgmtInfo == NULL) {
+        printMessage("Pages can't be copied because a file handle is not initialized.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (first < 0 || count < 0 || first + count > srcHandle->totalNumPages) {
+        printMessage("The page range is out of bound\n");
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    if (srcHandle->pageSize != dstHandle->pageSize) {
+        printMessage("Pages can't be copied between files with different page sizes.\n");
+        return RC_WRITE_FAILED;
+    }
+    if (count == 0) {
+        return RC_OK;
+    }
+    if (isBeingCompacted(srcHandle) || isBeingCompacted(dstHandle)) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = ensureCapacity(first + count, dstHandle);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    SM_OpenFile *src = (SM_OpenFile*) srcHandle->mgmtInfo;
+    SM_OpenFile *dst = (SM_OpenFile*) dstHandle->mgmtInfo;
+    // The copied pages bypass writeBlock, so their remembered hashes would be stale.
+    forgetWrittenPages(dst, first, count);
+    int epoch = beginOpenFileIo(dst);
+    coldTierInvalidate(__atomic_load_n(&dst->coldTier, __ATOMIC_ACQUIRE), first, count);
+    endOpenFileIo(dst, epoch);
+    noteChangedPages(dst->changes, first, count);
+    // The copy reads and writes the files directly, so the source's pooled writes go first
+    // and the destination's pooled copies of the overwritten pages are dropped.
+    if (src->pool != NULL && sharedPoolFlushFile(src->pool, src->poolFile) != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    if (dst->pool != NULL) {
+        sharedPoolInvalidate(dst->pool, dst->poolFile, first, count);
+    }
+    if (src->backend != &posixBackend || dst->backend != &posixBackend) {
+        rc = copyPagesThroughBackends(src, dst, srcHandle->pageSize, first, count);
+        if (rc != RC_OK) {
+            printMessage("The pages of %s could not be copied to %s!\n", srcHandle->fileName, dstHandle->fileName);
+        }
+        return rc;
+    }
+    off_t srcOffset = posixBackendDataOffset(src->state) + (off_t) first * srcHandle->pageSize;
+    off_t dstOffset = posixBackendDataOffset(dst->state) + (off_t) first * dstHandle->pageSize;
+    off_t len = (off_t) count * srcHandle->pageSize;
+    int srcFd = posixBackendFd(src->state);
+    int dstFd = posixBackendFd(dst->state);
+#ifdef FICLONERANGE
+    struct file_clone_range range;
+    range.src_fd = srcFd;
+    range.src_offset = (unsigned long long) srcOffset;
+    range.src_length = (unsigned long long) len;
+    range.dest_offset = (unsigned long long) dstOffset;
+    if (ioctl(dstFd, FICLONERANGE, &range) == 0) {
+        return RC_OK;
+    }
+#endif
+    rc = copyFileBytes(srcFd, srcOffset, dstFd, dstOffset, len);
+    if (rc != RC_OK) {
+        printMessage("The pages of %s could not be copied to %s!\n", srcHandle->fileName, dstHandle->fileName);
+    }
+    return rc;
+}
+
+
+RC copyPageRange(SM_FileHandle *srcHandle, SM_FileHandle *dstHandle, int first, int count)
+{
+    refreshPageCount(srcHandle);
+    refreshPageCount(dstHandle);
+    RC rc = copyPageRangeUnshipped(srcHandle, dstHandle, first, count);
+    // The copy does not pass through a page buffer, so a shipped destination reads the pages back.
+    if (rc == RC_OK && ((SM_OpenFile*) dstHandle->mgmtInfo)->shipper != NULL) {
+        rc = shipFilePages(dstHandle, first, count);
+    }
+    return rc;
+}
+
+
+/************************************************************
+ *                    multi-page transfers                  *
+ ************************************************************/
+
+/**
+ * @brief Reads numPages consecutive pages into one buffer. Files read straight from their
+ *        backend are read with a single backend call; files going through a shared pool or a
+ *        compaction are read page by page.
+ *
+ * @param firstPage The first page to read.
+ * @param numPages The number of pages to read.
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param memPages Buffer of numPages pages receiving the pages in order.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_READ_NON_EXISTING_PAGE if a page doesn't exist.
+ */
+static RC readBlocksUntraced(int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages)
+{
+    if (fHandle == NULL || memPages == NULL || fHandle->fileName == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (firstPage < 0 || numPages < 0) {
+        printMessage("The file %s could not be read!\n",fHandle->fileName);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (numPages == 0) {
+        return RC_OK;
+    }
+    if (compactionInProgress(openFile->compaction) || openFile->pool != NULL || openFile->backend->readPages == NULL) {
+        for (int i = 0; i < numPages; i++) {
+            RC rc = readBlockUntraced(firstPage + i, fHandle, memPages + (size_t) i * fHandle->pageSize);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+        return RC_OK;
+    }
+    __atomic_fetch_add(&openFile->ioCount, numPages, __ATOMIC_RELAXED);
+    if (openFile->backend->readPages(openFile->state, firstPage, numPages, memPages) != RC_OK) {
+        printMessage("The file %s could not be read!\n",fHandle->fileName);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    printMessage("The file %s has been read!\n",fHandle->fileName);
+    fHandle->curPagePos = firstPage + numPages - 1;
+    for (int i = 0; openFile->dedupWrites && i < numPages; i++) {
+        int pageNum = firstPage + i;
+        if (openFile->writeHashes[pageNum % WRITE_HASH_SLOTS].pageNum == pageNum) {
+            rememberPage(openFile, pageNum, pageChecksum(memPages + (size_t) i * fHandle->pageSize, fHandle->pageSize));
+        }
+    }
+    return RC_OK;
+}
+
 
+/**
+ * @brief Writes numPages consecutive pages from one buffer. Files written straight to their
+ *        backend are written with a single backend call; files in a shared pool or on a backend
+ *        without writePages are written page by page. Write deduplication never skips pages of
+ *        a multi-page write, it only remembers their hashes for later single-page writes.
+ *
+ * @param firstPage The first page to write.
+ * @param numPages The number of pages to write; the file must already hold all of them.
+ * @param fHandle It is the pointer of the file on which the operation will be performed.
+ * @param memPages Buffer of numPages pages in order.
+ * @return RC_OK if successful.
+ *         RC_FILE_HANDLE_NOT_INIT if the file has not be initialized.
+ *         RC_WRITE_FAILED if a page is outside the file or the write fails.
+ */
+static RC writeBlocksUntraced(int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages)
+{
+    if (fHandle == NULL || memPages == NULL || fHandle->fileName == NULL || fHandle->mgmtInfo == NULL) {
+        printMessage("File can't be initialized because file handle or memory page is null.\n");
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (firstPage < 0 || numPages < 0 || firstPage + numPages > fHandle->totalNumPages) {
+        printMessage("The file %s could not be written!\n",fHandle->fileName);
+        return RC_WRITE_FAILED;
+    }
+    if (isBeingCompacted(fHandle)) {
+        return RC_WRITE_FAILED;
+    }
+    SM_OpenFile *openFile = (SM_OpenFile*) fHandle->mgmtInfo;
+    if (numPages == 0) {
+        return RC_OK;
+    }
+    if (openFile->pool != NULL || openFile->backend->writePages == NULL) {
+        for (int i = 0; i < numPages; i++) {
+            RC rc = writePageOf(openFile, firstPage + i, fHandle, memPages + (size_t) i * fHandle->pageSize, 0);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+        return RC_OK;
     }
+    __atomic_fetch_add(&openFile->ioCount, numPages, __ATOMIC_RELAXED);
+    // A multi-page write is a scan; the cold tier only forgets the old pages.
+    coldTierInvalidate(coldTierOf(openFile), firstPage, numPages);
+    if (openFile->backend->writePages(openFile->state, firstPage, numPages, memPages) != RC_OK) {
+        printMessage("The file %s could not be written!\n",fHandle->fileName);
+        // Some of the pages may have been written, so their remembered hashes are stale.
+        forgetWrittenPages(openFile, firstPage, numPages);
+        return RC_WRITE_FAILED;
+    }
+    noteChangedPages(openFile->changes, firstPage, numPages);
+    shipPages(openFile->shipper, firstPage, numPages, memPages);
+    fHandle->curPagePos = firstPage + numPages - 1;
+    for (int i = 0; openFile->dedupWrites && i < numPages; i++) {
+        rememberPage(openFile, firstPage + i, pageChecksum(memPages + (size_t) i * fHandle->pageSize, fHandle->pageSize));
+    }
+    openFile->writeStats.pagesWritten += numPages;
+    openFile->writeStats.bytesWritten += (long long) numPages * fHandle->pageSize;
     return RC_OK;
-}
\ No newline at end of file
+}
+
+
+/************************************************************
+ *                    traced entry points                   *
+ ************************************************************/
+/* The public operations below only add a trace event around the work done by the
+ * untraced versions above; with tracing off the cost is a single flag check. They also
+ * keep the page count of handles sharing a file in step, count the pages of profiled
+ * files, and count themselves in flight so a profiler or cold tier dropped through another
+ * handle is not freed under them. */
+
+/* counts a call in flight on the handle's open file; -1 if the handle is not open */
+static int beginIo(SM_FileHandle *fHandle)
+{
+    return fHandle != NULL && fHandle->mgmtInfo != NULL ? beginOpenFileIo((SM_OpenFile*) fHandle->mgmtInfo) : -1;
+}
+
+static void endIo(SM_FileHandle *fHandle, int epoch)
+{
+    if (epoch != -1) {
+        endOpenFileIo((SM_OpenFile*) fHandle->mgmtInfo, epoch);
+    }
+}
+
+/* the name an I/O capture files the operation under */
+static char *fileNameOf(SM_FileHandle *fHandle)
+{
+    return fHandle != NULL ? fHandle->fileName : NULL;
+}
+
+/* counts the pages of a successful read or write in the heat profile of the file */
+static void profilePages(SM_FileHandle *fHandle, int firstPage, int numPages, int isWrite, RC rc)
+{
+    SM_OpenFile *openFile = fHandle != NULL ? (SM_OpenFile*) fHandle->mgmtInfo : NULL;
+    if (rc == RC_OK && openFile != NULL) {
+        profileAccess(__atomic_load_n(&openFile->profiler, __ATOMIC_ACQUIRE), firstPage, numPages, isWrite);
+    }
+}
+
+RC openPageFile(char *fileName, SM_FileHandle *fHandle)
+{
+    long long start = traceBegin();
+    RC rc = openPageFileUntraced(fileName, fHandle);
+    traceEnd(TRACE_OPEN, start, fileName, -1, rc);
+    return rc;
+}
+
+RC closePageFile(SM_FileHandle *fHandle)
+{
+    long long start = traceBegin();
+    char *fileName = fileNameOf(fHandle);
+    RC rc = closePageFileUntraced(fHandle);
+    traceEnd(TRACE_CLOSE, start, fileName, -1, rc);
+    return rc;
+}
+
+RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    refreshPageCount(fHandle);
+    int epoch = beginIo(fHandle);
+    long long start = traceBegin();
+    RC rc = readBlockUntraced(pageNum, fHandle, memPage);
+    traceEnd(TRACE_READ_BLOCK, start, fileNameOf(fHandle), pageNum, rc);
+    profilePages(fHandle, pageNum, 1, 0, rc);
+    endIo(fHandle, epoch);
+    publishPageCount(fHandle);
+    return rc;
+}
+
+RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    refreshPageCount(fHandle);
+    int epoch = beginIo(fHandle);
+    long long start = traceBegin();
+    RC rc = writeBlockUntraced(pageNum, fHandle, memPage);
+    traceEnd(TRACE_WRITE_BLOCK, start, fileNameOf(fHandle), pageNum, rc);
+    profilePages(fHandle, pageNum, 1, 1, rc);
+    endIo(fHandle, epoch);
+    publishPageCount(fHandle);
+    return rc;
+}
+
+/* a multi-page transfer is traced as one event per page, so replays and heat reports count every page */
+RC readBlocks(int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages)
+{
+    refreshPageCount(fHandle);
+    int epoch = beginIo(fHandle);
+    long long start = traceBegin();
+    RC rc = readBlocksUntraced(firstPage, numPages, fHandle, memPages);
+    traceEndPages(TRACE_READ_BLOCK, start, fileNameOf(fHandle), firstPage, numPages, rc);
+    profilePages(fHandle, firstPage, numPages, 0, rc);
+    endIo(fHandle, epoch);
+    publishPageCount(fHandle);
+    return rc;
+}
+
+RC writeBlocks(int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages)
+{
+    refreshPageCount(fHandle);
+    int epoch = beginIo(fHandle);
+    long long start = traceBegin();
+    RC rc = writeBlocksUntraced(firstPage, numPages, fHandle, memPages);
+    traceEndPages(TRACE_WRITE_BLOCK, start, fileNameOf(fHandle), firstPage, numPages, rc);
+    profilePages(fHandle, firstPage, numPages, 1, rc);
+    endIo(fHandle, epoch);
+    publishPageCount(fHandle);
+    return rc;
+}
+
+RC writeBlockRange(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, int offset, int length)
+{
+    refreshPageCount(fHandle);
+    int epoch = beginIo(fHandle);
+    long long start = traceBegin();
+    RC rc = writeBlockRangeUntraced(pageNum, fHandle, memPage, offset, length);
+    traceEnd(TRACE_WRITE_BLOCK, start, fileNameOf(fHandle), pageNum, rc);
+    profilePages(fHandle, pageNum, 1, 1, rc);
+    endIo(fHandle, epoch);
+    publishPageCount(fHandle);
+    return rc;
+}
+
+RC appendEmptyBlock(SM_FileHandle *fHandle)
+{
+    refreshPageCount(fHandle);
+    int epoch = beginIo(fHandle);
+    long long start = traceBegin();
+    int pageNum = fHandle != NULL ? fHandle->totalNumPages : -1;
+    RC rc = appendEmptyBlockUntraced(fHandle);
+    traceEnd(TRACE_APPEND, start, fileNameOf(fHandle), pageNum, rc);
+    endIo(fHandle, epoch);
+    publishPageCount(fHandle);
+    return rc;
+}
+
+RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle)
+{
+    refreshPageCount(fHandle);
+    int epoch = beginIo(fHandle);
+    long long start = traceBegin();
+    RC rc = ensureCapacityUntraced(numberOfPages, fHandle);
+    traceEnd(TRACE_ENSURE_CAPACITY, start, fileNameOf(fHandle), numberOfPages, rc);
+    endIo(fHandle, epoch);
+    publishPageCount(fHandle);
+    return rc;
+}
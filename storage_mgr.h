@@ -3,6 +3,10 @@
 
 #include "dberror.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /************************************************************
  *                    handle data structures                *
  ************************************************************/
@@ -11,17 +15,32 @@ typedef struct SM_FileHandle {
 	int totalNumPages;
 	int curPagePos;
 	void *mgmtInfo;
+	int pageSize;
 } SM_FileHandle;
 
 typedef char* SM_PageHandle;
 
+/* range writes are widened to whole sectors */
+#define SECTOR_SIZE 512
+
+/* per-handle write counters; pagesSkipped counts writes whose content was already on disk */
+typedef struct SM_WriteStats {
+	long pagesWritten;
+	long pagesSkipped;
+	long rangeWrites;
+	long long bytesWritten;
+} SM_WriteStats;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
+extern RC initStorageManagerWithBudget (long long memoryBudget);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithPageSize (char *fileName, int pageSize);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
+extern RC sharePageFile (SM_FileHandle *openHandle, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
 
@@ -39,5 +58,23 @@ extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC syncPageFile (SM_FileHandle *fHandle);
+
+/* avoiding redundant writes */
+extern RC writeBlockRange (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, int offset, int length);
+extern RC setWriteDedup (SM_FileHandle *fHandle, int enabled);
+extern RC getWriteStats (SM_FileHandle *fHandle, SM_WriteStats *stats);
+
+/* reading and writing runs of consecutive pages with one backend call */
+extern RC readBlocks (int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages);
+extern RC writeBlocks (int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle memPages);
+
+/* copying page files without round-tripping through readBlock/writeBlock */
+extern RC copyPageFile (char *srcFileName, char *dstFileName);
+extern RC copyPageRange (SM_FileHandle *srcHandle, SM_FileHandle *dstHandle, int first, int count);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef TABLES_H
+#define TABLES_H
+
+#include <stdbool.h>
+#include "dberror.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************
+ *                    values and record ids                 *
+ ************************************************************/
+typedef enum DataType {
+	DT_INT = 0,
+	DT_STRING = 1,
+	DT_FLOAT = 2,
+	DT_BOOL = 3
+} DataType;
+
+typedef struct Value {
+	DataType dt;
+	union v {
+		int intV;
+		char *stringV;
+		float floatV;
+		bool boolV;
+	} v;
+} Value;
+
+/* a record is found by its page and its slot in that page */
+typedef struct RID {
+	int page;
+	int slot;
+} RID;
+
+/* a record holds its attributes at fixed offsets: ints, floats and bools in their C size,
+ * strings in typeLength bytes padded with zeros */
+typedef struct Record {
+	RID id;
+	char *data;
+} Record;
+
+typedef struct Schema {
+	int numAttr;
+	char **attrNames;
+	DataType *dataTypes;
+	int *typeLength;
+	int *keyAttrs;
+	int keySize;
+} Schema;
+
+/* an open table; mgmtData holds the page file and the free space of its pages */
+typedef struct RM_TableData {
+	char *name;
+	Schema *schema;
+	void *mgmtData;
+} RM_TableData;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,8 +2,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/wait.h>
 
 #include "storage_mgr.h"
+#include "page_arena.h"
+#include "sm_trace.h"
+#include "io_replay.h"
+#include "sm_backend.h"
+#include "log_store.h"
+#include "change_tracking.h"
+#include "scrubber.h"
+#include "shared_pool.h"
+#include "extent_map.h"
+#include "compaction.h"
+#include "btree_mgr.h"
+#include "record_mgr.h"
+#include "hash_index.h"
+#include "external_sort.h"
+#include "checkpoint.h"
+#include "replication.h"
+#include "mem_governor.h"
+#include "file_catalog.h"
+#include "cold_tier.h"
+#include "heat_profile.h"
+#include "large_object.h"
+#include "page_kernels.h"
 #include "dberror.h"
 #include "test_helper.h"
 
@@ -32,6 +58,30 @@ static void checkConsistency(void);
 static void assessFileAppendToMaxCapacity(void);
 static void testWriteFailureOnPowerLoss(void);
 static void testAccessFailureForInvalidBlock(void);
+static void testCopyPageFileAndRange(void);
+static void testPageArenaAllocation(void);
+static void testOperationTracing(void);
+static void testIoCaptureAndReplay(void);
+static void testMemoryBackend(void);
+static void testSelectablePageSizes(void);
+static void testLogStructuredStore(void);
+static void testRedundantWriteSkipping(void);
+static void testIncrementalBackup(void);
+static void testIntegrityScrubber(void);
+static void testSharedBufferPool(void);
+static void testExtentAllocation(void);
+static void testOnlineCompaction(void);
+static void testBtreeIndex(void);
+static void testRecordManager(void);
+static void testHashIndex(void);
+static void testExternalSort(void);
+static void testFuzzyCheckpointing(void);
+static void testLogShipping(void);
+static void testMemoryGovernor(void);
+static void testFileCatalog(void);
+static void testColdTier(void);
+static void testHeatProfile(void);
+static void testLargeObjects(void);
 
 /* main function running all tests */
 int main (void)
@@ -58,6 +108,30 @@ int main (void)
   assessFileAppendToMaxCapacity();
   testWriteFailureOnPowerLoss();
   testAccessFailureForInvalidBlock();
+  testCopyPageFileAndRange();
+  testPageArenaAllocation();
+  testOperationTracing();
+  testIoCaptureAndReplay();
+  testMemoryBackend();
+  testSelectablePageSizes();
+  testLogStructuredStore();
+  testRedundantWriteSkipping();
+  testIncrementalBackup();
+  testIntegrityScrubber();
+  testSharedBufferPool();
+  testExtentAllocation();
+  testOnlineCompaction();
+  testBtreeIndex();
+  testRecordManager();
+  testHashIndex();
+  testExternalSort();
+  testFuzzyCheckpointing();
+  testLogShipping();
+  testMemoryGovernor();
+  testFileCatalog();
+  testColdTier();
+  testHeatProfile();
+  testLargeObjects();
   return 0;
 }
 
@@ -758,3 +832,2765 @@ void testAccessFailureForInvalidBlock(void)
 
   TEST_DONE();
 }
+
+/* Test: Copying a whole page file and a range of pages without reading them through readBlock. */
+void testCopyPageFileAndRange(void)
+{
+  SM_FileHandle fh, fhCopy;
+  SM_PageHandle ph;
+  int i, j;
+
+  testName = "test Copy Page File And Range";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  // Now we are creating a page file with 4 distinct pages
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(4, &fh));
+  for (i = 0; i < 4; i++) {
+    memset(ph, 'a' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+
+  // Copy the whole file and check every page of the copy
+  TEST_CHECK(copyPageFile(TESTPF, "test_copy.bin"));
+  TEST_CHECK(openPageFile("test_copy.bin", &fhCopy));
+  ASSERT_EQUALS_INT(4, fhCopy.totalNumPages, "copy should have the same number of pages");
+  for (i = 0; i < 4; i++) {
+    TEST_CHECK(readBlock(i, &fhCopy, ph));
+    for (j = 0; j < PAGE_SIZE; j++)
+      ASSERT_TRUE(ph[j] == 'a' + i, "copied page should match the source page");
+  }
+  TEST_CHECK(closePageFile(&fhCopy));
+  TEST_CHECK(destroyPageFile("test_copy.bin"));
+
+  // Copying a file onto itself, under its own or another name, must leave it alone
+  ASSERT_ERROR(copyPageFile(TESTPF, TESTPF), "copying a file onto itself should fail");
+  ASSERT_ERROR(copyPageFile(TESTPF, "./" TESTPF), "copying onto another name of the file should fail");
+  ASSERT_ERROR(copyPageFile("mem:test_self", "mem:test_self"), "copying a memory file onto itself should fail");
+  TEST_CHECK(readBlock(3, &fh, ph));
+  ASSERT_TRUE(fh.totalNumPages == 4 && ph[0] == 'd', "source should keep its pages");
+
+  // Copy pages 1 and 2 into a fresh one page file, which has to grow to 3 pages
+  TEST_CHECK(createPageFile("test_copy.bin"));
+  TEST_CHECK(openPageFile("test_copy.bin", &fhCopy));
+  TEST_CHECK(copyPageRange(&fh, &fhCopy, 1, 2));
+  ASSERT_EQUALS_INT(3, fhCopy.totalNumPages, "destination should grow to hold the copied range");
+  TEST_CHECK(readBlock(0, &fhCopy, ph));
+  for (j = 0; j < PAGE_SIZE; j++)
+    ASSERT_TRUE(ph[j] == 0, "page outside the copied range should stay empty");
+  for (i = 1; i < 3; i++) {
+    TEST_CHECK(readBlock(i, &fhCopy, ph));
+    for (j = 0; j < PAGE_SIZE; j++)
+      ASSERT_TRUE(ph[j] == 'a' + i, "copied range should match the source pages");
+  }
+  ASSERT_ERROR(copyPageRange(&fh, &fhCopy, 3, 2), "copying past the end of the source should fail");
+
+  TEST_CHECK(closePageFile(&fhCopy));
+  TEST_CHECK(destroyPageFile("test_copy.bin"));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Allocates and frees pages on a thread that exits with its free list full. */
+static void *churnArenaPages(void *arg)
+{
+  SM_PageHandle pages[40];
+  int i;
+
+  for (i = 0; i < 40; i++)
+    pages[i] = allocPage();
+  for (i = 0; i < 40; i++)
+    freePage(pages[i]);
+  return arg;
+}
+
+/* Allocates pages while the main thread shuts the arena down; the pages are never touched,
+ * since a shutdown may unmap them at any time. */
+static void *allocArenaPages(void *arg)
+{
+  long *allocated = (long *) arg;
+  int i;
+
+  for (i = 0; i < 3000; i++)
+    if (allocPage() != NULL)
+      (*allocated)++;
+  return arg;
+}
+
+/* Test: Page buffers taken from the page arena are aligned, zeroed and reusable for page I/O. */
+void testPageArenaAllocation(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[ARENA_PAGES_PER_REGION + 8];
+  PageArenaStats stats, after;
+  pthread_t thread, allocators[4];
+  long allocated[4];
+  int i, j, numPages = ARENA_PAGES_PER_REGION + 8;
+
+  testName = "test Page Arena Allocation";
+
+  TEST_CHECK(initPageArena(ARENA_ANY_NODE));
+
+  // Allocate more pages than a single region holds so the arena has to grow
+  for (i = 0; i < numPages; i++) {
+    pages[i] = allocPage();
+    ASSERT_TRUE(pages[i] != NULL, "arena should hand out a page");
+    ASSERT_TRUE(((unsigned long) pages[i]) % PAGE_SIZE == 0, "arena pages should be page aligned");
+  }
+  getPageArenaStats(&stats);
+  ASSERT_TRUE(stats.numRegions >= 2, "arena should have mapped a second region");
+  ASSERT_TRUE(stats.pagesInUse >= numPages, "all allocated pages should be counted as in use");
+
+  for (i = 0; i < numPages; i++)
+    memset(pages[i], 'Z', PAGE_SIZE);
+  for (i = 0; i < numPages; i++)
+    freePage(pages[i]);
+
+  // Recycled pages have to come back zeroed, just like calloc'd buffers
+  pages[0] = allocPage();
+  for (j = 0; j < PAGE_SIZE; j++)
+    ASSERT_TRUE(pages[0][j] == 0, "recycled arena page should be zeroed");
+
+  // Arena pages work as normal SM_PageHandle buffers
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  memset(pages[0], 'Q', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, pages[0]));
+  pages[1] = allocPage();
+  TEST_CHECK(readBlock(0, &fh, pages[1]));
+  for (j = 0; j < PAGE_SIZE; j++)
+    ASSERT_TRUE(pages[1][j] == 'Q', "page read into an arena buffer should match");
+  freePage(pages[0]);
+  freePage(pages[1]);
+
+  // A thread's cached frames go back to the arena when the thread exits
+  getPageArenaStats(&stats);
+  ASSERT_TRUE(pthread_create(&thread, NULL, churnArenaPages, NULL) == 0, "thread should start");
+  pthread_join(thread, NULL);
+  getPageArenaStats(&after);
+  ASSERT_TRUE(after.pagesInUse == stats.pagesInUse
+              && after.pagesFree == stats.pagesFree + (long) (after.numRegions - stats.numRegions) * ARENA_PAGES_PER_REGION,
+              "exited thread should hand its frames back");
+
+  // Threads can allocate from the arena of the node they run on
+  TEST_CHECK(initPageArena(ARENA_LOCAL_NODE));
+  ASSERT_TRUE(pthread_create(&thread, NULL, churnArenaPages, NULL) == 0, "thread should start");
+  pthread_join(thread, NULL);
+  getPageArenaStats(&after);
+  ASSERT_TRUE(after.numArenas >= 1 && after.pagesInUse == stats.pagesInUse, "node arena should hand out pages");
+  ASSERT_ERROR(initPageArena(ARENA_MAX_NODES), "node past the last arena should fail");
+  TEST_CHECK(initPageArena(ARENA_ANY_NODE));
+
+  // Shutting down while other threads allocate must neither deadlock nor crash
+  for (i = 0; i < 4; i++) {
+    allocated[i] = 0;
+    ASSERT_TRUE(pthread_create(&allocators[i], NULL, allocArenaPages, &allocated[i]) == 0, "thread should start");
+  }
+  for (i = 0; i < 20; i++) {
+    TEST_CHECK(shutdownPageArena());
+    sched_yield();
+  }
+  for (i = 0; i < 4; i++) {
+    pthread_join(allocators[i], NULL);
+    ASSERT_TRUE(allocated[i] == 3000, "allocation during a shutdown should still succeed");
+  }
+  TEST_CHECK(shutdownPageArena());
+  getPageArenaStats(&after);
+  ASSERT_TRUE(after.numRegions == 0 && after.pagesInUse == 0, "shutdown should unmap every region");
+  pages[0] = allocPage();
+  ASSERT_TRUE(pages[0] != NULL && pages[0][0] == 0, "arena should map fresh regions after a shutdown");
+  freePage(pages[0]);
+
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  TEST_DONE();
+}
+
+/* Test: Storage manager operations are recorded while tracing is on and dumped as Chrome trace JSON. */
+void testOperationTracing(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_TraceEvent events[64];
+  SM_TraceEvent *wrapped;
+  int i, count, reads = 0, writes = 0, appends = 0;
+  char line[256];
+  FILE *traceFile;
+
+  testName = "test Operation Tracing";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  memset(ph, 'T', PAGE_SIZE);
+
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(clearTrace());
+  TEST_CHECK(startTracing());
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  TEST_CHECK(writeBlock(1, &fh, ph));
+  TEST_CHECK(readBlock(1, &fh, ph));
+  ASSERT_ERROR(readBlock(7, &fh, ph), "reading a missing page should fail");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(stopTracing());
+
+  // Operations after tracing is stopped must not be recorded
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(readBlock(0, &fh, ph));
+  TEST_CHECK(closePageFile(&fh));
+
+  count = getTraceEvents(events, 64);
+  ASSERT_EQUALS_INT(6, count, "every traced operation should produce one event");
+  for (i = 0; i < count; i++) {
+    ASSERT_TRUE(events[i].endNs >= events[i].startNs, "events should end after they start");
+    if (events[i].op == TRACE_READ_BLOCK) {
+      reads++;
+      if (events[i].pageNum == 7)
+        ASSERT_TRUE(events[i].rc == RC_READ_NON_EXISTING_PAGE, "failed read should keep its return code");
+    }
+    if (events[i].op == TRACE_WRITE_BLOCK)
+      writes++;
+    if (events[i].op == TRACE_APPEND)
+      appends++;
+  }
+  ASSERT_EQUALS_INT(2, reads, "two reads were traced");
+  ASSERT_EQUALS_INT(1, writes, "one write was traced");
+  ASSERT_EQUALS_INT(1, appends, "one append was traced");
+
+  TEST_CHECK(dumpTraceJson("test_trace.json"));
+  traceFile = fopen("test_trace.json", "r");
+  ASSERT_TRUE(traceFile != NULL, "trace file should exist");
+  ASSERT_TRUE(fgets(line, sizeof(line), traceFile) != NULL, "trace file should not be empty");
+  ASSERT_TRUE(strncmp(line, "{\"traceEvents\":[", 16) == 0, "trace file should be Chrome trace JSON");
+  ASSERT_TRUE(fgets(line, sizeof(line), traceFile) != NULL && strstr(line, "\"ph\":\"X\"") != NULL, "events should be complete events");
+  fclose(traceFile);
+  remove("test_trace.json");
+  TEST_CHECK(clearTrace());
+  ASSERT_EQUALS_INT(0, getTraceEvents(NULL, 0), "cleared trace should be empty");
+
+  // A full ring and a ring lapped by exactly one event keep the newest TRACE_RING_EVENTS events
+  wrapped = (SM_TraceEvent*) malloc(sizeof(SM_TraceEvent) * (TRACE_RING_EVENTS + 1));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(7, &fh));
+  TEST_CHECK(startTracing());
+  TEST_CHECK(clearTrace());
+  for (i = 0; i < TRACE_RING_EVENTS; i++)
+    TEST_CHECK(readBlock(i % 7, &fh, ph));
+  count = getTraceEvents(wrapped, TRACE_RING_EVENTS + 1);
+  ASSERT_TRUE(count == TRACE_RING_EVENTS && wrapped[0].pageNum == 0, "full ring should hold every event");
+  TEST_CHECK(readBlock(i % 7, &fh, ph));
+  count = getTraceEvents(wrapped, TRACE_RING_EVENTS + 1);
+  ASSERT_TRUE(count == TRACE_RING_EVENTS && wrapped[0].pageNum == 1
+              && wrapped[count - 1].pageNum == TRACE_RING_EVENTS % 7, "lapped ring should drop only the oldest event");
+  TEST_CHECK(stopTracing());
+  TEST_CHECK(clearTrace());
+  TEST_CHECK(closePageFile(&fh));
+  free(wrapped);
+
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Test: Page API calls are captured to a binary file and replayed against a copy of the page file. */
+void testIoCaptureAndReplay(void)
+{
+  SM_FileHandle fh, fh2;
+  SM_PageHandle ph;
+  IoReplayStats stats;
+  int i;
+
+  testName = "test I/O Capture And Replay";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  memset(ph, 'C', PAGE_SIZE);
+
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(startIoCapture("test_capture.bin"));
+  ASSERT_ERROR(startIoCapture("test_capture.bin"), "a second capture should not start");
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(4, &fh));
+  for (i = 0; i < 4; i++)
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  for (i = 3; i >= 0; i--)
+    TEST_CHECK(readBlock(i, &fh, ph));
+  ASSERT_ERROR(readBlock(9, &fh, ph), "reading a missing page should fail");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(stopIoCapture());
+  ASSERT_ERROR(stopIoCapture(), "stopping twice should fail");
+
+  // Replaying into a fresh one page file: 1 ensureCapacity + 4 writes + 4 reads
+  TEST_CHECK(destroyPageFile(TESTPF));
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(replayIoTrace("test_capture.bin", NULL, TESTPF, 0, &stats));
+  ASSERT_EQUALS_INT(9, (int) stats.numOps, "all successful page operations should be replayed");
+  ASSERT_EQUALS_INT(1, (int) stats.numSkipped, "the failed read should be skipped");
+  ASSERT_TRUE(stats.maxLatencyUs >= stats.avgLatencyUs, "max latency should not be below the average");
+
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_TRUE(fh.totalNumPages >= 4, "replayed writes should have grown the file");
+  TEST_CHECK(readBlock(3, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'R', "replayed write should have reached the page file");
+  TEST_CHECK(closePageFile(&fh));
+
+  // Paced replay honours the original timing and gives the same result
+  TEST_CHECK(replayIoTrace("test_capture.bin", NULL, TESTPF, 1, &stats));
+  ASSERT_EQUALS_INT(9, (int) stats.numOps, "paced replay should run the same operations");
+
+  ASSERT_ERROR(replayIoTrace(TESTPF, NULL, TESTPF, 0, &stats), "a page file is not a capture file");
+
+  // A capture of two files keeps their calls apart
+  TEST_CHECK(createPageFile("test_capture2.bin"));
+  TEST_CHECK(startIoCapture("test_capture.bin"));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(openPageFile("test_capture2.bin", &fh2));
+  for (i = 0; i < 3; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    TEST_CHECK(writeBlock(0, &fh2, ph));
+  }
+  TEST_CHECK(readBlock(0, &fh2, ph));
+  TEST_CHECK(closePageFile(&fh2));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(stopIoCapture());
+  ASSERT_ERROR(replayIoTrace("test_capture.bin", NULL, TESTPF, 0, &stats), "a capture of two files needs a file named");
+  TEST_CHECK(replayIoTrace("test_capture.bin", TESTPF, TESTPF, 0, &stats));
+  ASSERT_EQUALS_INT(3, (int) stats.numOps, "only the calls on the named file should be replayed");
+  TEST_CHECK(replayIoTrace("test_capture.bin", "test_capture2.bin", "test_capture2.bin", 0, &stats));
+  ASSERT_EQUALS_INT(4, (int) stats.numOps, "the other file should be replayed on its own");
+  ASSERT_ERROR(replayIoTrace("test_capture.bin", "test_missing.bin", TESTPF, 0, &stats), "a file the capture does not hold should fail");
+
+  remove("test_capture.bin");
+  TEST_CHECK(destroyPageFile("test_capture2.bin"));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Test: Page files named with the memory backend prefix live in RAM and behave like files on disk. */
+void testMemoryBackend(void)
+{
+  SM_FileHandle fh, fh2, fh3;
+  SM_PageHandle ph;
+  int i, j;
+
+  testName = "test Memory Backend";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  ASSERT_TRUE(findStorageBackend("mem:test") == &memoryBackend, "mem: prefix should select the memory backend");
+  ASSERT_TRUE(findStorageBackend(TESTPF) == &posixBackend, "plain names should use the POSIX backend");
+
+  TEST_CHECK(createPageFile("mem:test"));
+  TEST_CHECK(openPageFile("mem:test", &fh));
+  ASSERT_EQUALS_INT(1, fh.totalNumPages, "new memory file should have one page");
+  TEST_CHECK(readFirstBlock(&fh, ph));
+  for (j = 0; j < PAGE_SIZE; j++)
+    ASSERT_TRUE(ph[j] == 0, "new memory page should be empty");
+
+  // Grow the file and fill every page
+  TEST_CHECK(ensureCapacity(3, &fh));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  ASSERT_EQUALS_INT(4, fh.totalNumPages, "memory file should have grown to 4 pages");
+  for (i = 0; i < 4; i++) {
+    memset(ph, 'm' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  ASSERT_TRUE(readBlock(4, &fh, ph) == RC_READ_NON_EXISTING_PAGE, "reading past the end should fail");
+  ASSERT_TRUE(writeBlock(4, &fh, ph) == RC_WRITE_FAILED, "writing past the end should fail");
+
+  // A second handle sees the same pages
+  TEST_CHECK(openPageFile("mem:test", &fh2));
+  ASSERT_EQUALS_INT(4, fh2.totalNumPages, "second handle should see all pages");
+  TEST_CHECK(readBlock(2, &fh2, ph));
+  for (j = 0; j < PAGE_SIZE; j++)
+    ASSERT_TRUE(ph[j] == 'm' + 2, "second handle should read what the first wrote");
+
+  // Destroying an open memory file keeps it usable until the last close
+  TEST_CHECK(destroyPageFile("mem:test"));
+  ASSERT_TRUE(openPageFile("mem:test", &fh3) == RC_FILE_NOT_FOUND, "destroyed file should not open again");
+  TEST_CHECK(readBlock(3, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'm' + 3, "destroyed file should stay readable through open handles");
+  TEST_CHECK(syncPageFile(&fh));
+
+  TEST_CHECK(closePageFile(&fh2));
+  TEST_CHECK(closePageFile(&fh));
+  ASSERT_TRUE(openPageFile("mem:test", &fh) == RC_FILE_NOT_FOUND, "destroyed memory file should be gone after the last close");
+
+  // Copying a memory file to disk
+  TEST_CHECK(createPageFile("mem:test"));
+  TEST_CHECK(openPageFile("mem:test", &fh));
+  TEST_CHECK(ensureCapacity(2, &fh));
+  memset(ph, 'd', PAGE_SIZE);
+  TEST_CHECK(writeBlock(1, &fh, ph));
+  TEST_CHECK(copyPageFile("mem:test", TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh2));
+  ASSERT_EQUALS_INT(2, fh2.totalNumPages, "disk copy should have as many pages as the memory file");
+  TEST_CHECK(readBlock(1, &fh2, ph));
+  ASSERT_TRUE(ph[0] == 'd', "disk copy should hold the memory file's pages");
+  TEST_CHECK(closePageFile(&fh2));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("mem:test"));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Test: Page files created with a non-default page size keep it across opens and in memory. */
+void testSelectablePageSizes(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  FILE *raw;
+  int i, j;
+
+  testName = "test Selectable Page Sizes";
+
+  ph = (SM_PageHandle) malloc(MAX_PAGE_SIZE);
+
+  ASSERT_ERROR(createPageFileWithPageSize(TESTPF, 3000), "unsupported page size should be rejected");
+
+  // 16 KiB pages on disk
+  TEST_CHECK(createPageFileWithPageSize(TESTPF, 16384));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_EQUALS_INT(16384, fh.pageSize, "handle should carry the page size of the file");
+  ASSERT_EQUALS_INT(1, fh.totalNumPages, "new file should have one page");
+  TEST_CHECK(readFirstBlock(&fh, ph));
+  ASSERT_TRUE(pageIsZero(ph, fh.pageSize), "first page should be empty");
+  TEST_CHECK(ensureCapacity(3, &fh));
+  for (i = 0; i < 3; i++) {
+    memset(ph, 'k' + i, fh.pageSize);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  TEST_CHECK(closePageFile(&fh));
+
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_EQUALS_INT(16384, fh.pageSize, "page size should be read back from the file");
+  ASSERT_EQUALS_INT(3, fh.totalNumPages, "reopened file should have 3 pages");
+  for (i = 0; i < 3; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    for (j = 0; j < fh.pageSize; j++)
+      ASSERT_TRUE(ph[j] == 'k' + i, "whole 16 KiB page should round trip");
+  }
+  ASSERT_TRUE(readBlock(3, &fh, ph) == RC_READ_NON_EXISTING_PAGE, "reading past the end should fail");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  // A default file whose first page looks like a 16 KiB header keeps its layout
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_EQUALS_INT(PAGE_SIZE, fh.pageSize, "default files should use PAGE_SIZE");
+  ASSERT_EQUALS_INT(1, fh.totalNumPages, "default file should have one page");
+  memset(ph, 0, PAGE_SIZE);
+  memcpy(ph, "SMPAGESZ", 8);
+  i = 16384;
+  memcpy(ph + 8, &i, sizeof(int));
+  i = ~16384;
+  memcpy(ph + 12, &i, sizeof(int));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_TRUE(fh.pageSize == PAGE_SIZE && fh.totalNumPages == 2, "page data should not be taken for a header");
+  memset(ph, 0, PAGE_SIZE);
+  TEST_CHECK(readBlock(0, &fh, ph));
+  ASSERT_TRUE(memcmp(ph, "SMPAGESZ", 8) == 0, "first page should keep its data");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  // Files written before the header existed are plain arrays of PAGE_SIZE pages
+  raw = fopen(TESTPF, "wb");
+  memset(ph, 'h', PAGE_SIZE);
+  fwrite(ph, 1, PAGE_SIZE, raw);
+  fwrite(ph, 1, PAGE_SIZE, raw);
+  fclose(raw);
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_TRUE(fh.pageSize == PAGE_SIZE && fh.totalNumPages == 2, "headerless file should keep its layout");
+  TEST_CHECK(readBlock(1, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'h' && ph[PAGE_SIZE - 1] == 'h', "headerless pages should read back");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  // 2 KiB pages in memory
+  TEST_CHECK(createPageFileWithPageSize("mem:small", 2048));
+  TEST_CHECK(openPageFile("mem:small", &fh));
+  ASSERT_EQUALS_INT(2048, fh.pageSize, "memory file should carry its page size");
+  TEST_CHECK(appendEmptyBlock(&fh));
+  memset(ph, 's', 2048);
+  TEST_CHECK(writeBlock(1, &fh, ph));
+  memset(ph, 0, MAX_PAGE_SIZE);
+  TEST_CHECK(readBlock(1, &fh, ph));
+  ASSERT_TRUE(ph[2047] == 's' && ph[2048] == 0, "only 2 KiB should be read");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("mem:small"));
+
+  // The specialized kernels agree with each other
+  memset(ph, 0, MAX_PAGE_SIZE);
+  ASSERT_TRUE(pageIsZero(ph, 4096) && pageIsZero(ph, 16384), "zeroed pages should be detected");
+  ASSERT_TRUE(pageChecksum(ph, 4096) != pageChecksum(ph, 8192), "checksum should depend on the page size");
+  ph[4095] = 1;
+  ASSERT_TRUE(!pageIsZero(ph, 4096), "last byte should be checked");
+  ASSERT_TRUE(pageChecksum(ph, 4096) != pageChecksum4096(ph + 4096), "checksum should change with the content");
+
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Try to test the log-structured backend: out-of-place writes, GC and recovery */
+void testLogStructuredStore(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  LogStoreStats stats;
+  int i, j, freed;
+  RC rc;
+
+  testName = "test Log Structured Store";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  ASSERT_TRUE(findStorageBackend("log:test_log.bin") == &logStoreBackend, "log: prefix should select the log store");
+
+  TEST_CHECK(createPageFile("log:test_log.bin"));
+  TEST_CHECK(openPageFile("log:test_log.bin", &fh));
+  ASSERT_EQUALS_INT(1, fh.totalNumPages, "new log file should have one page");
+  TEST_CHECK(readFirstBlock(&fh, ph));
+  ASSERT_TRUE(pageIsZero(ph, PAGE_SIZE), "unwritten page should read as zeros");
+
+  // Overwrite 8 pages many times; every version goes to the log tail
+  TEST_CHECK(ensureCapacity(8, &fh));
+  for (i = 0; i < 2 * LOG_SEGMENT_SLOTS; i++) {
+    memset(ph, 'a' + i % 26, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i % 8, &fh, ph));
+  }
+  TEST_CHECK(getLogStoreStats(&fh, &stats));
+  ASSERT_EQUALS_INT(2, stats.numSegments, "two segments should be filled");
+  ASSERT_EQUALS_INT(0, stats.freeSegments, "an emptied segment should wait for a checkpoint");
+  TEST_CHECK(logStoreCheckpoint(&fh));
+  TEST_CHECK(getLogStoreStats(&fh, &stats));
+  ASSERT_EQUALS_INT(1, stats.freeSegments, "the checkpoint should free the emptied segment");
+  for (; i < 8 * LOG_SEGMENT_SLOTS; i++) {
+    memset(ph, 'a' + i % 26, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i % 8, &fh, ph));
+    if (i % LOG_SEGMENT_SLOTS == LOG_SEGMENT_SLOTS - 1)
+      TEST_CHECK(logStoreCheckpoint(&fh));
+  }
+  TEST_CHECK(getLogStoreStats(&fh, &stats));
+  ASSERT_EQUALS_INT(8, stats.livePages, "only the newest versions should be live");
+  ASSERT_EQUALS_INT(8 * LOG_SEGMENT_SLOTS, (int) stats.pageWrites, "every write should append a version");
+  ASSERT_TRUE(stats.numSegments <= 3, "segments with only old versions should be reused");
+
+  // Leave page 0 alone in the second segment, then collect it
+  for (i = 1; i < 8; i++) {
+    memset(ph, 'A' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  TEST_CHECK(logStoreCollectGarbage(&fh, 0.25, &freed));
+  ASSERT_TRUE(freed >= 1, "sparse segment should be collected");
+  TEST_CHECK(getLogStoreStats(&fh, &stats));
+  ASSERT_TRUE(stats.pagesRelocated >= 1, "live page should have been relocated");
+  ASSERT_EQUALS_INT(8, stats.livePages, "collection should not change the live pages");
+  TEST_CHECK(readBlock(0, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'a' + (8 * LOG_SEGMENT_SLOTS - 8) % 26, "relocated page should keep its content");
+
+  // The background collector runs and stops with the file
+  TEST_CHECK(logStoreStartGc(&fh, 1, 0.5));
+  do {
+    TEST_CHECK(getLogStoreStats(&fh, &stats));
+  } while (stats.gcRuns < 2);
+  TEST_CHECK(logStoreStopGc(&fh));
+  TEST_CHECK(closePageFile(&fh));
+
+  // Reopen from the checkpoint
+  TEST_CHECK(openPageFile("log:test_log.bin", &fh));
+  ASSERT_EQUALS_INT(8, fh.totalNumPages, "page count should come from the checkpoint");
+  for (i = 1; i < 8; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    for (j = 0; j < PAGE_SIZE; j++)
+      ASSERT_TRUE(ph[j] == 'A' + i, "page should survive a clean reopen");
+  }
+
+  // Writes after the last checkpoint are replayed from the log after a crash
+  memset(ph, 'z', PAGE_SIZE);
+  TEST_CHECK(writeBlock(3, &fh, ph));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  TEST_CHECK(writeBlock(8, &fh, ph));
+  TEST_CHECK(ensureCapacity(11, &fh));
+  TEST_CHECK(copyPageFile("test_log.bin", "test_log_crash.bin"));
+  TEST_CHECK(copyPageFile("test_log.bin" LOG_CHECKPOINT_SUFFIX, "test_log_crash.bin" LOG_CHECKPOINT_SUFFIX));
+  TEST_CHECK(closePageFile(&fh));
+
+  TEST_CHECK(openPageFile("log:test_log_crash.bin", &fh));
+  ASSERT_EQUALS_INT(11, fh.totalNumPages, "appended pages should be recovered, also those never written");
+  TEST_CHECK(readBlock(10, &fh, ph));
+  ASSERT_TRUE(pageIsZero(ph, PAGE_SIZE), "recovered unwritten page should read as zeros");
+  TEST_CHECK(readBlock(3, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'z' && ph[PAGE_SIZE - 1] == 'z', "newest version should be recovered");
+  TEST_CHECK(readBlock(8, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'z', "page written after the checkpoint should be recovered");
+  TEST_CHECK(readBlock(4, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'A' + 4, "untouched page should come from the checkpoint");
+  TEST_CHECK(closePageFile(&fh));
+
+  // A checkpoint pointing into segments that were reused after it is refused
+  TEST_CHECK(openPageFile("log:test_log.bin", &fh));
+  ASSERT_EQUALS_INT(11, fh.totalNumPages, "clean reopen should keep the appended pages");
+  TEST_CHECK(copyPageFile("test_log.bin" LOG_CHECKPOINT_SUFFIX, "test_log_stale.bin" LOG_CHECKPOINT_SUFFIX));
+  for (i = 0; i < 4 * LOG_SEGMENT_SLOTS; i++) {
+    memset(ph, 'k' + i % 13, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i % 9, &fh, ph));
+    if (i % LOG_SEGMENT_SLOTS == LOG_SEGMENT_SLOTS - 1)
+      TEST_CHECK(logStoreCheckpoint(&fh));
+  }
+  TEST_CHECK(copyPageFile("test_log.bin", "test_log_stale.bin"));
+  TEST_CHECK(closePageFile(&fh));
+  rc = openPageFile("log:test_log_stale.bin", &fh);
+  ASSERT_EQUALS_INT(RC_PAGE_CORRUPT, rc, "stale checkpoint should be detected");
+  TEST_CHECK(destroyPageFile("log:test_log_stale.bin"));
+
+  TEST_CHECK(destroyPageFile("log:test_log_crash.bin"));
+  TEST_CHECK(destroyPageFile("log:test_log.bin"));
+  ASSERT_TRUE(access("test_log.bin" LOG_CHECKPOINT_SUFFIX, F_OK) != 0, "checkpoint should be destroyed with the file");
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Try to test skipping identical writes and sector-granular range writes */
+void testRedundantWriteSkipping(void)
+{
+  SM_FileHandle fh, fh2;
+  SM_PageHandle ph;
+  SM_WriteStats stats;
+  int i;
+
+  testName = "test Redundant Write Skipping";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(2, &fh));
+
+  // Deduplication is off until it is asked for
+  memset(ph, 'r', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(2, (int) stats.pagesWritten, "without deduplication every write should reach the file");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(setWriteDedup(&fh, 1));
+
+  // Rewriting the same content only reaches the file once
+  for (i = 0; i < 3; i++)
+    TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(writeCurrentBlock(&fh, ph));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(1, (int) stats.pagesWritten, "only the first write should reach the file");
+  ASSERT_EQUALS_INT(3, (int) stats.pagesSkipped, "identical rewrites should be skipped");
+
+  // A changed page is written again
+  ph[100] = 'x';
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(2, (int) stats.pagesWritten, "changed page should be written");
+
+  // Range writes cover only the changed sectors
+  memset(ph, 0, PAGE_SIZE);
+  TEST_CHECK(readBlock(1, &fh, ph));
+  memcpy(ph + 1020, "range", 5);
+  TEST_CHECK(writeBlockRange(1, &fh, ph, 1020, 5));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(1, (int) stats.rangeWrites, "range write should be counted");
+  ASSERT_TRUE(stats.bytesWritten == 2 * PAGE_SIZE + 2 * SECTOR_SIZE, "range across a sector boundary should write two sectors");
+  TEST_CHECK(writeBlockRange(1, &fh, ph, 1020, 5));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(4, (int) stats.pagesSkipped, "unchanged range write should be skipped");
+  ASSERT_ERROR(writeBlockRange(1, &fh, ph, PAGE_SIZE - 2, 5), "range past the page end should fail");
+  ASSERT_ERROR(writeBlockRange(2, &fh, ph, 0, 5), "range in a missing page should fail");
+
+  // Another independent handle sees the content, and a write it made in between is not
+  // mistaken for the content the first handle remembers
+  TEST_CHECK(openPageFile(TESTPF, &fh2));
+  TEST_CHECK(setWriteDedup(&fh2, 1));
+  TEST_CHECK(readBlock(1, &fh2, ph));
+  ASSERT_TRUE(memcmp(ph + 1020, "range", 5) == 0 && ph[1019] == 0 && ph[1025] == 0, "range should land in place");
+  TEST_CHECK(readBlock(0, &fh2, ph));
+  ASSERT_TRUE(ph[0] == 'r' && ph[100] == 'x', "deduplicated page should be on disk");
+  memset(ph, 'o', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh2, ph));
+  memset(ph, 'r', PAGE_SIZE);
+  ph[100] = 'x';
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(3, (int) stats.pagesWritten, "write over another handle's page should not be skipped");
+  TEST_CHECK(readBlock(0, &fh2, ph));
+  ASSERT_TRUE(ph[0] == 'r' && ph[100] == 'x', "last write should win across handles");
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(5, (int) stats.pagesSkipped, "rewrite of the stored page should still be skipped");
+  TEST_CHECK(setWriteDedup(&fh, 0));
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(getWriteStats(&fh, &stats));
+  ASSERT_EQUALS_INT(4, (int) stats.pagesWritten, "write without deduplication should always reach the file");
+  TEST_CHECK(closePageFile(&fh2));
+  TEST_CHECK(closePageFile(&fh));
+
+  // Memory files support range writes too
+  TEST_CHECK(createPageFile("mem:range"));
+  TEST_CHECK(openPageFile("mem:range", &fh));
+  memset(ph, 0, PAGE_SIZE);
+  ph[PAGE_SIZE - 1] = 'e';
+  TEST_CHECK(writeBlockRange(0, &fh, ph, PAGE_SIZE - 1, 1));
+  memset(ph, 0, PAGE_SIZE);
+  TEST_CHECK(readBlock(0, &fh, ph));
+  ASSERT_TRUE(ph[PAGE_SIZE - 1] == 'e', "memory range write should land in place");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("mem:range"));
+
+  TEST_CHECK(destroyPageFile(TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Try to test incremental backups built from changed-page tracking */
+void testIncrementalBackup(void)
+{
+  SM_FileHandle fh, backup;
+  SM_PageHandle ph, ph2;
+  FILE *delta;
+  int i, epoch, epoch2, epoch3;
+
+  testName = "test Incremental Backup";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  ph2 = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_ERROR(exportChangedPages(&fh, 0, "test_delta0.bin", &epoch), "export without tracking should fail");
+  TEST_CHECK(ensureCapacity(4, &fh));
+  for (i = 0; i < 4; i++) {
+    memset(ph, 'b' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+
+  // The first export after enabling tracking is a full backup
+  TEST_CHECK(enableChangeTracking(&fh));
+  TEST_CHECK(exportChangedPages(&fh, 0, "test_delta0.bin", &epoch));
+  ASSERT_EQUALS_INT(1, epoch, "first backup should cover epoch 1");
+
+  // Only the changed and appended pages go into the next delta
+  memset(ph, 'X', PAGE_SIZE);
+  TEST_CHECK(writeBlock(2, &fh, ph));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  TEST_CHECK(writeBlock(4, &fh, ph));
+  TEST_CHECK(exportChangedPages(&fh, epoch, "test_delta1.bin", &epoch2));
+  ASSERT_EQUALS_INT(2, epoch2, "second backup should cover epoch 2");
+  ASSERT_ERROR(exportChangedPages(&fh, 7, "test_delta2.bin", &epoch3), "unknown epoch should be rejected");
+  TEST_CHECK(closePageFile(&fh));
+
+  // Tracking survives reopening the file
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  memset(ph, 'Y', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(exportChangedPages(&fh, epoch2, "test_delta2.bin", &epoch3));
+  ASSERT_EQUALS_INT(3, epoch3, "third backup should cover epoch 3");
+  TEST_CHECK(closePageFile(&fh));
+
+  // The deltas are small and rebuild the file when applied in order
+  delta = fopen("test_delta1.bin", "rb");
+  fseek(delta, 0, SEEK_END);
+  ASSERT_TRUE(ftell(delta) < 3 * PAGE_SIZE, "incremental delta should hold two pages");
+  fclose(delta);
+  delta = fopen("test_delta2.bin", "rb");
+  fseek(delta, 0, SEEK_END);
+  ASSERT_TRUE(ftell(delta) < 2 * PAGE_SIZE, "incremental delta should hold one page");
+  fclose(delta);
+  TEST_CHECK(createPageFile("test_backup.bin"));
+  TEST_CHECK(openPageFile("test_backup.bin", &backup));
+  TEST_CHECK(applyPageDelta("test_delta0.bin", &backup));
+  TEST_CHECK(applyPageDelta("test_delta1.bin", &backup));
+  TEST_CHECK(applyPageDelta("test_delta2.bin", &backup));
+  ASSERT_EQUALS_INT(5, backup.totalNumPages, "backup should have all pages");
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  for (i = 0; i < 5; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    TEST_CHECK(readBlock(i, &backup, ph2));
+    ASSERT_TRUE(memcmp(ph, ph2, PAGE_SIZE) == 0, "restored page should match the source");
+  }
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(closePageFile(&backup));
+
+  TEST_CHECK(destroyPageFile("test_backup.bin"));
+  TEST_CHECK(destroyPageFile(TESTPF));
+  ASSERT_TRUE(access(TESTPF CHANGE_MAP_SUFFIX, F_OK) != 0, "change map should be destroyed with the file");
+  unlink("test_delta0.bin");
+  unlink("test_delta1.bin");
+  unlink("test_delta2.bin");
+  free(ph);
+  free(ph2);
+
+  TEST_DONE();
+}
+
+/* counts the problems the scrubber reports */
+static int scrubProblems[4];
+
+static void countScrubProblem(char *fileName, int pageNum, SM_ScrubProblem problem, void *arg)
+{
+  (void) fileName;
+  (void) pageNum;
+  (void) arg;
+  scrubProblems[problem]++;
+}
+
+/* rejects pages filled with 'B' */
+static int rejectPageB(int pageNum, const char *page, int pageSize, void *arg)
+{
+  (void) pageNum;
+  (void) pageSize;
+  (void) arg;
+  return page[0] != 'B';
+}
+
+/* Try to test the integrity scrubber: verifiers, torn tails, checksums and rate limiting */
+void testIntegrityScrubber(void)
+{
+  SM_FileHandle fh, other;
+  SM_PageHandle ph;
+  SM_Catalog *catalog;
+  SM_ScrubOptions options;
+  SM_ScrubStats stats;
+  FILE *raw;
+  int i;
+
+  testName = "test Integrity Scrubber";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  memset(&options, 0, sizeof(options));
+  options.onCorrupt = countScrubProblem;
+  options.verify = rejectPageB;
+  options.chunkPages = 4;
+
+  // A full pass reads every page and reports the ones the verifier rejects
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(64, &fh));
+  for (i = 0; i < 64; i++) {
+    memset(ph, i % 10 == 3 ? 'B' : 'A', PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  memset(scrubProblems, 0, sizeof(scrubProblems));
+  TEST_CHECK(scrubPageFile(&fh, &options, &stats));
+  ASSERT_EQUALS_INT(64, (int) stats.pagesScanned, "every page should be scanned");
+  ASSERT_EQUALS_INT(7, (int) stats.corruptPages, "rejected pages should be counted");
+  ASSERT_EQUALS_INT(7, scrubProblems[SCRUB_INVALID_PAGE], "rejected pages should be reported");
+
+  // The rate limit stretches the pass: 256 KiB at 1 MB/s take at least a quarter second
+  options.verify = NULL;
+  options.maxMBps = 1;
+  TEST_CHECK(scrubPageFile(&fh, &options, &stats));
+  ASSERT_TRUE(stats.elapsedSec >= 0.2, "rate limit should slow the pass down");
+  ASSERT_EQUALS_INT(0, (int) stats.corruptPages, "healthy file should pass");
+
+  // A huge chunk size is clamped instead of sizing buffers after it
+  options.maxMBps = 0;
+  options.chunkPages = 1 << 30;
+  TEST_CHECK(scrubPageFile(&fh, &options, &stats));
+  ASSERT_EQUALS_INT(64, (int) stats.pagesScanned, "clamped chunks should still scan every page");
+  options.chunkPages = 4;
+
+  // A partial page at the end of the file is reported
+  raw = fopen(TESTPF, "ab");
+  fwrite("torn", 1, 4, raw);
+  fclose(raw);
+  options.maxMBps = 0;
+  TEST_CHECK(scrubPageFile(&fh, &options, &stats));
+  ASSERT_EQUALS_INT(1, scrubProblems[SCRUB_TORN_TAIL], "torn tail should be reported");
+
+  // The background scrubber runs until it is stopped
+  options.maxPasses = 0;
+  options.passIntervalMs = 1;
+  TEST_CHECK(startScrubber(&fh, &options));
+  ASSERT_ERROR(startScrubber(&fh, &options), "second scrubber should be rejected");
+  do {
+    TEST_CHECK(getScrubStats(&fh, &stats));
+  } while (stats.passes < 2);
+  TEST_CHECK(readBlock(0, &fh, ph));
+  TEST_CHECK(stopScrubber(&fh));
+  TEST_CHECK(getScrubStats(&fh, &stats));
+  ASSERT_TRUE(stats.pagesScanned >= 128, "background scrubber should have scanned the file twice");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  // Log-structured files keep checksums, so silent corruption is found
+  TEST_CHECK(createPageFile("log:test_scrub.bin"));
+  TEST_CHECK(openPageFile("log:test_scrub.bin", &fh));
+  memset(ph, 'L', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  raw = fopen("test_scrub.bin", "r+b");
+  fseek(raw, LOG_SUPERBLOCK_SIZE + LOG_SLOT_HEADER_SIZE + 100, SEEK_SET);
+  fputc('!', raw);
+  fclose(raw);
+  memset(scrubProblems, 0, sizeof(scrubProblems));
+  options.maxPasses = 1;
+  TEST_CHECK(startScrubber(&fh, &options));
+  // closing the file stops the scrubber
+  do {
+    TEST_CHECK(getScrubStats(&fh, &stats));
+  } while (stats.passes < 1);
+  ASSERT_EQUALS_INT(1, scrubProblems[SCRUB_BAD_CHECKSUM], "checksum mismatch should be reported");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("log:test_scrub.bin"));
+
+  // Pages appended through another handle sharing the file are scrubbed too
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openCatalog("test_scrub.manifest", &catalog));
+  TEST_CHECK(catalogOpenFile(catalog, TESTPF, &fh));
+  TEST_CHECK(openPageFile(TESTPF, &other));
+  TEST_CHECK(ensureCapacity(12, &other));
+  TEST_CHECK(scrubPageFile(&fh, &options, &stats));
+  ASSERT_EQUALS_INT(12, (int) stats.pagesScanned, "pages appended through the other handle should be scanned");
+  TEST_CHECK(closePageFile(&other));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(closeCatalog(catalog));
+  unlink("test_scrub.manifest");
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Try to test a page cache shared by two processes */
+void testSharedBufferPool(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_SharedPool *pool;
+  SM_SharedPoolStats stats;
+  SM_WriteStats writes;
+  SM_PageHandle run;
+  pid_t child;
+  char name[32];
+  int i, status;
+
+  testName = "test Shared Buffer Pool";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  destroySharedPool("/sm_test_pool");
+
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(8, &fh));
+  TEST_CHECK(openSharedPool("/sm_test_pool", 4, PAGE_SIZE, &pool));
+  TEST_CHECK(attachSharedPool(&fh, pool));
+
+  // A write stays in the pool until the file is synced
+  memset(ph, 'p', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(getSharedPoolStats(pool, &stats));
+  ASSERT_EQUALS_INT(1, stats.dirtyFrames, "write should dirty one frame");
+
+  // Another process sees the write through the pool and writes a page of its own
+  child = fork();
+  if (child == 0) {
+    SM_FileHandle childFh;
+    SM_SharedPool *childPool;
+    int ok = openPageFile(TESTPF, &childFh) == RC_OK
+      && openSharedPool("/sm_test_pool", 0, PAGE_SIZE, &childPool) == RC_OK
+      && attachSharedPool(&childFh, childPool) == RC_OK
+      && readBlock(0, &childFh, ph) == RC_OK && ph[0] == 'p';
+    memset(ph, 'c', PAGE_SIZE);
+    ok = ok && writeBlock(1, &childFh, ph) == RC_OK;
+    // exit without closing: the page only exists in the pool
+    _exit(ok ? 0 : 1);
+  }
+  ASSERT_TRUE(child > 0 && waitpid(child, &status, 0) == child, "child process should run");
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0, "child should read the pooled page");
+  TEST_CHECK(readBlock(1, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'c' && ph[PAGE_SIZE - 1] == 'c', "child's write should be visible through the pool");
+  TEST_CHECK(getSharedPoolStats(pool, &stats));
+  ASSERT_TRUE(stats.hits >= 2, "both reads should hit the pool");
+  ASSERT_EQUALS_INT(2, stats.dirtyFrames, "both pages should still be dirty");
+
+  // Reading more pages than frames evicts and writes back dirty pages
+  for (i = 2; i < 8; i++)
+    TEST_CHECK(readBlock(i, &fh, ph));
+  TEST_CHECK(getSharedPoolStats(pool, &stats));
+  ASSERT_TRUE(stats.evictions >= 4 && stats.writeBacks >= 2, "dirty victims should be written back");
+  ASSERT_EQUALS_INT(4, stats.framesInUse, "pool should stay at its size");
+
+  // Pooled multi-page writes go page by page, but deduplication never skips their pages
+  run = (SM_PageHandle) malloc(2 * PAGE_SIZE);
+  memset(run, 'w', 2 * PAGE_SIZE);
+  TEST_CHECK(setWriteDedup(&fh, 1));
+  TEST_CHECK(writeBlocks(6, 2, &fh, run));
+  TEST_CHECK(writeBlocks(6, 2, &fh, run));
+  TEST_CHECK(getWriteStats(&fh, &writes));
+  ASSERT_TRUE(writes.pagesSkipped == 0 && writes.pagesWritten >= 4, "pooled runs should be written whole");
+  TEST_CHECK(setWriteDedup(&fh, 0));
+  free(run);
+
+  memset(ph, 'q', PAGE_SIZE);
+  TEST_CHECK(writeBlock(5, &fh, ph));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(getSharedPoolStats(pool, &stats));
+  ASSERT_EQUALS_INT(0, stats.dirtyFrames, "closing should flush the file's frames");
+
+  // The entries of closed files are reused, so a pool serves more files than its table holds
+  for (i = 0; i < SHARED_POOL_MAX_FILES + 8; i++) {
+    sprintf(name, "test_pool_%d.bin", i);
+    TEST_CHECK(createPageFile(name));
+    TEST_CHECK(openPageFile(name, &fh));
+    TEST_CHECK(attachSharedPool(&fh, pool));
+    memset(ph, 'a' + i % 26, PAGE_SIZE);
+    TEST_CHECK(writeBlock(0, &fh, ph));
+    TEST_CHECK(closePageFile(&fh));
+  }
+  for (i = 0; i < SHARED_POOL_MAX_FILES + 8; i++) {
+    sprintf(name, "test_pool_%d.bin", i);
+    TEST_CHECK(openPageFile(name, &fh));
+    TEST_CHECK(readBlock(0, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'a' + i % 26, "page written through a reused entry should reach its own file");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(destroyPageFile(name));
+  }
+
+  // Frames of a destroyed file never reach a file created later under its name
+  TEST_CHECK(createPageFile("test_pool_gone.bin"));
+  TEST_CHECK(openPageFile("test_pool_gone.bin", &fh));
+  TEST_CHECK(attachSharedPool(&fh, pool));
+  memset(ph, 'd', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(destroyPageFile("test_pool_gone.bin"));
+  TEST_CHECK(createPageFile("test_pool_gone.bin"));
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(openPageFile("test_pool_gone.bin", &fh));
+  TEST_CHECK(readBlock(0, &fh, ph));
+  ASSERT_TRUE(pageIsZero(ph, PAGE_SIZE), "recreated file should not get the old file's frames");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("test_pool_gone.bin"));
+
+  TEST_CHECK(closeSharedPool(pool));
+  TEST_CHECK(destroySharedPool("/sm_test_pool"));
+
+  // Without the pool every page is on disk
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(readBlock(0, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'p', "pooled write should reach the file");
+  TEST_CHECK(readBlock(1, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'c', "other process's pooled write should reach the file");
+  TEST_CHECK(readBlock(5, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'q', "write flushed on close should reach the file");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Try to test that pages of one object are allocated from its own extents */
+void testExtentAllocation(void)
+{
+  SM_FileHandle fh;
+  SM_ExtentMap *map;
+  SM_ExtentStats stats;
+  int pagesA[12], pagesB[4];
+  int extents[4], numExtents, pageNum, i;
+  SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  testName = "test Extent Allocation";
+
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(openExtentMap(&fh, 8, &map));
+
+  // Interleaved allocations of two objects still end up in separate extents
+  for (i = 0; i < 12; i++) {
+    TEST_CHECK(allocateObjectPage(map, 1, &pagesA[i]));
+    if (i < 4)
+      TEST_CHECK(allocateObjectPage(map, 2, &pagesB[i]));
+  }
+  for (i = 1; i < 12; i++)
+    ASSERT_TRUE(pagesA[i] / 8 == pagesA[0] / 8 || pagesA[i] / 8 == pagesA[8] / 8, "object 1 should use two extents");
+  for (i = 1; i < 4; i++)
+    ASSERT_EQUALS_INT(pagesB[0] + i, pagesB[i], "object 2 pages should be contiguous");
+  ASSERT_TRUE(pagesB[0] / 8 != pagesA[0] / 8 && pagesB[0] / 8 != pagesA[8] / 8, "objects should not share extents");
+  TEST_CHECK(getObjectExtents(map, 1, extents, 4, &numExtents));
+  ASSERT_EQUALS_INT(2, numExtents, "object 1 should own two extents");
+  ASSERT_EQUALS_INT(24, fh.totalNumPages, "file should grow by whole extents");
+
+  // A released object's extent is claimed by the next object that needs one
+  TEST_CHECK(releaseObject(map, 2));
+  TEST_CHECK(getExtentStats(map, &stats));
+  ASSERT_EQUALS_INT(1, stats.freeExtents, "released extent should be free");
+  ASSERT_EQUALS_INT(12, stats.usedPages, "only object 1 pages should be used");
+  TEST_CHECK(allocateObjectPage(map, 3, &pageNum));
+  ASSERT_EQUALS_INT(pagesB[0], pageNum, "free extent should be reused");
+  ASSERT_EQUALS_INT(24, fh.totalNumPages, "reusing an extent should not grow the file");
+
+  // Releasing single pages frees the extent once it is empty
+  TEST_CHECK(releaseObjectPage(map, pageNum));
+  ASSERT_ERROR(releaseObjectPage(map, pageNum), "page should not be released twice");
+  TEST_CHECK(getExtentStats(map, &stats));
+  ASSERT_EQUALS_INT(1, stats.freeExtents, "empty extent should be free again");
+
+  // The map is saved next to the file and survives reopening
+  TEST_CHECK(closeExtentMap(map));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  ASSERT_ERROR(openExtentMap(&fh, 16, &map), "another extent size should be rejected");
+  TEST_CHECK(openExtentMap(&fh, 8, &map));
+  TEST_CHECK(getExtentStats(map, &stats));
+  ASSERT_EQUALS_INT(3, stats.numExtents, "extents should be reloaded");
+  ASSERT_EQUALS_INT(12, stats.usedPages, "used pages should be reloaded");
+  TEST_CHECK(allocateObjectPage(map, 1, &pageNum));
+  ASSERT_EQUALS_INT(pagesA[8] / 8, pageNum / 8, "object 1 should continue in its own extent");
+  TEST_CHECK(closeExtentMap(map));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+  ASSERT_TRUE(access(TESTPF EXTENT_MAP_SUFFIX, F_OK) != 0, "destroying the file should remove its extent map");
+
+  // A file that already holds data gets no new map, which would hand its pages out again
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(3, &fh));
+  ASSERT_ERROR(openExtentMap(&fh, 8, &map), "a file with pages should be refused");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  memset(page, 'x', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, page));
+  ASSERT_ERROR(openExtentMap(&fh, 8, &map), "a file whose page holds data should be refused");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+  ASSERT_TRUE(access(TESTPF EXTENT_MAP_SUFFIX, F_OK) != 0, "a refused map should not be saved");
+  free(page);
+
+  TEST_DONE();
+}
+
+/* pages reported by the compaction callback */
+static int compactedPages;
+
+static int isTestPageLive(int pageNum, void *arg)
+{
+  (void) arg;
+  return pageNum == 5 || pageNum == 9;
+}
+
+static void countMovedPage(int oldPageNum, int newPageNum, void *arg)
+{
+  (void) arg;
+  if (newPageNum < oldPageNum)
+    compactedPages++;
+}
+
+/* Try to test moving live pages to the front of a file in bounded steps */
+void testOnlineCompaction(void)
+{
+  SM_FileHandle fh, copy;
+  SM_PageHandle ph;
+  SM_CompactStats stats;
+  SM_ColdTierStats tierStats;
+  int remap[16];
+  FILE *raw;
+  long size;
+  int i, epoch;
+
+  testName = "test Online Compaction";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  // Even pages hold data, odd pages were never written
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(16, &fh));
+  for (i = 0; i < 16; i += 2) {
+    memset(ph, 'A' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  compactedPages = 0;
+  TEST_CHECK(startCompaction(&fh, NULL, countMovedPage, NULL));
+  ASSERT_ERROR(startCompaction(&fh, NULL, NULL, NULL), "second compaction should be rejected");
+
+  // Between steps the old page numbers still read the right pages and writes fail
+  TEST_CHECK(compactStep(&fh, 3, &stats));
+  ASSERT_EQUALS_INT(8, stats.livePages, "zero pages should be free");
+  ASSERT_EQUALS_INT(7, stats.pagesToMove, "every live page but the first should move");
+  ASSERT_EQUALS_INT(3, stats.pagesMoved, "a step should stay within its budget");
+  ASSERT_TRUE(!stats.done, "compaction should not be done after one step");
+  for (i = 0; i < 16; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    ASSERT_TRUE(ph[0] == (i % 2 == 0 ? 'A' + i : 0) && ph[PAGE_SIZE - 1] == ph[0], "old page numbers should read the old content");
+  }
+  ASSERT_ERROR(writeBlock(0, &fh, ph), "writes should wait for the compaction");
+  ASSERT_ERROR(appendEmptyBlock(&fh), "the file should not grow during compaction");
+  do {
+    TEST_CHECK(compactStep(&fh, 2, &stats));
+  } while (!stats.done);
+  ASSERT_EQUALS_INT(7, compactedPages, "every moved page should be reported");
+
+  // Afterwards the live pages are at the front and the tail is gone
+  ASSERT_EQUALS_INT(8, fh.totalNumPages, "file should shrink to its live pages");
+  for (i = 0; i < 8; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'A' + 2 * i, "live pages should keep their order");
+  }
+  TEST_CHECK(getCompactionRemap(&fh, remap, 16));
+  ASSERT_EQUALS_INT(2, remap[4], "remap should hold the new page number");
+  ASSERT_EQUALS_INT(PAGE_NOT_LIVE, remap[3], "remap should mark free pages");
+  raw = fopen(TESTPF, "rb");
+  fseek(raw, 0, SEEK_END);
+  size = ftell(raw);
+  fclose(raw);
+  ASSERT_EQUALS_INT(PAGE_FILE_HEADER_SIZE + 8 * PAGE_SIZE, (int) size, "file on disk should be truncated");
+  memset(ph, 'z', PAGE_SIZE);
+  TEST_CHECK(writeBlock(7, &fh, ph));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+
+  // Backups see the file shrink, and a finished compaction no longer bypasses the cold tier
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(16, &fh));
+  for (i = 0; i < 16; i += 2) {
+    memset(ph, 'A' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  TEST_CHECK(enableChangeTracking(&fh));
+  TEST_CHECK(exportChangedPages(&fh, 0, "test_compact_full.bin", &epoch));
+  TEST_CHECK(enableColdTier(&fh, 0));
+  TEST_CHECK(compactPageFile(&fh, NULL, NULL, NULL, &stats));
+  TEST_CHECK(exportChangedPages(&fh, epoch, "test_compact_delta.bin", &epoch));
+  memset(ph, 'q', PAGE_SIZE);
+  TEST_CHECK(writeBlock(5, &fh, ph));
+  TEST_CHECK(readBlock(5, &fh, ph));
+  TEST_CHECK(getColdTierStats(&fh, &tierStats));
+  ASSERT_TRUE(tierStats.pages == 1 && tierStats.hits == 1, "reads after the compaction should use the cold tier");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile(TESTPF));
+  TEST_CHECK(createPageFile("test_compact_copy.bin"));
+  TEST_CHECK(openPageFile("test_compact_copy.bin", &copy));
+  TEST_CHECK(applyPageDelta("test_compact_full.bin", &copy));
+  ASSERT_EQUALS_INT(16, copy.totalNumPages, "full backup should restore every page");
+  TEST_CHECK(applyPageDelta("test_compact_delta.bin", &copy));
+  ASSERT_EQUALS_INT(8, copy.totalNumPages, "delta should shrink the copy with the file");
+  for (i = 0; i < 8; i++) {
+    TEST_CHECK(readBlock(i, &copy, ph));
+    ASSERT_TRUE(ph[0] == 'A' + 2 * i, "copy should hold the compacted pages");
+  }
+  TEST_CHECK(closePageFile(&copy));
+  TEST_CHECK(destroyPageFile("test_compact_copy.bin"));
+  remove("test_compact_full.bin");
+  remove("test_compact_delta.bin");
+
+  // The caller can decide which pages are live; memory files shrink as well
+  TEST_CHECK(createPageFile("mem:compact"));
+  TEST_CHECK(openPageFile("mem:compact", &fh));
+  TEST_CHECK(ensureCapacity(12, &fh));
+  for (i = 0; i < 12; i++) {
+    memset(ph, 'a' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  TEST_CHECK(compactPageFile(&fh, isTestPageLive, NULL, NULL, &stats));
+  ASSERT_EQUALS_INT(2, fh.totalNumPages, "only the live pages should be kept");
+  TEST_CHECK(readBlock(1, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'a' + 9, "second live page should be at page 1");
+  ASSERT_ERROR(readBlock(2, &fh, ph), "pages after the live ones should be gone");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("mem:compact"));
+
+  // Log-structured files reclaim space with their garbage collector instead
+  TEST_CHECK(createPageFile("log:test_compact.bin"));
+  TEST_CHECK(openPageFile("log:test_compact.bin", &fh));
+  ASSERT_ERROR(compactPageFile(&fh, NULL, NULL, NULL, &stats), "log-structured files cannot be compacted");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("log:test_compact.bin"));
+
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Try to test inserting, finding, scanning and deleting keys of a B+-tree index */
+void testBtreeIndex(void)
+{
+  BTreeHandle *tree;
+  BT_ScanHandle *scan;
+  Value key, *keys;
+  RID rid, *rids;
+  int i, count, last, numNodes, numEntries;
+
+  testName = "test B+-tree Index";
+
+  key.dt = DT_INT;
+  ASSERT_TRUE(createBtree("test_btree.bin", DT_INT, 1000) == RC_IM_N_TO_LAGE, "nodes larger than a page should be rejected");
+  ASSERT_ERROR(createBtree("test_btree.bin", DT_STRING, 4), "only integer keys should be supported");
+  TEST_CHECK(createBtree("test_btree.bin", DT_INT, 4));
+  TEST_CHECK(openBtree(&tree, "test_btree.bin"));
+
+  // Keys inserted out of order split leaves and inner nodes
+  for (i = 0; i < 200; i++) {
+    key.v.intV = i * 37 % 200;
+    rid.page = key.v.intV;
+    rid.slot = key.v.intV % 7;
+    TEST_CHECK(insertKey(tree, &key, rid));
+  }
+  key.v.intV = 5;
+  ASSERT_TRUE(insertKey(tree, &key, rid) == RC_IM_KEY_ALREADY_EXISTS, "duplicate keys should be rejected");
+  TEST_CHECK(getNumEntries(tree, &numEntries));
+  ASSERT_EQUALS_INT(200, numEntries, "every key should be counted");
+  for (i = 0; i < 200; i++) {
+    key.v.intV = i;
+    TEST_CHECK(findKey(tree, &key, &rid));
+    ASSERT_TRUE(rid.page == i && rid.slot == i % 7, "key should lead to its record id");
+  }
+  key.v.intV = 200;
+  ASSERT_TRUE(findKey(tree, &key, &rid) == RC_IM_KEY_NOT_FOUND, "missing key should not be found");
+
+  // A range scan returns the keys between its bounds in order
+  {
+    Value low, high;
+    low.dt = high.dt = DT_INT;
+    low.v.intV = 50;
+    high.v.intV = 59;
+    TEST_CHECK(openTreeRangeScan(tree, &low, &high, &scan));
+    for (count = 0; nextEntry(scan, &rid) == RC_OK; count++)
+      ASSERT_EQUALS_INT(50 + count, rid.page, "range scan should return keys in order");
+    TEST_CHECK(closeTreeScan(scan));
+    ASSERT_EQUALS_INT(10, count, "range scan should stop at its upper bound");
+  }
+
+  // Deleting half of the keys merges nodes and keeps the rest reachable
+  TEST_CHECK(getNumNodes(tree, &numNodes));
+  for (i = 0; i < 200; i += 2) {
+    key.v.intV = i;
+    TEST_CHECK(deleteKey(tree, &key));
+  }
+  ASSERT_TRUE(deleteKey(tree, &key) == RC_IM_KEY_NOT_FOUND, "deleted key should be gone");
+  for (i = 0; i < 200; i++) {
+    key.v.intV = i;
+    ASSERT_TRUE((findKey(tree, &key, &rid) == RC_OK) == (i % 2 == 1), "only odd keys should be left");
+  }
+  TEST_CHECK(getNumNodes(tree, &count));
+  ASSERT_TRUE(count < numNodes, "merged nodes should be freed");
+  TEST_CHECK(openTreeScan(tree, &scan));
+  for (count = 0, last = -1; nextEntry(scan, &rid) == RC_OK; count++, last = rid.page)
+    ASSERT_TRUE(rid.page > last, "full scan should be ascending");
+  TEST_CHECK(closeTreeScan(scan));
+  ASSERT_EQUALS_INT(100, count, "full scan should see every remaining key");
+
+  // Deleting everything shrinks the tree back to a single leaf, also after reopening
+  for (i = 1; i < 200; i += 2) {
+    key.v.intV = i;
+    TEST_CHECK(deleteKey(tree, &key));
+  }
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(openBtree(&tree, "test_btree.bin"));
+  TEST_CHECK(getNumNodes(tree, &numNodes));
+  TEST_CHECK(getNumEntries(tree, &numEntries));
+  ASSERT_EQUALS_INT(1, numNodes, "empty tree should be one leaf");
+  ASSERT_EQUALS_INT(0, numEntries, "empty tree should have no keys");
+
+  // Bulk loading builds full levels bottom up; later inserts still split correctly
+  keys = (Value*) malloc(sizeof(Value) * 1000);
+  rids = (RID*) malloc(sizeof(RID) * 1000);
+  for (i = 0; i < 1000; i++) {
+    keys[i].dt = DT_INT;
+    keys[i].v.intV = 2 * i;
+    rids[i].page = 2 * i;
+    rids[i].slot = 0;
+  }
+  keys[1].v.intV = 0;
+  ASSERT_TRUE(bulkLoadBtree(tree, keys, rids, 1000) == RC_IM_KEY_ALREADY_EXISTS, "duplicate input should be rejected");
+  keys[1].v.intV = 2;
+  TEST_CHECK(bulkLoadBtree(tree, keys, rids, 1000));
+  ASSERT_ERROR(bulkLoadBtree(tree, keys, rids, 1000), "only an empty tree should be bulk loaded");
+  TEST_CHECK(getNumNodes(tree, &numNodes));
+  ASSERT_EQUALS_INT(250 + 50 + 10 + 2 + 1, numNodes, "leaves and inner nodes should be full");
+  for (i = 0; i < 1000; i++) {
+    key.v.intV = 2 * i + 1;
+    rid.page = 2 * i + 1;
+    TEST_CHECK(insertKey(tree, &key, rid));
+  }
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(openBtree(&tree, "test_btree.bin"));
+  for (i = 0; i < 2000; i++) {
+    key.v.intV = i;
+    TEST_CHECK(findKey(tree, &key, &rid));
+    ASSERT_EQUALS_INT(i, rid.page, "bulk loaded and inserted keys should be found");
+  }
+  TEST_CHECK(openTreeScan(tree, &scan));
+  for (count = 0; nextEntry(scan, &rid) == RC_OK; count++)
+    ASSERT_EQUALS_INT(count, rid.page, "scan should see every key in order");
+  TEST_CHECK(closeTreeScan(scan));
+  ASSERT_EQUALS_INT(2000, count, "scan should see every key");
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("test_btree.bin"));
+  free(keys);
+  free(rids);
+
+  TEST_DONE();
+}
+
+/* returns a copy of an attribute name that freeSchema can free */
+static char *copyName(const char *name)
+{
+  char *copy = (char*) malloc(strlen(name) + 1);
+  strcpy(copy, name);
+  return copy;
+}
+
+/* counts the records of a scan and checks that each one can be read by its id */
+static int countScan(RM_TableData *table, RM_Predicate *preds, int numPreds, Record *record, Record *check)
+{
+  RM_ScanHandle scan;
+  int count = 0, mismatches = 0;
+
+  TEST_CHECK(startScan(table, &scan, preds, numPreds));
+  while (next(&scan, record) == RC_OK) {
+    TEST_CHECK(getRecord(table, record->id, check));
+    mismatches += memcmp(record->data, check->data, getRecordSize(table->schema)) != 0;
+    count++;
+  }
+  TEST_CHECK(closeScan(&scan));
+  ASSERT_EQUALS_INT(0, mismatches, "scanned records should match their ids");
+  return count;
+}
+
+/* Test the record manager: slotted pages, moved records and filtered scans */
+void testRecordManager(void)
+{
+  RM_TableData table;
+  Schema *schema;
+  Record *record, *check;
+  Value value, *result;
+  RM_Predicate preds[2];
+  RID rids[600];
+  char name[16], longName[100];
+  int i, expected;
+
+  testName = "test record manager";
+
+  char **names = (char**) malloc(sizeof(char*) * 3);
+  DataType *types = (DataType*) malloc(sizeof(DataType) * 3);
+  int *lengths = (int*) malloc(sizeof(int) * 3);
+  int *keys = (int*) malloc(sizeof(int));
+  names[0] = copyName("a");
+  names[1] = copyName("b");
+  names[2] = copyName("c");
+  types[0] = DT_INT;
+  types[1] = DT_STRING;
+  types[2] = DT_FLOAT;
+  lengths[0] = lengths[2] = 0;
+  lengths[1] = 99;
+  keys[0] = 0;
+  schema = createSchema(3, names, types, lengths, 1, keys);
+  ASSERT_EQUALS_INT(4 + 99 + 4, getRecordSize(schema), "record should hold every attribute");
+
+  TEST_CHECK(initRecordManager(NULL));
+
+  // 600 ints fit in a record, but their schema does not fit on the table's first page
+  {
+    Schema *wide;
+    char **wideNames = (char**) malloc(sizeof(char*) * 600);
+    DataType *wideTypes = (DataType*) malloc(sizeof(DataType) * 600);
+    int *wideLengths = (int*) malloc(sizeof(int) * 600);
+    for (i = 0; i < 600; i++) {
+      wideNames[i] = copyName("w");
+      wideTypes[i] = DT_INT;
+      wideLengths[i] = 0;
+    }
+    wide = createSchema(600, wideNames, wideTypes, wideLengths, 0, NULL);
+    ASSERT_TRUE(getRecordSize(wide) < PAGE_SIZE, "wide record should fit in a page");
+    ASSERT_TRUE(createTable("test_wide.bin", wide) == RC_WRITE_FAILED, "schema larger than a page should be refused");
+    ASSERT_TRUE(access("test_wide.bin", F_OK) != 0, "refused table should not leave a file");
+    freeSchema(wide);
+  }
+
+  TEST_CHECK(createTable("test_table.bin", schema));
+  TEST_CHECK(openTable(&table, "test_table.bin"));
+  TEST_CHECK(createRecord(&record, table.schema));
+  TEST_CHECK(createRecord(&check, table.schema));
+
+  // Short strings are stored in their own length, so many records share a page
+  for (i = 0; i < 600; i++) {
+    sprintf(name, "name%d", i);
+    value.dt = DT_INT;
+    value.v.intV = i;
+    TEST_CHECK(setAttr(record, table.schema, 0, &value));
+    value.dt = DT_STRING;
+    value.v.stringV = name;
+    TEST_CHECK(setAttr(record, table.schema, 1, &value));
+    value.dt = DT_FLOAT;
+    value.v.floatV = i * 0.5f;
+    TEST_CHECK(setAttr(record, table.schema, 2, &value));
+    TEST_CHECK(insertRecord(&table, record));
+    rids[i] = record->id;
+  }
+  value.dt = DT_INT;
+  ASSERT_TRUE(setAttr(record, table.schema, 1, &value) == RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "attribute type should be checked");
+  ASSERT_EQUALS_INT(600, getNumTuples(&table), "every insert should be counted");
+  ASSERT_TRUE(rids[599].page > 1 && rids[599].page < 8, "records should be packed into few pages");
+  TEST_CHECK(getRecord(&table, rids[123], check));
+  TEST_CHECK(getAttr(check, table.schema, 1, &result));
+  ASSERT_EQUALS_STRING("name123", result->v.stringV, "string attribute should be read back");
+  free(result->v.stringV);
+  free(result);
+
+  // Growing records of the full first page move them to other pages under the same id
+  memset(longName, 'x', 98);
+  longName[98] = '\0';
+  value.dt = DT_STRING;
+  value.v.stringV = longName;
+  for (i = 0; i < 30; i++) {
+    TEST_CHECK(getRecord(&table, rids[i], record));
+    TEST_CHECK(setAttr(record, table.schema, 1, &value));
+    TEST_CHECK(updateRecord(&table, record));
+  }
+  for (i = 0; i < 30; i++) {
+    TEST_CHECK(getRecord(&table, rids[i], check));
+    TEST_CHECK(getAttr(check, table.schema, 0, &result));
+    ASSERT_EQUALS_INT(i, result->v.intV, "moved record should keep its id");
+    free(result);
+    ASSERT_TRUE(strcmp(check->data + 4, longName) == 0, "moved record should hold the update");
+  }
+
+  // Deleted records are gone and new records take their room
+  for (i = 0; i < 600; i += 3)
+    TEST_CHECK(deleteRecord(&table, rids[i]));
+  ASSERT_EQUALS_INT(400, getNumTuples(&table), "deletes should be counted");
+  ASSERT_ERROR(getRecord(&table, rids[3], check), "deleted record should not be found");
+  ASSERT_ERROR(deleteRecord(&table, rids[3]), "deleted record should not be deleted again");
+  TEST_CHECK(getRecord(&table, rids[400], record));
+  TEST_CHECK(insertRecord(&table, record));
+  TEST_CHECK(getRecord(&table, record->id, check));
+  ASSERT_TRUE(memcmp(record->data, check->data, getRecordSize(table.schema)) == 0, "new record should be read back");
+
+  // Predicates are applied to a page at a time
+  preds[0].attrNum = 0;
+  preds[0].op = RM_GE;
+  preds[0].value.dt = DT_INT;
+  preds[0].value.v.intV = 100;
+  preds[1].attrNum = 0;
+  preds[1].op = RM_LT;
+  preds[1].value.dt = DT_INT;
+  preds[1].value.v.intV = 200;
+  for (i = 100, expected = 0; i < 200; i++)
+    expected += i % 3 != 0;
+  ASSERT_EQUALS_INT(expected, countScan(&table, preds, 2, record, check), "int range should select its records");
+  preds[0].attrNum = 1;
+  preds[0].op = RM_EQ;
+  preds[0].value.dt = DT_STRING;
+  preds[0].value.v.stringV = longName;
+  for (i = 0, expected = 0; i < 30; i++)
+    expected += i % 3 != 0;
+  ASSERT_EQUALS_INT(expected, countScan(&table, preds, 1, record, check), "moved records should be found once");
+  preds[0].attrNum = 2;
+  preds[0].op = RM_GT;
+  preds[0].value.dt = DT_FLOAT;
+  preds[0].value.v.floatV = 250.0f;
+  for (i = 501, expected = 0; i < 600; i++)
+    expected += i % 3 != 0;
+  ASSERT_EQUALS_INT(expected, countScan(&table, preds, 1, record, check), "float predicate should select its records");
+  preds[0].value.dt = DT_INT;
+  ASSERT_TRUE(startScan(&table, NULL, preds, 1) != RC_OK, "scan needs a handle");
+  {
+    RM_ScanHandle scan;
+    ASSERT_TRUE(startScan(&table, &scan, preds, 1) == RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "predicate type should be checked");
+  }
+
+  // A moved record that fits again returns to its page
+  TEST_CHECK(getRecord(&table, rids[1], record));
+  value.v.stringV = "short";
+  TEST_CHECK(setAttr(record, table.schema, 1, &value));
+  TEST_CHECK(updateRecord(&table, record));
+  TEST_CHECK(getRecord(&table, rids[1], check));
+  ASSERT_TRUE(strcmp(check->data + 4, "short") == 0, "update of a moved record should be read back");
+
+  // The tuple count and the schema survive reopening
+  TEST_CHECK(closeTable(&table));
+  TEST_CHECK(openTable(&table, "test_table.bin"));
+  ASSERT_EQUALS_INT(401, getNumTuples(&table), "tuple count should be persistent");
+  ASSERT_EQUALS_INT(401, countScan(&table, NULL, 0, record, check), "scan should see every record");
+  ASSERT_TRUE(strcmp(table.schema->attrNames[1], "b") == 0 && table.schema->dataTypes[2] == DT_FLOAT, "schema should be persistent");
+
+  freeRecord(record);
+  freeRecord(check);
+  TEST_CHECK(closeTable(&table));
+  TEST_CHECK(deleteTable("test_table.bin"));
+  TEST_CHECK(shutdownRecordManager());
+  freeSchema(schema);
+
+  TEST_DONE();
+}
+
+/* Test the extendible hash index: splits, deletes, batched lookups and reopening */
+void testHashIndex(void)
+{
+  HashIndexHandle *index;
+  Value key, *keys;
+  RID rid, *rids;
+  RC *found;
+  SM_TraceEvent *events;
+  int i, count, numBuckets, depth, numEntries, reads;
+
+  testName = "test extendible hash index";
+
+  key.dt = DT_INT;
+  ASSERT_ERROR(createHashIndex("test_hash.bin", DT_STRING), "only integer keys should be supported");
+  TEST_CHECK(createHashIndex("test_hash.bin", DT_INT));
+  TEST_CHECK(openHashIndex(&index, "test_hash.bin"));
+
+  // Inserts split full buckets and double the directory when needed
+  for (i = 0; i < 5000; i++) {
+    key.v.intV = i * 7919;
+    rid.page = i;
+    rid.slot = i % 13;
+    TEST_CHECK(hashInsertKey(index, &key, rid));
+  }
+  key.v.intV = 7919;
+  ASSERT_TRUE(hashInsertKey(index, &key, rid) == RC_IM_KEY_ALREADY_EXISTS, "duplicate keys should be rejected");
+  TEST_CHECK(getHashNumEntries(index, &numEntries));
+  TEST_CHECK(getHashNumBuckets(index, &numBuckets));
+  TEST_CHECK(getHashGlobalDepth(index, &depth));
+  ASSERT_EQUALS_INT(5000, numEntries, "every key should be counted");
+  ASSERT_TRUE(numBuckets > 1 && numBuckets <= (1 << depth), "buckets should have been split");
+  for (i = 0, count = 0; i < 5000; i++) {
+    key.v.intV = i * 7919;
+    count += hashFindKey(index, &key, &rid) == RC_OK && rid.page == i && rid.slot == i % 13;
+  }
+  ASSERT_EQUALS_INT(5000, count, "every key should lead to its record id");
+  key.v.intV = 1;
+  ASSERT_TRUE(hashFindKey(index, &key, &rid) == RC_IM_KEY_NOT_FOUND, "missing key should not be found");
+
+  // Deleted keys are gone, the others stay
+  for (i = 0; i < 5000; i += 2) {
+    key.v.intV = i * 7919;
+    TEST_CHECK(hashDeleteKey(index, &key));
+  }
+  key.v.intV = 0;
+  ASSERT_TRUE(hashDeleteKey(index, &key) == RC_IM_KEY_NOT_FOUND, "deleted key should be gone");
+  TEST_CHECK(closeHashIndex(index));
+
+  // The directory survives reopening, and a batched lookup reads every bucket once
+  TEST_CHECK(openHashIndex(&index, "test_hash.bin"));
+  TEST_CHECK(getHashNumEntries(index, &numEntries));
+  ASSERT_EQUALS_INT(2500, numEntries, "key count should be persistent");
+  keys = (Value*) malloc(sizeof(Value) * 5000);
+  rids = (RID*) malloc(sizeof(RID) * 5000);
+  found = (RC*) malloc(sizeof(RC) * 5000);
+  events = (SM_TraceEvent*) malloc(sizeof(SM_TraceEvent) * 8192);
+  for (i = 0; i < 5000; i++) {
+    keys[i].dt = DT_INT;
+    keys[i].v.intV = (4999 - i) * 7919;
+  }
+  TEST_CHECK(clearTrace());
+  TEST_CHECK(startTracing());
+  TEST_CHECK(hashFindKeys(index, keys, 5000, rids, found));
+  TEST_CHECK(stopTracing());
+  count = getTraceEvents(events, 8192);
+  for (i = 0, reads = 0; i < count; i++)
+    reads += events[i].op == TRACE_READ_BLOCK;
+  TEST_CHECK(clearTrace());
+  ASSERT_EQUALS_INT(numBuckets, reads, "every bucket should be read once");
+  for (i = 0, count = 0; i < 5000; i++) {
+    int k = 4999 - i;
+    count += k % 2 == 0 ? found[i] == RC_IM_KEY_NOT_FOUND : found[i] == RC_OK && rids[i].page == k;
+  }
+  ASSERT_EQUALS_INT(5000, count, "batched lookup should match single lookups");
+  keys[7].dt = DT_FLOAT;
+  ASSERT_TRUE(hashFindKeys(index, keys, 5000, rids, found) == RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "key types should be checked");
+
+  TEST_CHECK(closeHashIndex(index));
+  TEST_CHECK(deleteHashIndex("test_hash.bin"));
+
+  // A directory too large for page 0 goes on in a chain of directory pages
+  TEST_CHECK(createHashIndex("test_hash.bin", DT_INT));
+  TEST_CHECK(openHashIndex(&index, "test_hash.bin"));
+  for (i = 0; i < 200000; i++) {
+    key.v.intV = i;
+    rid.page = i;
+    rid.slot = 0;
+    TEST_CHECK(hashInsertKey(index, &key, rid));
+  }
+  TEST_CHECK(getHashGlobalDepth(index, &depth));
+  ASSERT_TRUE(HASH_DIRECTORY_OFFSET + (4 << depth) > PAGE_SIZE, "directory should outgrow page 0");
+  TEST_CHECK(closeHashIndex(index));
+  TEST_CHECK(openHashIndex(&index, "test_hash.bin"));
+  TEST_CHECK(getHashNumEntries(index, &numEntries));
+  ASSERT_EQUALS_INT(200000, numEntries, "every key should be counted");
+  for (i = 0, count = 0; i < 200000; i++) {
+    key.v.intV = i;
+    count += hashFindKey(index, &key, &rid) == RC_OK && rid.page == i;
+  }
+  ASSERT_EQUALS_INT(200000, count, "the directory chain should survive reopening");
+  TEST_CHECK(closeHashIndex(index));
+  TEST_CHECK(deleteHashIndex("test_hash.bin"));
+  free(keys);
+  free(rids);
+  free(found);
+  free(events);
+
+  TEST_DONE();
+}
+
+/* orders sort test records by descending key */
+static int compareKeysDescending(const void *a, const void *b, void *arg)
+{
+  int x = *(const int*) a, y = *(const int*) b;
+  (void) arg;
+  return (x < y) - (x > y);
+}
+
+/* reads the sorted test records back and checks their order; returns the record count */
+static int checkSortedRecords(char *fileName, int numRecords, int descending)
+{
+  SM_FileHandle fh;
+  int i, count = 0, misordered = 0, lastKey = 0, lastSeq = -1;
+  long seqSum = 0;
+  char *pages;
+
+  TEST_CHECK(openPageFile(fileName, &fh));
+  pages = (char*) malloc((size_t) fh.totalNumPages * PAGE_SIZE);
+  TEST_CHECK(readBlocks(0, fh.totalNumPages, &fh, pages));
+  for (i = 0; i < numRecords; i++) {
+    int *record = (int*) (pages + (i / (PAGE_SIZE / 16)) * PAGE_SIZE + (i % (PAGE_SIZE / 16)) * 16);
+    if (i > 0) {
+      int order = descending ? lastKey - record[0] : record[0] - lastKey;
+      // equal keys keep the input order
+      misordered += order < 0 || (order == 0 && record[1] < lastSeq);
+    }
+    lastKey = record[0];
+    lastSeq = record[1];
+    seqSum += record[1];
+    count++;
+  }
+  ASSERT_EQUALS_INT(0, misordered, "records should be in order");
+  ASSERT_TRUE(seqSum == (long) numRecords * (numRecords - 1) / 2, "every record should be there once");
+  TEST_CHECK(closePageFile(&fh));
+  free(pages);
+  return count;
+}
+
+/* Test multi-page transfers and the external merge sort */
+void testExternalSort(void)
+{
+  SM_FileHandle fh;
+  SM_SortSpec spec;
+  SM_SortStats stats;
+  SM_WriteStats writeStats;
+  SM_TraceEvent *events;
+  char *pages;
+  int i, numPages, count, inOrder;
+
+  testName = "test external sort";
+
+  // 20000 records of 16 bytes: a key with many duplicates, the input position and a payload
+  numPages = (20000 * 16 + PAGE_SIZE - 1) / PAGE_SIZE;
+  pages = (char*) calloc((size_t) numPages, PAGE_SIZE);
+  for (i = 0; i < 20000; i++) {
+    int *record = (int*) (pages + (i / (PAGE_SIZE / 16)) * PAGE_SIZE + (i % (PAGE_SIZE / 16)) * 16);
+    record[0] = (int) ((i * 7919L) % 5000);
+    record[1] = i;
+    record[2] = record[3] = -i;
+  }
+  TEST_CHECK(createPageFile("test_sort_in.bin"));
+  TEST_CHECK(openPageFile("test_sort_in.bin", &fh));
+  ASSERT_ERROR(writeBlocks(0, numPages, &fh, pages), "pages outside the file should not be written");
+  TEST_CHECK(ensureCapacity(numPages, &fh));
+
+  // With deduplication on the pages still go out together, are traced one by one and remembered
+  events = (SM_TraceEvent*) malloc(sizeof(SM_TraceEvent) * 8192);
+  TEST_CHECK(setWriteDedup(&fh, 1));
+  TEST_CHECK(clearTrace());
+  TEST_CHECK(startTracing());
+  TEST_CHECK(writeBlocks(0, numPages, &fh, pages));
+  TEST_CHECK(stopTracing());
+  count = getTraceEvents(events, 8192);
+  for (i = 0, inOrder = 0; i < count; i++)
+    inOrder += events[i].op == TRACE_WRITE_BLOCK && events[i].pageNum == i;
+  TEST_CHECK(clearTrace());
+  ASSERT_TRUE(count == numPages && inOrder == numPages, "every page should be traced");
+  TEST_CHECK(writeBlock(1, &fh, pages + PAGE_SIZE));
+  TEST_CHECK(getWriteStats(&fh, &writeStats));
+  ASSERT_TRUE(writeStats.pagesWritten == numPages && writeStats.pagesSkipped == 1, "written pages should be remembered");
+  TEST_CHECK(setWriteDedup(&fh, 0));
+  free(events);
+  memset(pages, 0, (size_t) numPages * PAGE_SIZE);
+  TEST_CHECK(readBlocks(0, numPages, &fh, pages));
+  ASSERT_TRUE(((int*) pages)[16 / 4 + 1] == 1 && ((int*) (pages + (numPages - 1) * PAGE_SIZE))[1] == (numPages - 1) * (PAGE_SIZE / 16),
+              "pages written together should be read back together");
+  ASSERT_ERROR(readBlocks(numPages - 1, 2, &fh, pages), "pages past the end should not be read");
+  TEST_CHECK(closePageFile(&fh));
+
+  // A budget of 8 pages makes 20 runs that need three passes merging three runs at a time
+  memset(&spec, 0, sizeof(spec));
+  spec.recordSize = 16;
+  spec.numRecords = 20000;
+  spec.keyOffset = 0;
+  spec.memoryPages = 8;
+  TEST_CHECK(externalSort("test_sort_in.bin", "test_sort_out.bin", &spec, &stats));
+  ASSERT_EQUALS_INT(20, stats.numRuns, "every run should fill half of the budget");
+  ASSERT_EQUALS_INT(3, stats.mergePasses, "runs should be merged three at a time");
+  ASSERT_EQUALS_INT(20000, checkSortedRecords("test_sort_out.bin", 20000, 0), "sorted output should hold every record");
+  ASSERT_TRUE(access("test_sort_out.bin.runs0", F_OK) != 0 && access("test_sort_out.bin.runs1", F_OK) != 0, "scratch files should be removed");
+
+  // With enough memory the single run is the output; a comparator can give another order
+  spec.compare = compareKeysDescending;
+  spec.memoryPages = 0;
+  TEST_CHECK(externalSort("test_sort_in.bin", "test_sort_out.bin", &spec, &stats));
+  ASSERT_EQUALS_INT(1, stats.numRuns, "input should fit in one run");
+  ASSERT_EQUALS_INT(0, stats.mergePasses, "one run should need no merge");
+  ASSERT_TRUE(stats.pagesRead == numPages && stats.pagesWritten == numPages, "every page should be read and written once");
+  ASSERT_EQUALS_INT(20000, checkSortedRecords("test_sort_out.bin", 20000, 1), "descending output should hold every record");
+
+  // Bad specs are rejected
+  ASSERT_ERROR(externalSort("test_sort_in.bin", "test_sort_in.bin", &spec, NULL), "input and output should differ");
+  spec.recordSize = PAGE_SIZE + 1;
+  ASSERT_ERROR(externalSort("test_sort_in.bin", "test_sort_out.bin", &spec, NULL), "records larger than a page should be rejected");
+  spec.recordSize = 16;
+  spec.numRecords = numPages * (PAGE_SIZE / 16) + 1;
+  ASSERT_ERROR(externalSort("test_sort_in.bin", "test_sort_out.bin", &spec, NULL), "missing records should be detected");
+
+  TEST_CHECK(destroyPageFile("test_sort_in.bin"));
+  TEST_CHECK(destroyPageFile("test_sort_out.bin"));
+  free(pages);
+
+  TEST_DONE();
+}
+
+/* Try to test fuzzy checkpoints and recovery bounded by the segment journal */
+void testFuzzyCheckpointing(void)
+{
+  SM_FileHandle fh, fh2;
+  SM_PageHandle ph;
+  SM_SharedPool *pool;
+  SM_SharedPoolStats poolStats;
+  SM_CheckpointOptions options;
+  SM_CheckpointStats stats;
+  LogStoreStats logStats;
+  int i, j, numPages = 20 * LOG_SEGMENT_SLOTS;
+  RC rc;
+
+  testName = "test Fuzzy Checkpointing";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  // Fill 20 segments of a log-structured file, then checkpoint it
+  TEST_CHECK(createPageFile("log:test_ckpt.bin"));
+  TEST_CHECK(openPageFile("log:test_ckpt.bin", &fh));
+  TEST_CHECK(ensureCapacity(numPages, &fh));
+  for (i = 0; i < numPages; i++) {
+    memset(ph, 'a' + i % 26, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  TEST_CHECK(getLogStoreStats(&fh, &logStats));
+  ASSERT_EQUALS_INT(numPages, (int) logStats.unflushedWrites, "writes should not be covered by a checkpoint yet");
+  TEST_CHECK(checkpointPageFile(&fh, &stats));
+  ASSERT_EQUALS_INT(1, (int) stats.checkpoints, "one checkpoint should be taken");
+  ASSERT_EQUALS_INT(numPages, (int) stats.unflushedWrites, "checkpoint should record the unflushed writes");
+  ASSERT_TRUE(stats.recoveryPages <= LOG_SEGMENT_SLOTS, "after a checkpoint only the active segment needs replay");
+
+  // A crash after a few more writes only replays the segments written since the checkpoint
+  memset(ph, 'z', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(writeBlock(100, &fh, ph));
+  TEST_CHECK(writeBlock(numPages - 1, &fh, ph));
+  TEST_CHECK(copyPageFile("test_ckpt.bin", "test_ckpt_crash.bin"));
+  TEST_CHECK(copyPageFile("test_ckpt.bin" LOG_CHECKPOINT_SUFFIX, "test_ckpt_crash.bin" LOG_CHECKPOINT_SUFFIX));
+  TEST_CHECK(closePageFile(&fh));
+
+  TEST_CHECK(openPageFile("log:test_ckpt_crash.bin", &fh));
+  TEST_CHECK(getLogStoreStats(&fh, &logStats));
+  ASSERT_TRUE(logStats.numSegments >= 20, "file should span all its segments");
+  ASSERT_TRUE(logStats.lastRecoverySlots > 0 && logStats.lastRecoverySlots <= 2 * LOG_SEGMENT_SLOTS,
+              "recovery should only read the journaled segments");
+  TEST_CHECK(readBlock(0, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'z' && ph[PAGE_SIZE - 1] == 'z', "write after the checkpoint should be recovered");
+  TEST_CHECK(readBlock(numPages - 1, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'z', "write in a new segment should be recovered");
+  TEST_CHECK(readBlock(5, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'a' + 5, "untouched page should come from the checkpoint");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("log:test_ckpt_crash.bin"));
+  TEST_CHECK(destroyPageFile("log:test_ckpt.bin"));
+
+  // Segments reused after a checkpoint are replayed and checked against it
+  TEST_CHECK(createPageFile("log:test_ckpt.bin"));
+  TEST_CHECK(openPageFile("log:test_ckpt.bin", &fh));
+  TEST_CHECK(ensureCapacity(8, &fh));
+  for (i = 0; i < 2 * LOG_SEGMENT_SLOTS; i++) {
+    memset(ph, 'a' + i % 26, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i % 8, &fh, ph));
+  }
+  TEST_CHECK(checkpointPageFile(&fh, &stats));
+  TEST_CHECK(copyPageFile("test_ckpt.bin" LOG_CHECKPOINT_SUFFIX, "test_ckpt_stale.bin" LOG_CHECKPOINT_SUFFIX));
+  for (; i < 4 * LOG_SEGMENT_SLOTS; i++) {
+    memset(ph, 'a' + i % 26, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i % 8, &fh, ph));
+    if (i == 3 * LOG_SEGMENT_SLOTS - 1)
+      TEST_CHECK(checkpointPageFile(&fh, &stats));
+  }
+  TEST_CHECK(getLogStoreStats(&fh, &logStats));
+  ASSERT_EQUALS_INT(2, logStats.numSegments, "emptied segments should be reused");
+  TEST_CHECK(copyPageFile("test_ckpt.bin", "test_ckpt_crash.bin"));
+  TEST_CHECK(copyPageFile("test_ckpt.bin" LOG_CHECKPOINT_SUFFIX, "test_ckpt_crash.bin" LOG_CHECKPOINT_SUFFIX));
+  TEST_CHECK(copyPageFile("test_ckpt.bin", "test_ckpt_stale.bin"));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(openPageFile("log:test_ckpt_crash.bin", &fh));
+  for (i = 0, j = 0; i < 8; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    j += ph[0] == 'a' + (4 * LOG_SEGMENT_SLOTS - 8 + i) % 26;
+  }
+  ASSERT_EQUALS_INT(8, j, "pages in a reused segment should be recovered");
+  TEST_CHECK(closePageFile(&fh));
+  rc = openPageFile("log:test_ckpt_stale.bin", &fh);
+  ASSERT_EQUALS_INT(RC_PAGE_CORRUPT, rc, "replay should find checkpointed versions that were overwritten");
+  TEST_CHECK(destroyPageFile("log:test_ckpt_stale.bin"));
+  TEST_CHECK(destroyPageFile("log:test_ckpt_crash.bin"));
+  TEST_CHECK(destroyPageFile("log:test_ckpt.bin"));
+
+  // The background checkpointer flushes dirty pool pages while writes go on
+  destroySharedPool("/sm_ckpt_pool");
+  TEST_CHECK(createPageFile(TESTPF));
+  TEST_CHECK(openPageFile(TESTPF, &fh));
+  TEST_CHECK(ensureCapacity(32, &fh));
+  TEST_CHECK(openSharedPool("/sm_ckpt_pool", 64, PAGE_SIZE, &pool));
+  TEST_CHECK(attachSharedPool(&fh, pool));
+  for (i = 31; i >= 0; i--) {
+    memset(ph, 'A' + i % 26, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+  memset(&options, 0, sizeof(options));
+  options.targetRecoveryMs = 1;
+  options.intervalMs = 1;
+  options.replayPagesPerSec = 1000;
+  TEST_CHECK(startCheckpointer(&fh, &options));
+  memset(ph, 'w', PAGE_SIZE);
+  i = 0;
+  do {
+    // every round over the pages changes them, so the writes are not skipped as identical
+    ph[0] = 'a' + (i / 32) % 26;
+    TEST_CHECK(writeBlock(i++ % 32, &fh, ph));
+    TEST_CHECK(getCheckpointStats(&fh, &stats));
+  } while (stats.checkpoints < 2);
+  TEST_CHECK(stopCheckpointer(&fh));
+  TEST_CHECK(getCheckpointStats(&fh, &stats));
+  ASSERT_TRUE(stats.checkpoints >= 2, "stats should stay readable after stopping");
+  ASSERT_TRUE(stats.pagesFlushed >= 32, "dirty pages should be flushed by the checkpoints");
+
+  TEST_CHECK(checkpointPageFile(&fh, &stats));
+  ASSERT_EQUALS_INT(0, (int) stats.recoveryPages, "a checkpoint should leave no dirty pages");
+  TEST_CHECK(getSharedPoolStats(pool, &poolStats));
+  ASSERT_EQUALS_INT(0, poolStats.dirtyFrames, "pool should have no dirty frames");
+  TEST_CHECK(openPageFile(TESTPF, &fh2));
+  TEST_CHECK(readBlock(0, &fh2, ph));
+  ASSERT_TRUE(ph[PAGE_SIZE - 1] == 'w', "checkpointed page should be in the file");
+  TEST_CHECK(closePageFile(&fh2));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(closeSharedPool(pool));
+  TEST_CHECK(destroySharedPool("/sm_ckpt_pool"));
+  TEST_CHECK(destroyPageFile(TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Ship the changes of a page file through a pipe and through a file, and check that the
+ * replicas end up with the same pages */
+void testLogShipping(void)
+{
+  SM_FileHandle fh, fh2;
+  SM_PageHandle ph, ph2;
+  SM_Replica *replica;
+  SM_ShippingStats shipStats;
+  SM_ReplicaStats stats;
+  SM_Catalog *catalog;
+  int i, fds[2], fd;
+
+  testName = "test Log Shipping";
+
+  ph = (SM_PageHandle) malloc(3 * PAGE_SIZE);
+  ph2 = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile("test_primary.bin"));
+  TEST_CHECK(openPageFile("test_primary.bin", &fh));
+  TEST_CHECK(ensureCapacity(4, &fh));
+  for (i = 0; i < 4; i++) {
+    memset(ph, 'a' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlock(i, &fh, ph));
+  }
+
+  // An empty replica catches up with the existing pages, then follows the writes
+  ASSERT_TRUE(pipe(fds) == 0, "pipe should be created");
+  TEST_CHECK(startReplica("test_replica.bin", fds[0], &replica));
+  TEST_CHECK(startLogShipping(&fh, fds[1], 1));
+  ASSERT_TRUE(startLogShipping(&fh, fds[1], 0) != RC_OK, "a file should only be shipped once");
+  memset(ph, 'B', PAGE_SIZE);
+  TEST_CHECK(writeBlock(1, &fh, ph));
+  TEST_CHECK(appendEmptyBlock(&fh));
+  for (i = 0; i < 3; i++) {
+    memset(ph + i * PAGE_SIZE, 'X' + i, PAGE_SIZE);
+  }
+  TEST_CHECK(writeBlocks(2, 3, &fh, ph));
+  TEST_CHECK(getShippingStats(&fh, &shipStats));
+  do {
+    sched_yield();
+    TEST_CHECK(getReplicaStats(replica, &stats));
+  } while (stats.appliedRecords < shipStats.queuedRecords && !stats.failed);
+  ASSERT_EQUALS_INT(0, stats.failed, "replica should apply the stream");
+  ASSERT_EQUALS_INT(4 + 1 + 3, (int) stats.pages, "replica should apply every shipped page");
+  ASSERT_TRUE(stats.pageWrites < stats.pages, "consecutive pages should be applied together");
+  ASSERT_TRUE(stats.lagMs >= 0 && stats.maxLagMs >= stats.lagMs, "replica should report its lag");
+
+  TEST_CHECK(openPageFile("test_replica.bin", &fh2));
+  ASSERT_EQUALS_INT(5, fh2.totalNumPages, "replica should have the primary's page count");
+  for (i = 0; i < 5; i++) {
+    TEST_CHECK(readBlock(i, &fh, ph));
+    TEST_CHECK(readBlock(i, &fh2, ph2));
+    ASSERT_TRUE(memcmp(ph, ph2, PAGE_SIZE) == 0, "replica page should match the primary");
+  }
+  TEST_CHECK(closePageFile(&fh2));
+
+  // Closing the stream ends the replica
+  TEST_CHECK(stopLogShipping(&fh));
+  TEST_CHECK(getShippingStats(&fh, &shipStats));
+  ASSERT_EQUALS_INT((int) shipStats.queuedRecords, (int) shipStats.shippedRecords, "every record should be shipped");
+  close(fds[1]);
+  do {
+    sched_yield();
+    TEST_CHECK(getReplicaStats(replica, &stats));
+  } while (!stats.ended);
+  TEST_CHECK(stopReplica(replica));
+  close(fds[0]);
+
+  // A stream saved to a file is replayed into a new replica
+  fd = open("test_ship.log", O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  ASSERT_TRUE(fd >= 0, "stream file should be created");
+  TEST_CHECK(startLogShipping(&fh, fd, 1));
+  memset(ph, 'q', PAGE_SIZE);
+  TEST_CHECK(writeBlock(0, &fh, ph));
+  TEST_CHECK(stopLogShipping(&fh));
+  close(fd);
+  fd = open("test_ship.log", O_RDONLY);
+  TEST_CHECK(startReplica("test_replica2.bin", fd, &replica));
+  do {
+    sched_yield();
+    TEST_CHECK(getReplicaStats(replica, &stats));
+  } while (!stats.ended);
+  ASSERT_EQUALS_INT(0, stats.failed, "saved stream should be applied");
+  TEST_CHECK(stopReplica(replica));
+  close(fd);
+  TEST_CHECK(openPageFile("test_replica2.bin", &fh2));
+  ASSERT_EQUALS_INT(5, fh2.totalNumPages, "replayed replica should have the primary's page count");
+  TEST_CHECK(readBlock(0, &fh2, ph2));
+  ASSERT_TRUE(ph2[0] == 'q' && ph2[PAGE_SIZE - 1] == 'q', "replayed replica should have the last write");
+  TEST_CHECK(readBlock(4, &fh2, ph2));
+  ASSERT_TRUE(ph2[0] == 'Z', "replayed replica should have the existing pages");
+  TEST_CHECK(closePageFile(&fh2));
+
+  // A replica shrunk by the primary publishes the new page count to a reader sharing it
+  TEST_CHECK(createPageFile("test_replica3.bin"));
+  TEST_CHECK(openCatalog("test_replica.manifest", &catalog));
+  TEST_CHECK(catalogOpenFile(catalog, "test_replica3.bin", &fh2));
+  ASSERT_TRUE(pipe(fds) == 0, "pipe should be created");
+  TEST_CHECK(startReplica("test_replica3.bin", fds[0], &replica));
+  TEST_CHECK(startLogShipping(&fh, fds[1], 1));
+  TEST_CHECK(truncateOpenFile(&fh, 3));
+  TEST_CHECK(getShippingStats(&fh, &shipStats));
+  do {
+    sched_yield();
+    TEST_CHECK(getReplicaStats(replica, &stats));
+  } while (stats.appliedRecords < shipStats.queuedRecords && !stats.failed);
+  ASSERT_EQUALS_INT(0, stats.failed, "replica should apply the resize");
+  TEST_CHECK(readBlock(0, &fh2, ph2));
+  ASSERT_EQUALS_INT(3, fh2.totalNumPages, "reader should see the replica shrink");
+  ASSERT_ERROR(readBlock(4, &fh2, ph2), "dropped replica page should not be readable");
+  TEST_CHECK(closePageFile(&fh2));
+  TEST_CHECK(stopLogShipping(&fh));
+  close(fds[1]);
+  do {
+    sched_yield();
+    TEST_CHECK(getReplicaStats(replica, &stats));
+  } while (!stats.ended);
+  TEST_CHECK(stopReplica(replica));
+  close(fds[0]);
+  TEST_CHECK(closeCatalog(catalog));
+
+  TEST_CHECK(closePageFile(&fh));
+  unlink("test_ship.log");
+  unlink("test_replica.manifest");
+  TEST_CHECK(destroyPageFile("test_replica3.bin"));
+  TEST_CHECK(destroyPageFile("test_replica2.bin"));
+  TEST_CHECK(destroyPageFile("test_replica.bin"));
+  TEST_CHECK(destroyPageFile("test_primary.bin"));
+  free(ph);
+  free(ph2);
+
+  TEST_DONE();
+}
+
+/* a cache of the memory governor test; gives back as much as it is asked for */
+static long long shrinkTestCache(void *context, long long bytes)
+{
+  long long *cached = (long long*) context;
+  long long freed = bytes < *cached ? bytes : *cached;
+  *cached -= freed;
+  return freed;
+}
+
+/* Try the process-wide memory budget with weighted consumers, file buffers and a sort */
+void testMemoryGovernor(void)
+{
+  SM_MemConsumer *cache, *table;
+  SM_MemoryStats stats;
+  SM_MemConsumerStats consumerStats;
+  SM_ShippingStats shipStats;
+  SM_ReplicaStats replicaStats;
+  SM_Replica *replica;
+  SM_SortSpec spec;
+  SM_SortStats sortStats;
+  SM_FileHandle fh;
+  char *pages;
+  long long cached = 0;
+  int i, fds[2];
+
+  testName = "test Memory Governor";
+
+  // Alone, the cache may fill most of the budget
+  TEST_CHECK(initStorageManagerWithBudget(1024 * 1024));
+  TEST_CHECK(registerMemConsumer("test cache", 1, shrinkTestCache, &cached, &cache));
+  TEST_CHECK(registerMemConsumer("test table", 3, NULL, NULL, &table));
+  TEST_CHECK(memReserve(cache, 768 * 1024));
+  cached = 768 * 1024;
+
+  // The table may claim three quarters of the budget, so the cache gives memory back
+  TEST_CHECK(memReserve(table, 512 * 1024));
+  TEST_CHECK(getMemConsumerStats(cache, &consumerStats));
+  ASSERT_EQUALS_INT(1, (int) consumerStats.shrinkCalls, "cache should be asked to shrink once");
+  ASSERT_TRUE(consumerStats.used == 512 * 1024 && cached == consumerStats.used, "cache should give back what the table needs");
+  ASSERT_TRUE(consumerStats.share == 256 * 1024, "cache's share should follow the weights");
+  TEST_CHECK(getMemoryStats(&stats));
+  ASSERT_TRUE(stats.used == 1024 * 1024 && stats.peak == stats.used, "budget should be used up");
+
+  // The table is below its share, so the cache can't take memory from it
+  ASSERT_TRUE(memReserve(cache, 64 * 1024) == RC_MEMORY_BUDGET_EXCEEDED, "cache over its share should be denied");
+  memRelease(table, 256 * 1024);
+  TEST_CHECK(memReserve(cache, 64 * 1024));
+  cached += 64 * 1024;
+
+  // Lowering the budget shrinks the consumers over their share
+  TEST_CHECK(setMemoryBudget(512 * 1024));
+  TEST_CHECK(getMemoryStats(&stats));
+  ASSERT_TRUE(stats.used == 512 * 1024 && cached == 256 * 1024, "cache should shrink to the new budget");
+  ASSERT_EQUALS_INT(1, (int) stats.denied, "one reservation should be denied");
+  unregisterMemConsumer(table);
+  unregisterMemConsumer(cache);
+  TEST_CHECK(getMemoryStats(&stats));
+  ASSERT_TRUE(stats.used == 0, "unregistering should return the memory");
+
+  // Initializing the record and index managers keeps the budget
+  TEST_CHECK(initRecordManager(NULL));
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(getMemoryStats(&stats));
+  ASSERT_TRUE(stats.budget == 512 * 1024, "initializing a manager should keep the budget");
+  TEST_CHECK(shutdownIndexManager());
+  TEST_CHECK(shutdownRecordManager());
+
+  // The shipping queues of a file grow while the stream is blocked and shrink when it is idle
+  TEST_CHECK(setMemoryBudget(MEMGOV_UNLIMITED));
+  pages = (char*) calloc(64, PAGE_SIZE);
+  for (i = 0; i < 64; i++) {
+    memset(pages + i * PAGE_SIZE, 'a' + i % 26, PAGE_SIZE);
+  }
+  TEST_CHECK(createPageFile("test_mem.bin"));
+  TEST_CHECK(openPageFile("test_mem.bin", &fh));
+  TEST_CHECK(ensureCapacity(64, &fh));
+  TEST_CHECK(setFileMemoryWeight(&fh, 2));
+  ASSERT_TRUE(pipe(fds) == 0, "pipe should be created");
+  TEST_CHECK(startLogShipping(&fh, fds[1], 0));
+  TEST_CHECK(writeBlocks(0, 64, &fh, pages));
+  TEST_CHECK(getFileMemoryStats(&fh, &consumerStats));
+  ASSERT_EQUALS_INT(2, consumerStats.weight, "file should have its weight");
+  ASSERT_TRUE(consumerStats.used > 2 * REPL_MIN_QUEUE_BYTES, "queue should grow while the pipe is full");
+  TEST_CHECK(startReplica("test_mem_replica.bin", fds[0], &replica));
+  do {
+    sched_yield();
+    TEST_CHECK(getShippingStats(&fh, &shipStats));
+  } while (shipStats.shippedRecords < shipStats.queuedRecords);
+  TEST_CHECK(setMemoryBudget(3 * REPL_MIN_QUEUE_BYTES));
+  TEST_CHECK(getFileMemoryStats(&fh, &consumerStats));
+  ASSERT_TRUE(consumerStats.shrinkCalls == 1 && consumerStats.used == 2 * REPL_MIN_QUEUE_BYTES,
+              "idle queues should shrink to their first size");
+  TEST_CHECK(stopLogShipping(&fh));
+  close(fds[1]);
+  do {
+    sched_yield();
+    TEST_CHECK(getReplicaStats(replica, &replicaStats));
+  } while (!replicaStats.ended);
+  TEST_CHECK(stopReplica(replica));
+  close(fds[0]);
+  TEST_CHECK(getFileMemoryStats(&fh, &consumerStats));
+  ASSERT_TRUE(consumerStats.used == 0, "stopping should release the queues");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("test_mem_replica.bin"));
+
+  // A sort asking for 64 pages gets what the budget allows and writes more runs
+  for (i = 0; i < 4000; i++) {
+    int *record = (int*) (pages + (i / (PAGE_SIZE / 16)) * PAGE_SIZE + (i % (PAGE_SIZE / 16)) * 16);
+    record[0] = 4000 - i;
+    record[1] = i;
+  }
+  TEST_CHECK(openPageFile("test_mem.bin", &fh));
+  TEST_CHECK(writeBlocks(0, 16, &fh, pages));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(setMemoryBudget(16 * PAGE_SIZE));
+  memset(&spec, 0, sizeof(spec));
+  spec.recordSize = 16;
+  spec.numRecords = 4000;
+  spec.memoryPages = 64;
+  TEST_CHECK(externalSort("test_mem.bin", "test_mem_sorted.bin", &spec, &sortStats));
+  ASSERT_EQUALS_INT(16, sortStats.memoryPages, "sort should get 16 pages");
+  ASSERT_EQUALS_INT(2, sortStats.numRuns, "smaller budget should make two runs");
+  ASSERT_EQUALS_INT(4000, checkSortedRecords("test_mem_sorted.bin", 4000, 0), "sorted output should hold every record");
+  TEST_CHECK(setMemoryBudget(4 * PAGE_SIZE));
+  ASSERT_TRUE(externalSort("test_mem.bin", "test_mem_sorted.bin", &spec, NULL) == RC_MEMORY_BUDGET_EXCEEDED,
+              "sort should fail when even its smallest budget does not fit");
+
+  TEST_CHECK(setMemoryBudget(MEMGOV_UNLIMITED));
+  TEST_CHECK(destroyPageFile("test_mem_sorted.bin"));
+  TEST_CHECK(destroyPageFile("test_mem.bin"));
+  free(pages);
+
+  TEST_DONE();
+}
+
+void testFileCatalog(void)
+{
+  SM_Catalog *catalog;
+  SM_CatalogStats stats;
+  SM_CatalogInfo info;
+  SM_CompactStats compactStats;
+  SM_FileHandle first, second, handles[16];
+  char *names[16];
+  SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+  int i;
+
+  testName = "test File Catalog";
+
+  for (i = 0; i < 16; i++) {
+    names[i] = (char*) malloc(32);
+    sprintf(names[i], "test_cat_%d.bin", i);
+    TEST_CHECK(createPageFile(names[i]));
+  }
+  TEST_CHECK(openCatalog("test_cat.manifest", &catalog));
+
+  // Two names of one file share the open file and its page count, not the position
+  TEST_CHECK(catalogOpenFile(catalog, "test_cat_0.bin", &first));
+  TEST_CHECK(catalogOpenFile(catalog, "./test_cat_0.bin", &second));
+  TEST_CHECK(getCatalogStats(catalog, &stats));
+  ASSERT_TRUE(stats.fileOpens == 1 && stats.sharedOpens == 1, "second open should share the file");
+  ASSERT_TRUE(first.mgmtInfo == second.mgmtInfo, "handles should share the open file");
+  memset(page, 'c', PAGE_SIZE);
+  TEST_CHECK(appendEmptyBlock(&first));
+  TEST_CHECK(writeBlock(1, &first, page));
+  TEST_CHECK(readFirstBlock(&second, page));
+  ASSERT_EQUALS_INT(2, second.totalNumPages, "second handle should see the appended page");
+  ASSERT_TRUE(second.curPagePos == 0 && first.curPagePos == 1, "positions should stay apart");
+  TEST_CHECK(readBlock(1, &second, page));
+  ASSERT_TRUE(page[0] == 'c' && page[PAGE_SIZE - 1] == 'c', "second handle should read the write");
+  TEST_CHECK(closePageFile(&first));
+  TEST_CHECK(readBlock(1, &second, page));
+  TEST_CHECK(closePageFile(&second));
+
+  // The catalog still holds the file open; many files open on several threads
+  TEST_CHECK(catalogOpenAll(catalog, names, 16, 4, handles));
+  TEST_CHECK(getCatalogStats(catalog, &stats));
+  ASSERT_TRUE(stats.files == 16 && stats.fileOpens == 16 && stats.sharedOpens == 2, "every file should be opened once");
+  for (i = 0; i < 16; i++) {
+    TEST_CHECK(ensureCapacity(i + 1, &handles[i]));
+    TEST_CHECK(closePageFile(&handles[i]));
+  }
+  TEST_CHECK(catalogLookup(catalog, "test_cat_5.bin", &info));
+  ASSERT_TRUE(info.open && info.totalNumPages == 6, "open file should be answered by the catalog");
+
+  // A plain open of a file the catalog holds shares it; closing a handle only stops its own work
+  TEST_CHECK(catalogOpenFile(catalog, "test_cat_3.bin", &first));
+  TEST_CHECK(openPageFile("test_cat_3.bin", &second));
+  ASSERT_TRUE(first.mgmtInfo == second.mgmtInfo, "plain open should share the catalog's file");
+  memset(page, 'd', PAGE_SIZE);
+  TEST_CHECK(writeBlock(2, &second, page));
+  TEST_CHECK(startCompaction(&first, NULL, NULL, NULL));
+  TEST_CHECK(closePageFile(&second));
+  ASSERT_ERROR(writeBlock(0, &first, page), "compaction of the other handle should go on");
+  do {
+    TEST_CHECK(compactStep(&first, 1, &compactStats));
+  } while (!compactStats.done);
+  TEST_CHECK(readFirstBlock(&first, page));
+  ASSERT_TRUE(page[0] == 'd', "compaction should move the page written through the shared handle");
+  TEST_CHECK(startCompaction(&first, NULL, NULL, NULL));
+  TEST_CHECK(closePageFile(&first));
+  TEST_CHECK(openPageFile("test_cat_3.bin", &second));
+  TEST_CHECK(writeBlock(0, &second, page));
+  TEST_CHECK(closePageFile(&second));
+  TEST_CHECK(getCatalogStats(catalog, &stats));
+  ASSERT_TRUE(stats.files == 16 && stats.sharedOpens == 5, "plain opens should be served by the catalog");
+
+  // Destroying a file the catalog holds closes it there, so a file created under its path is opened afresh
+  TEST_CHECK(destroyPageFile("test_cat_9.bin"));
+  TEST_CHECK(getCatalogStats(catalog, &stats));
+  ASSERT_TRUE(stats.files == 15 && stats.manifestEntries == 15, "catalog should forget the destroyed file");
+  TEST_CHECK(createPageFile("test_cat_9.bin"));
+  TEST_CHECK(openPageFile("test_cat_9.bin", &first));
+  ASSERT_EQUALS_INT(1, first.totalNumPages, "new file should not share the destroyed one");
+  TEST_CHECK(catalogOpenFile(catalog, "test_cat_9.bin", &second));
+  ASSERT_TRUE(second.totalNumPages == 1 && second.mgmtInfo != first.mgmtInfo, "catalog should open the new file");
+  TEST_CHECK(closePageFile(&first));
+  TEST_CHECK(closePageFile(&second));
+  TEST_CHECK(getCatalogStats(catalog, &stats));
+  ASSERT_TRUE(stats.files == 16 && stats.fileOpens == 17 && stats.sharedOpens == 5, "new file should be opened once");
+  ASSERT_TRUE(catalogOpenFile(catalog, "test_cat_missing.bin", &first) == RC_FILE_NOT_FOUND, "missing file should not open");
+  TEST_CHECK(closeCatalog(catalog));
+
+  // A new catalog answers from the manifest until a file changes
+  TEST_CHECK(openCatalog("test_cat.manifest", &catalog));
+  TEST_CHECK(catalogLookup(catalog, "test_cat_7.bin", &info));
+  ASSERT_TRUE(!info.open && info.totalNumPages == 8 && info.pageSize == PAGE_SIZE, "manifest should know the file");
+  TEST_CHECK(openPageFile("test_cat_7.bin", &first));
+  TEST_CHECK(appendEmptyBlock(&first));
+  TEST_CHECK(closePageFile(&first));
+  TEST_CHECK(catalogLookup(catalog, "test_cat_7.bin", &info));
+  ASSERT_EQUALS_INT(9, info.totalNumPages, "changed file should be read again");
+  TEST_CHECK(catalogLookup(catalog, "test_cat_7.bin", &info));
+  TEST_CHECK(getCatalogStats(catalog, &stats));
+  ASSERT_TRUE(stats.manifestEntries == 16 && stats.manifestHits == 2 && stats.manifestMisses == 1,
+              "only the changed file should miss");
+  ASSERT_TRUE(stats.files == 0, "lookups should not keep files open");
+  TEST_CHECK(closeCatalog(catalog));
+
+  for (i = 0; i < 16; i++) {
+    TEST_CHECK(destroyPageFile(names[i]));
+    free(names[i]);
+  }
+  unlink("test_cat.manifest");
+  free(page);
+
+  TEST_DONE();
+}
+
+/* Reads pages through a handle until told to stop, while another handle sharing the file
+ * drops and recreates the file's profiler or cold tier. */
+typedef struct SharedReader {
+  SM_FileHandle *fh;
+  int stop;
+  long reads;
+} SharedReader;
+
+static void *readSharedPages(void *arg)
+{
+  SharedReader *reader = (SharedReader *) arg;
+  char page[PAGE_SIZE];
+
+  while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE))
+    if (readBlock((int) (reader->reads % 16), reader->fh, page) == RC_OK)
+      reader->reads++;
+  return arg;
+}
+
+void testColdTier(void)
+{
+  SM_FileHandle fh, other;
+  SM_ColdTierStats stats;
+  SharedReader reader;
+  pthread_t thread;
+  SM_MemConsumerStats fileStats;
+  SM_PageHandle pages = (SM_PageHandle) malloc(64 * PAGE_SIZE);
+  SM_PageHandle page = (SM_PageHandle) malloc(PAGE_SIZE);
+  long long held;
+  int i, j, same;
+
+  testName = "test Cold Tier";
+
+  // 16 zero pages, 16 filled with one byte, 16 of text and 16 of noise
+  memset(pages, 0, 32 * PAGE_SIZE);
+  memset(pages + 16 * PAGE_SIZE, 'x', 16 * PAGE_SIZE);
+  for (i = 32; i < 48; i++) {
+    for (j = 0; j + 32 <= PAGE_SIZE; j += 32) {
+      sprintf(pages + i * PAGE_SIZE + j, "record %06d of page %04d;   ", j / 32, i);
+    }
+  }
+  srand(48);
+  for (i = 48 * PAGE_SIZE; i < 64 * PAGE_SIZE; i++) {
+    pages[i] = (char) rand();
+  }
+  TEST_CHECK(createPageFile("test_cold.bin"));
+  TEST_CHECK(openPageFile("test_cold.bin", &fh));
+  TEST_CHECK(ensureCapacity(64, &fh));
+  TEST_CHECK(enableColdTier(&fh, 0));
+  for (i = 0; i < 64; i++) {
+    TEST_CHECK(writeBlock(i, &fh, pages + i * PAGE_SIZE));
+  }
+  TEST_CHECK(getColdTierStats(&fh, &stats));
+  ASSERT_TRUE(stats.pages == 48 && stats.zeroPages == 16 && stats.sameFilledPages == 16, "compressible pages should be kept");
+  ASSERT_EQUALS_INT(16, (int) stats.rejected, "noise should not be kept");
+  ASSERT_TRUE(stats.bytes * 3 < 48LL * PAGE_SIZE, "kept pages should take a third of their size");
+  TEST_CHECK(getFileMemoryStats(&fh, &fileStats));
+  ASSERT_TRUE(fileStats.used == stats.bytes, "tier should be charged to the file");
+
+  // Kept pages are read from the tier, the others from the file
+  for (i = 0, same = 0; i < 64; i++) {
+    TEST_CHECK(readBlock(i, &fh, page));
+    same += memcmp(page, pages + i * PAGE_SIZE, PAGE_SIZE) == 0;
+  }
+  ASSERT_EQUALS_INT(64, same, "every page should read back as written");
+  TEST_CHECK(getColdTierStats(&fh, &stats));
+  ASSERT_TRUE(stats.hits == 48 && stats.misses == 16, "only noise should miss");
+
+  // A scan write drops the old copies
+  TEST_CHECK(setWriteDedup(&fh, 0));
+  TEST_CHECK(writeBlocks(16, 4, &fh, pages + 32 * PAGE_SIZE));
+  TEST_CHECK(readBlock(17, &fh, page));
+  ASSERT_TRUE(memcmp(page, pages + 33 * PAGE_SIZE, PAGE_SIZE) == 0, "page written by a scan should be read from the file");
+  TEST_CHECK(getColdTierStats(&fh, &stats));
+  ASSERT_TRUE(stats.misses == 17 && stats.pages == 45, "scan should drop the pages it wrote");
+
+  // A shared handle uses the same tier
+  TEST_CHECK(sharePageFile(&fh, &other));
+  TEST_CHECK(readBlock(40, &other, page));
+  TEST_CHECK(getColdTierStats(&other, &stats));
+  ASSERT_EQUALS_INT(49, (int) stats.hits, "shared handle should hit");
+  TEST_CHECK(closePageFile(&other));
+
+  // A lower budget takes memory back from the tier
+  held = stats.bytes;
+  TEST_CHECK(setMemoryBudget(held / 2));
+  TEST_CHECK(getColdTierStats(&fh, &stats));
+  ASSERT_TRUE(stats.bytes <= held / 2 && stats.bytesShrunk >= held - held / 2, "tier should shrink to the budget");
+  ASSERT_TRUE(stats.evictions > 0, "oldest pages should be dropped");
+  TEST_CHECK(setMemoryBudget(MEMGOV_UNLIMITED));
+
+  // A small tier keeps only the newest pages
+  TEST_CHECK(disableColdTier(&fh));
+  TEST_CHECK(getFileMemoryStats(&fh, &fileStats));
+  ASSERT_TRUE(fileStats.used == 0, "disabling should release the tier");
+  TEST_CHECK(enableColdTier(&fh, 4096));
+  for (i = 32; i < 48; i++) {
+    TEST_CHECK(readBlock(i, &fh, page));
+  }
+  TEST_CHECK(getColdTierStats(&fh, &stats));
+  ASSERT_TRUE(stats.bytes <= 4096 && stats.evictions > 0 && stats.pages < 16, "tier should stay within its limit");
+  TEST_CHECK(readBlock(47, &fh, page));
+  ASSERT_TRUE(memcmp(page, pages + 47 * PAGE_SIZE, PAGE_SIZE) == 0, "newest page should be kept");
+  TEST_CHECK(getColdTierStats(&fh, &stats));
+  ASSERT_EQUALS_INT(1, (int) stats.hits, "newest page should hit");
+
+  // Disabling waits for reads through a shared handle that may still use the tier
+  TEST_CHECK(sharePageFile(&fh, &other));
+  reader.fh = &other;
+  reader.stop = 0;
+  reader.reads = 0;
+  ASSERT_TRUE(pthread_create(&thread, NULL, readSharedPages, &reader) == 0, "thread should start");
+  for (i = 0; i < 200; i++) {
+    TEST_CHECK(disableColdTier(&fh));
+    sched_yield();
+    TEST_CHECK(enableColdTier(&fh, 0));
+  }
+  __atomic_store_n(&reader.stop, 1, __ATOMIC_RELEASE);
+  pthread_join(thread, NULL);
+  ASSERT_TRUE(reader.reads > 0, "shared handle should keep reading");
+  TEST_CHECK(closePageFile(&other));
+  TEST_CHECK(readBlock(20, &fh, page));
+  ASSERT_TRUE(memcmp(page, pages + 20 * PAGE_SIZE, PAGE_SIZE) == 0, "pages should still read back after the tier was swapped");
+
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("test_cold.bin"));
+  free(pages);
+  free(page);
+
+  TEST_DONE();
+}
+
+void testHeatProfile(void)
+{
+  SM_FileHandle fh, other;
+  SM_HeatProfile profile;
+  SharedReader reader;
+  pthread_t thread;
+  SM_PageHandle pages = (SM_PageHandle) calloc(256, PAGE_SIZE);
+  FILE *report;
+  char line[256];
+  int i, j, found = 0;
+
+  testName = "test Heat Profile";
+
+  TEST_CHECK(createPageFile("test_heat.bin"));
+  TEST_CHECK(openPageFile("test_heat.bin", &fh));
+  TEST_CHECK(ensureCapacity(256, &fh));
+  TEST_CHECK(startHeatProfile(&fh, 0));
+
+  // A scan, ten passes over eight pages and fifty writes of one page
+  TEST_CHECK(readBlocks(0, 256, &fh, pages));
+  for (i = 0; i < 10; i++) {
+    for (j = 0; j < 8; j++) {
+      TEST_CHECK(readBlock(100 + j, &fh, pages));
+    }
+  }
+  for (i = 0; i < 50; i++) {
+    TEST_CHECK(writeBlock(42, &fh, pages));
+  }
+  TEST_CHECK(getHeatProfile(&fh, &profile));
+  ASSERT_TRUE(profile.accesses == 386 && profile.reads == 336 && profile.writes == 50, "every access should be counted");
+  ASSERT_TRUE(profile.sequential == 255 + 70, "scan and passes should be sequential");
+  ASSERT_TRUE(profile.hotPages[0].pageNum == 42 && profile.hotPages[0].accesses == 51, "written page should be hottest");
+  ASSERT_TRUE(profile.hotPages[1].pageNum == 100 && profile.hotPages[8].pageNum == 107
+              && profile.hotPages[8].accesses == 11, "passed pages should follow");
+  ASSERT_TRUE(profile.coldAccesses == 256 && profile.reuse[0] == 49 && profile.reuse[3] == 72 && profile.reuse[8] == 9,
+              "reuse distances should be measured");
+  TEST_CHECK(dumpHeatProfile(&profile, "test_heat.txt"));
+  report = fopen("test_heat.txt", "r");
+  while (report != NULL && fgets(line, sizeof(line), report) != NULL) {
+    found += strstr(line, "        42           51") != NULL;
+  }
+  if (report != NULL) {
+    fclose(report);
+  }
+  ASSERT_EQUALS_INT(1, found, "report should list the hottest page");
+  TEST_CHECK(stopHeatProfile(&fh));
+  TEST_CHECK(readBlock(0, &fh, pages));
+  TEST_CHECK(getHeatProfile(&fh, &profile));
+  ASSERT_TRUE(profile.accesses == 386, "profile should stay after stopping");
+
+  // Sampled, the hottest page and the mix are still found
+  TEST_CHECK(startHeatProfile(&fh, 4));
+  srand(49);
+  for (i = 0; i < 4096; i++) {
+    TEST_CHECK(readBlock(i % 2 == 0 ? 5 : rand() % 256, &fh, pages));
+  }
+  TEST_CHECK(getHeatProfile(&fh, &profile));
+  ASSERT_TRUE(profile.accesses == 4096 && profile.reads == 4096, "exact counters should not be sampled");
+  ASSERT_TRUE(profile.hotPages[0].pageNum == 5 && profile.hotPages[0].accesses > 1536 && profile.hotPages[0].accesses < 2560,
+              "sampled count of the hottest page should be close");
+  TEST_CHECK(stopHeatProfile(&fh));
+  ASSERT_TRUE(startHeatProfile(&fh, 17) == RC_WRITE_FAILED, "shift out of range should fail");
+
+  // Stopping waits for reads through a shared handle that may still count pages
+  TEST_CHECK(sharePageFile(&fh, &other));
+  reader.fh = &other;
+  reader.stop = 0;
+  reader.reads = 0;
+  ASSERT_TRUE(pthread_create(&thread, NULL, readSharedPages, &reader) == 0, "thread should start");
+  for (i = 0; i < 200; i++) {
+    TEST_CHECK(startHeatProfile(&fh, 0));
+    sched_yield();
+    TEST_CHECK(stopHeatProfile(&fh));
+  }
+  __atomic_store_n(&reader.stop, 1, __ATOMIC_RELEASE);
+  pthread_join(thread, NULL);
+  ASSERT_TRUE(reader.reads > 0, "shared handle should keep reading");
+  TEST_CHECK(closePageFile(&other));
+
+  // A capture is profiled without replaying it
+  TEST_CHECK(startIoCapture("test_heat.cap"));
+  for (i = 0; i < 30; i++) {
+    TEST_CHECK(readBlock(i % 3, &fh, pages));
+  }
+  TEST_CHECK(writeBlock(3, &fh, pages));
+  TEST_CHECK(stopIoCapture());
+  TEST_CHECK(profileIoCapture("test_heat.cap", NULL, 0, &profile));
+  ASSERT_TRUE(profile.accesses == 31 && profile.writes == 1 && profile.reuse[2] == 27, "capture should be profiled");
+  TEST_CHECK(profileIoCapture("test_heat.cap", "test_heat.bin", 0, &profile));
+  ASSERT_TRUE(profile.accesses == 31, "the named file should be profiled");
+  ASSERT_ERROR(profileIoCapture("test_heat.cap", "test_missing.bin", 0, &profile), "a file the capture does not hold should fail");
+
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("test_heat.bin"));
+  unlink("test_heat.cap");
+  unlink("test_heat.txt");
+  free(pages);
+
+  TEST_DONE();
+}
+
+void testLargeObjects(void)
+{
+  SM_FileHandle fh;
+  SM_LOStore *store;
+  SM_LargeObject *a, *b, *c;
+  SM_LOStats stats, before;
+  SM_WriteStats writes, writesBefore;
+  int idA, idB, idC, n, i, pages;
+  int sizeA = 300 * 1024, sizeB = 0;
+  char *dataA = (char*) malloc(300 * 2048);
+  char *dataB = (char*) malloc(200000);
+  char *buf = (char*) malloc(300 * 2048);
+
+  testName = "test Large Objects";
+
+  for (i = 0; i < 300 * 2048; i++) {
+    dataA[i] = (char) (i * 7 + i / 4096);
+  }
+  for (i = 0; i < 200000; i++) {
+    dataB[i] = (char) (i * 13 + 1);
+  }
+  TEST_CHECK(createPageFile("test_lo.bin"));
+  TEST_CHECK(openPageFile("test_lo.bin", &fh));
+  TEST_CHECK(openLargeObjectStore(&fh, 16, &store));
+  TEST_CHECK(loCreate(store, &idA));
+  TEST_CHECK(loCreate(store, &idB));
+  ASSERT_TRUE(idA > 0 && idB > 0 && idA != idB, "objects should get distinct ids");
+  TEST_CHECK(loOpen(store, idA, &a));
+  TEST_CHECK(loOpen(store, idB, &b));
+
+  // Unaligned chunks of two objects written in turn
+  for (i = 0; i < sizeA; i += 30000) {
+    TEST_CHECK(loWrite(a, i, sizeA - i < 30000 ? sizeA - i : 30000, dataA + i));
+    TEST_CHECK(loWrite(b, sizeB, 10000, dataB + sizeB));
+    sizeB += 10000;
+  }
+  TEST_CHECK(getLargeObjectStats(a, &stats));
+  ASSERT_TRUE(stats.length == sizeA && stats.numPages == 75, "object should have its pages");
+  ASSERT_TRUE(stats.numRuns > 1 && stats.numRuns <= 5 && stats.directoryPages == 1, "pages should come in extent runs");
+  TEST_CHECK(loRead(a, 0, 400000, buf, &n));
+  ASSERT_TRUE(n == sizeA && memcmp(buf, dataA, sizeA) == 0, "object should read back");
+
+  // Whole pages are read into the caller's buffer, only the edges are buffered
+  TEST_CHECK(getLargeObjectStats(a, &before));
+  TEST_CHECK(loRead(a, 3 * PAGE_SIZE, 16 * PAGE_SIZE, buf, &n));
+  TEST_CHECK(getLargeObjectStats(a, &stats));
+  ASSERT_TRUE(n == 16 * PAGE_SIZE && memcmp(buf, dataA + 3 * PAGE_SIZE, n) == 0, "aligned range should read");
+  ASSERT_TRUE(stats.bytesBuffered == before.bytesBuffered && stats.ioCalls - before.ioCalls <= 2
+              && stats.pagesTransferred - before.pagesTransferred == 16, "aligned range should map to runs");
+  TEST_CHECK(loRead(a, 12345, 70000, buf, &n));
+  TEST_CHECK(getLargeObjectStats(a, &before));
+  ASSERT_TRUE(n == 70000 && memcmp(buf, dataA + 12345, n) == 0, "unaligned range should read");
+  ASSERT_TRUE(before.bytesBuffered - stats.bytesBuffered == (PAGE_SIZE - 12345 % PAGE_SIZE) + 425,
+              "only the partial pages should be buffered");
+  TEST_CHECK(loRead(a, sizeA - 100, 1000, buf, &n));
+  ASSERT_TRUE(n == 100 && memcmp(buf, dataA + sizeA - 100, 100) == 0, "read should stop at the end");
+  TEST_CHECK(loRead(a, sizeA + 1, 10, buf, &n));
+  ASSERT_EQUALS_INT(0, n, "read past the end should return nothing");
+
+  // Overwriting in place keeps the pages
+  memcpy(dataA + 5000, dataB, 10000);
+  TEST_CHECK(loWrite(a, 5000, 10000, dataB));
+  TEST_CHECK(loRead(a, 0, sizeA, buf, &n));
+  TEST_CHECK(getLargeObjectStats(a, &stats));
+  ASSERT_TRUE(stats.numPages == 75 && memcmp(buf, dataA, sizeA) == 0, "overwrite should land in place");
+
+  // With deduplication on, whole pages still go out with one writeBlocks call per run
+  TEST_CHECK(setWriteDedup(&fh, 1));
+  TEST_CHECK(loWrite(a, 3 * PAGE_SIZE, 16 * PAGE_SIZE, dataA + 3 * PAGE_SIZE));
+  TEST_CHECK(getWriteStats(&fh, &writesBefore));
+  TEST_CHECK(getLargeObjectStats(a, &before));
+  TEST_CHECK(loWrite(a, 3 * PAGE_SIZE, 16 * PAGE_SIZE, dataA + 3 * PAGE_SIZE));
+  TEST_CHECK(getLargeObjectStats(a, &stats));
+  TEST_CHECK(getWriteStats(&fh, &writes));
+  ASSERT_TRUE(stats.ioCalls - before.ioCalls <= 2 && writes.pagesWritten - writesBefore.pagesWritten >= 16
+              && writes.pagesSkipped == writesBefore.pagesSkipped, "runs should be written whole, not page by page");
+  TEST_CHECK(setWriteDedup(&fh, 0));
+
+  // Truncated pages are reused, and a gap reads as zeros even on reused pages
+  TEST_CHECK(loTruncate(a, 10000));
+  TEST_CHECK(getLargeObjectStats(a, &stats));
+  ASSERT_TRUE(stats.length == 10000 && stats.numPages == 3 && stats.numRuns == 1, "truncate should give pages back");
+  pages = fh.totalNumPages;
+  TEST_CHECK(loWrite(b, 150000, 100, dataB + 150000));
+  ASSERT_EQUALS_INT(pages, fh.totalNumPages, "released extents should be reused");
+  memset(dataB + sizeB, 0, 150000 - sizeB);
+  sizeB = 150100;
+  TEST_CHECK(loRead(b, 0, 200000, buf, &n));
+  ASSERT_TRUE(n == sizeB && memcmp(buf, dataB, sizeB) == 0, "gap should read as zeros");
+  TEST_CHECK(loClose(a));
+  TEST_CHECK(loClose(b));
+  TEST_CHECK(closeLargeObjectStore(store));
+  TEST_CHECK(closePageFile(&fh));
+
+  // Objects survive a reopen; deleted ones are gone and their pages reused
+  TEST_CHECK(openPageFile("test_lo.bin", &fh));
+  TEST_CHECK(openLargeObjectStore(&fh, 16, &store));
+  TEST_CHECK(loOpen(store, idA, &a));
+  TEST_CHECK(loOpen(store, idB, &b));
+  TEST_CHECK(loRead(a, 0, 400000, buf, &n));
+  ASSERT_TRUE(n == 10000 && memcmp(buf, dataA, n) == 0, "object should persist");
+  TEST_CHECK(loRead(b, 0, 400000, buf, &n));
+  ASSERT_TRUE(n == sizeB && memcmp(buf, dataB, n) == 0, "grown object should persist");
+  TEST_CHECK(loClose(b));
+  TEST_CHECK(loDelete(store, idB));
+  ASSERT_TRUE(loOpen(store, idB, &b) == RC_READ_NON_EXISTING_PAGE, "deleted object should not open");
+  ASSERT_TRUE(loOpen(store, 0, &b) == RC_READ_NON_EXISTING_PAGE, "page 0 is not an object");
+  TEST_CHECK(loCreate(store, &idC));
+  TEST_CHECK(loOpen(store, idC, &c));
+  TEST_CHECK(loWrite(c, 0, 150000, dataB));
+  ASSERT_EQUALS_INT(pages, fh.totalNumPages, "pages of the deleted object should be reused");
+  TEST_CHECK(loClose(a));
+  TEST_CHECK(loClose(c));
+  TEST_CHECK(closeLargeObjectStore(store));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("test_lo.bin"));
+
+  // A file with pages of its own is not turned into a store
+  TEST_CHECK(createPageFile("test_lo.bin"));
+  TEST_CHECK(openPageFile("test_lo.bin", &fh));
+  TEST_CHECK(ensureCapacity(3, &fh));
+  ASSERT_TRUE(openLargeObjectStore(&fh, 0, &store) == RC_WRITE_FAILED, "used file should be refused");
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("test_lo.bin"));
+
+  // Runs that do not fit on the header page continue on a directory page
+  TEST_CHECK(createPageFileWithPageSize("test_lo.bin", 2048));
+  TEST_CHECK(openPageFile("test_lo.bin", &fh));
+  TEST_CHECK(openLargeObjectStore(&fh, 1, &store));
+  TEST_CHECK(loCreate(store, &idA));
+  TEST_CHECK(loCreate(store, &idB));
+  TEST_CHECK(loOpen(store, idA, &a));
+  TEST_CHECK(loOpen(store, idB, &b));
+  for (i = 0; i < 300; i++) {
+    TEST_CHECK(loWrite(a, i * 2048, 2048, dataA + i * 2048));
+    TEST_CHECK(loWrite(b, i * 2048, 2048, dataB));
+  }
+  TEST_CHECK(loClose(a));
+  TEST_CHECK(loClose(b));
+  TEST_CHECK(closeLargeObjectStore(store));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(openPageFile("test_lo.bin", &fh));
+  TEST_CHECK(openLargeObjectStore(&fh, 1, &store));
+  TEST_CHECK(loOpen(store, idA, &a));
+  TEST_CHECK(getLargeObjectStats(a, &stats));
+  ASSERT_TRUE(stats.numRuns == 300 && stats.directoryPages == 2, "runs should overflow to a second page");
+  TEST_CHECK(loRead(a, 0, 300 * 2048, buf, &n));
+  ASSERT_TRUE(n == 300 * 2048 && memcmp(buf, dataA, n) == 0, "fragmented object should read back");
+  TEST_CHECK(loTruncate(a, 100 * 2048));
+  TEST_CHECK(getLargeObjectStats(a, &stats));
+  ASSERT_TRUE(stats.numRuns == 100 && stats.directoryPages == 1, "overflow page should be given back");
+  TEST_CHECK(loClose(a));
+  TEST_CHECK(closeLargeObjectStore(store));
+  TEST_CHECK(closePageFile(&fh));
+  TEST_CHECK(destroyPageFile("test_lo.bin"));
+
+  free(dataA);
+  free(dataB);
+  free(buf);
+
+  TEST_DONE();
+}
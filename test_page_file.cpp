@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "page_file.hpp"
+#include "sm_trace.h"
+#include "io_replay.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTPF "test_pagefile_cpp.bin"
+#define QUIETOUT "test_quiet_cpp.txt"
+
+/* Sends standard out to QUIETOUT until stopCapture returns the bytes written to it. */
+static int startCapture(void)
+{
+  fflush(stdout);
+  int saved = dup(1);
+  int fd = open(QUIETOUT, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  dup2(fd, 1);
+  close(fd);
+  return saved;
+}
+
+static long stopCapture(int saved)
+{
+  struct stat st;
+  fflush(stdout);
+  dup2(saved, 1);
+  close(saved);
+  long size = stat(QUIETOUT, &st) == 0 ? (long) st.st_size : -1;
+  unlink(QUIETOUT);
+  return size;
+}
+
+/* prototypes for test functions */
+static void testPageFileLifecycle(void);
+static void testPageBuffers(void);
+static void testPageRangeIteration(void);
+
+/* main function running all tests */
+int main (void)
+{
+  testName = (char *) "";
+
+  initStorageManager();
+
+  testPageFileLifecycle();
+  testPageBuffers();
+  testPageRangeIteration();
+  return 0;
+}
+
+/* Test: Opening, writing, moving and closing a PageFile with error codes instead of return codes. */
+void testPageFileLifecycle(void)
+{
+  std::error_code ec;
+  std::vector<std::byte> buffer(PAGE_SIZE, std::byte{'w'});
+
+  testName = (char *) "test PageFile life cycle";
+
+  ASSERT_TRUE(!sm::PageFile::create(TESTPF), "create should succeed");
+  sm::PageFile file = sm::PageFile::open(TESTPF, ec);
+  ASSERT_TRUE(!ec && file.isOpen(), "open should succeed");
+  ASSERT_EQUALS_INT(1, file.numPages(), "new file should have one page");
+  ASSERT_EQUALS_INT(PAGE_SIZE, file.pageSize(), "default page size expected");
+
+  ASSERT_TRUE(!file.write(0, buffer), "write from a span should succeed");
+  std::fill(buffer.begin(), buffer.end(), std::byte{0});
+  ASSERT_TRUE(!file.read(0, buffer), "read into a span should succeed");
+  ASSERT_TRUE(buffer[PAGE_SIZE - 1] == std::byte{'w'}, "page should round trip through spans");
+
+  ec = file.read(5, buffer);
+  ASSERT_TRUE(ec == sm::makeError(RC_READ_NON_EXISTING_PAGE), "missing page should map to its return code");
+  ASSERT_TRUE(ec.category() == sm::storageCategory(), "errors should be in the storage_mgr category");
+  ASSERT_TRUE(file.read(0, std::span<std::byte>(buffer).first(10)) == std::errc::invalid_argument, "short buffer should be rejected");
+
+  // Failures come back as codes without the C layer printing anything
+  int saved = startCapture();
+  ec = file.read(9, buffer);
+  sm::PageFile absent = sm::PageFile::open("missing_file.bin", ec);
+  long printed = stopCapture(saved);
+  ASSERT_TRUE(ec && printed == 0, "wrapper should not print diagnostics");
+  saved = startCapture();
+  readBlock(9, file.handle(), reinterpret_cast<char *>(buffer.data()));
+  printed = stopCapture(saved);
+  ASSERT_TRUE(printed > 0, "direct C calls should still print");
+  ASSERT_TRUE(sm::makeError(RC_MEMORY_BUDGET_EXCEEDED).message() == "memory budget exceeded", "every code should have a message");
+
+  // Moving hands the open file over; the moved-from object no longer owns it, and the
+  // handle background workers point to stays where it is
+  SM_FileHandle *handle = file.handle();
+  sm::PageFile moved = std::move(file);
+  ASSERT_TRUE(!file.isOpen() && moved.isOpen(), "move should transfer ownership");
+  ASSERT_TRUE(moved.handle() == handle, "handle should keep its address across a move");
+  ASSERT_TRUE(std::strcmp(moved.name(), TESTPF) == 0, "file name should survive the move");
+  ASSERT_TRUE(!moved.ensureCapacity(3), "ensureCapacity should succeed after the move");
+  ASSERT_EQUALS_INT(3, moved.numPages(), "file should have grown to 3 pages");
+  ASSERT_TRUE(file.append() == sm::makeError(RC_FILE_HANDLE_NOT_INIT), "moved-from file should report an error");
+  ASSERT_TRUE(!moved.close(), "close should succeed");
+  ASSERT_TRUE(!moved.close(), "closing twice should be harmless");
+  ASSERT_EQUALS_INT(0, getTraceEvents(nullptr, 0), "C headers should link from C++");
+
+  sm::PageFile missing = sm::PageFile::open("missing_file.bin", ec);
+  ASSERT_TRUE(ec == sm::makeError(RC_FILE_NOT_FOUND) && !missing.isOpen(), "missing file should not open");
+
+  ASSERT_TRUE(!sm::PageFile::destroy(TESTPF), "destroy should succeed");
+
+  TEST_DONE();
+}
+
+/* Test: Page buffers are aligned, zeroed and sized to the file's page size. */
+void testPageBuffers(void)
+{
+  std::error_code ec;
+
+  testName = (char *) "test Page buffers";
+
+  sm::Page page(PAGE_SIZE);
+  ASSERT_TRUE(page && page.size() == PAGE_SIZE, "arena page should be allocated");
+  ASSERT_TRUE(((unsigned long) page.handle()) % PAGE_SIZE == 0, "page should be page aligned");
+  ASSERT_TRUE(page.bytes()[0] == std::byte{0}, "new page should be zeroed");
+
+  sm::Page other = std::move(page);
+  ASSERT_TRUE(!page && other, "moving a page should transfer the buffer");
+
+  ASSERT_TRUE(!sm::PageFile::create("mem:cpp", 8192), "memory file with 8 KiB pages should be created");
+  sm::PageFile file = sm::PageFile::open("mem:cpp", ec);
+  ASSERT_TRUE(!ec, "memory file should open");
+  sm::Page big = file.newPage();
+  ASSERT_EQUALS_INT(8192, big.size(), "newPage should use the file's page size");
+  std::memset(big.handle(), 'b', big.size());
+  ASSERT_TRUE(!file.write(0, big.bytes()), "write from a Page should succeed");
+  ASSERT_TRUE(file.read(0, other.bytes()) == std::errc::invalid_argument, "4 KiB buffer is too small for an 8 KiB page");
+  ASSERT_TRUE(!file.close(), "close should succeed");
+  ASSERT_TRUE(!sm::PageFile::destroy("mem:cpp"), "destroy should succeed");
+
+  TEST_DONE();
+}
+
+/* Test: Iterating over a page range reads every page into one reused buffer. */
+void testPageRangeIteration(void)
+{
+  std::error_code ec;
+  int expected = 0;
+
+  testName = (char *) "test PageRange iteration";
+
+  ASSERT_TRUE(!sm::PageFile::create(TESTPF), "create should succeed");
+  sm::PageFile file = sm::PageFile::open(TESTPF, ec);
+  ASSERT_TRUE(!file.ensureCapacity(5), "file should grow to 5 pages");
+  sm::Page page = file.newPage();
+  for (int i = 0; i < 5; i++) {
+    std::memset(page.handle(), 'a' + i, page.size());
+    ASSERT_TRUE(!file.write(i, page.bytes()), "write should succeed");
+  }
+
+  for (const sm::PageView &view : file.pages()) {
+    ASSERT_EQUALS_INT(expected, view.pageNum, "pages should come in order");
+    ASSERT_TRUE(view.bytes[0] == std::byte('a' + expected), "page content should match");
+    expected++;
+  }
+  ASSERT_EQUALS_INT(5, expected, "every page should be visited");
+
+  // A range past the end stops at the first missing page and reports why
+  sm::PageRange range = file.pages(3, 8);
+  expected = 3;
+  for (const sm::PageView &view : range) {
+    ASSERT_EQUALS_INT(expected, view.pageNum, "pages should come in order");
+    expected++;
+  }
+  ASSERT_EQUALS_INT(5, expected, "iteration should stop at the end of the file");
+  ASSERT_TRUE(range.error() == sm::makeError(RC_READ_NON_EXISTING_PAGE), "range should report the failed read");
+
+  ASSERT_TRUE(!file.close(), "close should succeed");
+  ASSERT_TRUE(!sm::PageFile::destroy(TESTPF), "destroy should succeed");
+
+  TEST_DONE();
+}